@@ -0,0 +1,288 @@
+#pragma once
+
+#include <podrm/cancellation.hpp>
+#include <podrm/metadata.hpp>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace podrm::async {
+
+struct AsyncDatabaseOptions {
+  /// Number of worker threads, each has its own connection
+  std::size_t workers = 4;
+};
+
+/// Limits and scheduling of a single operation
+struct OperationOptions {
+  /// Operation fails with OperationCancelled or OperationTimedOut once the
+  /// limits are exceeded, backends with Database::limit are also interrupted
+  /// while running
+  OperationLimits limits;
+
+  /// Operations of different lanes are started in round-robin order, so a
+  /// busy caller does not delay the others
+  std::uint64_t lane = 0;
+};
+
+/// Runs operations of a synchronous backend on a pool of worker threads,
+/// every worker owns a connection created by the factory
+template <typename Backend> class AsyncDatabase {
+public:
+  /// Creates the connections in the calling thread, so connection errors
+  /// are thrown from the constructor
+  template <typename Factory>
+    requires std::is_invocable_r_v<Backend, Factory &>
+  explicit AsyncDatabase(Factory connect,
+                         const AsyncDatabaseOptions options = {}) {
+    if (options.workers == 0) {
+      throw std::invalid_argument{"At least one worker is required"};
+    }
+
+    std::vector<Backend> connections;
+    connections.reserve(options.workers);
+    for (std::size_t i = 0; i < options.workers; ++i) {
+      connections.push_back(std::invoke(connect));
+    }
+
+    this->workers.reserve(options.workers);
+    try {
+      for (Backend &connection : connections) {
+        this->workers.emplace_back(
+            [this, connection = std::move(connection)]() mutable {
+              this->workLoop(connection);
+            });
+      }
+    } catch (...) {
+      // Joinable threads must not be destroyed
+      this->stop();
+      throw;
+    }
+  }
+
+  AsyncDatabase(const AsyncDatabase &) = delete;
+  AsyncDatabase(AsyncDatabase &&) = delete;
+  AsyncDatabase &operator=(const AsyncDatabase &) = delete;
+  AsyncDatabase &operator=(AsyncDatabase &&) = delete;
+
+  /// Runs the queued operations and stops the workers
+  ~AsyncDatabase() { this->stop(); }
+
+  /// Queues the function to be called with a connection in a worker thread
+  /// @returns future of the function result
+  template <typename Function>
+    requires std::is_invocable_v<Function &, Backend &>
+  std::future<std::invoke_result_t<Function &, Backend &>>
+  submit(Function function, OperationOptions options = {}) {
+    using Result = std::invoke_result_t<Function &, Backend &>;
+
+    auto operation = std::make_unique<TypedOperation<Result, Function>>(
+        std::move(function), std::move(options.limits));
+    std::future<Result> future = operation->promise.get_future();
+
+    {
+      const std::lock_guard lock{this->mutex};
+      std::deque<std::unique_ptr<Operation>> &lane =
+          this->lanes[options.lane];
+      if (lane.empty()) {
+        this->activeLanes.push_back(options.lane);
+      }
+      lane.push_back(std::move(operation));
+    }
+    this->notEmpty.notify_one();
+
+    return future;
+  }
+
+  /// @returns future of the persisted entity, including its generated key
+  template <DatabaseEntity Entity>
+  std::future<Entity> persist(Entity entity, OperationOptions options = {}) {
+    return this->submit(
+        [entity = std::move(entity)](Backend &backend) mutable {
+          backend.persist(entity);
+          return entity;
+        },
+        std::move(options));
+  }
+
+  template <DatabaseEntity Entity>
+  std::future<std::optional<Entity>> find(PrimaryKeyType<Entity> key,
+                                          OperationOptions options = {}) {
+    return this->submit(
+        [key = std::move(key)](Backend &backend) {
+          return backend.template find<Entity>(key);
+        },
+        std::move(options));
+  }
+
+  template <DatabaseEntity Entity>
+  std::future<void> update(Entity entity, OperationOptions options = {}) {
+    return this->submit(
+        [entity = std::move(entity)](Backend &backend) {
+          backend.update(entity);
+        },
+        std::move(options));
+  }
+
+  template <DatabaseEntity Entity>
+  std::future<void> erase(PrimaryKeyType<Entity> key,
+                          OperationOptions options = {}) {
+    return this->submit(
+        [key = std::move(key)](Backend &backend) {
+          backend.template erase<Entity>(key);
+        },
+        std::move(options));
+  }
+
+  /// Iterates the table in a worker
+  /// @returns future of all entities of the table
+  template <DatabaseEntity Entity>
+  std::future<std::vector<Entity>> iterate(OperationOptions options = {}) {
+    return this->submit(
+        [](Backend &backend) {
+          std::vector<Entity> entities;
+          for (Entity entity : backend.template iterate<Entity>()) {
+            entities.push_back(std::move(entity));
+          }
+          return entities;
+        },
+        std::move(options));
+  }
+
+  /// @returns number of operations that are not started yet
+  [[nodiscard]] std::size_t queued() const {
+    const std::lock_guard lock{this->mutex};
+    std::size_t count = 0;
+    for (const auto &[id, lane] : this->lanes) {
+      count += lane.size();
+    }
+    return count;
+  }
+
+private:
+  class Operation {
+  public:
+    Operation() = default;
+    Operation(const Operation &) = delete;
+    Operation(Operation &&) = delete;
+    Operation &operator=(const Operation &) = delete;
+    Operation &operator=(Operation &&) = delete;
+    virtual ~Operation() = default;
+
+    /// Runs the operation and completes its future
+    virtual void run(Backend &backend) = 0;
+  };
+
+  template <typename Result, typename Function>
+  class TypedOperation final : public Operation {
+  public:
+    TypedOperation(Function function, OperationLimits limits)
+        : function(std::move(function)), limits(std::move(limits)) {}
+
+    void run(Backend &backend) override {
+      try {
+        this->limits.check();
+        // Backends that support limits also interrupt running statements
+        if constexpr (requires { backend.limit(this->limits); }) {
+          const auto scope = backend.limit(this->limits);
+          this->invoke(backend);
+        } else {
+          this->invoke(backend);
+        }
+      } catch (...) {
+        this->promise.set_exception(std::current_exception());
+      }
+    }
+
+    std::promise<Result> promise;
+
+  private:
+    Function function;
+
+    OperationLimits limits;
+
+    void invoke(Backend &backend) {
+      if constexpr (std::is_void_v<Result>) {
+        std::invoke(this->function, backend);
+        this->promise.set_value();
+      } else {
+        this->promise.set_value(std::invoke(this->function, backend));
+      }
+    }
+  };
+
+  mutable std::mutex mutex;
+
+  std::condition_variable notEmpty;
+
+  /// Queued operations of every lane with operations
+  std::unordered_map<std::uint64_t, std::deque<std::unique_ptr<Operation>>>
+      lanes;
+
+  /// Lanes with queued operations in the order they are served
+  std::deque<std::uint64_t> activeLanes;
+
+  bool stopping = false;
+
+  std::vector<std::thread> workers;
+
+  /// Waits for the next operation in round-robin lane order
+  /// @returns nullptr if the database is stopping and nothing is queued
+  std::unique_ptr<Operation> pop() {
+    std::unique_lock lock{this->mutex};
+    this->notEmpty.wait(lock, [this] {
+      return !this->activeLanes.empty() || this->stopping;
+    });
+    if (this->activeLanes.empty()) {
+      return nullptr;
+    }
+
+    const std::uint64_t id = this->activeLanes.front();
+    this->activeLanes.pop_front();
+
+    const auto lane = this->lanes.find(id);
+    std::unique_ptr<Operation> operation = std::move(lane->second.front());
+    lane->second.pop_front();
+    if (lane->second.empty()) {
+      this->lanes.erase(lane);
+    } else {
+      this->activeLanes.push_back(id);
+    }
+
+    return operation;
+  }
+
+  /// Lets the workers run the queued operations and joins them
+  void stop() {
+    {
+      const std::lock_guard lock{this->mutex};
+      this->stopping = true;
+    }
+    this->notEmpty.notify_all();
+    for (std::thread &worker : this->workers) {
+      worker.join();
+    }
+  }
+
+  void workLoop(Backend &connection) {
+    while (const std::unique_ptr<Operation> operation = this->pop()) {
+      operation->run(connection);
+    }
+  }
+};
+
+} // namespace podrm::async
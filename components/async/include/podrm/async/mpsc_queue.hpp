@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+
+namespace podrm::async {
+
+/// Bounded lock-free queue for multiple producers and a single consumer.
+/// Every cell has a sequence number that tells whether it can be written or
+/// read in the current lap, so producers only contend on the enqueue index
+template <typename T> class MpscQueue {
+public:
+  /// @param capacity maximum number of elements, rounded up to a power of two
+  explicit MpscQueue(const std::size_t capacity)
+      : mask(roundUp(capacity) - 1),
+        cells(std::make_unique<Cell[]>(this->mask + 1)) {
+    for (std::size_t i = 0; i <= this->mask; ++i) {
+      this->cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  MpscQueue(const MpscQueue &) = delete;
+  MpscQueue(MpscQueue &&) = delete;
+  MpscQueue &operator=(const MpscQueue &) = delete;
+  MpscQueue &operator=(MpscQueue &&) = delete;
+  ~MpscQueue() = default;
+
+  /// Can be called from any thread
+  /// @returns false if the queue is full, the value is left untouched
+  bool tryPush(T &value) {
+    std::size_t position = this->enqueuePos.load(std::memory_order_relaxed);
+    while (true) {
+      Cell &cell = this->cells[position & this->mask];
+      const std::size_t sequence =
+          cell.sequence.load(std::memory_order_acquire);
+      const auto difference = static_cast<std::intptr_t>(sequence) -
+                              static_cast<std::intptr_t>(position);
+
+      if (difference == 0) {
+        if (this->enqueuePos.compare_exchange_weak(
+                position, position + 1, std::memory_order_relaxed)) {
+          cell.value = std::move(value);
+          cell.sequence.store(position + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (difference < 0) {
+        return false;
+      } else {
+        position = this->enqueuePos.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /// Must only be called from the consumer thread
+  std::optional<T> tryPop() {
+    const std::size_t position =
+        this->dequeuePos.load(std::memory_order_relaxed);
+    Cell &cell = this->cells[position & this->mask];
+    const std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+    if (sequence != position + 1) {
+      return std::nullopt;
+    }
+
+    std::optional<T> result{std::move(cell.value)};
+    cell.value = T{};
+    cell.sequence.store(position + this->mask + 1, std::memory_order_release);
+    this->dequeuePos.store(position + 1, std::memory_order_relaxed);
+
+    return result;
+  }
+
+  /// @returns approximate number of queued elements
+  [[nodiscard]] std::size_t size() const {
+    const std::size_t dequeued =
+        this->dequeuePos.load(std::memory_order_relaxed);
+    const std::size_t enqueued =
+        this->enqueuePos.load(std::memory_order_relaxed);
+    return enqueued > dequeued ? enqueued - dequeued : 0;
+  }
+
+  [[nodiscard]] std::size_t capacity() const { return this->mask + 1; }
+
+private:
+  // Not std::hardware_destructive_interference_size, it is missing in libc++
+  static constexpr std::size_t CacheLine = 64;
+
+  struct Cell {
+    std::atomic<std::size_t> sequence;
+    T value{};
+  };
+
+  const std::size_t mask;
+
+  std::unique_ptr<Cell[]> cells;
+
+  alignas(CacheLine) std::atomic<std::size_t> enqueuePos{0};
+
+  alignas(CacheLine) std::atomic<std::size_t> dequeuePos{0};
+
+  static std::size_t roundUp(const std::size_t capacity) {
+    std::size_t result = 2;
+    while (result < capacity) {
+      result *= 2;
+    }
+    return result;
+  }
+};
+
+} // namespace podrm::async
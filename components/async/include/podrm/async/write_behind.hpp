@@ -0,0 +1,377 @@
+#pragma once
+
+#include <podrm/async/mpsc_queue.hpp>
+#include <podrm/metadata.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace podrm::async {
+
+/// Database that can batch operations into transactions, with savepoints
+/// to undo single operations of a batch
+template <typename Backend>
+concept TransactionalBackend = requires(Backend &backend) {
+  { backend.begin() };
+  { backend.begin().commit() };
+  { backend.savepoint().release() };
+  { backend.savepoint().rollback() };
+};
+
+struct WriteBehindOptions {
+  /// Maximum number of queued operations, producers wait while the queue is
+  /// full
+  std::size_t queueCapacity = 4096;
+
+  /// Maximum number of operations committed in a single transaction
+  std::size_t maxBatchSize = 256;
+
+  /// Maximum time the first operation of a batch waits for the others
+  std::chrono::microseconds maxBatchDelay{2000};
+};
+
+struct WriteBehindMetrics {
+  /// Number of operations waiting in the queue
+  std::size_t queueDepth;
+
+  std::uint64_t committedBatches;
+
+  /// Number of committed operations, excluding failed ones
+  std::uint64_t committedOperations;
+
+  /// Duration of the last commit
+  std::chrono::nanoseconds lastCommitLatency;
+
+  /// Longest commit duration
+  std::chrono::nanoseconds maxCommitLatency;
+};
+
+/// Applies write operations to the backend from a dedicated writer thread.
+/// Operations are grouped into transactions bounded by
+/// WriteBehindOptions::maxBatchSize and WriteBehindOptions::maxBatchDelay,
+/// futures are completed after the transaction is committed. Every
+/// operation runs in its own savepoint, so a failing operation fails only
+/// its own future and none of its changes are committed
+template <TransactionalBackend Backend> class WriteBehind {
+public:
+  explicit WriteBehind(Backend backend, const WriteBehindOptions options = {})
+      : backend(std::move(backend)), options(options),
+        queue(options.queueCapacity),
+        writer([this] { this->writeLoop(); }) {}
+
+  WriteBehind(const WriteBehind &) = delete;
+  WriteBehind(WriteBehind &&) = delete;
+  WriteBehind &operator=(const WriteBehind &) = delete;
+  WriteBehind &operator=(WriteBehind &&) = delete;
+
+  /// Commits all queued operations and stops the writer thread
+  ~WriteBehind() {
+    {
+      const std::lock_guard lock{this->mutex};
+      this->stopping = true;
+    }
+    this->notEmpty.notify_one();
+    this->writer.join();
+  }
+
+  /// Queues the function to be called with the backend in the writer thread
+  /// @returns future of the function result, ready after the commit
+  template <typename Function>
+    requires std::is_invocable_v<Function &, Backend &>
+  std::future<std::invoke_result_t<Function &, Backend &>>
+  submit(Function function) {
+    using Result = std::invoke_result_t<Function &, Backend &>;
+
+    auto operation = std::make_unique<TypedOperation<Result, Function>>(
+        std::move(function));
+    std::future<Result> future = operation->promise.get_future();
+
+    this->push(std::move(operation));
+
+    return future;
+  }
+
+  /// @returns future of the persisted entity, including its generated key
+  template <DatabaseEntity Entity> std::future<Entity> persist(Entity entity) {
+    return this->submit(
+        [entity = std::move(entity)](Backend &backend) mutable {
+          backend.persist(entity);
+          return entity;
+        });
+  }
+
+  template <DatabaseEntity Entity>
+  std::future<void> update(Entity entity) {
+    return this->submit([entity = std::move(entity)](Backend &backend) {
+      backend.update(entity);
+    });
+  }
+
+  template <DatabaseEntity Entity>
+  std::future<void> erase(PrimaryKeyType<Entity> key) {
+    return this->submit([key = std::move(key)](Backend &backend) {
+      backend.template erase<Entity>(key);
+    });
+  }
+
+  /// @returns future that is ready once all previously queued operations are
+  /// committed
+  std::future<void> flush() {
+    return this->submit([](Backend & /*backend*/) {});
+  }
+
+  [[nodiscard]] WriteBehindMetrics metrics() const {
+    return WriteBehindMetrics{
+        .queueDepth = this->queue.size(),
+        .committedBatches =
+            this->committedBatches.load(std::memory_order_relaxed),
+        .committedOperations =
+            this->committedOperations.load(std::memory_order_relaxed),
+        .lastCommitLatency = std::chrono::nanoseconds{
+            this->lastCommitLatency.load(std::memory_order_relaxed)},
+        .maxCommitLatency = std::chrono::nanoseconds{
+            this->maxCommitLatency.load(std::memory_order_relaxed)},
+    };
+  }
+
+private:
+  class Operation {
+  public:
+    Operation() = default;
+    Operation(const Operation &) = delete;
+    Operation(Operation &&) = delete;
+    Operation &operator=(const Operation &) = delete;
+    Operation &operator=(Operation &&) = delete;
+    virtual ~Operation() = default;
+
+    /// Applies the operation inside the batch transaction, failures are kept
+    /// for this operation only
+    /// @returns false if the operation failed
+    virtual bool apply(Backend &backend) = 0;
+
+    /// Completes the future after the batch transaction is finished
+    /// @param failure commit failure, if any
+    virtual void complete(std::exception_ptr failure) = 0;
+  };
+
+  template <typename Result, typename Function>
+  class TypedOperation final : public Operation {
+  public:
+    explicit TypedOperation(Function function)
+        : function(std::move(function)) {}
+
+    bool apply(Backend &backend) override {
+      try {
+        if constexpr (std::is_void_v<Result>) {
+          std::invoke(this->function, backend);
+        } else {
+          this->result.emplace(std::invoke(this->function, backend));
+        }
+        return true;
+      } catch (...) {
+        this->failure = std::current_exception();
+        return false;
+      }
+    }
+
+    void complete(const std::exception_ptr failure) override {
+      if (this->failure == nullptr && failure != nullptr) {
+        this->failure = failure;
+      }
+
+      if (this->failure != nullptr) {
+        this->promise.set_exception(this->failure);
+      } else if constexpr (std::is_void_v<Result>) {
+        this->promise.set_value();
+      } else {
+        this->promise.set_value(std::move(*this->result));
+      }
+    }
+
+    std::promise<Result> promise;
+
+  private:
+    Function function;
+
+    std::conditional_t<std::is_void_v<Result>, bool, std::optional<Result>>
+        result{};
+
+    std::exception_ptr failure;
+  };
+
+  Backend backend;
+
+  WriteBehindOptions options;
+
+  MpscQueue<std::unique_ptr<Operation>> queue;
+
+  std::mutex mutex;
+
+  /// Wakes up the writer waiting for operations
+  std::condition_variable notEmpty;
+
+  /// Wakes up producers waiting for free space in the queue
+  std::condition_variable notFull;
+
+  /// Guarded by the mutex, like the waiting flags and counters below
+  bool stopping = false;
+
+  bool writerWaiting = false;
+
+  std::size_t producersWaiting = 0;
+
+  std::atomic<std::uint64_t> committedBatches{0};
+
+  std::atomic<std::uint64_t> committedOperations{0};
+
+  std::atomic<std::int64_t> lastCommitLatency{0};
+
+  std::atomic<std::int64_t> maxCommitLatency{0};
+
+  std::thread writer;
+
+  void push(std::unique_ptr<Operation> operation) {
+    if (!this->queue.tryPush(operation)) {
+      std::unique_lock lock{this->mutex};
+      ++this->producersWaiting;
+      this->notFull.wait(lock, [this, &operation] {
+        return this->queue.tryPush(operation);
+      });
+      --this->producersWaiting;
+    }
+
+    // Writer checks the queue under the mutex before it waits, so the
+    // operation is either seen there or notified
+    bool writerWaiting = false;
+    {
+      const std::lock_guard lock{this->mutex};
+      writerWaiting = this->writerWaiting;
+    }
+    if (writerWaiting) {
+      this->notEmpty.notify_one();
+    }
+  }
+
+  /// Waits for an operation until the deadline, or until stopping without
+  /// one
+  /// @returns nullptr if there are no operations
+  std::unique_ptr<Operation> pop(
+      const std::optional<std::chrono::steady_clock::time_point> deadline) {
+    std::optional<std::unique_ptr<Operation>> operation = this->queue.tryPop();
+    if (!operation.has_value()) {
+      std::unique_lock lock{this->mutex};
+      this->writerWaiting = true;
+      const auto ready = [this, &operation] {
+        operation = this->queue.tryPop();
+        return operation.has_value() || this->stopping;
+      };
+      if (deadline.has_value()) {
+        this->notEmpty.wait_until(lock, *deadline, ready);
+      } else {
+        this->notEmpty.wait(lock, ready);
+      }
+      this->writerWaiting = false;
+    }
+
+    if (!operation.has_value()) {
+      return nullptr;
+    }
+
+    bool producersWaiting = false;
+    {
+      const std::lock_guard lock{this->mutex};
+      producersWaiting = this->producersWaiting != 0;
+    }
+    if (producersWaiting) {
+      this->notFull.notify_all();
+    }
+
+    return std::move(*operation);
+  }
+
+  void writeLoop() {
+    std::vector<std::unique_ptr<Operation>> batch;
+    while (true) {
+      std::unique_ptr<Operation> first = this->pop(std::nullopt);
+      if (first == nullptr) {
+        const std::lock_guard lock{this->mutex};
+        if (this->stopping && this->queue.size() == 0) {
+          return;
+        }
+        continue;
+      }
+
+      batch.push_back(std::move(first));
+      const auto deadline =
+          std::chrono::steady_clock::now() + this->options.maxBatchDelay;
+      while (batch.size() < this->options.maxBatchSize) {
+        std::unique_ptr<Operation> next = this->pop(deadline);
+        if (next == nullptr) {
+          break;
+        }
+        batch.push_back(std::move(next));
+      }
+
+      this->commit(batch);
+      batch.clear();
+    }
+  }
+
+  void commit(const std::vector<std::unique_ptr<Operation>> &batch) {
+    const auto start = std::chrono::steady_clock::now();
+
+    std::exception_ptr failure;
+    std::uint64_t succeeded = 0;
+    try {
+      auto transaction = this->backend.begin();
+      for (const std::unique_ptr<Operation> &operation : batch) {
+        auto savepoint = this->backend.savepoint();
+        if (operation->apply(this->backend)) {
+          savepoint.release();
+          ++succeeded;
+        } else {
+          savepoint.rollback();
+        }
+      }
+      transaction.commit();
+    } catch (...) {
+      failure = std::current_exception();
+    }
+
+    const std::int64_t latency =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start)
+            .count();
+    this->lastCommitLatency.store(latency, std::memory_order_relaxed);
+    std::int64_t maxLatency =
+        this->maxCommitLatency.load(std::memory_order_relaxed);
+    while (maxLatency < latency &&
+           !this->maxCommitLatency.compare_exchange_weak(
+               maxLatency, latency, std::memory_order_relaxed)) {
+    }
+    if (failure == nullptr) {
+      this->committedBatches.fetch_add(1, std::memory_order_relaxed);
+      this->committedOperations.fetch_add(succeeded,
+                                          std::memory_order_relaxed);
+    }
+
+    for (const std::unique_ptr<Operation> &operation : batch) {
+      operation->complete(failure);
+    }
+  }
+};
+
+} // namespace podrm::async
@@ -0,0 +1,295 @@
+#include "field.hpp"
+
+#include <podrm/async/async_database.hpp>
+#include <podrm/async/mpsc_queue.hpp>
+#include <podrm/async/write_behind.hpp>
+#include <podrm/cancellation.hpp>
+#include <podrm/reflection.hpp>
+#include <podrm/sqlite.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+namespace orm = podrm::sqlite;
+
+namespace {
+
+struct Counter {
+  std::int64_t id;
+
+  std::int64_t hits;
+};
+
+/// Backend that fails to move into the worker of the second connection,
+/// after the first worker is started
+struct FragileBackend {
+  int index;
+
+  int moves = 0;
+
+  explicit FragileBackend(const int index) : index(index) {}
+
+  FragileBackend(const FragileBackend &) = delete;
+  FragileBackend(FragileBackend &&other)
+      : index(other.index), moves(other.moves + 1) {
+    // Moved into the connection list first, then into the worker
+    if (this->index == 1 && this->moves == 2) {
+      throw std::runtime_error{"Failed to start a worker"};
+    }
+  }
+  FragileBackend &operator=(const FragileBackend &) = delete;
+  FragileBackend &operator=(FragileBackend &&) = delete;
+  ~FragileBackend() = default;
+};
+
+} // namespace
+
+template <>
+constexpr auto podrm::EntityRegistration<Counter> =
+    podrm::EntityRegistrationData<Counter>{
+        .id = test::Field<Counter, &Counter::id>,
+        .idMode = IdMode::Auto,
+    };
+
+TEST_CASE("MpscQueue delivers values from every producer", "[async]") {
+  constexpr int Producers = 4;
+  constexpr int PerProducer = 1000;
+
+  podrm::async::MpscQueue<int> queue{64};
+  CHECK(queue.capacity() == 64);
+
+  std::vector<std::thread> producers;
+  for (int producer = 0; producer < Producers; ++producer) {
+    producers.emplace_back([&queue] {
+      for (int i = 1; i <= PerProducer; ++i) {
+        int value = i;
+        while (!queue.tryPush(value)) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  std::int64_t sum = 0;
+  for (int received = 0; received < Producers * PerProducer;) {
+    if (const std::optional<int> value = queue.tryPop()) {
+      sum += *value;
+      ++received;
+    }
+  }
+
+  for (std::thread &producer : producers) {
+    producer.join();
+  }
+
+  CHECK(sum == std::int64_t{Producers} * PerProducer * (PerProducer + 1) / 2);
+  CHECK_FALSE(queue.tryPop().has_value());
+}
+
+TEST_CASE("WriteBehind commits queued operations", "[async]") {
+  const std::filesystem::path path =
+      std::filesystem::temp_directory_path() / "podrm-write-behind.db";
+  std::filesystem::remove(path);
+
+  orm::Database reader = orm::Database::inFile(path);
+  REQUIRE_NOTHROW(reader.createTable<Counter>());
+
+  SECTION("operations are committed in batches") {
+    podrm::async::WriteBehind<orm::Database> writer{
+        orm::Database::inFile(path),
+        {.queueCapacity = 16, .maxBatchSize = 8},
+    };
+
+    std::vector<std::future<Counter>> persisted;
+    for (std::int64_t i = 0; i < 100; ++i) {
+      persisted.push_back(writer.persist(Counter{.id = 0, .hits = i}));
+    }
+
+    const Counter first = persisted.front().get();
+    CHECK(first.id != 0);
+
+    writer.update(Counter{.id = first.id, .hits = 1000}).get();
+    writer.erase<Counter>(persisted.back().get().id).get();
+
+    const podrm::async::WriteBehindMetrics metrics = writer.metrics();
+    CHECK(metrics.queueDepth == 0);
+    CHECK(metrics.committedOperations == 102);
+    CHECK(metrics.committedBatches < metrics.committedOperations);
+    CHECK(metrics.maxCommitLatency >= metrics.lastCommitLatency);
+
+    CHECK(reader.count<Counter>() == 99);
+    CHECK(reader.find<Counter>(first.id)->hits == 1000);
+  }
+
+  SECTION("producers and the writer wake each other up") {
+    constexpr int Producers = 4;
+    constexpr int PerProducer = 50;
+
+    podrm::async::WriteBehind<orm::Database> writer{
+        orm::Database::inFile(path),
+        {.queueCapacity = 2, .maxBatchSize = 1},
+    };
+
+    std::vector<std::thread> producers;
+    for (int producer = 0; producer < Producers; ++producer) {
+      producers.emplace_back([&writer] {
+        for (int i = 0; i < PerProducer; ++i) {
+          writer.persist(Counter{.id = 0, .hits = i}).get();
+        }
+      });
+    }
+    for (std::thread &producer : producers) {
+      producer.join();
+    }
+
+    CHECK(reader.count<Counter>() == Producers * PerProducer);
+  }
+
+  SECTION("failed operation does not fail the batch") {
+    podrm::async::WriteBehind<orm::Database> writer{
+        orm::Database::inFile(path),
+    };
+
+    std::future<void> erased = writer.erase<Counter>(42);
+    std::future<Counter> persisted = writer.persist(Counter{.id = 0});
+    writer.flush().get();
+
+    CHECK_THROWS_AS(erased.get(), std::runtime_error);
+    CHECK_NOTHROW(persisted.get());
+    CHECK(reader.count<Counter>() == 1);
+  }
+
+  SECTION("failed operation does not commit its changes") {
+    podrm::async::WriteBehind<orm::Database> writer{
+        orm::Database::inFile(path),
+    };
+
+    std::future<void> failed = writer.submit([](orm::Database &db) {
+      Counter counter{.id = 0, .hits = 1};
+      db.persist(counter);
+      throw std::runtime_error{"Failed after writing"};
+    });
+    std::future<Counter> persisted = writer.persist(Counter{.id = 0});
+    writer.flush().get();
+
+    CHECK_THROWS_AS(failed.get(), std::runtime_error);
+    CHECK(persisted.get().hits == 0);
+    CHECK(reader.count<Counter>() == 1);
+    CHECK(writer.metrics().committedOperations == 2);
+  }
+
+  SECTION("destruction commits queued operations") {
+    {
+      podrm::async::WriteBehind<orm::Database> writer{
+          orm::Database::inFile(path),
+      };
+      for (int i = 0; i < 10; ++i) {
+        writer.persist(Counter{.id = 0, .hits = i});
+      }
+    }
+
+    CHECK(reader.count<Counter>() == 10);
+  }
+}
+
+TEST_CASE("AsyncDatabase runs operations on workers", "[async]") {
+  const std::filesystem::path path =
+      std::filesystem::temp_directory_path() / "podrm-async-database.db";
+  std::filesystem::remove(path);
+
+  orm::Database::inFile(path).createTable<Counter>();
+
+  podrm::async::AsyncDatabase<orm::Database> db{
+      [&path] { return orm::Database::inFile(path); },
+      {.workers = 2},
+  };
+
+  SECTION("entity operations") {
+    const Counter persisted = db.persist(Counter{.id = 0, .hits = 1}).get();
+    CHECK(persisted.id != 0);
+
+    db.update(Counter{.id = persisted.id, .hits = 2}).get();
+    const std::optional<Counter> found = db.find<Counter>(persisted.id).get();
+    REQUIRE(found.has_value());
+    CHECK(found->hits == 2);
+
+    CHECK(db.iterate<Counter>().get().size() == 1);
+
+    db.erase<Counter>(persisted.id).get();
+    CHECK_FALSE(db.find<Counter>(persisted.id).get().has_value());
+    CHECK_THROWS_AS(db.erase<Counter>(persisted.id).get(), std::runtime_error);
+  }
+
+  SECTION("cancelled and expired operations are not started") {
+    podrm::CancellationSource source;
+    source.cancel();
+
+    std::future<Counter> cancelled = db.persist(
+        Counter{.id = 0}, {.limits = {.token = source.token()}});
+    std::future<Counter> expired = db.persist(
+        Counter{.id = 0},
+        {.limits = podrm::OperationLimits::timeout(std::chrono::seconds{-1})});
+
+    CHECK_THROWS_AS(cancelled.get(), podrm::OperationCancelled);
+    CHECK_THROWS_AS(expired.get(), podrm::OperationTimedOut);
+    CHECK(db.iterate<Counter>().get().empty());
+  }
+}
+
+TEST_CASE("AsyncDatabase serves lanes in turns", "[async]") {
+  podrm::async::AsyncDatabase<orm::Database> db{
+      [] { return orm::Database::inMemory("podrm-async-lanes"); },
+      {.workers = 1},
+  };
+
+  // Holds the only worker until every operation is queued
+  std::promise<void> started;
+  std::promise<void> release;
+  std::future<void> blocked =
+      db.submit([&started, released = release.get_future().share()](
+                    orm::Database & /*db*/) {
+        started.set_value();
+        released.wait();
+      });
+  started.get_future().wait();
+
+  std::vector<int> order;
+  std::vector<std::future<void>> done;
+  const auto record = [&order](const int value) {
+    return [&order, value](orm::Database & /*db*/) { order.push_back(value); };
+  };
+  for (int i = 0; i < 3; ++i) {
+    done.push_back(db.submit(record(10 + i), {.lane = 1}));
+  }
+  done.push_back(db.submit(record(20), {.lane = 2}));
+  CHECK(db.queued() == 4);
+
+  release.set_value();
+  blocked.get();
+  for (std::future<void> &future : done) {
+    future.get();
+  }
+
+  CHECK(order == std::vector{10, 20, 11, 12});
+}
+
+TEST_CASE("AsyncDatabase stops started workers if a worker fails to start",
+          "[async]") {
+  int connections = 0;
+  const auto connect = [&connections] {
+    return FragileBackend{connections++};
+  };
+
+  using Database = podrm::async::AsyncDatabase<FragileBackend>;
+  CHECK_THROWS_AS(Database(connect, {.workers = 2}), std::runtime_error);
+  CHECK(connections == 2);
+}
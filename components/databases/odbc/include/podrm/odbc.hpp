@@ -1,5 +1,8 @@
 #pragma once
 
-#include <podrm/odbc/cursor.hpp>      // IWYU pragma: export
-#include <podrm/odbc/database.hpp>    // IWYU pragma: export
-#include <podrm/odbc/environment.hpp> // IWYU pragma: export
+#include <podrm/odbc/cursor.hpp>              // IWYU pragma: export
+#include <podrm/odbc/database.hpp>            // IWYU pragma: export
+#include <podrm/odbc/environment.hpp>         // IWYU pragma: export
+#include <podrm/odbc/limit_scope.hpp>         // IWYU pragma: export
+#include <podrm/odbc/replicated_database.hpp> // IWYU pragma: export
+#include <podrm/odbc/transaction.hpp>         // IWYU pragma: export
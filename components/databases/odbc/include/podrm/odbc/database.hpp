@@ -1,13 +1,26 @@
 #pragma once
 
+#include <podrm/aggregate.hpp>
+#include <podrm/cancellation.hpp>
+#include <podrm/instrumentation.hpp>
 #include <podrm/metadata.hpp>
 #include <podrm/odbc/cursor.hpp>
 #include <podrm/odbc/detail/connection.hpp>
 #include <podrm/odbc/environment.hpp>
+#include <podrm/odbc/limit_scope.hpp>
+#include <podrm/odbc/transaction.hpp>
+#include <podrm/predicate.hpp>
 
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
 #include <optional>
+#include <ranges>
 #include <string_view>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
 namespace podrm::odbc {
 
@@ -26,6 +39,38 @@ public:
                                                              connectionString)};
   }
 
+  //---------------- Transactions ------------------//
+
+  /// Begins a transaction, operations of this database are a part of it
+  /// until it is committed or rolled back
+  [[nodiscard]] Transaction begin() { return Transaction{this->connection}; }
+
+  //---------------- Limits ------------------//
+
+  /// Statements of this database fail with OperationCancelled or
+  /// OperationTimedOut once the limits are exceeded, until the scope is
+  /// destroyed. The deadline is enforced by the driver query timeout
+  [[nodiscard]] LimitScope limit(OperationLimits limits) {
+    return LimitScope{this->connection, std::move(limits)};
+  }
+
+  /// Cancels the running statement with OperationCancelled, can be called
+  /// from any thread
+  void interrupt() { this->connection.interrupt(); }
+
+  /// @returns false if the connection to the server is lost
+  bool alive() { return this->connection.alive(); }
+
+  //---------------- Instrumentation ------------------//
+
+  /// Reports every statement with its timings to the observer, e.g. a
+  /// HistogramObserver. Statements are not timed without one
+  /// @param observer observer outliving the database, nullptr to stop
+  /// reporting
+  void setObserver(Observer *observer) {
+    this->connection.setObserver(observer);
+  }
+
   //---------------- Operations ------------------//
 
   template <DatabaseEntity T> void createTable() {
@@ -40,11 +85,29 @@ public:
     return this->connection.exists(DatabaseEntityDescription<T>.value());
   }
 
+  /// Inserts the entity, for IdMode::Auto the generated key is written back
   template <DatabaseEntity Entity> void persist(Entity &entity) {
     return this->connection.persist(DatabaseEntityDescription<Entity>.value(),
                                     &entity);
   }
 
+  /// Persists all entities of the range in a single transaction
+  template <std::ranges::forward_range Range>
+    requires DatabaseEntity<std::ranges::range_value_t<Range>> &&
+             std::is_same_v<std::ranges::range_reference_t<Range>,
+                            std::ranges::range_value_t<Range> &>
+  void persistMany(Range &&entities) {
+    using Entity = std::ranges::range_value_t<Range>;
+
+    std::vector<void *> pointers;
+    for (Entity &entity : entities) {
+      pointers.push_back(&entity);
+    }
+
+    this->connection.persistMany(DatabaseEntityDescription<Entity>.value(),
+                                 pointers);
+  }
+
   template <DatabaseEntity Entity>
   std::optional<Entity> find(const PrimaryKeyType<Entity> &key) {
     Entity result;
@@ -61,16 +124,203 @@ public:
     this->connection.erase(DatabaseEntityDescription<Entity>.value(), key);
   }
 
+  /// Erases the entities matching the predicate
+  /// @returns number of erased entities
+  template <DatabaseEntity Entity>
+  std::uint64_t eraseWhere(const Predicate<Entity> &where) {
+    return this->connection.eraseWhere(
+        DatabaseEntityDescription<Entity>.value(), where.conditions);
+  }
+
+  /// Erases the entities with the given keys, missing keys are ignored
+  /// @returns number of erased entities
+  template <DatabaseEntity Entity, std::ranges::input_range Range>
+    requires std::convertible_to<std::ranges::range_reference_t<Range>,
+                                 const PrimaryKeyType<Entity> &>
+  std::uint64_t eraseMany(Range &&keys) {
+    std::vector<AsImage> images;
+    for (const PrimaryKeyType<Entity> &key : keys) {
+      images.emplace_back(key);
+    }
+
+    return this->connection.eraseMany(DatabaseEntityDescription<Entity>.value(),
+                                      images);
+  }
+
+  /// Applies the assignments to the entities matching the predicate, e.g.
+  /// db.updateWhere(Column<&T::a> > 1, Column<&T::b>.set(2))
+  /// @returns number of updated entities
+  template <DatabaseEntity Entity, std::same_as<SetExpression<Entity>>... Sets>
+    requires(sizeof...(Sets) > 0)
+  std::uint64_t updateWhere(const Predicate<Entity> &where,
+                            const Sets &...sets) {
+    const std::array<Assignment, sizeof...(Sets)> assignments = {
+        sets.assignment...,
+    };
+
+    return this->connection.updateWhere(
+        DatabaseEntityDescription<Entity>.value(), where.conditions,
+        assignments);
+  }
+
   template <DatabaseEntity Entity> void update(const Entity &entity) {
     this->connection.update(DatabaseEntityDescription<Entity>.value(), &entity);
   }
 
+  /// Inserts the entity or updates it if an entity with the same primary key
+  /// already exists
+  template <DatabaseEntity Entity> void upsert(const Entity &entity) {
+    this->connection.upsert(DatabaseEntityDescription<Entity>.value(), &entity);
+  }
+
+  /// Upserts all entities of the range in a single transaction
+  template <std::ranges::forward_range Range>
+    requires DatabaseEntity<std::ranges::range_value_t<Range>> &&
+             std::is_lvalue_reference_v<std::ranges::range_reference_t<Range>>
+  void upsertMany(Range &&entities) {
+    using Entity = std::ranges::range_value_t<Range>;
+
+    std::vector<const void *> pointers;
+    for (const Entity &entity : entities) {
+      pointers.push_back(&entity);
+    }
+
+    this->connection.upsertMany(DatabaseEntityDescription<Entity>.value(),
+                                pointers);
+  }
+
+  /// Updates only the selected fields of the entity
+  template <DatabaseEntity Entity, FieldSelector... Fields>
+    requires(sizeof...(Fields) > 0)
+  void update(const Entity &entity, const Fields... fields) {
+    this->connection.update(DatabaseEntityDescription<Entity>.value(), &entity,
+                            makeFieldMask(fields...));
+  }
+
+  /// Updates only the fields that differ from the snapshot
+  /// @param snapshot entity state as it was loaded from the database
+  template <DatabaseEntity Entity>
+  void update(const Entity &entity, const Entity &snapshot) {
+    this->connection.updateChanged(DatabaseEntityDescription<Entity>.value(),
+                                   &entity, &snapshot);
+  }
+
+  /// Atomically adds the delta to a numeric field without reading the entity
+  /// @returns true if the entity was found
+  template <auto MemberPtr>
+    requires DatabaseField<MemberPtr>
+  bool increment(const PrimaryKeyType<MemberClass<MemberPtr>> &key,
+                 const MemberType<MemberPtr> &delta) {
+    return this->connection.increment(
+        DatabaseEntityDescription<MemberClass<MemberPtr>>.value(),
+        DatabaseFieldIndex<MemberPtr>.value(), key, &delta);
+  }
+
+  /// Atomically replaces the field value if it is equal to the expected one
+  /// @returns true if the value was replaced
+  template <auto MemberPtr>
+    requires DatabaseField<MemberPtr>
+  bool compareAndSet(const PrimaryKeyType<MemberClass<MemberPtr>> &key,
+                     const MemberType<MemberPtr> &expected,
+                     const MemberType<MemberPtr> &desired) {
+    return this->connection.compareAndSet(
+        DatabaseEntityDescription<MemberClass<MemberPtr>>.value(),
+        DatabaseFieldIndex<MemberPtr>.value(), key, &expected, &desired);
+  }
+
   template <DatabaseEntity Entity> Cursor<Entity> iterate() {
     return Cursor<Entity>{
         this->connection.iterate(DatabaseEntityDescription<Entity>.value()),
     };
   }
 
+  /// Iterates over entities, reading only the columns of the projection
+  /// @tparam Projection struct with fields named as the entity columns
+  template <DatabaseEntity Entity, ProjectionOf<Entity> Projection>
+  Cursor<Projection> iterateAs() {
+    return Cursor<Projection>{
+        this->connection.iterate(DatabaseEntityDescription<Entity>.value(),
+                                 ProjectionDescription<Projection>.value()),
+    };
+  }
+
+  /// Counts the entities matching the predicate
+  template <DatabaseEntity Entity>
+  std::uint64_t count(const Predicate<Entity> &where = {}) {
+    // NOLINTNEXTLINE(bugprone-unchecked-optional-access): count is not NULL
+    return this->aggregate(Count<Entity>, where).value();
+  }
+
+  /// Sums the field over the entities matching the predicate
+  template <auto MemberPtr>
+    requires NumericField<MemberPtr>
+  MemberType<MemberPtr>
+  sum(const Predicate<MemberClass<MemberPtr>> &where = {}) {
+    return this->aggregate(Sum<MemberPtr>, where)
+        .value_or(MemberType<MemberPtr>{});
+  }
+
+  /// @returns minimum of the field, or nullopt if no entities match
+  template <auto MemberPtr>
+    requires PrimitiveField<MemberPtr>
+  std::optional<MemberType<MemberPtr>>
+  min(const Predicate<MemberClass<MemberPtr>> &where = {}) {
+    return this->aggregate(Min<MemberPtr>, where);
+  }
+
+  /// @returns maximum of the field, or nullopt if no entities match
+  template <auto MemberPtr>
+    requires PrimitiveField<MemberPtr>
+  std::optional<MemberType<MemberPtr>>
+  max(const Predicate<MemberClass<MemberPtr>> &where = {}) {
+    return this->aggregate(Max<MemberPtr>, where);
+  }
+
+  /// Computes the aggregate over the entities matching the predicate
+  /// @returns aggregate value, or nullopt if no entities match
+  template <DatabaseEntity Entity, typename Result>
+  std::optional<Result> aggregate(const Aggregate<Entity, Result> &aggregate,
+                                  const Predicate<Entity> &where = {}) {
+    Result result;
+    if (!this->connection.aggregate(DatabaseEntityDescription<Entity>.value(),
+                                    aggregate.description, where.conditions,
+                                    &result)) {
+      return std::nullopt;
+    }
+
+    return result;
+  }
+
+  /// Computes the aggregate for each distinct value of the key field
+  /// @returns (key, aggregate value) pairs ordered by the key
+  template <auto KeyPtr, typename Result>
+    requires PrimitiveField<KeyPtr>
+  std::vector<std::pair<MemberType<KeyPtr>, Result>>
+  groupBy(const Aggregate<MemberClass<KeyPtr>, Result> &aggregate,
+          const Predicate<MemberClass<KeyPtr>> &where = {}) {
+    using Entity = MemberClass<KeyPtr>;
+    using Group = std::pair<MemberType<KeyPtr>, Result>;
+
+    constexpr EntityDescription Description =
+        DatabaseEntityDescription<Entity>.value();
+    constexpr std::size_t Key = DatabaseFieldIndex<KeyPtr>.value();
+
+    const auto groupDescription = makeGroupDescription<MemberType<KeyPtr>,
+                                                       Result>(
+        Description.fields[Key], aggregate.description);
+
+    Cursor<Group> cursor{this->connection.groupBy(
+        Description, Key, aggregate.description, where.conditions,
+        groupDescription)};
+
+    std::vector<Group> groups;
+    for (Group group : cursor) {
+      groups.push_back(std::move(group));
+    }
+
+    return groups;
+  }
+
 private:
   detail::Connection connection;
 
@@ -1,17 +1,27 @@
 #pragma once
 
+#include <podrm/aggregate.hpp>
+#include <podrm/cancellation.hpp>
+#include <podrm/instrumentation.hpp>
 #include <podrm/metadata.hpp>
 #include <podrm/odbc/detail/cursor.hpp>
 #include <podrm/odbc/detail/result.hpp>
 #include <podrm/odbc/environment.hpp>
+#include <podrm/predicate.hpp>
 #include <podrm/span.hpp>
 
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
 #include <filesystem>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <string>
 #include <string_view>
+#include <tuple>
+#include <utility>
 
 namespace podrm::odbc::detail {
 
@@ -24,6 +34,40 @@ public:
   static Connection fromConnectionString(Environment &environment,
                                          std::string_view connectionString);
 
+  //---------------- Transactions ------------------//
+
+  void begin();
+
+  void commit();
+
+  void rollback();
+
+  //---------------- Limits ------------------//
+
+  /// Statements fail with OperationCancelled or OperationTimedOut once the
+  /// limits are exceeded. Deadline is passed to the driver as the query
+  /// timeout, the limits are checked before each statement and between
+  /// fetched rows
+  /// @param limits new limits, nullopt to remove them
+  /// @returns previous limits
+  std::optional<OperationLimits>
+  setLimits(std::optional<OperationLimits> limits);
+
+  /// Cancels the running statement with SQLCancel, can be called from any
+  /// thread
+  void interrupt();
+
+  /// @returns false if the driver reports that the connection to the server
+  /// is lost
+  bool alive();
+
+  //---------------- Instrumentation ------------------//
+
+  /// Reports every executed statement to the observer, which must outlive
+  /// the connection
+  /// @param observer new observer, nullptr to stop reporting
+  void setObserver(Observer *observer);
+
   //---------------- Operations ------------------//
 
   void createTable(const EntityDescription &entity);
@@ -32,8 +76,13 @@ public:
 
   bool exists(const EntityDescription &entity);
 
+  /// Inserts the entity, writing the generated key back for IdMode::Auto
   void persist(const EntityDescription &description, void *entity);
 
+  /// Persists all entities in a single transaction
+  void persistMany(const EntityDescription &description,
+                   span<void *const> entities);
+
   /// @param[out] result pointer to the result structure, filled if found
   bool find(const EntityDescription &description, const AsImage &key,
             void *result);
@@ -42,13 +91,126 @@ public:
 
   void update(EntityDescription description, const void *entity);
 
+  /// Erases the entities matching the conditions
+  /// @returns number of erased entities
+  std::uint64_t eraseWhere(const EntityDescription &description,
+                           span<const Condition> where);
+
+  /// Erases the entities with the given keys, missing keys are ignored
+  /// @returns number of erased entities
+  std::uint64_t eraseMany(const EntityDescription &description,
+                          span<const AsImage> keys);
+
+  /// Applies the assignments to the entities matching the conditions
+  /// @returns number of updated entities
+  std::uint64_t updateWhere(const EntityDescription &description,
+                            span<const Condition> where,
+                            span<const Assignment> assignments);
+
+  /// Inserts the entity or updates it if an entity with the same primary key
+  /// already exists
+  void upsert(const EntityDescription &description, const void *entity);
+
+  /// Upserts all entities in a single transaction
+  void upsertMany(const EntityDescription &description,
+                  span<const void *const> entities);
+
+  /// Updates only the top-level fields selected by the mask
+  void update(EntityDescription description, const void *entity,
+              FieldMask fields);
+
+  /// Updates only the top-level fields that differ from the snapshot, does
+  /// nothing if there are no changes
+  /// @param snapshot entity state as it was loaded from the database
+  void updateChanged(EntityDescription description, const void *entity,
+                     const void *snapshot);
+
+  /// Atomically adds the delta to a numeric field
+  /// @param[in] delta pointer to the value of the field type
+  /// @returns true if the entity was found
+  bool increment(const EntityDescription &description, std::size_t field,
+                 const AsImage &key, const void *delta);
+
+  /// Atomically replaces the field value if it is equal to the expected one
+  /// @param[in] expected pointer to the value of the field type
+  /// @param[in] desired pointer to the value of the field type
+  /// @returns true if the value was replaced
+  bool compareAndSet(const EntityDescription &description, std::size_t field,
+                     const AsImage &key, const void *expected,
+                     const void *desired);
+
   Cursor iterate(EntityDescription description);
 
+  /// Iterates over the entity columns selected by the projection
+  Cursor iterate(EntityDescription description,
+                 span<const FieldDescription> projection);
+
+  /// Computes the aggregate over the entities matching the conditions
+  /// @param[out] result pointer to the aggregate value, filled if there are
+  /// matching entities
+  bool aggregate(const EntityDescription &description,
+                 const AggregateDescription &aggregate,
+                 span<const Condition> where, void *result);
+
+  /// Computes the aggregate for each distinct value of the key field
+  /// @param group description of the (key, aggregate value) row
+  Cursor groupBy(const EntityDescription &description, std::size_t key,
+                 const AggregateDescription &aggregate,
+                 span<const Condition> where,
+                 span<const FieldDescription> group);
+
 private:
   std::unique_ptr<void, void (*)(void *)> connection;
 
   std::unique_ptr<std::mutex> mutex = std::make_unique<std::mutex>();
 
+  /// Guarded by the mutex, statements use a copy taken under it
+  std::optional<OperationLimits> limits;
+
+  /// Receives statement events, statements are not timed without it
+  Observer *observer = nullptr;
+
+  /// Whether statements are reported to the observer. Read by
+  /// operation scopes without the mutex, kept on the heap so that the
+  /// connection stays movable
+  std::unique_ptr<std::atomic<bool>> reported =
+      std::make_unique<std::atomic<bool>>(false);
+
+  /// @returns whether operation scopes set the reported operation
+  [[nodiscard]] bool reporting() const {
+    return this->reported->load(std::memory_order_relaxed);
+  }
+
+  /// Guards the running statement, which is cancelled by interrupt
+  std::unique_ptr<std::mutex> runningMutex = std::make_unique<std::mutex>();
+
+  void *running = nullptr;
+
+  /// SQL dialect of the connected DBMS, for statements without a portable
+  /// syntax
+  enum class Dialect : std::uint8_t {
+    Generic,
+    SQLite,
+    PostgreSQL,
+    SQLServer,
+  };
+
+  Dialect dialect;
+
+  /// Whether a transaction started by begin is active
+  bool transactionActive = false;
+
+  /// Kinds of statements generated from entity descriptions
+  enum class Generated : std::uint8_t {
+    Insert,
+    PartialUpdate,
+    Upsert,
+  };
+
+  /// Generated statements, keyed by kind, entity and selected fields
+  std::map<std::tuple<Generated, std::string_view, FieldMask>, std::string>
+      generated;
+
   explicit Connection(void *connection);
 
   /// @returns number of affected entries
@@ -56,6 +218,29 @@ private:
                         span<const AsImage> args = {});
 
   Result query(std::string_view statement, span<const AsImage> args = {});
+
+  /// Executes the prepared statement within the limits, the statement can be
+  /// cancelled by interrupt while it runs
+  /// @param limits copy of the limits taken under the mutex
+  void executePrepared(void *statement,
+                       const std::optional<OperationLimits> &limits);
+
+  void setAutocommit(bool enabled);
+
+  /// Commits or rolls back the active transaction and enables autocommit
+  /// @returns true on success
+  bool endTransaction(bool commit);
+
+  /// Runs the body inside a transaction, rolling it back if the body throws.
+  /// Inside an active transaction the body is run as a part of it
+  template <typename Body> void inTransaction(const Body &body);
+
+  [[nodiscard]] std::string
+  createInsert(const EntityDescription &description) const;
+
+  /// @returns statement of the given kind, generating it on the first use
+  std::string getGenerated(Generated kind, const EntityDescription &description,
+                           FieldMask fields = 0);
 };
 
 } // namespace podrm::odbc::detail
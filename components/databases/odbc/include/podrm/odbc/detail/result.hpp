@@ -1,14 +1,29 @@
 #pragma once
 
+#include <podrm/cancellation.hpp>
 #include <podrm/odbc/detail/row.hpp>
 
 #include <memory>
 #include <optional>
 
+namespace podrm::detail {
+
+struct Observation;
+
+} // namespace podrm::detail
+
 namespace podrm::odbc::detail {
 
 class Result {
 public:
+  Result(const Result &) = delete;
+  Result(Result &&other) noexcept;
+  Result &operator=(const Result &) = delete;
+  Result &operator=(Result &&other) noexcept;
+
+  /// Reports the statement to the observer if it was not consumed
+  ~Result();
+
   [[nodiscard]] std::optional<Row> getRow() const {
     if (!this->statement.has_value()) {
       return std::nullopt;
@@ -16,6 +31,8 @@ public:
     return Row{statement->get(), this->columnCount};
   }
 
+  /// @throws OperationCancelled or OperationTimedOut if the limits of the
+  /// query are exceeded
   bool nextRow();
 
   [[nodiscard]] bool valid() const;
@@ -29,9 +46,22 @@ private:
 
   int columnCount = 0;
 
+  /// Event reported once all rows are fetched, null without an observer
+  std::unique_ptr<podrm::detail::Observation> observation;
+
+  /// Limits of the query, checked between fetched rows since SQLCancel only
+  /// interrupts the execution
+  std::optional<OperationLimits> limits;
+
   friend class Connection;
 
-  explicit Result(Statement statement);
+  explicit Result(
+      Statement statement,
+      std::unique_ptr<podrm::detail::Observation> observation = nullptr,
+      std::optional<OperationLimits> limits = std::nullopt);
+
+  /// Reports the observation, if any, and drops it
+  void finishObservation();
 };
 
 } // namespace podrm::odbc::detail
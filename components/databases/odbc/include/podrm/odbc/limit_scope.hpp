@@ -0,0 +1,40 @@
+#pragma once
+
+#include <podrm/cancellation.hpp>
+#include <podrm/odbc/detail/connection.hpp>
+
+#include <optional>
+#include <utility>
+
+namespace podrm::odbc {
+
+/// Limits operations of a database, previous limits are restored on
+/// destruction
+class LimitScope {
+public:
+  LimitScope(const LimitScope &) = delete;
+  LimitScope(LimitScope &&other) noexcept
+      : connection(std::exchange(other.connection, nullptr)),
+        previous(std::move(other.previous)) {}
+  LimitScope &operator=(const LimitScope &) = delete;
+  LimitScope &operator=(LimitScope &&) = delete;
+
+  ~LimitScope() {
+    if (this->connection != nullptr) {
+      this->connection->setLimits(std::move(this->previous));
+    }
+  }
+
+private:
+  detail::Connection *connection;
+
+  std::optional<OperationLimits> previous;
+
+  LimitScope(detail::Connection &connection, OperationLimits limits)
+      : connection(&connection),
+        previous(connection.setLimits(std::move(limits))) {}
+
+  friend class Database;
+};
+
+} // namespace podrm::odbc
@@ -0,0 +1,280 @@
+#pragma once
+
+#include <podrm/aggregate.hpp>
+#include <podrm/instrumentation.hpp>
+#include <podrm/metadata.hpp>
+#include <podrm/odbc/cursor.hpp>
+#include <podrm/odbc/database.hpp>
+#include <podrm/odbc/environment.hpp>
+#include <podrm/odbc/transaction.hpp>
+#include <podrm/predicate.hpp>
+#include <podrm/replication.hpp>
+#include <podrm/span.hpp>
+
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <ranges>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace podrm::odbc {
+
+/// Database with read replicas: reads go to a healthy replica in turn,
+/// writes and transactions go to the primary. Replicas lag behind the
+/// primary, see ReplicationOptions::stickiness to read own writes. Like
+/// Database, it is meant to be used by one session at a time
+class ReplicatedDatabase {
+public:
+  //---------------- Constructors ------------------//
+
+  ReplicatedDatabase(Database primary, std::vector<Database> replicas,
+                     const ReplicationOptions &options = {})
+      : router(std::move(primary), std::move(replicas), options) {}
+
+  static ReplicatedDatabase
+  fromConnectionStrings(Environment &environment,
+                        const std::string_view primary,
+                        const span<const std::string_view> replicas,
+                        const ReplicationOptions &options = {}) {
+    std::vector<Database> replicaDatabases;
+    replicaDatabases.reserve(replicas.size());
+    for (const std::string_view replica : replicas) {
+      replicaDatabases.push_back(
+          Database::fromConnectionString(environment, replica));
+    }
+
+    return ReplicatedDatabase{
+        Database::fromConnectionString(environment, primary),
+        std::move(replicaDatabases), options};
+  }
+
+  //---------------- Routing ------------------//
+
+  /// Database receiving writes, e.g. for reads that must see them at once
+  Database &primary() { return this->router.primary(); }
+
+  Database &replica(const std::size_t index) {
+    return this->router.replicas().at(index);
+  }
+
+  std::size_t replicaCount() { return this->router.replicas().size(); }
+
+  /// Checks every replica, returning recovered ones to rotation at once
+  /// @returns number of healthy replicas
+  std::size_t checkHealth() { return this->router.checkHealth(); }
+
+  //---------------- Transactions ------------------//
+
+  /// Begins a transaction on the primary. Reads of this database are not a
+  /// part of it, use primary() for them
+  [[nodiscard]] Transaction begin() { return this->router.write().begin(); }
+
+  //---------------- Instrumentation ------------------//
+
+  /// Reports statements of the primary and every replica to the observer
+  /// @param observer observer outliving the database, nullptr to stop
+  /// reporting
+  void setObserver(Observer *observer) {
+    this->router.primary().setObserver(observer);
+    for (Database &replica : this->router.replicas()) {
+      replica.setObserver(observer);
+    }
+  }
+
+  //---------------- Writes ------------------//
+
+  template <DatabaseEntity T> void createTable() {
+    this->router.write().createTable<T>();
+  }
+
+  template <DatabaseEntity T> void dropTable() {
+    this->router.write().dropTable<T>();
+  }
+
+  /// Inserts the entity, for IdMode::Auto the generated key is written back
+  template <DatabaseEntity Entity> void persist(Entity &entity) {
+    this->router.write().persist(entity);
+  }
+
+  /// Persists all entities of the range in a single transaction
+  template <std::ranges::forward_range Range>
+    requires DatabaseEntity<std::ranges::range_value_t<Range>> &&
+             std::is_same_v<std::ranges::range_reference_t<Range>,
+                            std::ranges::range_value_t<Range> &>
+  void persistMany(Range &&entities) {
+    this->router.write().persistMany(std::forward<Range>(entities));
+  }
+
+  template <DatabaseEntity Entity>
+  void erase(const PrimaryKeyType<Entity> &key) {
+    this->router.write().erase<Entity>(key);
+  }
+
+  /// Erases the entities matching the predicate
+  /// @returns number of erased entities
+  template <DatabaseEntity Entity>
+  std::uint64_t eraseWhere(const Predicate<Entity> &where) {
+    return this->router.write().eraseWhere<Entity>(where);
+  }
+
+  /// Erases the entities with the given keys, missing keys are ignored
+  /// @returns number of erased entities
+  template <DatabaseEntity Entity, std::ranges::input_range Range>
+    requires std::convertible_to<std::ranges::range_reference_t<Range>,
+                                 const PrimaryKeyType<Entity> &>
+  std::uint64_t eraseMany(Range &&keys) {
+    return this->router.write().eraseMany<Entity>(std::forward<Range>(keys));
+  }
+
+  /// Applies the assignments to the entities matching the predicate
+  /// @returns number of updated entities
+  template <DatabaseEntity Entity, std::same_as<SetExpression<Entity>>... Sets>
+    requires(sizeof...(Sets) > 0)
+  std::uint64_t updateWhere(const Predicate<Entity> &where,
+                            const Sets &...sets) {
+    return this->router.write().updateWhere<Entity>(where, sets...);
+  }
+
+  template <DatabaseEntity Entity> void update(const Entity &entity) {
+    this->router.write().update(entity);
+  }
+
+  /// Inserts the entity or updates it if an entity with the same primary key
+  /// already exists
+  template <DatabaseEntity Entity> void upsert(const Entity &entity) {
+    this->router.write().upsert(entity);
+  }
+
+  /// Upserts all entities of the range in a single transaction
+  template <std::ranges::forward_range Range>
+    requires DatabaseEntity<std::ranges::range_value_t<Range>> &&
+             std::is_lvalue_reference_v<std::ranges::range_reference_t<Range>>
+  void upsertMany(Range &&entities) {
+    this->router.write().upsertMany(std::forward<Range>(entities));
+  }
+
+  /// Updates only the selected fields of the entity
+  template <DatabaseEntity Entity, FieldSelector... Fields>
+    requires(sizeof...(Fields) > 0)
+  void update(const Entity &entity, const Fields... fields) {
+    this->router.write().update(entity, fields...);
+  }
+
+  /// Updates only the fields that differ from the snapshot
+  /// @param snapshot entity state as it was loaded from the database
+  template <DatabaseEntity Entity>
+  void update(const Entity &entity, const Entity &snapshot) {
+    this->router.write().update(entity, snapshot);
+  }
+
+  /// Atomically adds the delta to a numeric field without reading the entity
+  /// @returns true if the entity was found
+  template <auto MemberPtr>
+    requires DatabaseField<MemberPtr>
+  bool increment(const PrimaryKeyType<MemberClass<MemberPtr>> &key,
+                 const MemberType<MemberPtr> &delta) {
+    return this->router.write().increment<MemberPtr>(key, delta);
+  }
+
+  /// Atomically replaces the field value if it is equal to the expected one
+  /// @returns true if the value was replaced
+  template <auto MemberPtr>
+    requires DatabaseField<MemberPtr>
+  bool compareAndSet(const PrimaryKeyType<MemberClass<MemberPtr>> &key,
+                     const MemberType<MemberPtr> &expected,
+                     const MemberType<MemberPtr> &desired) {
+    return this->router.write().compareAndSet<MemberPtr>(key, expected,
+                                                         desired);
+  }
+
+  //---------------- Reads ------------------//
+
+  template <typename T> bool exists() {
+    return this->router.read([](Database &db) { return db.exists<T>(); });
+  }
+
+  template <DatabaseEntity Entity>
+  std::optional<Entity> find(const PrimaryKeyType<Entity> &key) {
+    return this->router.read(
+        [&key](Database &db) { return db.find<Entity>(key); });
+  }
+
+  /// Iterates over entities of a replica, its failures while iterating are
+  /// not retried
+  template <DatabaseEntity Entity> Cursor<Entity> iterate() {
+    return this->router.read(
+        [](Database &db) { return db.iterate<Entity>(); });
+  }
+
+  /// Iterates over entities, reading only the columns of the projection
+  template <DatabaseEntity Entity, ProjectionOf<Entity> Projection>
+  Cursor<Projection> iterateAs() {
+    return this->router.read(
+        [](Database &db) { return db.iterateAs<Entity, Projection>(); });
+  }
+
+  /// Counts the entities matching the predicate
+  template <DatabaseEntity Entity>
+  std::uint64_t count(const Predicate<Entity> &where = {}) {
+    return this->router.read(
+        [&where](Database &db) { return db.count<Entity>(where); });
+  }
+
+  /// Sums the field over the entities matching the predicate
+  template <auto MemberPtr>
+    requires NumericField<MemberPtr>
+  MemberType<MemberPtr>
+  sum(const Predicate<MemberClass<MemberPtr>> &where = {}) {
+    return this->router.read(
+        [&where](Database &db) { return db.sum<MemberPtr>(where); });
+  }
+
+  /// @returns minimum of the field, or nullopt if no entities match
+  template <auto MemberPtr>
+    requires PrimitiveField<MemberPtr>
+  std::optional<MemberType<MemberPtr>>
+  min(const Predicate<MemberClass<MemberPtr>> &where = {}) {
+    return this->router.read(
+        [&where](Database &db) { return db.min<MemberPtr>(where); });
+  }
+
+  /// @returns maximum of the field, or nullopt if no entities match
+  template <auto MemberPtr>
+    requires PrimitiveField<MemberPtr>
+  std::optional<MemberType<MemberPtr>>
+  max(const Predicate<MemberClass<MemberPtr>> &where = {}) {
+    return this->router.read(
+        [&where](Database &db) { return db.max<MemberPtr>(where); });
+  }
+
+  /// Computes the aggregate over the entities matching the predicate
+  /// @returns aggregate value, or nullopt if no entities match
+  template <DatabaseEntity Entity, typename Result>
+  std::optional<Result> aggregate(const Aggregate<Entity, Result> &aggregate,
+                                  const Predicate<Entity> &where = {}) {
+    return this->router.read([&aggregate, &where](Database &db) {
+      return db.aggregate(aggregate, where);
+    });
+  }
+
+  /// Computes the aggregate for each distinct value of the key field
+  /// @returns (key, aggregate value) pairs ordered by the key
+  template <auto KeyPtr, typename Result>
+    requires PrimitiveField<KeyPtr>
+  std::vector<std::pair<MemberType<KeyPtr>, Result>>
+  groupBy(const Aggregate<MemberClass<KeyPtr>, Result> &aggregate,
+          const Predicate<MemberClass<KeyPtr>> &where = {}) {
+    return this->router.read([&aggregate, &where](Database &db) {
+      return db.groupBy<KeyPtr>(aggregate, where);
+    });
+  }
+
+private:
+  podrm::detail::ReplicaRouter<Database> router;
+};
+
+} // namespace podrm::odbc
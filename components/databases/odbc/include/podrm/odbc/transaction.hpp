@@ -0,0 +1,54 @@
+#pragma once
+
+#include <podrm/odbc/detail/connection.hpp>
+
+#include <stdexcept>
+#include <utility>
+
+namespace podrm::odbc {
+
+/// Database transaction, rolled back on destruction unless committed
+class Transaction {
+public:
+  Transaction(const Transaction &) = delete;
+  Transaction(Transaction &&other) noexcept
+      : connection(std::exchange(other.connection, nullptr)) {}
+  Transaction &operator=(const Transaction &) = delete;
+  Transaction &operator=(Transaction &&) = delete;
+
+  ~Transaction() {
+    if (this->connection == nullptr) {
+      return;
+    }
+
+    try {
+      this->connection->rollback();
+    } catch (...) { // NOLINT(bugprone-empty-catch): destructor must not throw
+    }
+  }
+
+  void commit() { this->finish(&detail::Connection::commit); }
+
+  void rollback() { this->finish(&detail::Connection::rollback); }
+
+private:
+  detail::Connection *connection;
+
+  explicit Transaction(detail::Connection &connection)
+      : connection(&connection) {
+    this->connection->begin();
+  }
+
+  void finish(void (detail::Connection::*operation)()) {
+    if (this->connection == nullptr) {
+      throw std::logic_error{"Transaction is already finished"};
+    }
+
+    (this->connection->*operation)();
+    this->connection = nullptr;
+  }
+
+  friend class Database;
+};
+
+} // namespace podrm::odbc
@@ -1,16 +1,25 @@
 #include "error.hpp"
 #include "string.hpp"
 
+#include <podrm/aggregate.hpp>
+#include <podrm/cancellation.hpp>
+#include <podrm/instrumentation.hpp>
 #include <podrm/metadata.hpp>
 #include <podrm/multilambda.hpp>
+#include <podrm/observation.hpp>
 #include <podrm/odbc/detail/connection.hpp>
 #include <podrm/odbc/detail/cursor.hpp>
 #include <podrm/odbc/detail/result.hpp>
 #include <podrm/odbc/detail/row.hpp>
 #include <podrm/odbc/environment.hpp>
+#include <podrm/predicate.hpp>
 #include <podrm/span.hpp>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <filesystem>
@@ -21,6 +30,7 @@
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <type_traits>
 #include <utility>
 #include <variant>
 #include <vector>
@@ -36,6 +46,14 @@ namespace podrm::odbc::detail {
 
 namespace {
 
+/// Maximum number of keys bound to a single statement
+constexpr std::size_t MaxBoundKeys = 500;
+
+using podrm::detail::notify;
+using podrm::detail::observe;
+using podrm::detail::OperationScope;
+using podrm::detail::Stopwatch;
+
 using Statement = std::unique_ptr<void, decltype([](SQLHSTMT statement) {
                                     SQLFreeStmt(statement, 0);
                                   })>;
@@ -258,12 +276,356 @@ std::vector<AsImage> intoArgs(const FieldDescription description,
       description.field);
 }
 
+bool sameImage(const AsImage &lhs, const AsImage &rhs) {
+  if (lhs.index() != rhs.index()) {
+    return false;
+  }
+
+  return std::visit(
+      [&rhs](const auto &value) {
+        using Image = std::decay_t<decltype(value)>;
+        const Image &other = std::get<Image>(rhs);
+        if constexpr (std::is_same_v<Image, span<const std::byte>>) {
+          return std::equal(value.begin(), value.end(), other.begin(),
+                            other.end());
+        } else {
+          return value == other;
+        }
+      },
+      lhs);
+}
+
+bool sameField(const FieldDescription &description, const void *lhs,
+               const void *rhs) {
+  const std::vector<AsImage> lhsImages = intoArgs(description, lhs);
+  const std::vector<AsImage> rhsImages = intoArgs(description, rhs);
+
+  return std::equal(lhsImages.begin(), lhsImages.end(), rhsImages.begin(),
+                    rhsImages.end(), sameImage);
+}
+
+void checkMaskable(const EntityDescription &description) {
+  if (description.fields.size() > MaxMaskedFields) {
+    throw std::invalid_argument{
+        fmt::format("Entity {} has too many fields for a partial update",
+                    description.name),
+    };
+  }
+}
+
+std::string createPartialUpdate(const EntityDescription &description,
+                                const FieldMask fields) {
+  fmt::memory_buffer buf;
+  fmt::appender appender{buf};
+
+  fmt::format_to(appender, R"(UPDATE "{}" SET )", description.name);
+
+  bool first = true;
+  for (std::size_t i = 0; i < description.fields.size(); ++i) {
+    if ((fields & (FieldMask{1} << i)) != 0) {
+      createUpdateParamPlaceholders(description.fields[i], appender, {}, first);
+    }
+  }
+
+  fmt::format_to(appender, " WHERE {} = ?",
+                 description.fields[description.primaryKey].name);
+
+  return fmt::to_string(buf);
+}
+
+const PrimitiveFieldDescription &
+getPrimitiveField(const EntityDescription &description,
+                  const std::size_t field) {
+  const auto *primitive =
+      std::get_if<PrimitiveFieldDescription>(&description.fields[field].field);
+  if (primitive == nullptr) {
+    throw std::invalid_argument{
+        fmt::format("Field {}.{} is not primitive", description.name,
+                    description.fields[field].name),
+    };
+  }
+
+  return *primitive;
+}
+
+std::string_view toString(const Comparison comparison) {
+  switch (comparison) {
+  case Comparison::Equal:
+    return "=";
+  case Comparison::NotEqual:
+    return "<>";
+  case Comparison::Less:
+    return "<";
+  case Comparison::LessOrEqual:
+    return "<=";
+  case Comparison::Greater:
+    return ">";
+  case Comparison::GreaterOrEqual:
+    return ">=";
+  }
+
+  assert(false);
+  return "";
+}
+
+/// Appends the WHERE clause and collects the compared values into args
+void formatWhere(const EntityDescription &description,
+                 const span<const Condition> where, fmt::appender appender,
+                 std::vector<AsImage> &args) {
+  bool first = true;
+  for (const Condition &condition : where) {
+    getPrimitiveField(description, condition.field);
+
+    fmt::format_to(appender, R"({}"{}" {} ?)", first ? " WHERE " : " AND ",
+                   description.fields[condition.field].name,
+                   toString(condition.comparison));
+    args.push_back(condition.value);
+    first = false;
+  }
+}
+
+std::string formatAggregate(const EntityDescription &description,
+                            const AggregateDescription &aggregate) {
+  if (aggregate.function == AggregateFunction::Count) {
+    return "COUNT(*)";
+  }
+
+  getPrimitiveField(description, aggregate.field);
+
+  const std::string_view name = description.fields[aggregate.field].name;
+  switch (aggregate.function) {
+  case AggregateFunction::Count:
+    break;
+  case AggregateFunction::Sum:
+    return fmt::format(R"(SUM("{}"))", name);
+  case AggregateFunction::Min:
+    return fmt::format(R"(MIN("{}"))", name);
+  case AggregateFunction::Max:
+    return fmt::format(R"(MAX("{}"))", name);
+  }
+
+  assert(false);
+  return "";
+}
+
+void collectColumns(const FieldDescription &description,
+                    std::vector<std::string_view> prefixes,
+                    std::vector<std::string> &columns) {
+  prefixes.push_back(description.name);
+
+  const auto collectPrimitive =
+      [&prefixes, &columns](const PrimitiveFieldDescription &) {
+        columns.emplace_back(fmt::to_string(fmt::join(prefixes, "_")));
+      };
+
+  const auto collectComposite =
+      [&prefixes, &columns](const CompositeFieldDescription &descr) {
+        for (const FieldDescription &field : descr.fields) {
+          collectColumns(field, prefixes, columns);
+        }
+      };
+
+  std::visit(podrm::detail::MultiLambda{collectPrimitive, collectComposite},
+             description.field);
+}
+
+/// @returns flattened names of all columns except the primary key
+std::vector<std::string> getValueColumns(const EntityDescription &description) {
+  std::vector<std::string> columns;
+  for (std::size_t i = 0; i < description.fields.size(); ++i) {
+    if (i != description.primaryKey) {
+      collectColumns(description.fields[i], {}, columns);
+    }
+  }
+
+  return columns;
+}
+
+/// INSERT ... ON CONFLICT, supported by SQLite and PostgreSQL
+std::string createOnConflictUpsert(const EntityDescription &description) {
+  fmt::memory_buffer buf;
+  fmt::appender appender{buf};
+
+  fmt::format_to(appender, R"(INSERT INTO "{}" VALUES ()", description.name);
+
+  bool first = true;
+  for (const FieldDescription &field : description.fields) {
+    createPersistParamPlaceholders(field, appender, first);
+  }
+
+  fmt::format_to(appender, R"() ON CONFLICT("{}") DO )",
+                 description.fields[description.primaryKey].name);
+
+  const std::vector<std::string> columns = getValueColumns(description);
+  if (columns.empty()) {
+    fmt::format_to(appender, "NOTHING");
+    return fmt::to_string(buf);
+  }
+
+  fmt::format_to(appender, "UPDATE SET ");
+  first = true;
+  for (const std::string &column : columns) {
+    fmt::format_to(appender, R"({}"{}"=EXCLUDED."{}")", first ? "" : ",",
+                   column, column);
+    first = false;
+  }
+
+  return fmt::to_string(buf);
+}
+
+/// Standard MERGE statement
+std::string createMergeUpsert(const EntityDescription &description) {
+  fmt::memory_buffer buf;
+  fmt::appender appender{buf};
+
+  std::vector<std::string> allColumns;
+  for (const FieldDescription &field : description.fields) {
+    collectColumns(field, {}, allColumns);
+  }
+
+  fmt::format_to(appender, R"(MERGE INTO "{}" USING (VALUES ()",
+                 description.name);
+
+  bool first = true;
+  for (const FieldDescription &field : description.fields) {
+    createPersistParamPlaceholders(field, appender, first);
+  }
+
+  const std::string_view primaryKey =
+      description.fields[description.primaryKey].name;
+  fmt::format_to(appender, R"()) AS src ("{}") ON "{}"."{}" = src."{}")",
+                 fmt::join(allColumns, R"(",")"), description.name, primaryKey,
+                 primaryKey);
+
+  const std::vector<std::string> columns = getValueColumns(description);
+  if (!columns.empty()) {
+    fmt::format_to(appender, " WHEN MATCHED THEN UPDATE SET ");
+    first = true;
+    for (const std::string &column : columns) {
+      fmt::format_to(appender, R"({}"{}"=src."{}")", first ? "" : ",", column,
+                     column);
+      first = false;
+    }
+  }
+
+  fmt::format_to(appender,
+                 R"( WHEN NOT MATCHED THEN INSERT ("{}") VALUES (src."{}");)",
+                 fmt::join(allColumns, R"(",")"),
+                 fmt::join(allColumns, R"(",src.")"));
+
+  return fmt::to_string(buf);
+}
+
+void checkAutoId(const EntityDescription &description) {
+  const PrimitiveFieldDescription &primaryKey =
+      getPrimitiveField(description, description.primaryKey);
+  if (primaryKey.imageType != ImageType::Int &&
+      primaryKey.imageType != ImageType::Uint) {
+    throw std::invalid_argument{
+        fmt::format("Entity {} has automatic ids, but its primary key is not "
+                    "an integer",
+                    description.name),
+    };
+  }
+}
+
+void setGeneratedKey(const EntityDescription &description, void *entity,
+                     const std::int64_t key) {
+  const FieldDescription &field = description.fields[description.primaryKey];
+  const PrimitiveFieldDescription &primaryKey =
+      getPrimitiveField(description, description.primaryKey);
+
+  if (primaryKey.imageType == ImageType::Uint) {
+    primaryKey.fromImage(static_cast<std::uint64_t>(key),
+                         field.memberPtr(entity));
+  } else {
+    primaryKey.fromImage(key, field.memberPtr(entity));
+  }
+}
+
 void closeConnection(SQLHDBC connection) { SQLDisconnect(connection); }
 
 } // namespace
 
 Connection::Connection(SQLHANDLE connection)
-    : connection(connection, &closeConnection) {}
+    : connection(connection, &closeConnection), dialect(Dialect::Generic) {
+  constexpr static std::size_t MaxNameSize = 64;
+
+  std::array<SQLCHAR, MaxNameSize> name = {};
+  SQLSMALLINT length = 0;
+  if (!SQL_SUCCEEDED(SQLGetInfo(connection, SQL_DBMS_NAME, name.data(),
+                                name.size(), &length))) {
+    return;
+  }
+
+  const std::string_view dbmsName{
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast): safe
+      reinterpret_cast<const char *>(name.data()),
+      std::min(static_cast<std::size_t>(length), name.size()),
+  };
+  if (dbmsName == "SQLite") {
+    this->dialect = Dialect::SQLite;
+  } else if (dbmsName == "PostgreSQL") {
+    this->dialect = Dialect::PostgreSQL;
+  } else if (dbmsName == "Microsoft SQL Server") {
+    this->dialect = Dialect::SQLServer;
+  }
+}
+
+std::string
+Connection::createInsert(const EntityDescription &description) const {
+  const bool autoId = description.idMode == IdMode::Auto;
+
+  std::vector<std::string> columns;
+  for (std::size_t i = 0; i < description.fields.size(); ++i) {
+    if (!autoId || i != description.primaryKey) {
+      collectColumns(description.fields[i], {}, columns);
+    }
+  }
+
+  const std::string_view primaryKey =
+      description.fields[description.primaryKey].name;
+
+  fmt::memory_buffer buf;
+  fmt::appender appender{buf};
+
+  fmt::format_to(appender, R"(INSERT INTO "{}")", description.name);
+  if (!columns.empty()) {
+    fmt::format_to(appender, R"( ("{}"))", fmt::join(columns, R"(",")"));
+  }
+
+  // Generated keys are returned by the insert itself, without a second query
+  if (autoId) {
+    switch (this->dialect) {
+    case Dialect::SQLite:
+    case Dialect::PostgreSQL:
+      break;
+    case Dialect::SQLServer:
+      fmt::format_to(appender, R"( OUTPUT INSERTED."{}")", primaryKey);
+      break;
+    case Dialect::Generic:
+      throw std::runtime_error{
+          "Automatic ids are not supported for this DBMS",
+      };
+    }
+  }
+
+  if (columns.empty()) {
+    fmt::format_to(appender, " DEFAULT VALUES");
+  } else {
+    fmt::format_to(appender, " VALUES (");
+    for (std::size_t i = 0; i < columns.size(); ++i) {
+      fmt::format_to(appender, "{}?", i == 0 ? "" : ",");
+    }
+    fmt::format_to(appender, ")");
+  }
+
+  if (autoId && this->dialect != Dialect::SQLServer) {
+    fmt::format_to(appender, R"( RETURNING "{}")", primaryKey);
+  }
+
+  return fmt::to_string(buf);
+}
 
 Connection Connection::fromRaw(SQLHANDLE connection) {
   return Connection{connection};
@@ -293,20 +655,25 @@ std::uint64_t Connection::execute(const std::string_view statement,
                                   const span<const AsImage> args) {
   const std::unique_lock lock{*this->mutex};
 
+  Stopwatch stopwatch{this->observer != nullptr};
   const Statement stmt = createStatement(this->connection.get(), statement);
+  const std::chrono::nanoseconds prepareTime = stopwatch.lap();
 
   for (int i = 0; i < args.size(); ++i) {
     bindArg(stmt, i, args[i]);
   }
 
-  const int executeResult = SQLExecute(stmt.get());
-  if (!SQL_SUCCEEDED(executeResult)) {
-    throw std::runtime_error{
-        extractError(this->connection.get(), SQL_HANDLE_DBC)};
-  }
+  this->executePrepared(stmt.get(), this->limits);
 
   SQLLEN affectedRows = 0;
   SQLRowCount(stmt.get(), &affectedRows);
+
+  if (this->observer != nullptr) {
+    notify(*this->observer, statement, prepareTime, stopwatch.lap(),
+           static_cast<std::uint64_t>(std::max<SQLLEN>(affectedRows, 0)), args,
+           false);
+  }
+
   return affectedRows;
 }
 
@@ -314,22 +681,181 @@ Result Connection::query(const std::string_view statement,
                          const span<const AsImage> args) {
   const std::unique_lock lock{*this->mutex};
 
+  Stopwatch stopwatch{this->observer != nullptr};
   Statement stmt = createStatement(this->connection.get(), statement);
+  const std::chrono::nanoseconds prepareTime = stopwatch.lap();
 
   for (int i = 0; i < args.size(); ++i) {
     bindArg(stmt, i, args[i]);
   }
 
-  const int executeResult = SQLExecute(stmt.get());
+  std::unique_ptr<podrm::detail::Observation> observation =
+      observe(this->observer, statement, prepareTime, args, false);
+
+  const std::optional<OperationLimits> limits = this->limits;
+  this->executePrepared(stmt.get(), limits);
+
+  return Result{std::move(stmt), std::move(observation), limits};
+}
+
+void Connection::executePrepared(
+    SQLHSTMT statement, const std::optional<OperationLimits> &limits) {
+  if (limits.has_value()) {
+    limits->check();
+
+    if (limits->deadline.has_value()) {
+      // Query timeout has a resolution of seconds, rounded up to not expire
+      // before the deadline
+      const auto remaining = std::chrono::ceil<std::chrono::seconds>(
+          *limits->deadline - OperationLimits::Clock::now());
+      const auto timeout =
+          static_cast<SQLULEN>(std::max<std::int64_t>(remaining.count(), 1));
+      SQLSetStmtAttr(
+          statement, SQL_ATTR_QUERY_TIMEOUT,
+          // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+          reinterpret_cast<SQLPOINTER>(timeout), 0);
+    }
+  }
+
+  {
+    const std::lock_guard lock{*this->runningMutex};
+    this->running = statement;
+  }
+
+  const int executeResult = SQLExecute(statement);
+
+  {
+    const std::lock_guard lock{*this->runningMutex};
+    this->running = nullptr;
+  }
+
   if (!SQL_SUCCEEDED(executeResult)) {
+    throwStatementError(statement,
+                        extractError(this->connection.get(), SQL_HANDLE_DBC));
+  }
+}
+
+std::optional<OperationLimits>
+Connection::setLimits(std::optional<OperationLimits> limits) {
+  const std::unique_lock lock{*this->mutex};
+  return std::exchange(this->limits, std::move(limits));
+}
+
+void Connection::interrupt() {
+  const std::lock_guard lock{*this->runningMutex};
+  if (this->running != nullptr) {
+    SQLCancel(this->running);
+  }
+}
+
+bool Connection::alive() {
+  const std::unique_lock lock{*this->mutex};
+  SQLUINTEGER dead = SQL_CD_TRUE;
+  const int result =
+      SQLGetConnectAttr(this->connection.get(), SQL_ATTR_CONNECTION_DEAD,
+                        &dead, 0, nullptr);
+  return SQL_SUCCEEDED(result) && dead == SQL_CD_FALSE;
+}
+
+void Connection::setObserver(Observer *const observer) {
+  const std::unique_lock lock{*this->mutex};
+  this->observer = observer;
+  this->reported->store(observer != nullptr, std::memory_order_relaxed);
+}
+
+void Connection::setAutocommit(const bool enabled) {
+  SQLSetConnectAttr(
+      this->connection.get(), SQL_ATTR_AUTOCOMMIT,
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast): ODBC API
+      reinterpret_cast<SQLPOINTER>(enabled ? SQL_AUTOCOMMIT_ON
+                                           : SQL_AUTOCOMMIT_OFF),
+      0);
+}
+
+bool Connection::endTransaction(const bool commit) {
+  const int result = SQLEndTran(SQL_HANDLE_DBC, this->connection.get(),
+                                commit ? SQL_COMMIT : SQL_ROLLBACK);
+  this->setAutocommit(true);
+  this->transactionActive = false;
+
+  return SQL_SUCCEEDED(result);
+}
+
+void Connection::begin() {
+  if (this->transactionActive) {
+    throw std::logic_error{"Transaction is already active"};
+  }
+
+  this->setAutocommit(false);
+  this->transactionActive = true;
+}
+
+void Connection::commit() {
+  if (!this->endTransaction(true)) {
+    throw std::runtime_error{
+        extractError(this->connection.get(), SQL_HANDLE_DBC)};
+  }
+}
+
+void Connection::rollback() {
+  if (!this->endTransaction(false)) {
     throw std::runtime_error{
         extractError(this->connection.get(), SQL_HANDLE_DBC)};
   }
+}
+
+template <typename Body> void Connection::inTransaction(const Body &body) {
+  // Statements are already a part of the active transaction
+  if (this->transactionActive) {
+    body();
+    return;
+  }
+
+  this->begin();
+
+  try {
+    body();
+  } catch (...) {
+    this->endTransaction(false);
+    throw;
+  }
 
-  return Result{std::move(stmt)};
+  this->commit();
+}
+
+std::string Connection::getGenerated(const Generated kind,
+                                     const EntityDescription &description,
+                                     const FieldMask fields) {
+  const std::unique_lock lock{*this->mutex};
+
+  auto cached = this->generated.find({kind, description.name, fields});
+  if (cached != this->generated.end()) {
+    return cached->second;
+  }
+
+  std::string statement;
+  switch (kind) {
+  case Generated::Insert:
+    statement = this->createInsert(description);
+    break;
+  case Generated::PartialUpdate:
+    statement = createPartialUpdate(description, fields);
+    break;
+  case Generated::Upsert:
+    statement = this->dialect == Dialect::Generic
+                    ? createMergeUpsert(description)
+                    : createOnConflictUpsert(description);
+    break;
+  }
+
+  this->generated.emplace(std::tuple{kind, description.name, fields},
+                          statement);
+
+  return statement;
 }
 
 void Connection::createTable(const EntityDescription &entity) {
+  const OperationScope scope{entity.name, "createTable", this->reporting()};
   this->execute(fmt::format("DROP TABLE IF EXISTS \"{}\"", entity.name));
 
   fmt::memory_buffer buf;
@@ -350,10 +876,12 @@ void Connection::createTable(const EntityDescription &entity) {
 }
 
 void Connection::dropTable(const EntityDescription &entity) {
+  const OperationScope scope{entity.name, "dropTable", this->reporting()};
   this->execute(fmt::format(R"(DROP TABLE "{}")", entity.name));
 }
 
 bool Connection::exists(const EntityDescription &entity) {
+  const OperationScope scope{entity.name, "exists", this->reporting()};
   const Result result = this->query(
       fmt::format(R"(SELECT EXISTS(SELECT 1 FROM "{}"))", entity.name));
   // NOLINTNEXTLINE(bugprone-unchecked-optional-access): fixed query
@@ -361,18 +889,14 @@ bool Connection::exists(const EntityDescription &entity) {
 }
 
 void Connection::persist(const EntityDescription &description, void *entity) {
-  fmt::memory_buffer buf;
-  fmt::appender appender{buf};
-
-  fmt::format_to(appender, R"(INSERT INTO "{}" VALUES ()", description.name);
+  const OperationScope scope{description.name, "persist", this->reporting()};
+  const bool autoId = description.idMode == IdMode::Auto;
 
-  bool first = true;
   std::vector<AsImage> values;
   for (std::size_t i = 0; i < description.fields.size(); ++i) {
-    if (description.idMode == IdMode::Auto && i == description.primaryKey) {
-      // TODO: support auto ids
+    if (autoId && i == description.primaryKey) {
+      continue;
     }
-    createPersistParamPlaceholders(description.fields[i], appender, first);
 
     for (AsImage &value :
          intoArgs(description.fields[i],
@@ -380,13 +904,40 @@ void Connection::persist(const EntityDescription &description, void *entity) {
       values.emplace_back(std::move(value));
     }
   }
-  fmt::format_to(appender, ")");
 
-  this->execute(fmt::to_string(buf), values);
+  const std::string statement =
+      this->getGenerated(Generated::Insert, description);
+
+  if (!autoId) {
+    this->execute(statement, values);
+    return;
+  }
+
+  checkAutoId(description);
+
+  const Result result = this->query(statement, values);
+  const std::optional<Row> row = result.getRow();
+  if (!row.has_value()) {
+    throw std::runtime_error{"Generated key was not returned"};
+  }
+
+  setGeneratedKey(description, entity, row->get(0).bigint());
+}
+
+void Connection::persistMany(const EntityDescription &description,
+                             const span<void *const> entities) {
+  const OperationScope scope{description.name, "persistMany",
+                             this->reporting()};
+  this->inTransaction([this, &description, entities] {
+    for (void *entity : entities) {
+      this->persist(description, entity);
+    }
+  });
 }
 
 bool Connection::find(const EntityDescription &description, const AsImage &key,
                       void *result) {
+  const OperationScope scope{description.name, "find", this->reporting()};
   const std::string queryStr =
       fmt::format(R"(SELECT * FROM "{}" WHERE {} = ?)", description.name,
                   description.fields[description.primaryKey].name);
@@ -401,6 +952,7 @@ bool Connection::find(const EntityDescription &description, const AsImage &key,
 
 void Connection::erase(const EntityDescription description,
                        const AsImage &key) {
+  const OperationScope scope{description.name, "erase", this->reporting()};
   const std::string queryStr =
       fmt::format(R"(DELETE FROM "{}" WHERE {} = ?)", description.name,
                   description.fields[description.primaryKey].name);
@@ -412,8 +964,89 @@ void Connection::erase(const EntityDescription description,
   }
 }
 
+std::uint64_t Connection::eraseWhere(const EntityDescription &description,
+                                     const span<const Condition> where) {
+  const OperationScope scope{description.name, "eraseWhere", this->reporting()};
+  fmt::memory_buffer buf;
+  fmt::appender appender{buf};
+  std::vector<AsImage> args;
+
+  fmt::format_to(appender, R"(DELETE FROM "{}")", description.name);
+  formatWhere(description, where, appender, args);
+
+  return this->execute(fmt::to_string(buf), args);
+}
+
+std::uint64_t Connection::eraseMany(const EntityDescription &description,
+                                    const span<const AsImage> keys) {
+  const OperationScope scope{description.name, "eraseMany", this->reporting()};
+  const std::string_view key = description.fields[description.primaryKey].name;
+
+  std::uint64_t erased = 0;
+  this->inTransaction([this, &description, keys, key, &erased] {
+    for (std::size_t offset = 0; offset < keys.size();
+         offset += MaxBoundKeys) {
+      const std::size_t count = std::min(MaxBoundKeys, keys.size() - offset);
+
+      fmt::memory_buffer buf;
+      fmt::appender appender{buf};
+      fmt::format_to(appender, R"(DELETE FROM "{}" WHERE "{}" IN ()",
+                     description.name, key);
+      for (std::size_t i = 0; i < count; ++i) {
+        fmt::format_to(appender, "{}?", i == 0 ? "" : ",");
+      }
+      fmt::format_to(appender, ")");
+
+      erased += this->execute(fmt::to_string(buf),
+                                    keys.subspan(offset, count));
+    }
+  });
+
+  return erased;
+}
+
+std::uint64_t
+Connection::updateWhere(const EntityDescription &description,
+                        const span<const Condition> where,
+                        const span<const Assignment> assignments) {
+  const OperationScope scope{description.name, "updateWhere",
+                             this->reporting()};
+  if (assignments.empty()) {
+    throw std::invalid_argument{
+        fmt::format("No fields of {} to update", description.name),
+    };
+  }
+
+  fmt::memory_buffer buf;
+  fmt::appender appender{buf};
+  std::vector<AsImage> args;
+
+  fmt::format_to(appender, R"(UPDATE "{}" SET )", description.name);
+  bool first = true;
+  for (const Assignment &assignment : assignments) {
+    getPrimitiveField(description, assignment.field);
+
+    const std::string_view name = description.fields[assignment.field].name;
+    switch (assignment.operation) {
+    case AssignmentOperation::Set:
+      fmt::format_to(appender, R"({}"{}" = ?)", first ? "" : ",", name);
+      break;
+    case AssignmentOperation::Add:
+      fmt::format_to(appender, R"({}"{}" = "{}" + ?)", first ? "" : ",", name,
+                     name);
+      break;
+    }
+    args.push_back(assignment.value);
+    first = false;
+  }
+  formatWhere(description, where, appender, args);
+
+  return this->execute(fmt::to_string(buf), args);
+}
+
 void Connection::update(const EntityDescription description,
                         const void *entity) {
+  const OperationScope scope{description.name, "update", this->reporting()};
   fmt::memory_buffer buf;
   fmt::appender appender{buf};
 
@@ -446,7 +1079,144 @@ void Connection::update(const EntityDescription description,
   }
 }
 
+void Connection::upsert(const EntityDescription &description,
+                        const void *entity) {
+  const OperationScope scope{description.name, "upsert", this->reporting()};
+  const std::string statement =
+      this->getGenerated(Generated::Upsert, description);
+
+  std::vector<AsImage> values;
+  for (const FieldDescription &field : description.fields) {
+    for (AsImage &value : intoArgs(field, field.constMemberPtr(entity))) {
+      values.emplace_back(std::move(value));
+    }
+  }
+
+  this->execute(statement, values);
+}
+
+void Connection::upsertMany(const EntityDescription &description,
+                            const span<const void *const> entities) {
+  const OperationScope scope{description.name, "upsertMany", this->reporting()};
+  this->inTransaction([this, &description, entities] {
+    for (const void *entity : entities) {
+      this->upsert(description, entity);
+    }
+  });
+}
+
+void Connection::update(const EntityDescription description,
+                        const void *entity, const FieldMask fields) {
+  const OperationScope scope{description.name, "update", this->reporting()};
+  checkMaskable(description);
+
+  if (fields == 0) {
+    throw std::invalid_argument{"No fields selected for update"};
+  }
+
+  const std::string statement =
+      this->getGenerated(Generated::PartialUpdate, description, fields);
+
+  std::vector<AsImage> values;
+  for (std::size_t i = 0; i < description.fields.size(); ++i) {
+    if ((fields & (FieldMask{1} << i)) == 0) {
+      continue;
+    }
+
+    const FieldDescription &field = description.fields[i];
+    for (AsImage &value : intoArgs(field, field.constMemberPtr(entity))) {
+      values.emplace_back(std::move(value));
+    }
+  }
+
+  std::vector<AsImage> key = intoArgs(
+      description.fields[description.primaryKey],
+      description.fields[description.primaryKey].constMemberPtr(entity));
+  if (key.size() != 1) {
+    throw std::invalid_argument{
+        fmt::format("Entity has composite primary key")};
+  }
+  values.emplace_back(std::move(key[0]));
+
+  const std::uint64_t changes = this->execute(statement, values);
+  if (changes == 0) {
+    throw std::runtime_error("Entity with the given key is not found");
+  }
+}
+
+void Connection::updateChanged(const EntityDescription description,
+                               const void *entity, const void *snapshot) {
+  const OperationScope scope{description.name, "updateChanged",
+                             this->reporting()};
+  checkMaskable(description);
+
+  FieldMask changed = 0;
+  for (std::size_t i = 0; i < description.fields.size(); ++i) {
+    const FieldDescription &field = description.fields[i];
+    if (!sameField(field, field.constMemberPtr(entity),
+                   field.constMemberPtr(snapshot))) {
+      changed |= FieldMask{1} << i;
+    }
+  }
+
+  if (changed == 0) {
+    return;
+  }
+
+  this->update(description, entity, changed);
+}
+
+bool Connection::increment(const EntityDescription &description,
+                           const std::size_t field, const AsImage &key,
+                           const void *delta) {
+  const OperationScope scope{description.name, "increment", this->reporting()};
+  const PrimitiveFieldDescription &primitive =
+      getPrimitiveField(description, field);
+  if (primitive.imageType != ImageType::Int &&
+      primitive.imageType != ImageType::Uint &&
+      primitive.imageType != ImageType::Float) {
+    throw std::invalid_argument{
+        fmt::format("Field {}.{} is not numeric", description.name,
+                    description.fields[field].name),
+    };
+  }
+
+  const std::string_view name = description.fields[field].name;
+  const std::string statement =
+      fmt::format(R"(UPDATE "{}" SET "{}" = "{}" + ? WHERE {} = ?)",
+                  description.name, name, name,
+                  description.fields[description.primaryKey].name);
+
+  const std::array<AsImage, 2> args = {primitive.asImage(delta), key};
+
+  return this->execute(statement, args) != 0;
+}
+
+bool Connection::compareAndSet(const EntityDescription &description,
+                               const std::size_t field, const AsImage &key,
+                               const void *expected, const void *desired) {
+  const OperationScope scope{description.name, "compareAndSet",
+                             this->reporting()};
+  const PrimitiveFieldDescription &primitive =
+      getPrimitiveField(description, field);
+
+  const std::string_view name = description.fields[field].name;
+  const std::string statement =
+      fmt::format(R"(UPDATE "{}" SET "{}" = ? WHERE {} = ? AND "{}" = ?)",
+                  description.name, name,
+                  description.fields[description.primaryKey].name, name);
+
+  const std::array<AsImage, 3> args = {
+      primitive.asImage(desired),
+      key,
+      primitive.asImage(expected),
+  };
+
+  return this->execute(statement, args) != 0;
+}
+
 Cursor Connection::iterate(const EntityDescription description) {
+  const OperationScope scope{description.name, "iterate", this->reporting()};
   const std::string queryStr =
       fmt::format(R"(SELECT * FROM "{}")", description.name);
 
@@ -456,4 +1226,76 @@ Cursor Connection::iterate(const EntityDescription description) {
   };
 }
 
+Cursor Connection::iterate(const EntityDescription description,
+                           const span<const FieldDescription> projection) {
+  const OperationScope scope{description.name, "iterate", this->reporting()};
+  std::vector<std::string_view> columns;
+  for (const FieldDescription &field : projection) {
+    columns.push_back(field.name);
+  }
+
+  const std::string queryStr =
+      fmt::format(R"(SELECT "{}" FROM "{}")", fmt::join(columns, R"(",")"),
+                  description.name);
+
+  return Cursor{
+      this->query(queryStr),
+      projection,
+  };
+}
+
+bool Connection::aggregate(const EntityDescription &description,
+                           const AggregateDescription &aggregate,
+                           const span<const Condition> where, void *result) {
+  const OperationScope scope{description.name, "aggregate", this->reporting()};
+  fmt::memory_buffer buf;
+  fmt::appender appender{buf};
+  std::vector<AsImage> args;
+
+  fmt::format_to(appender, R"(SELECT {} FROM "{}")",
+                 formatAggregate(description, aggregate), description.name);
+  formatWhere(description, where, appender, args);
+  if (aggregate.function != AggregateFunction::Count) {
+    // Aggregates of an empty set are NULL, return no row instead
+    fmt::format_to(appender, " HAVING COUNT(*) > 0");
+  }
+
+  const FieldDescription value{
+      .name = "aggregate",
+      .memberPtr = [](void *value) { return value; },
+      .constMemberPtr = [](const void *value) { return value; },
+      .field = aggregate.result,
+  };
+  const Cursor cursor{
+      this->query(fmt::to_string(buf), args),
+      podrm::span<const FieldDescription, 1>{&value, 1},
+  };
+
+  return cursor.extract(result);
+}
+
+Cursor Connection::groupBy(const EntityDescription &description,
+                           const std::size_t key,
+                           const AggregateDescription &aggregate,
+                           const span<const Condition> where,
+                           const span<const FieldDescription> group) {
+  const OperationScope scope{description.name, "groupBy", this->reporting()};
+  getPrimitiveField(description, key);
+
+  fmt::memory_buffer buf;
+  fmt::appender appender{buf};
+  std::vector<AsImage> args;
+
+  const std::string_view name = description.fields[key].name;
+  fmt::format_to(appender, R"(SELECT "{}", {} FROM "{}")", name,
+                 formatAggregate(description, aggregate), description.name);
+  formatWhere(description, where, appender, args);
+  fmt::format_to(appender, R"( GROUP BY "{}" ORDER BY "{}")", name, name);
+
+  return Cursor{
+      this->query(fmt::to_string(buf), args),
+      group,
+  };
+}
+
 } // namespace podrm::odbc::detail
@@ -1,7 +1,10 @@
 #include "error.hpp"
 
+#include <podrm/cancellation.hpp>
+
 #include <array>
 #include <cstddef>
+#include <stdexcept>
 #include <string>
 
 #include <sql.h>
@@ -30,4 +33,30 @@ std::string extractError(SQLHANDLE handle, const SQLSMALLINT type) {
       static_cast<std::size_t>(length),
   };
 }
+
+std::string extractState(SQLHANDLE handle, const SQLSMALLINT type) {
+  SQLINTEGER native = 0;
+
+  constexpr static std::size_t StateSize = 5;
+
+  std::array<SQLCHAR, StateSize + 1> state = {};
+
+  SQLSMALLINT length = 0;
+
+  SQLGetDiagRec(type, handle, 1, state.data(), &native, nullptr, 0, &length);
+
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast): safe
+  return std::string{reinterpret_cast<char *>(state.data())};
+}
+
+void throwStatementError(SQLHSTMT statement, const std::string &message) {
+  const std::string state = extractState(statement, SQL_HANDLE_STMT);
+  if (state == "HYT00") {
+    throw OperationTimedOut{};
+  }
+  if (state == "HY008") {
+    throw OperationCancelled{};
+  }
+  throw std::runtime_error{message};
+}
 } // namespace podrm::odbc
@@ -9,6 +9,15 @@ namespace podrm::odbc {
 
 std::string extractError(SQLHANDLE handle, SQLSMALLINT type);
 
+/// @returns SQLSTATE of the first diagnostic record
+std::string extractState(SQLHANDLE handle, SQLSMALLINT type);
+
+/// @throws OperationTimedOut or OperationCancelled if the statement was
+/// stopped by its query timeout or SQLCancel, std::runtime_error with the
+/// message otherwise
+[[noreturn]] void throwStatementError(SQLHSTMT statement,
+                                      const std::string &message);
+
 inline std::string statementError(SQLHSTMT statement) {
   return extractError(statement, SQL_HANDLE_STMT);
 }
@@ -1,8 +1,11 @@
 #include "error.hpp"
 
+#include <podrm/cancellation.hpp>
+#include <podrm/observation.hpp>
 #include <podrm/odbc/detail/result.hpp>
 
 #include <cassert>
+#include <memory>
 #include <optional>
 #include <stdexcept>
 #include <utility>
@@ -12,16 +15,44 @@
 
 namespace podrm::odbc::detail {
 
-Result::Result(Result::Statement statement) : statement(std::move(statement)) {
+Result::Result(Result::Statement statement,
+               std::unique_ptr<podrm::detail::Observation> observation,
+               std::optional<OperationLimits> limits)
+    : statement(std::move(statement)), observation(std::move(observation)),
+      limits(std::move(limits)) {
   this->nextRow();
 }
 
+Result::Result(Result &&other) noexcept = default;
+
+Result &Result::operator=(Result &&other) noexcept {
+  if (this != &other) {
+    this->finishObservation();
+    this->statement = std::move(other.statement);
+    this->columnCount = other.columnCount;
+    this->observation = std::move(other.observation);
+    this->limits = std::move(other.limits);
+  }
+  return *this;
+}
+
+Result::~Result() { this->finishObservation(); }
+
 bool Result::nextRow() {
   assert(this->statement.has_value());
 
+  if (this->limits.has_value()) {
+    this->limits->check();
+  }
+
   const int result = SQLFetch(this->statement->get());
+  if (this->observation != nullptr) {
+    this->observation->event.executeTime += this->observation->stopwatch.lap();
+  }
+
   if (result == SQL_NO_DATA) {
     this->statement.reset();
+    this->finishObservation();
     return false;
   }
 
@@ -34,9 +65,25 @@ bool Result::nextRow() {
 
   this->columnCount = columns;
 
+  if (this->observation != nullptr) {
+    ++this->observation->event.rows;
+    // Time spent by the caller between fetches is not execution time
+    this->observation->stopwatch.lap();
+  }
+
   return true;
 }
 
 bool Result::valid() const { return this->statement.has_value(); }
 
+void Result::finishObservation() {
+  if (this->observation == nullptr) {
+    return;
+  }
+
+  const std::unique_ptr<podrm::detail::Observation> observation =
+      std::move(this->observation);
+  observation->emit();
+}
+
 } // namespace podrm::odbc::detail
@@ -1,18 +1,25 @@
 #include "field.hpp"
 
+#include <podrm/aggregate.hpp>
+#include <podrm/cancellation.hpp>
 #include <podrm/metadata.hpp>
 #include <podrm/odbc.hpp>
+#include <podrm/predicate.hpp>
 #include <podrm/reflection.hpp>
 #include <podrm/span.hpp>
 
 #include <array>
 #include <cassert>
+#include <chrono>
 #include <cstdint>
 #include <cstdlib>
 #include <functional>
 #include <optional>
 #include <ostream>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 #include <catch2/catch_test_macros.hpp>
 #include <fmt/core.h>
@@ -76,6 +83,35 @@ constexpr auto podrm::EntityRegistration<Person> =
 
 static_assert(podrm::DatabaseEntity<Person>);
 
+namespace {
+
+struct PersonName {
+  std::int64_t id;
+
+  std::string name;
+};
+
+} // namespace
+
+static_assert(podrm::ProjectionOf<PersonName, Person>);
+
+namespace {
+
+struct Counter {
+  std::int64_t id;
+
+  std::int64_t hits;
+};
+
+} // namespace
+
+template <>
+constexpr auto podrm::EntityRegistration<Counter> =
+    podrm::EntityRegistrationData<Counter>{
+        .id = test::Field<Counter, &Counter::id>,
+        .idMode = IdMode::Manual,
+    };
+
 TEST_CASE("ODBC works", "[odbc]") {
   orm::Environment env;
 
@@ -121,6 +157,43 @@ TEST_CASE("ODBC works", "[odbc]") {
 
   REQUIRE_NOTHROW(db.persist(person));
 
+  SECTION("persist writes back generated ids") {
+    CHECK(address.id != 0);
+    CHECK(person.id != 0);
+
+    Person newPerson{
+        .id = person.id,
+        .name = "John",
+        .address{.key = address.id},
+    };
+    REQUIRE_NOTHROW(db.persist(newPerson));
+    CHECK(newPerson.id != person.id);
+  }
+
+  SECTION("persistMany writes back generated ids") {
+    std::array people = {
+        Person{
+            .id = 0,
+            .name = "John",
+            .address{.key = address.id},
+        },
+        Person{
+            .id = 0,
+            .name = "Jane",
+            .address{.key = address.id},
+        },
+    };
+    REQUIRE_NOTHROW(db.persistMany(people));
+    CHECK(people[0].id != person.id);
+    CHECK(people[1].id != people[0].id);
+
+    for (const Person &expected : people) {
+      const std::optional<Person> personFound = db.find<Person>(expected.id);
+      REQUIRE(personFound.has_value());
+      CHECK(*personFound == expected);
+    }
+  }
+
   SECTION("find on non-existent id returns nullopt") {
     const std::optional<Person> person = db.find<Person>(42);
     CHECK_FALSE(person.has_value());
@@ -166,6 +239,86 @@ TEST_CASE("ODBC works", "[odbc]") {
     CHECK(personFound->name == "Anne");
   }
 
+  SECTION("update of selected fields does not write other fields") {
+    person.name = "Anne";
+    person.address.key = 42;
+    REQUIRE_NOTHROW(
+        db.update(person, podrm::test::Field<Person, &Person::name>));
+
+    const std::optional<Person> personFound = db.find<Person>(person.id);
+    REQUIRE(personFound.has_value());
+    CHECK(personFound->name == "Anne");
+    CHECK(personFound->address.key == address.id);
+  }
+
+  SECTION("update against a snapshot writes only changed fields") {
+    Address newAddress{
+        .id = 1,
+        .postalCode = "def",
+    };
+    REQUIRE_NOTHROW(db.persist(newAddress));
+
+    const std::optional<Person> snapshot = db.find<Person>(person.id);
+    REQUIRE(snapshot.has_value());
+
+    Person renamed = *snapshot;
+    renamed.name = "Bob";
+    REQUIRE_NOTHROW(db.update(renamed));
+
+    Person moved = *snapshot;
+    moved.address.key = newAddress.id;
+    REQUIRE_NOTHROW(db.update(moved, *snapshot));
+
+    const std::optional<Person> personFound = db.find<Person>(person.id);
+    REQUIRE(personFound.has_value());
+    CHECK(personFound->name == "Bob");
+    CHECK(personFound->address.key == newAddress.id);
+  }
+
+  SECTION("update against an unchanged snapshot does nothing") {
+    REQUIRE_NOTHROW(db.erase<Person>(person.id));
+    CHECK_NOTHROW(db.update(person, person));
+  }
+
+  SECTION("upsert updates an existing entity") {
+    person.name = "Anne";
+    REQUIRE_NOTHROW(db.upsert(person));
+
+    const std::optional<Person> personFound = db.find<Person>(person.id);
+    REQUIRE(personFound.has_value());
+    CHECK(personFound->name == "Anne");
+  }
+
+  SECTION("upsertMany inserts new and updates existing entities") {
+    person.name = "Anne";
+    const std::array people = {
+        person,
+        Person{
+            .id = person.id + 1,
+            .name = "John",
+            .address{.key = address.id},
+        },
+    };
+    REQUIRE_NOTHROW(db.upsertMany(people));
+
+    for (const Person &expected : people) {
+      const std::optional<Person> personFound = db.find<Person>(expected.id);
+      REQUIRE(personFound.has_value());
+      CHECK(*personFound == expected);
+    }
+  }
+
+  SECTION("iterateAs reads only the projected columns") {
+    int i = 0;
+    for (const PersonName &result : db.iterateAs<Person, PersonName>()) {
+      CHECK(result.id == person.id);
+      CHECK(result.name == person.name);
+      ++i;
+    }
+
+    CHECK(i == 1);
+  }
+
   SECTION("iterate iterates over existing entities") {
     Person newPerson{
         .id = 1,
@@ -189,3 +342,194 @@ TEST_CASE("ODBC works", "[odbc]") {
     CHECK(i == 2);
   }
 }
+
+TEST_CASE("ODBC atomic field operations", "[odbc]") {
+  orm::Environment env;
+
+  const char *connectionString = std::getenv("PODRM_ODBC_CONNECTION_STRING");
+  REQUIRE(connectionString != nullptr);
+
+  orm::Database db = orm::Database::fromConnectionString(env, connectionString);
+
+  REQUIRE_NOTHROW(db.createTable<Counter>());
+
+  Counter counter{
+      .id = 1,
+      .hits = 0,
+  };
+  REQUIRE_NOTHROW(db.persist(counter));
+
+  SECTION("increment adds to the stored value") {
+    CHECK(db.increment<&Counter::hits>(counter.id, 2));
+    CHECK(db.increment<&Counter::hits>(counter.id, -1));
+
+    const std::optional<Counter> counterFound = db.find<Counter>(counter.id);
+    REQUIRE(counterFound.has_value());
+    CHECK(counterFound->hits == 1);
+  }
+
+  SECTION("increment on non-existent id returns false") {
+    CHECK_FALSE(db.increment<&Counter::hits>(42, 1));
+  }
+
+  SECTION("compareAndSet replaces only the expected value") {
+    CHECK(db.compareAndSet<&Counter::hits>(counter.id, 0, 5));
+    CHECK_FALSE(db.compareAndSet<&Counter::hits>(counter.id, 0, 7));
+
+    const std::optional<Counter> counterFound = db.find<Counter>(counter.id);
+    REQUIRE(counterFound.has_value());
+    CHECK(counterFound->hits == 5);
+  }
+}
+
+TEST_CASE("ODBC aggregates", "[odbc]") {
+  orm::Environment env;
+
+  const char *connectionString = std::getenv("PODRM_ODBC_CONNECTION_STRING");
+  REQUIRE(connectionString != nullptr);
+
+  orm::Database db = orm::Database::fromConnectionString(env, connectionString);
+
+  REQUIRE_NOTHROW(db.createTable<Counter>());
+
+  std::vector<Counter> counters = {
+      {.id = 1, .hits = 10},
+      {.id = 2, .hits = 20},
+      {.id = 3, .hits = 10},
+  };
+  REQUIRE_NOTHROW(db.persistMany(counters));
+
+  SECTION("count counts matching entities") {
+    CHECK(db.count<Counter>() == 3);
+    CHECK(db.count<Counter>(podrm::Column<&Counter::hits> == 10) == 2);
+    CHECK(db.count<Counter>(podrm::Column<&Counter::hits> > 20) == 0);
+  }
+
+  SECTION("sum, min and max are computed over matching entities") {
+    CHECK(db.sum<&Counter::hits>() == 40);
+    CHECK(db.sum<&Counter::hits>(podrm::Column<&Counter::id> > 3) == 0);
+    CHECK(db.min<&Counter::hits>() == 10);
+    CHECK(db.max<&Counter::hits>(podrm::Column<&Counter::id> != 2) == 10);
+    CHECK_FALSE(
+        db.max<&Counter::hits>(podrm::Column<&Counter::id> > 3).has_value());
+  }
+
+  SECTION("groupBy aggregates each group") {
+    CHECK(db.groupBy<&Counter::hits>(podrm::Count<Counter>) ==
+          std::vector<std::pair<std::int64_t, std::uint64_t>>{
+              {10, 2},
+              {20, 1},
+          });
+    CHECK(db.groupBy<&Counter::hits>(podrm::Max<&Counter::id>) ==
+          std::vector<std::pair<std::int64_t, std::int64_t>>{
+              {10, 3},
+              {20, 2},
+          });
+  }
+}
+
+TEST_CASE("ODBC bulk operations", "[odbc]") {
+  orm::Environment env;
+
+  const char *connectionString = std::getenv("PODRM_ODBC_CONNECTION_STRING");
+  REQUIRE(connectionString != nullptr);
+
+  orm::Database db = orm::Database::fromConnectionString(env, connectionString);
+
+  REQUIRE_NOTHROW(db.createTable<Counter>());
+
+  std::vector<Counter> counters = {
+      {.id = 1, .hits = 10},
+      {.id = 2, .hits = 20},
+      {.id = 3, .hits = 30},
+  };
+  REQUIRE_NOTHROW(db.persistMany(counters));
+
+  SECTION("eraseWhere erases only matching entities") {
+    CHECK(db.eraseWhere(podrm::Column<&Counter::hits> >= 20) == 2);
+    CHECK(db.count<Counter>() == 1);
+  }
+
+  SECTION("eraseMany ignores missing keys") {
+    CHECK(db.eraseMany<Counter>(std::vector<std::int64_t>{1, 3, 42}) == 2);
+    CHECK(db.count<Counter>() == 1);
+  }
+
+  SECTION("updateWhere applies assignments to matching entities") {
+    CHECK(db.updateWhere(podrm::Column<&Counter::id> != 2,
+                         podrm::Column<&Counter::hits>.add(5)) == 2);
+    CHECK(db.sum<&Counter::hits>() == 70);
+  }
+
+  SECTION("bulk operations are rolled back with the transaction") {
+    {
+      orm::Transaction transaction = db.begin();
+      CHECK(db.eraseWhere<Counter>({}) == 3);
+    }
+    CHECK(db.count<Counter>() == 3);
+  }
+}
+
+TEST_CASE("ODBC operation limits", "[odbc]") {
+  orm::Environment env;
+
+  const char *connectionString = std::getenv("PODRM_ODBC_CONNECTION_STRING");
+  REQUIRE(connectionString != nullptr);
+
+  orm::Database db = orm::Database::fromConnectionString(env, connectionString);
+
+  REQUIRE_NOTHROW(db.createTable<Counter>());
+
+  {
+    const orm::LimitScope scope =
+        db.limit(podrm::OperationLimits::timeout(std::chrono::seconds{-1}));
+    CHECK_THROWS_AS(db.count<Counter>(), podrm::OperationTimedOut);
+  }
+
+  podrm::CancellationSource source;
+  source.cancel();
+  {
+    const orm::LimitScope scope = db.limit({.token = source.token()});
+    CHECK_THROWS_AS(db.find<Counter>(1), podrm::OperationCancelled);
+  }
+
+  {
+    const orm::LimitScope scope =
+        db.limit(podrm::OperationLimits::timeout(std::chrono::minutes{1}));
+    CHECK(db.count<Counter>() == 0);
+  }
+}
+
+TEST_CASE("ODBC read replicas", "[odbc]") {
+  orm::Environment env;
+
+  const char *connectionString = std::getenv("PODRM_ODBC_CONNECTION_STRING");
+  REQUIRE(connectionString != nullptr);
+
+  // The primary serves as its own replica, the routing is observed through
+  // limits of the replica connection
+  const std::array<std::string_view, 1> replicas{connectionString};
+  orm::ReplicatedDatabase db = orm::ReplicatedDatabase::fromConnectionStrings(
+      env, connectionString, replicas,
+      {.stickiness = std::chrono::minutes{1}});
+
+  REQUIRE(db.replicaCount() == 1);
+  CHECK(db.checkHealth() == 1);
+
+  podrm::CancellationSource source;
+  source.cancel();
+  const orm::LimitScope scope =
+      db.replica(0).limit({.token = source.token()});
+
+  SECTION("reads go to a replica") {
+    CHECK_THROWS_AS(db.count<Counter>(), podrm::OperationCancelled);
+  }
+
+  SECTION("reads after a write go to the primary") {
+    REQUIRE_NOTHROW(db.createTable<Counter>());
+    Counter counter{.id = 1, .hits = 2};
+    REQUIRE_NOTHROW(db.persist(counter));
+    CHECK(db.find<Counter>(1).value().hits == 2);
+    CHECK(db.count<Counter>() == 1);
+  }
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <podrm/cancellation.hpp>
+#include <podrm/instrumentation.hpp>
+#include <podrm/metadata.hpp>
+#include <podrm/postgres/detail/async_connection.hpp>
+#include <podrm/postgres/detail/result.hpp>
+#include <podrm/postgres/reactor.hpp>
+#include <podrm/postgres/task.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace podrm::postgres {
+
+/// Database driven by the reactor, operations are coroutines that suspend
+/// while waiting for the server. Referenced entities must outlive the
+/// returned tasks. Operations fail with OperationCancelled or
+/// OperationTimedOut once their limits are exceeded, deadlines are enforced
+/// by the server with statement_timeout
+class AsyncDatabase {
+public:
+  /// Connects synchronously, the connections then run in the reactor
+  /// @param connections number of connections, each runs one statement at a
+  /// time
+  AsyncDatabase(Reactor &reactor, const std::string &connectionStr,
+                const std::size_t connections = 1) {
+    if (connections == 0) {
+      throw std::invalid_argument{"At least one connection is required"};
+    }
+
+    this->connections.reserve(connections);
+    for (std::size_t i = 0; i < connections; ++i) {
+      this->connections.push_back(
+          std::make_unique<detail::AsyncConnection>(reactor, connectionStr));
+    }
+  }
+
+  /// Inserts the entity, for IdMode::Auto the generated key is written back
+  template <DatabaseEntity Entity>
+  Task<void> persist(Entity &entity, const OperationLimits limits = {}) {
+    co_await this->pick().persist(DatabaseEntityDescription<Entity>.value(),
+                                  &entity, limits);
+  }
+
+  template <DatabaseEntity Entity>
+  Task<std::optional<Entity>> find(const PrimaryKeyType<Entity> key,
+                                   const OperationLimits limits = {}) {
+    Entity result;
+    if (!co_await this->pick().find(DatabaseEntityDescription<Entity>.value(),
+                                    key, &result, limits)) {
+      co_return std::nullopt;
+    }
+
+    co_return result;
+  }
+
+  template <DatabaseEntity Entity>
+  Task<void> erase(const PrimaryKeyType<Entity> key,
+                   const OperationLimits limits = {}) {
+    co_await this->pick().erase(DatabaseEntityDescription<Entity>.value(),
+                                key, limits);
+  }
+
+  template <DatabaseEntity Entity>
+  Task<void> update(const Entity &entity, const OperationLimits limits = {}) {
+    co_await this->pick().update(DatabaseEntityDescription<Entity>.value(),
+                                 &entity, limits);
+  }
+
+  template <DatabaseEntity Entity>
+  Task<std::vector<Entity>> findAll(const OperationLimits limits = {}) {
+    const EntityDescription &description =
+        DatabaseEntityDescription<Entity>.value();
+    const detail::Result result =
+        co_await this->pick().selectAll(description, limits);
+
+    std::vector<Entity> entities(static_cast<std::size_t>(result.rows()));
+    for (int row = 0; row < result.rows(); ++row) {
+      detail::extractRow(result, row, description.fields,
+                         &entities[static_cast<std::size_t>(row)]);
+    }
+    co_return entities;
+  }
+
+  /// Cancels the running statements of all connections with PQcancel, the
+  /// operations fail with OperationCancelled
+  void interrupt() {
+    for (const std::unique_ptr<detail::AsyncConnection> &connection :
+         this->connections) {
+      connection->interrupt();
+    }
+  }
+
+  /// Reports every statement of all connections with its timings and sizes
+  /// to the observer, e.g. a HistogramObserver. Statements are not timed
+  /// without one
+  /// @param observer observer outliving the database, nullptr to stop
+  /// reporting
+  void setObserver(Observer *observer) {
+    for (const std::unique_ptr<detail::AsyncConnection> &connection :
+         this->connections) {
+      connection->setObserver(observer);
+    }
+  }
+
+private:
+  std::vector<std::unique_ptr<detail::AsyncConnection>> connections;
+
+  /// @returns connection with the fewest running and waiting operations
+  detail::AsyncConnection &pick() {
+    return **std::ranges::min_element(
+        this->connections, {},
+        [](const std::unique_ptr<detail::AsyncConnection> &connection) {
+          return connection->load();
+        });
+  }
+};
+
+} // namespace podrm::postgres
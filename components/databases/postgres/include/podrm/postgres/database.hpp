@@ -1,10 +1,16 @@
 #pragma once
 
+#include <podrm/instrumentation.hpp>
 #include <podrm/metadata.hpp>
+#include <podrm/postgres/decode_stats.hpp>
 #include <podrm/postgres/detail/connection.hpp>
+#include <podrm/postgres/detail/result.hpp>
 
+#include <chrono>
+#include <cstddef>
 #include <string>
 #include <utility>
+#include <vector>
 
 namespace podrm::postgres {
 
@@ -21,6 +27,48 @@ public:
     return this->connection.exists(DatabaseEntityDescription<T>.value());
   }
 
+  /// Runs the query and decodes all returned rows, blocks of rows are
+  /// decoded by several threads straight into the returned vector
+  /// @param query statement returning the entity columns in order, e.g.
+  /// SELECT * from the entity table
+  /// @param threads number of decoding threads, hardware concurrency if 0
+  /// @param[out] stats decoding throughput, if not null
+  template <DatabaseEntity Entity>
+  std::vector<Entity> fetchAll(const std::string &query,
+                               const std::size_t threads = 0,
+                               DecodeStats *const stats = nullptr) {
+    const EntityDescription &description =
+        DatabaseEntityDescription<Entity>.value();
+    const detail::Result result = this->connection.select(description, query);
+
+    std::vector<Entity> entities(static_cast<std::size_t>(result.rows()));
+    const auto start = std::chrono::steady_clock::now();
+    const std::size_t used = detail::extractRows(
+        result, description.fields, entities.data(), sizeof(Entity), threads);
+
+    if (stats != nullptr) {
+      *stats = DecodeStats{
+          .rows = entities.size(),
+          .bytes = result.size(),
+          .threads = used,
+          .elapsed = std::chrono::steady_clock::now() - start,
+      };
+    }
+
+    return entities;
+  }
+
+  /// Pings the server, reconnecting first if the connection is lost
+  /// @returns true if the server answers
+  bool alive() { return this->connection.alive(); }
+
+  /// Reports every statement with its timings and sizes to the observer
+  /// @param observer observer outliving the database, nullptr to stop
+  /// reporting
+  void setObserver(Observer *observer) {
+    this->connection.setObserver(observer);
+  }
+
 private:
   detail::Connection connection;
 
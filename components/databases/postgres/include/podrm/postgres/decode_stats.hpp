@@ -0,0 +1,38 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace podrm::postgres {
+
+/// Throughput of decoding a result into entities
+struct DecodeStats {
+  std::size_t rows = 0;
+
+  /// Total length of the decoded text values
+  std::uint64_t bytes = 0;
+
+  std::size_t threads = 0;
+
+  std::chrono::nanoseconds elapsed{0};
+
+  /// @returns 0 if nothing was timed, e.g. for empty results
+  [[nodiscard]] double rowsPerSecond() const {
+    return this->perSecond(static_cast<double>(this->rows));
+  }
+
+  /// @returns 0 if nothing was timed, e.g. for empty results
+  [[nodiscard]] double bytesPerSecond() const {
+    return this->perSecond(static_cast<double>(this->bytes));
+  }
+
+private:
+  [[nodiscard]] double perSecond(const double amount) const {
+    const double seconds =
+        std::chrono::duration<double>(this->elapsed).count();
+    return seconds > 0 ? amount / seconds : 0;
+  }
+};
+
+} // namespace podrm::postgres
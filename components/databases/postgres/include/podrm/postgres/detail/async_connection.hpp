@@ -0,0 +1,116 @@
+#pragma once
+
+#include <podrm/cancellation.hpp>
+#include <podrm/instrumentation.hpp>
+#include <podrm/metadata.hpp>
+#include <podrm/postgres/detail/result.hpp>
+#include <podrm/postgres/detail/str.hpp>
+#include <podrm/postgres/reactor.hpp>
+#include <podrm/postgres/task.hpp>
+#include <podrm/span.hpp>
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct pg_conn;
+
+namespace podrm::postgres::detail {
+
+/// Non-blocking connection, statements are prepared once and executed one
+/// at a time, other callers wait in a FIFO queue
+class AsyncConnection {
+public:
+  AsyncConnection(Reactor &reactor, const std::string &connectionStr);
+  ~AsyncConnection();
+
+  AsyncConnection(const AsyncConnection &) = delete;
+  AsyncConnection(AsyncConnection &&) = delete;
+  AsyncConnection &operator=(const AsyncConnection &) = delete;
+  AsyncConnection &operator=(AsyncConnection &&) = delete;
+
+  /// Inserts the entity, writing the generated key back for IdMode::Auto
+  Task<void> persist(const EntityDescription &description, void *entity,
+                     OperationLimits limits);
+
+  /// @param[out] result pointer to the result structure, filled if found
+  Task<bool> find(const EntityDescription &description, AsImage key,
+                  void *result, OperationLimits limits);
+
+  Task<void> erase(const EntityDescription &description, AsImage key,
+                   OperationLimits limits);
+
+  Task<void> update(const EntityDescription &description, const void *entity,
+                    OperationLimits limits);
+
+  /// @returns result with all entities of the table
+  Task<Result> selectAll(const EntityDescription &description,
+                         OperationLimits limits);
+
+  /// Asks the server to cancel the running statement with PQcancel, which
+  /// blocks until the request is sent
+  void interrupt();
+
+  /// Number of operations running or waiting for this connection
+  [[nodiscard]] std::size_t load() const { return this->pending; }
+
+  /// Reports every executed statement to the observer, which must outlive
+  /// the connection
+  /// @param observer new observer, nullptr to stop reporting
+  void setObserver(Observer *observer) { this->observer = observer; }
+
+  [[nodiscard]] Str escapeIdentifier(std::string_view identifier) const;
+
+private:
+  pg_conn *connection;
+
+  Reactor &reactor;
+
+  int socket;
+
+  /// Names of prepared statements, keyed by their text
+  std::unordered_map<std::string, std::string> prepared;
+
+  /// Read by interrupt from other threads
+  std::atomic<bool> busy{false};
+
+  std::deque<std::coroutine_handle<>> waiters;
+
+  std::size_t pending = 0;
+
+  /// Receives statement events, statements are not timed without it
+  Observer *observer = nullptr;
+
+  class Acquire;
+
+  class Guard;
+
+  /// @returns awaitable that resumes once the connection is free for a
+  /// statement, the connection is then held until release
+  Acquire acquire();
+
+  /// Passes the connection to the next waiting caller
+  void release();
+
+  /// Prepares the statement if needed, executes it with text parameters and
+  /// waits for its result. The deadline is enforced with statement_timeout,
+  /// sent in a pipeline along with the statement
+  /// @param context entity and operation reported to the observer
+  /// @throws OperationCancelled or OperationTimedOut if the limits are
+  /// exceeded or the statement is cancelled
+  Task<Result> execute(podrm::detail::OperationContext context,
+                       std::string statement, std::vector<std::string> params,
+                       int expectedStatus, OperationLimits limits);
+
+  Task<void> flush();
+
+  /// @returns last result of the sent command
+  Task<Result> receive();
+};
+
+} // namespace podrm::postgres::detail
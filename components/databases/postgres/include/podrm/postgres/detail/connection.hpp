@@ -1,5 +1,6 @@
 #pragma once
 
+#include <podrm/instrumentation.hpp>
 #include <podrm/metadata.hpp>
 #include <podrm/postgres/detail/result.hpp>
 #include <podrm/postgres/detail/str.hpp>
@@ -20,6 +21,9 @@ public:
 
   bool exists(const EntityDescription &entity);
 
+  /// Runs the query of the entity table, the whole result is kept in memory
+  Result select(const EntityDescription &entity, const std::string &query);
+
   Connection(const Connection &) = delete;
   Connection(Connection &&) noexcept;
   Connection &operator=(const Connection &) = delete;
@@ -27,9 +31,25 @@ public:
 
   [[nodiscard]] Str escapeIdentifier(std::string_view identifier) const;
 
+  /// Pings the server, reconnecting first if the connection is lost
+  /// @returns true if the server answers
+  bool alive();
+
+  /// Reports every executed statement to the observer, which must outlive
+  /// the connection
+  /// @param observer new observer, nullptr to stop reporting
+  void setObserver(Observer *observer) { this->observer = observer; }
+
 private:
   pg_conn *connection;
 
+  /// Receives statement events, statements are not timed without it
+  Observer *observer = nullptr;
+
+  /// Reports the statement executed with PQexec, which prepares it as well
+  void notify(const std::string &statement,
+              podrm::detail::Stopwatch &stopwatch, const Result &result);
+
   Result execute(const std::string &statement);
 
   Result query(const std::string &statement);
@@ -1,5 +1,10 @@
 #pragma once
 
+#include <podrm/metadata.hpp>
+#include <podrm/span.hpp>
+
+#include <cstddef>
+#include <cstdint>
 #include <string_view>
 
 struct pg_result;
@@ -14,6 +19,19 @@ public:
   [[nodiscard]] int status() const;
   [[nodiscard]] std::string_view value(int row, int column) const;
 
+  [[nodiscard]] int rows() const;
+
+  /// @returns total length of the returned values in bytes
+  [[nodiscard]] std::uint64_t size() const;
+
+  /// @returns number of rows affected by the command
+  [[nodiscard]] std::uint64_t affectedRows() const;
+
+  [[nodiscard]] std::string_view errorMessage() const;
+
+  /// @returns SQLSTATE code of the error, empty if there is none
+  [[nodiscard]] std::string_view errorState() const;
+
   Result(const Result &) = delete;
   Result(Result &&) noexcept;
   Result &operator=(const Result &) = delete;
@@ -23,4 +41,18 @@ private:
   pg_result *result;
 };
 
+/// Initializes the entity from a row of the text result
+void extractRow(const Result &result, int row,
+                span<const FieldDescription> description, void *data);
+
+/// Initializes entities from all rows of the text result, blocks of rows are
+/// decoded by several threads at once
+/// @param data array of result.rows() entities
+/// @param stride distance between the entities in bytes
+/// @param workers number of threads, hardware concurrency if 0
+/// @returns number of threads used
+std::size_t extractRows(const Result &result,
+                        span<const FieldDescription> description, void *data,
+                        std::size_t stride, std::size_t workers);
+
 } // namespace podrm::postgres::detail
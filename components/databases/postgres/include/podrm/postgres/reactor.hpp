@@ -0,0 +1,129 @@
+#pragma once
+
+#include <podrm/postgres/task.hpp>
+
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace podrm::postgres {
+
+/// Single-threaded epoll event loop that resumes coroutines waiting for file
+/// descriptors
+class Reactor {
+public:
+  Reactor();
+  ~Reactor();
+
+  Reactor(const Reactor &) = delete;
+  Reactor(Reactor &&) = delete;
+  Reactor &operator=(const Reactor &) = delete;
+  Reactor &operator=(Reactor &&) = delete;
+
+  enum class Event : std::uint8_t {
+    Readable,
+    Writable,
+  };
+
+  /// Awaitable that resumes the coroutine once the descriptor is ready
+  class FdAwaiter {
+  public:
+    bool await_ready() noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> handle);
+
+    void await_resume() noexcept {}
+
+  private:
+    Reactor &reactor;
+
+    int fd;
+
+    Event event;
+
+    FdAwaiter(Reactor &reactor, const int fd, const Event event)
+        : reactor(reactor), fd(fd), event(event) {}
+
+    friend class Reactor;
+  };
+
+  FdAwaiter readable(const int fd) {
+    return FdAwaiter{*this, fd, Event::Readable};
+  }
+
+  FdAwaiter writable(const int fd) {
+    return FdAwaiter{*this, fd, Event::Writable};
+  }
+
+  /// Queues the coroutine to be resumed by the next poll
+  void post(std::coroutine_handle<> handle);
+
+  /// Removes the descriptor from the reactor, must be called before the
+  /// descriptor is closed
+  void forget(int fd);
+
+  /// Starts the task, it runs in the reactor until completion. Exceptions of
+  /// the task are rethrown from poll
+  void spawn(Task<void> task);
+
+  /// Resumes posted coroutines and coroutines with ready descriptors
+  /// @param timeout maximum time to wait for events, nullopt to wait
+  /// indefinitely
+  void poll(std::optional<std::chrono::milliseconds> timeout);
+
+  /// Polls until the task is complete
+  /// @returns task result
+  template <typename T> T run(Task<T> task) {
+    bool done = false;
+    std::conditional_t<std::is_void_v<T>, bool, std::optional<T>> result{};
+
+    this->spawn(complete(std::move(task), result, done));
+    while (!done) {
+      this->checkProgress();
+      this->poll(std::nullopt);
+    }
+
+    if constexpr (!std::is_void_v<T>) {
+      // NOLINTNEXTLINE(bugprone-unchecked-optional-access): set when done
+      return std::move(*result);
+    }
+  }
+
+private:
+  int epoll;
+
+  /// Descriptors added to the epoll instance
+  std::unordered_set<int> registered;
+
+  /// Number of coroutines waiting for descriptors
+  std::size_t waiting = 0;
+
+  std::vector<std::coroutine_handle<>> ready;
+
+  std::exception_ptr failure;
+
+  void wait(int fd, Event event, std::coroutine_handle<> handle);
+
+  /// @throws failure of a spawned task, or std::logic_error if there is
+  /// nothing to wait for
+  void checkProgress();
+
+  template <typename T, typename Result>
+  static Task<void> complete(Task<T> task, Result &result, bool &done) {
+    if constexpr (std::is_void_v<T>) {
+      co_await std::move(task);
+    } else {
+      result.emplace(co_await std::move(task));
+    }
+    done = true;
+  }
+};
+
+} // namespace podrm::postgres
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <podrm/instrumentation.hpp>
+#include <podrm/metadata.hpp>
+#include <podrm/postgres/database.hpp>
+#include <podrm/postgres/decode_stats.hpp>
+#include <podrm/replication.hpp>
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace podrm::postgres {
+
+/// Database with streaming replicas: reads go to a healthy replica in turn,
+/// writes go to the primary. Replicas lag behind the primary, see
+/// ReplicationOptions::stickiness to read own writes
+class ReplicatedDatabase {
+public:
+  /// @throws std::runtime_error if a server cannot be connected to
+  ReplicatedDatabase(const std::string &primary,
+                     const std::vector<std::string> &replicas,
+                     const ReplicationOptions &options = {})
+      : router(Database{primary}, connect(replicas), options) {}
+
+  /// Database receiving writes, e.g. for reads that must see them at once
+  Database &primary() { return this->router.primary(); }
+
+  Database &replica(const std::size_t index) {
+    return this->router.replicas().at(index);
+  }
+
+  std::size_t replicaCount() { return this->router.replicas().size(); }
+
+  /// Pings every replica, reconnecting lost ones and returning recovered
+  /// ones to rotation at once
+  /// @returns number of healthy replicas
+  std::size_t checkHealth() { return this->router.checkHealth(); }
+
+  template <DatabaseEntity T> void createTable() {
+    this->router.write().createTable<T>();
+  }
+
+  template <DatabaseEntity T> bool exists() {
+    return this->router.read([](Database &db) { return db.exists<T>(); });
+  }
+
+  /// Runs the query on a replica, see Database::fetchAll
+  template <DatabaseEntity Entity>
+  std::vector<Entity> fetchAll(const std::string &query,
+                               const std::size_t threads = 0,
+                               DecodeStats *const stats = nullptr) {
+    return this->router.read([&query, threads, stats](Database &db) {
+      return db.fetchAll<Entity>(query, threads, stats);
+    });
+  }
+
+  /// Reports statements of the primary and every replica to the observer
+  /// @param observer observer outliving the database, nullptr to stop
+  /// reporting
+  void setObserver(Observer *observer) {
+    this->router.primary().setObserver(observer);
+    for (Database &replica : this->router.replicas()) {
+      replica.setObserver(observer);
+    }
+  }
+
+private:
+  podrm::detail::ReplicaRouter<Database> router;
+
+  static std::vector<Database>
+  connect(const std::vector<std::string> &connectionStrings) {
+    std::vector<Database> databases;
+    databases.reserve(connectionStrings.size());
+    for (const std::string &connectionString : connectionStrings) {
+      databases.emplace_back(connectionString);
+    }
+    return databases;
+  }
+};
+
+} // namespace podrm::postgres
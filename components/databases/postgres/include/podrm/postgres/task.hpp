@@ -0,0 +1,133 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace podrm::postgres {
+
+template <typename T> class Task;
+
+namespace detail {
+
+/// Resumes the awaiting coroutine, if any, once the task is complete
+struct TaskFinalAwaiter {
+  bool await_ready() noexcept { return false; }
+
+  template <typename Promise>
+  std::coroutine_handle<>
+  await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+    const std::coroutine_handle<> continuation = handle.promise().continuation;
+    return continuation ? continuation : std::noop_coroutine();
+  }
+
+  void await_resume() noexcept {}
+};
+
+class TaskPromiseBase {
+public:
+  std::suspend_always initial_suspend() noexcept { return {}; }
+
+  TaskFinalAwaiter final_suspend() noexcept { return {}; }
+
+  void unhandled_exception() { this->exception = std::current_exception(); }
+
+  std::coroutine_handle<> continuation;
+
+protected:
+  std::exception_ptr exception;
+
+  void rethrow() const {
+    if (this->exception != nullptr) {
+      std::rethrow_exception(this->exception);
+    }
+  }
+};
+
+template <typename T> class TaskPromise : public TaskPromiseBase {
+public:
+  Task<T> get_return_object();
+
+  template <typename Value>
+    requires std::is_convertible_v<Value &&, T>
+  void return_value(Value &&value) {
+    this->value.emplace(std::forward<Value>(value));
+  }
+
+  T result() {
+    this->rethrow();
+    // NOLINTNEXTLINE(bugprone-unchecked-optional-access): set if no exception
+    return std::move(*this->value);
+  }
+
+private:
+  std::optional<T> value;
+};
+
+template <> class TaskPromise<void> : public TaskPromiseBase {
+public:
+  Task<void> get_return_object();
+
+  void return_void() {}
+
+  void result() const { this->rethrow(); }
+};
+
+} // namespace detail
+
+/// Lazily started coroutine, runs when awaited and resumes the awaiting
+/// coroutine on completion
+template <typename T> class [[nodiscard]] Task {
+public:
+  using promise_type = detail::TaskPromise<T>;
+
+  Task(const Task &) = delete;
+  Task(Task &&other) noexcept
+      : handle(std::exchange(other.handle, nullptr)) {}
+  Task &operator=(const Task &) = delete;
+  Task &operator=(Task &&) = delete;
+
+  ~Task() {
+    if (this->handle) {
+      this->handle.destroy();
+    }
+  }
+
+  auto operator co_await() && noexcept {
+    struct Awaiter {
+      std::coroutine_handle<promise_type> handle;
+
+      bool await_ready() noexcept { return false; }
+
+      std::coroutine_handle<>
+      await_suspend(const std::coroutine_handle<> awaiting) noexcept {
+        this->handle.promise().continuation = awaiting;
+        return this->handle;
+      }
+
+      T await_resume() { return this->handle.promise().result(); }
+    };
+
+    return Awaiter{this->handle};
+  }
+
+private:
+  std::coroutine_handle<promise_type> handle;
+
+  explicit Task(const std::coroutine_handle<promise_type> handle)
+      : handle(handle) {}
+
+  friend promise_type;
+};
+
+template <typename T> Task<T> detail::TaskPromise<T>::get_return_object() {
+  return Task<T>{std::coroutine_handle<TaskPromise>::from_promise(*this)};
+}
+
+inline Task<void> detail::TaskPromise<void>::get_return_object() {
+  return Task<void>{std::coroutine_handle<TaskPromise>::from_promise(*this)};
+}
+
+} // namespace podrm::postgres
@@ -0,0 +1,523 @@
+#include "formatters.hpp" // IWYU pragma: keep
+
+#include <podrm/cancellation.hpp>
+#include <podrm/instrumentation.hpp>
+#include <podrm/metadata.hpp>
+#include <podrm/multilambda.hpp>
+#include <podrm/postgres/detail/async_connection.hpp>
+#include <podrm/postgres/detail/result.hpp>
+#include <podrm/postgres/detail/str.hpp>
+#include <podrm/postgres/reactor.hpp>
+#include <podrm/postgres/task.hpp>
+#include <podrm/span.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <fmt/core.h>
+#include <fmt/format.h>
+#include <libpq-fe.h>
+
+namespace podrm::postgres::detail {
+
+namespace {
+
+void collectColumns(const AsyncConnection &connection,
+                    const FieldDescription &description,
+                    std::vector<std::string_view> prefixes,
+                    std::vector<std::string> &columns) {
+  prefixes.push_back(description.name);
+
+  const auto collectPrimitive = [&connection, &prefixes,
+                                 &columns](const PrimitiveFieldDescription &) {
+    const Str column = connection.escapeIdentifier(
+        fmt::to_string(fmt::join(prefixes, "_")));
+    columns.emplace_back(column.view());
+  };
+
+  const auto collectComposite =
+      [&connection, &prefixes,
+       &columns](const CompositeFieldDescription &descr) {
+        for (const FieldDescription &field : descr.fields) {
+          collectColumns(connection, field, prefixes, columns);
+        }
+      };
+
+  std::visit(podrm::detail::MultiLambda{collectPrimitive, collectComposite},
+             description.field);
+}
+
+/// @returns text representation of the image, as accepted by PostgreSQL
+std::string toText(const AsImage &image) {
+  const auto bytesToText = [](const span<const std::byte> bytes) {
+    std::string text = "\\x";
+    for (const std::byte byte : bytes) {
+      fmt::format_to(std::back_inserter(text), "{:02x}",
+                     static_cast<unsigned>(byte));
+    }
+    return text;
+  };
+
+  return std::visit(
+      [&bytesToText](const auto &value) -> std::string {
+        using Image = std::decay_t<decltype(value)>;
+        if constexpr (std::is_same_v<Image, span<const std::byte>> ||
+                      std::is_same_v<Image, std::vector<std::byte>>) {
+          return bytesToText(value);
+        } else if constexpr (std::is_same_v<Image, std::string_view> ||
+                             std::is_same_v<Image, std::string>) {
+          return std::string{value};
+        } else if constexpr (std::is_same_v<Image, bool>) {
+          return value ? "true" : "false";
+        } else {
+          return fmt::to_string(value);
+        }
+      },
+      image);
+}
+
+void collectParams(const FieldDescription &description, const void *field,
+                   std::vector<std::string> &params) {
+  const auto collectPrimitive =
+      [field, &params](const PrimitiveFieldDescription &descr) {
+        params.push_back(toText(descr.asImage(field)));
+      };
+
+  const auto collectComposite =
+      [field, &params](const CompositeFieldDescription &descr) {
+        for (const FieldDescription &fieldDescr : descr.fields) {
+          collectParams(fieldDescr, fieldDescr.constMemberPtr(field), params);
+        }
+      };
+
+  std::visit(podrm::detail::MultiLambda{collectPrimitive, collectComposite},
+             description.field);
+}
+
+std::string formatPlaceholders(const std::size_t count) {
+  fmt::memory_buffer buf;
+  for (std::size_t i = 1; i <= count; ++i) {
+    fmt::format_to(fmt::appender{buf}, "{}${}", i == 1 ? "" : ",", i);
+  }
+  return fmt::to_string(buf);
+}
+
+} // namespace
+
+class AsyncConnection::Acquire {
+public:
+  explicit Acquire(AsyncConnection &connection) : connection(connection) {}
+
+  bool await_ready() noexcept {
+    if (this->connection.busy) {
+      return false;
+    }
+    this->connection.busy = true;
+    return true;
+  }
+
+  void await_suspend(const std::coroutine_handle<> handle) {
+    this->connection.waiters.push_back(handle);
+  }
+
+  void await_resume() noexcept {}
+
+private:
+  AsyncConnection &connection;
+};
+
+class AsyncConnection::Guard {
+public:
+  explicit Guard(AsyncConnection &connection) : connection(connection) {}
+
+  Guard(const Guard &) = delete;
+  Guard(Guard &&) = delete;
+  Guard &operator=(const Guard &) = delete;
+  Guard &operator=(Guard &&) = delete;
+
+  ~Guard() { this->connection.release(); }
+
+private:
+  AsyncConnection &connection;
+};
+
+AsyncConnection::AsyncConnection(Reactor &reactor,
+                                 const std::string &connectionStr)
+    : connection(PQconnectdb(connectionStr.c_str())), reactor(reactor) {
+  if (PQstatus(this->connection) != CONNECTION_OK ||
+      PQsetnonblocking(this->connection, 1) != 0) {
+    const std::string error = PQerrorMessage(this->connection);
+    PQfinish(this->connection);
+    throw std::runtime_error{
+        fmt::format("Failed to connect to db: {}", error),
+    };
+  }
+
+  this->socket = PQsocket(this->connection);
+}
+
+AsyncConnection::~AsyncConnection() {
+  this->reactor.forget(this->socket);
+  PQfinish(this->connection);
+}
+
+Str AsyncConnection::escapeIdentifier(const std::string_view identifier) const {
+  return Str{PQescapeIdentifier(this->connection, identifier.data(),
+                                identifier.size())};
+}
+
+AsyncConnection::Acquire AsyncConnection::acquire() {
+  ++this->pending;
+  return Acquire{*this};
+}
+
+void AsyncConnection::release() {
+  --this->pending;
+
+  if (this->waiters.empty()) {
+    this->busy = false;
+    return;
+  }
+
+  // The connection stays busy and is handed over to the next caller
+  this->reactor.post(this->waiters.front());
+  this->waiters.pop_front();
+}
+
+Task<void> AsyncConnection::flush() {
+  while (true) {
+    const int result = PQflush(this->connection);
+    if (result == 0) {
+      co_return;
+    }
+    if (result < 0) {
+      throw std::runtime_error{
+          fmt::format("Failed to send a statement: {}",
+                      PQerrorMessage(this->connection)),
+      };
+    }
+
+    co_await this->reactor.writable(this->socket);
+    // Server might be waiting for its output to be read
+    PQconsumeInput(this->connection);
+  }
+}
+
+Task<Result> AsyncConnection::receive() {
+  std::optional<Result> last;
+  while (true) {
+    while (PQisBusy(this->connection) != 0) {
+      co_await this->reactor.readable(this->socket);
+      if (PQconsumeInput(this->connection) == 0) {
+        throw std::runtime_error{
+            fmt::format("Failed to receive a result: {}",
+                        PQerrorMessage(this->connection)),
+        };
+      }
+    }
+
+    PGresult *result = PQgetResult(this->connection);
+    if (result == nullptr) {
+      break;
+    }
+    last.emplace(result);
+  }
+
+  if (!last.has_value()) {
+    throw std::runtime_error{"No result received"};
+  }
+
+  co_return std::move(*last);
+}
+
+Task<Result> AsyncConnection::execute(
+    const podrm::detail::OperationContext context, std::string statement,
+    std::vector<std::string> params, const int expectedStatus,
+    const OperationLimits limits) {
+  limits.check();
+  co_await this->acquire();
+  const Guard guard{*this};
+  // Limits might be exceeded while waiting for the connection
+  limits.check();
+
+  podrm::detail::Stopwatch stopwatch{this->observer != nullptr};
+
+  auto prepared = this->prepared.find(statement);
+  const bool cacheHit = prepared != this->prepared.end();
+  if (!cacheHit) {
+    std::string name = fmt::format("podrm_{}", this->prepared.size());
+    if (PQsendPrepare(this->connection, name.c_str(), statement.c_str(),
+                      static_cast<int>(params.size()), nullptr) == 0) {
+      throw std::runtime_error{
+          fmt::format("Failed to prepare a statement: {}",
+                      PQerrorMessage(this->connection)),
+      };
+    }
+    co_await this->flush();
+
+    const Result result = co_await this->receive();
+    if (result.status() != PGRES_COMMAND_OK) {
+      throw std::runtime_error{
+          fmt::format("Failed to prepare a statement: {}",
+                      result.errorMessage()),
+      };
+    }
+
+    prepared = this->prepared.emplace(statement, std::move(name)).first;
+  }
+  const std::chrono::nanoseconds prepareTime = stopwatch.lap();
+
+  std::vector<const char *> values;
+  values.reserve(params.size());
+  for (const std::string &param : params) {
+    values.push_back(param.c_str());
+  }
+
+  // The deadline is sent in the same pipeline as the statement. The
+  // setting is local to the implicit transaction of the pipeline, so it
+  // costs no round trip and is never reset
+  const bool pipelined = limits.deadline.has_value();
+  if (pipelined) {
+    const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(
+        *limits.deadline - OperationLimits::Clock::now());
+    const std::string setTimeout = fmt::format(
+        "SELECT set_config('statement_timeout', '{}', true)",
+        std::max<std::int64_t>(remaining.count(), 1));
+    if (PQenterPipelineMode(this->connection) == 0 ||
+        PQsendQueryParams(this->connection, setTimeout.c_str(), 0, nullptr,
+                          nullptr, nullptr, nullptr, 0) == 0) {
+      throw std::runtime_error{
+          fmt::format("Failed to set a statement timeout: {}",
+                      PQerrorMessage(this->connection)),
+      };
+    }
+  }
+
+  if (PQsendQueryPrepared(this->connection, prepared->second.c_str(),
+                          static_cast<int>(values.size()), values.data(),
+                          nullptr, nullptr, 0) == 0 ||
+      (pipelined && PQpipelineSync(this->connection) == 0)) {
+    throw std::runtime_error{
+        fmt::format("Error when executing a statement: {}",
+                    PQerrorMessage(this->connection)),
+    };
+  }
+  co_await this->flush();
+
+  std::optional<Result> timeoutResult;
+  if (pipelined) {
+    timeoutResult.emplace(co_await this->receive());
+  }
+  Result result = co_await this->receive();
+  if (pipelined) {
+    const Result sync = co_await this->receive();
+    if (sync.status() != PGRES_PIPELINE_SYNC ||
+        PQexitPipelineMode(this->connection) == 0) {
+      throw std::runtime_error{
+          fmt::format("Failed to end a pipeline: {}",
+                      PQerrorMessage(this->connection)),
+      };
+    }
+    if (timeoutResult->status() != PGRES_TUPLES_OK) {
+      throw std::runtime_error{
+          fmt::format("Failed to set a statement timeout: {}",
+                      timeoutResult->errorMessage()),
+      };
+    }
+  }
+
+  if (result.status() != expectedStatus) {
+    // query_canceled is reported both for PQcancel and statement_timeout
+    if (result.errorState() == "57014") {
+      if (limits.deadline.has_value() &&
+          OperationLimits::Clock::now() >= *limits.deadline) {
+        throw OperationTimedOut{};
+      }
+      throw OperationCancelled{};
+    }
+    throw std::runtime_error{
+        fmt::format("Error when executing a statement: {}",
+                    result.errorMessage()),
+    };
+  }
+
+  if (this->observer != nullptr) {
+    std::uint64_t bytesBound = 0;
+    for (const std::string &param : params) {
+      bytesBound += param.size();
+    }
+
+    this->observer->onStatement(StatementEvent{
+        .entity = context.entity,
+        .operation = context.operation,
+        .statement = statement,
+        .prepareTime = prepareTime,
+        .executeTime = stopwatch.lap(),
+        .rows = expectedStatus == PGRES_TUPLES_OK
+                    ? static_cast<std::uint64_t>(result.rows())
+                    : result.affectedRows(),
+        .bytesBound = bytesBound,
+        .bytesDecoded = result.size(),
+        .cacheHit = cacheHit,
+    });
+  }
+
+  co_return std::move(result);
+}
+
+Task<void> AsyncConnection::persist(const EntityDescription &description,
+                                    void *entity,
+                                    const OperationLimits limits) {
+  const bool autoId = description.idMode == IdMode::Auto;
+  const FieldDescription &key = description.fields[description.primaryKey];
+
+  std::vector<std::string> columns;
+  std::vector<std::string> params;
+  for (std::size_t i = 0; i < description.fields.size(); ++i) {
+    if (!autoId || i != description.primaryKey) {
+      const FieldDescription &field = description.fields[i];
+      collectColumns(*this, field, {}, columns);
+      collectParams(field, field.constMemberPtr(entity), params);
+    }
+  }
+
+  std::string statement =
+      columns.empty()
+          ? fmt::format("INSERT INTO {} DEFAULT VALUES",
+                        this->escapeIdentifier(description.name))
+          : fmt::format("INSERT INTO {} ({}) VALUES ({})",
+                        this->escapeIdentifier(description.name),
+                        fmt::join(columns, ","),
+                        formatPlaceholders(columns.size()));
+
+  const podrm::detail::OperationContext context{description.name, "persist"};
+  if (!autoId) {
+    co_await this->execute(context, std::move(statement), std::move(params),
+                           PGRES_COMMAND_OK, limits);
+    co_return;
+  }
+
+  statement += fmt::format(" RETURNING {}", this->escapeIdentifier(key.name));
+  const Result result =
+      co_await this->execute(context, std::move(statement), std::move(params),
+                             PGRES_TUPLES_OK, limits);
+
+  extractRow(result, 0, span<const FieldDescription>{&key, 1}, entity);
+}
+
+Task<bool> AsyncConnection::find(const EntityDescription &description,
+                                 const AsImage key, void *result,
+                                 const OperationLimits limits) {
+  std::string statement = fmt::format(
+      "SELECT * FROM {} WHERE {} = $1",
+      this->escapeIdentifier(description.name),
+      this->escapeIdentifier(description.fields[description.primaryKey].name));
+
+  std::vector<std::string> params{toText(key)};
+  const podrm::detail::OperationContext context{description.name, "find"};
+  const Result rows =
+      co_await this->execute(context, std::move(statement), std::move(params),
+                             PGRES_TUPLES_OK, limits);
+  if (rows.rows() == 0) {
+    co_return false;
+  }
+
+  extractRow(rows, 0, description.fields, result);
+  co_return true;
+}
+
+Task<void> AsyncConnection::erase(const EntityDescription &description,
+                                  const AsImage key,
+                                  const OperationLimits limits) {
+  std::string statement = fmt::format(
+      "DELETE FROM {} WHERE {} = $1", this->escapeIdentifier(description.name),
+      this->escapeIdentifier(description.fields[description.primaryKey].name));
+
+  std::vector<std::string> params{toText(key)};
+  const podrm::detail::OperationContext context{description.name, "erase"};
+  const Result result =
+      co_await this->execute(context, std::move(statement), std::move(params),
+                             PGRES_COMMAND_OK, limits);
+  if (result.affectedRows() == 0) {
+    throw std::runtime_error("Entity with the given key is not found");
+  }
+}
+
+Task<void> AsyncConnection::update(const EntityDescription &description,
+                                   const void *entity,
+                                   const OperationLimits limits) {
+  const FieldDescription &key = description.fields[description.primaryKey];
+
+  std::vector<std::string> columns;
+  std::vector<std::string> params;
+  for (std::size_t i = 0; i < description.fields.size(); ++i) {
+    if (i != description.primaryKey) {
+      const FieldDescription &field = description.fields[i];
+      collectColumns(*this, field, {}, columns);
+      collectParams(field, field.constMemberPtr(entity), params);
+    }
+  }
+  if (columns.empty()) {
+    collectColumns(*this, key, {}, columns);
+    collectParams(key, key.constMemberPtr(entity), params);
+  }
+
+  fmt::memory_buffer buf;
+  fmt::appender appender{buf};
+  fmt::format_to(appender, "UPDATE {} SET ",
+                 this->escapeIdentifier(description.name));
+  for (std::size_t i = 0; i < columns.size(); ++i) {
+    fmt::format_to(appender, "{}{}=${}", i == 0 ? "" : ",", columns[i], i + 1);
+  }
+  fmt::format_to(appender, " WHERE {} = ${}", this->escapeIdentifier(key.name),
+                 columns.size() + 1);
+  collectParams(key, key.constMemberPtr(entity), params);
+
+  const podrm::detail::OperationContext context{description.name, "update"};
+  const Result result =
+      co_await this->execute(context, fmt::to_string(buf), std::move(params),
+                             PGRES_COMMAND_OK, limits);
+  if (result.affectedRows() == 0) {
+    throw std::runtime_error("Entity with the given key is not found");
+  }
+}
+
+Task<Result>
+AsyncConnection::selectAll(const EntityDescription &description,
+                           const OperationLimits limits) {
+  const podrm::detail::OperationContext context{description.name, "findAll"};
+  co_return co_await this->execute(
+      context,
+      fmt::format("SELECT * FROM {}", this->escapeIdentifier(description.name)),
+      std::vector<std::string>{}, PGRES_TUPLES_OK, limits);
+}
+
+void AsyncConnection::interrupt() {
+  if (!this->busy) {
+    return;
+  }
+
+  PGcancel *cancel = PQgetCancel(this->connection);
+  if (cancel == nullptr) {
+    return;
+  }
+
+  constexpr std::size_t ErrorSize = 256;
+  std::array<char, ErrorSize> error{};
+  PQcancel(cancel, error.data(), static_cast<int>(error.size()));
+  PQfreeCancel(cancel);
+}
+
+} // namespace podrm::postgres::detail
@@ -1,5 +1,6 @@
 #include "formatters.hpp" // IWYU pragma: keep
 
+#include <podrm/instrumentation.hpp>
 #include <podrm/metadata.hpp>
 #include <podrm/multilambda.hpp>
 #include <podrm/postgres/detail/connection.hpp>
@@ -7,10 +8,12 @@
 #include <podrm/postgres/detail/str.hpp>
 
 #include <cstddef>
+#include <cstdint>
 #include <stdexcept>
 #include <string>
 #include <string_view>
 #include <type_traits>
+#include <utility>
 #include <variant>
 #include <vector>
 
@@ -42,19 +45,19 @@ std::string_view toString(const ImageType type) {
 }
 
 void createTableFields(const FieldDescription &description,
-                       const bool isPrimaryKey, Connection &connection,
+                       const std::string_view constraint,
+                       Connection &connection,
                        fmt::appender &appender,
                        std::vector<std::string_view> prefixes, bool &first) {
   prefixes.push_back(description.name);
 
   const auto createPrimitiveField =
-      [isPrimaryKey, &prefixes, &connection, &appender,
+      [constraint, &prefixes, &connection, &appender,
        &first](const PrimitiveFieldDescription &descr) {
         fmt::format_to(appender, "{}{} {}{}", first ? "" : ",",
                        connection.escapeIdentifier(
                            fmt::to_string(fmt::join(prefixes, "_"))),
-                       toString(descr.imageType),
-                       isPrimaryKey ? " PRIMARY KEY" : "");
+                       toString(descr.imageType), constraint);
         first = false;
       };
 
@@ -62,7 +65,7 @@ void createTableFields(const FieldDescription &description,
       [&prefixes, &connection, &appender,
        &first](const CompositeFieldDescription &descr) {
         for (const FieldDescription &field : descr.fields) {
-          createTableFields(field, false, connection, appender, prefixes,
+          createTableFields(field, "", connection, appender, prefixes,
                             first);
         }
       };
@@ -90,14 +93,35 @@ Connection::Connection(const std::string &connectionStr)
   }
 }
 
-Connection::~Connection() { PQfinish(this->connection); }
+Connection::Connection(Connection &&other) noexcept
+    : connection(std::exchange(other.connection, nullptr)),
+      observer(other.observer) {}
+
+Connection::~Connection() {
+  if (this->connection != nullptr) {
+    PQfinish(this->connection);
+  }
+}
 
 Str Connection::escapeIdentifier(const std::string_view identifier) const {
   return Str{PQescapeIdentifier(this->connection, identifier.data(),
                                 identifier.size())};
 }
 
+bool Connection::alive() {
+  if (PQstatus(this->connection) != CONNECTION_OK) {
+    PQreset(this->connection);
+    if (PQstatus(this->connection) != CONNECTION_OK) {
+      return false;
+    }
+  }
+
+  const Result result{PQexec(this->connection, "SELECT 1")};
+  return result.status() == PGRES_TUPLES_OK;
+}
+
 Result Connection::execute(const std::string &statement) {
+  podrm::detail::Stopwatch stopwatch{this->observer != nullptr};
   Result result{PQexec(this->connection, statement.c_str())};
   if (result.status() != PGRES_COMMAND_OK) {
     throw std::runtime_error{
@@ -105,10 +129,12 @@ Result Connection::execute(const std::string &statement) {
                     PQerrorMessage(this->connection)),
     };
   }
+  this->notify(statement, stopwatch, result);
   return result;
 }
 
 Result Connection::query(const std::string &statement) {
+  podrm::detail::Stopwatch stopwatch{this->observer != nullptr};
   Result result{PQexec(this->connection, statement.c_str())};
   if (result.status() != PGRES_TUPLES_OK) {
     throw std::runtime_error{
@@ -116,26 +142,65 @@ Result Connection::query(const std::string &statement) {
                     PQerrorMessage(this->connection)),
     };
   }
+  this->notify(statement, stopwatch, result);
   return result;
 }
 
+void Connection::notify(const std::string &statement,
+                        podrm::detail::Stopwatch &stopwatch,
+                        const Result &result) {
+  if (this->observer == nullptr) {
+    return;
+  }
+
+  this->observer->onStatement(StatementEvent{
+      .entity = podrm::detail::currentOperation.entity,
+      .operation = podrm::detail::currentOperation.operation,
+      .statement = statement,
+      .prepareTime = {},
+      .executeTime = stopwatch.lap(),
+      .rows = result.status() == PGRES_TUPLES_OK
+                  ? static_cast<std::uint64_t>(result.rows())
+                  : result.affectedRows(),
+      .bytesBound = 0,
+      .bytesDecoded = result.size(),
+      .cacheHit = false,
+  });
+}
+
 void Connection::createTable(const EntityDescription &entity) {
+  const podrm::detail::OperationScope scope{entity.name, "createTable",
+                                            this->observer != nullptr};
   const Str escapedTableName = this->escapeIdentifier(entity.name);
   this->execute(fmt::format("DROP TABLE IF EXISTS {}", escapedTableName));
 
   fmt::memory_buffer buf;
   fmt::appender appender{buf};
   fmt::format_to(appender, "CREATE TABLE {} (", escapedTableName);
+  const std::string_view primaryKeyConstraint =
+      entity.idMode == IdMode::Auto
+          ? " GENERATED BY DEFAULT AS IDENTITY PRIMARY KEY"
+          : " PRIMARY KEY";
   bool first = true;
   for (std::size_t i = 0; i < entity.fields.size(); ++i) {
-    createTableFields(entity.fields[i], entity.primaryKey == i, *this, appender,
-                      {}, first);
+    createTableFields(entity.fields[i],
+                      entity.primaryKey == i ? primaryKeyConstraint : "",
+                      *this, appender, {}, first);
   }
   fmt::format_to(appender, ")");
   this->execute(fmt::to_string(buf));
 }
 
+Result Connection::select(const EntityDescription &entity,
+                          const std::string &query) {
+  const podrm::detail::OperationScope scope{entity.name, "select",
+                                            this->observer != nullptr};
+  return this->query(query);
+}
+
 bool Connection::exists(const EntityDescription &entity) {
+  const podrm::detail::OperationScope scope{entity.name, "exists",
+                                            this->observer != nullptr};
   const Result result = this->query(fmt::format(
       "SELECT EXISTS(SELECT 1 FROM {})", this->escapeIdentifier(entity.name)));
   return result.value(0, 0)[0] == 't';
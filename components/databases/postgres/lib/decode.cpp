@@ -0,0 +1,125 @@
+#include <podrm/metadata.hpp>
+#include <podrm/multilambda.hpp>
+#include <podrm/parallel.hpp>
+#include <podrm/postgres/detail/result.hpp>
+#include <podrm/span.hpp>
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <variant>
+#include <vector>
+
+#include <fmt/core.h>
+
+namespace podrm::postgres::detail {
+
+namespace {
+
+template <typename Number> Number parseNumber(const std::string_view text) {
+  Number number{};
+  const auto [end, error] =
+      std::from_chars(text.data(), text.data() + text.size(), number);
+  if (error != std::errc{} || end != text.data() + text.size()) {
+    throw std::runtime_error{fmt::format("Invalid number {}", text)};
+  }
+  return number;
+}
+
+std::vector<std::byte> parseBytes(const std::string_view text) {
+  if (!text.starts_with("\\x")) {
+    throw std::runtime_error{"Unsupported bytea format"};
+  }
+
+  std::vector<std::byte> bytes;
+  for (std::size_t i = 2; i + 1 < text.size(); i += 2) {
+    bytes.push_back(
+        static_cast<std::byte>(parseNumber<unsigned>(text.substr(i, 2))));
+  }
+  return bytes;
+}
+
+void init(const FieldDescription &description, const Result &result,
+          const int row, int &column, void *field) {
+  const auto initPrimitive = [&result, row, &column,
+                              field](const PrimitiveFieldDescription &descr) {
+    const std::string_view text = result.value(row, column);
+    ++column;
+
+    switch (descr.imageType) {
+    case ImageType::Int:
+      descr.fromImage(parseNumber<std::int64_t>(text), field);
+      return;
+    case ImageType::Uint:
+      descr.fromImage(parseNumber<std::uint64_t>(text), field);
+      return;
+    case ImageType::Float:
+      // std::from_chars for doubles is missing in older libc++
+      descr.fromImage(std::strtod(std::string{text}.c_str(), nullptr), field);
+      return;
+    case ImageType::String:
+      descr.fromImage(text, field);
+      return;
+    case ImageType::Bool:
+      descr.fromImage(text == "t", field);
+      return;
+    case ImageType::Bytes: {
+      const std::vector<std::byte> bytes = parseBytes(text);
+      descr.fromImage(span<const std::byte>{bytes}, field);
+      return;
+    }
+    }
+  };
+
+  const auto initComposite = [&result, row, &column,
+                              field](const CompositeFieldDescription &descr) {
+    for (const FieldDescription &fieldDescr : descr.fields) {
+      init(fieldDescr, result, row, column, fieldDescr.memberPtr(field));
+    }
+  };
+
+  std::visit(podrm::detail::MultiLambda{initPrimitive, initComposite},
+             description.field);
+}
+
+} // namespace
+
+void extractRow(const Result &result, const int row,
+                const span<const FieldDescription> description, void *data) {
+  int column = 0;
+  for (const FieldDescription &field : description) {
+    init(field, result, row, column, field.memberPtr(data));
+  }
+}
+
+std::size_t extractRows(const Result &result,
+                        const span<const FieldDescription> description,
+                        void *const data, const std::size_t stride,
+                        const std::size_t workers) {
+  // Rows decoded by a worker at once, large enough to amortize scheduling
+  constexpr std::size_t RowsPerTask = 512;
+
+  const auto rows = static_cast<std::size_t>(result.rows());
+  const std::size_t tasks = (rows + RowsPerTask - 1) / RowsPerTask;
+  const std::size_t used = std::min(workerCount(workers), tasks);
+
+  // Every row has its own entity, so tasks do not share any state
+  const auto decodeTask = [&](std::size_t /*worker*/, const std::size_t task) {
+    const std::size_t last = std::min(rows, (task + 1) * RowsPerTask);
+    for (std::size_t row = task * RowsPerTask; row < last; ++row) {
+      extractRow(result, static_cast<int>(row), description,
+                 static_cast<std::byte *>(data) + row * stride);
+    }
+  };
+  parallelFor(tasks, used, decodeTask);
+
+  return used;
+}
+
+} // namespace podrm::postgres::detail
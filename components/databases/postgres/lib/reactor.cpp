@@ -0,0 +1,142 @@
+#include <podrm/postgres/reactor.hpp>
+#include <podrm/postgres/task.hpp>
+
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <sys/epoll.h>
+#include <unistd.h>
+
+namespace podrm::postgres {
+
+namespace {
+
+/// Coroutine that starts immediately and destroys itself on completion
+struct Detached {
+  struct promise_type {
+    Detached get_return_object() { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+};
+
+Detached runDetached(Task<void> task, std::exception_ptr &failure) {
+  try {
+    co_await std::move(task);
+  } catch (...) {
+    failure = std::current_exception();
+  }
+}
+
+[[noreturn]] void throwSystemError(const char *what) {
+  throw std::system_error{errno, std::system_category(), what};
+}
+
+} // namespace
+
+Reactor::Reactor() : epoll(epoll_create1(EPOLL_CLOEXEC)) {
+  if (this->epoll < 0) {
+    throwSystemError("Failed to create epoll instance");
+  }
+}
+
+Reactor::~Reactor() { close(this->epoll); }
+
+void Reactor::FdAwaiter::await_suspend(const std::coroutine_handle<> handle) {
+  this->reactor.wait(this->fd, this->event, handle);
+}
+
+void Reactor::wait(const int fd, const Event event,
+                   const std::coroutine_handle<> handle) {
+  epoll_event request{};
+  request.events =
+      (event == Event::Readable ? EPOLLIN : EPOLLOUT) | EPOLLONESHOT;
+  request.data.ptr = handle.address();
+
+  // One-shot descriptors stay registered but disabled after an event
+  if (this->registered.contains(fd)) {
+    if (epoll_ctl(this->epoll, EPOLL_CTL_MOD, fd, &request) == 0) {
+      ++this->waiting;
+      return;
+    }
+    if (errno != ENOENT) {
+      throwSystemError("Failed to wait for descriptor");
+    }
+    this->registered.erase(fd);
+  }
+
+  if (epoll_ctl(this->epoll, EPOLL_CTL_ADD, fd, &request) != 0) {
+    throwSystemError("Failed to wait for descriptor");
+  }
+  this->registered.insert(fd);
+  ++this->waiting;
+}
+
+void Reactor::post(const std::coroutine_handle<> handle) {
+  this->ready.push_back(handle);
+}
+
+void Reactor::forget(const int fd) {
+  if (this->registered.erase(fd) != 0) {
+    epoll_ctl(this->epoll, EPOLL_CTL_DEL, fd, nullptr);
+  }
+}
+
+void Reactor::spawn(Task<void> task) {
+  runDetached(std::move(task), this->failure);
+}
+
+void Reactor::checkProgress() {
+  if (this->failure != nullptr) {
+    std::rethrow_exception(std::exchange(this->failure, nullptr));
+  }
+
+  if (this->waiting == 0 && this->ready.empty()) {
+    throw std::logic_error{
+        "Task is suspended, but nothing is waited for in the reactor"};
+  }
+}
+
+void Reactor::poll(const std::optional<std::chrono::milliseconds> timeout) {
+  constexpr std::size_t MaxEvents = 64;
+
+  std::vector<std::coroutine_handle<>> posted;
+  posted.swap(this->ready);
+  for (const std::coroutine_handle<> handle : posted) {
+    handle.resume();
+  }
+
+  int timeoutMs = timeout.has_value() ? static_cast<int>(timeout->count()) : -1;
+  if (!this->ready.empty() || !posted.empty()) {
+    timeoutMs = 0;
+  }
+
+  std::array<epoll_event, MaxEvents> events{};
+  const int count = epoll_wait(this->epoll, events.data(),
+                               static_cast<int>(events.size()), timeoutMs);
+  if (count < 0 && errno != EINTR) {
+    throwSystemError("Failed to wait for events");
+  }
+
+  for (int i = 0; i < count; ++i) {
+    --this->waiting;
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+    std::coroutine_handle<>::from_address(events[i].data.ptr).resume();
+  }
+
+  if (this->failure != nullptr) {
+    std::rethrow_exception(std::exchange(this->failure, nullptr));
+  }
+}
+
+} // namespace podrm::postgres
@@ -1,5 +1,7 @@
 #include <podrm/postgres/detail/result.hpp>
 
+#include <charconv>
+#include <cstdint>
 #include <string_view>
 
 #include <libpq-fe.h>
@@ -24,4 +26,35 @@ std::string_view Result::value(const int row, const int column) const {
   return PQgetvalue(this->result, row, column);
 }
 
+int Result::rows() const { return PQntuples(this->result); }
+
+std::uint64_t Result::size() const {
+  const int rows = PQntuples(this->result);
+  const int columns = PQnfields(this->result);
+  std::uint64_t size = 0;
+  for (int row = 0; row < rows; ++row) {
+    for (int column = 0; column < columns; ++column) {
+      size +=
+          static_cast<std::uint64_t>(PQgetlength(this->result, row, column));
+    }
+  }
+  return size;
+}
+
+std::uint64_t Result::affectedRows() const {
+  const std::string_view tuples = PQcmdTuples(this->result);
+  std::uint64_t rows = 0;
+  std::from_chars(tuples.data(), tuples.data() + tuples.size(), rows);
+  return rows;
+}
+
+std::string_view Result::errorMessage() const {
+  return PQresultErrorMessage(this->result);
+}
+
+std::string_view Result::errorState() const {
+  const char *state = PQresultErrorField(this->result, PG_DIAG_SQLSTATE);
+  return state == nullptr ? std::string_view{} : std::string_view{state};
+}
+
 } // namespace podrm::postgres::detail
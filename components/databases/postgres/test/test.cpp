@@ -0,0 +1,228 @@
+#include "field.hpp"
+
+#include <podrm/metadata.hpp>
+#include <podrm/postgres/decode_stats.hpp>
+#include <podrm/postgres/detail/result.hpp>
+#include <podrm/postgres/reactor.hpp>
+#include <podrm/postgres/task.hpp>
+#include <podrm/reflection.hpp>
+
+#include <array>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+#include <libpq-fe.h>
+
+// The reactor is built on epoll
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+namespace pg = podrm::postgres;
+
+namespace {
+
+struct Sample {
+  std::int64_t id;
+
+  std::string name;
+
+  std::uint64_t visits;
+
+  friend bool operator==(const Sample &, const Sample &) = default;
+};
+
+} // namespace
+
+template <>
+constexpr auto podrm::EntityRegistration<Sample> =
+    podrm::EntityRegistrationData<Sample>{
+        .id = test::Field<Sample, &Sample::id>,
+        .idMode = IdMode::Manual,
+    };
+
+namespace {
+
+/// @returns text result with a row of every sample, as sent by the server
+pg::detail::Result makeResult(const std::vector<Sample> &samples) {
+  std::array<char, 8> id{"id"};
+  std::array<char, 8> name{"name"};
+  std::array<char, 8> visits{"visits"};
+  std::array<PGresAttDesc, 3> columns{
+      PGresAttDesc{.name = id.data()},
+      PGresAttDesc{.name = name.data()},
+      PGresAttDesc{.name = visits.data()},
+  };
+
+  PGresult *result = PQmakeEmptyPGresult(nullptr, PGRES_TUPLES_OK);
+  REQUIRE(result != nullptr);
+  REQUIRE(PQsetResultAttrs(result, static_cast<int>(columns.size()),
+                           columns.data()) != 0);
+
+  bool set = true;
+  for (std::size_t i = 0; i < samples.size(); ++i) {
+    const Sample &sample = samples[i];
+    std::array<std::string, 3> values{
+        std::to_string(sample.id),
+        sample.name,
+        std::to_string(sample.visits),
+    };
+    for (std::size_t column = 0; column < values.size(); ++column) {
+      set = set && PQsetvalue(result, static_cast<int>(i),
+                              static_cast<int>(column), values[column].data(),
+                              static_cast<int>(values[column].size())) != 0;
+    }
+  }
+  REQUIRE(set);
+
+  return pg::detail::Result{result};
+}
+
+} // namespace
+
+TEST_CASE("PostgreSQL rows are decoded in parallel", "[postgres]") {
+  // Several blocks of rows, the last one incomplete
+  constexpr std::int64_t Rows = 5000;
+
+  std::vector<Sample> samples;
+  for (std::int64_t i = 0; i < Rows; ++i) {
+    samples.push_back({
+        .id = i,
+        .name = "sample " + std::to_string(i),
+        .visits = static_cast<std::uint64_t>(i * 3),
+    });
+  }
+  const pg::detail::Result result = makeResult(samples);
+  REQUIRE(result.rows() == Rows);
+
+  SECTION("every thread count decodes all rows") {
+    for (const std::size_t threads : {1, 4, 8}) {
+      std::vector<Sample> decoded(samples.size());
+      CHECK(pg::detail::extractRows(
+                result, podrm::DatabaseEntityDescription<Sample>->fields,
+                decoded.data(), sizeof(Sample), threads) <= threads);
+      CHECK(decoded == samples);
+    }
+  }
+
+  SECTION("empty results are decoded without threads") {
+    const pg::detail::Result empty = makeResult({});
+    CHECK(pg::detail::extractRows(
+              empty, podrm::DatabaseEntityDescription<Sample>->fields,
+              nullptr, sizeof(Sample), 4) == 0);
+  }
+}
+
+TEST_CASE("PostgreSQL decode stats of empty results", "[postgres]") {
+  const pg::DecodeStats stats;
+  CHECK(stats.rowsPerSecond() == 0);
+  CHECK(stats.bytesPerSecond() == 0);
+}
+
+#ifdef __linux__
+
+namespace {
+
+/// Suspends the coroutine until the next poll of the reactor
+struct Yield {
+  pg::Reactor &reactor;
+
+  bool await_ready() noexcept { return false; }
+
+  void await_suspend(const std::coroutine_handle<> handle) {
+    this->reactor.post(handle);
+  }
+
+  void await_resume() noexcept {}
+};
+
+pg::Task<int> answer() { co_return 42; }
+
+pg::Task<int> twice(pg::Reactor &reactor) {
+  const int first = co_await answer();
+  co_await Yield{reactor};
+  co_return first + co_await answer();
+}
+
+pg::Task<int> fail(pg::Reactor &reactor) {
+  co_await Yield{reactor};
+  throw std::runtime_error{"Task failed"};
+}
+
+pg::Task<void> failNow() {
+  throw std::runtime_error{"Task failed"};
+  co_return;
+}
+
+pg::Task<std::string> readMessage(pg::Reactor &reactor, const int fd) {
+  co_await reactor.readable(fd);
+  std::array<char, 16> buffer{};
+  const ssize_t size = read(fd, buffer.data(), buffer.size());
+  if (size < 0) {
+    throw std::runtime_error{"Failed to read"};
+  }
+  co_return std::string{buffer.data(), static_cast<std::size_t>(size)};
+}
+
+pg::Task<void> writeMessage(pg::Reactor &reactor, const int fd,
+                            const std::string_view message) {
+  co_await reactor.writable(fd);
+  if (write(fd, message.data(), message.size()) < 0) {
+    throw std::runtime_error{"Failed to write"};
+  }
+}
+
+} // namespace
+
+TEST_CASE("Task returns values and exceptions", "[postgres]") {
+  pg::Reactor reactor;
+
+  CHECK(reactor.run(answer()) == 42);
+  CHECK(reactor.run(twice(reactor)) == 84);
+  CHECK_THROWS_AS(reactor.run(fail(reactor)), std::runtime_error);
+}
+
+TEST_CASE("Reactor resumes coroutines waiting for descriptors",
+          "[postgres]") {
+  pg::Reactor reactor;
+
+  std::array<int, 2> pipe{};
+  REQUIRE(::pipe(pipe.data()) == 0);
+  const auto [readEnd, writeEnd] = pipe;
+
+  SECTION("readers are resumed once written to") {
+    reactor.spawn(writeMessage(reactor, writeEnd, "hello"));
+    CHECK(reactor.run(readMessage(reactor, readEnd)) == "hello");
+  }
+
+  SECTION("descriptors are waited for repeatedly") {
+    for (const std::string_view message : {"first", "second"}) {
+      reactor.spawn(writeMessage(reactor, writeEnd, message));
+      CHECK(reactor.run(readMessage(reactor, readEnd)) == message);
+    }
+  }
+
+  reactor.forget(readEnd);
+  reactor.forget(writeEnd);
+  close(readEnd);
+  close(writeEnd);
+}
+
+TEST_CASE("Reactor rethrows failures of spawned tasks", "[postgres]") {
+  using namespace std::chrono_literals;
+
+  pg::Reactor reactor;
+  reactor.spawn(failNow());
+
+  CHECK_THROWS_AS(reactor.poll(0ms), std::runtime_error);
+  CHECK_NOTHROW(reactor.poll(0ms));
+}
+
+#endif
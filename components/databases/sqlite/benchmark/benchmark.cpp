@@ -0,0 +1,113 @@
+#include <podrm/reflection.hpp>
+#include <podrm/sqlite.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <fmt/core.h>
+
+namespace orm = podrm::sqlite;
+
+namespace {
+
+struct Row {
+  std::int64_t id;
+
+  std::int64_t value;
+
+  std::string payload;
+};
+
+} // namespace
+
+template <>
+constexpr auto podrm::EntityRegistration<Row> =
+    podrm::EntityRegistrationData<Row>{
+        .id = podrm::FieldOf<Row, &Row::id>,
+        .idMode = IdMode::Manual,
+    };
+
+namespace {
+
+constexpr std::int64_t BatchedRows = 200'000;
+constexpr std::int64_t BatchSize = 1000;
+constexpr std::int64_t SingleRows = 500;
+constexpr std::int64_t Reads = 200'000;
+
+template <typename Body> double measureMs(const Body &body) {
+  const auto start = std::chrono::steady_clock::now();
+  body();
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+void run(const std::string_view name, const orm::ConnectionOptions &options) {
+  const std::filesystem::path path =
+      std::filesystem::temp_directory_path() / "podrm-benchmark.db";
+  for (const char *suffix : {"", "-wal", "-shm", "-journal"}) {
+    std::filesystem::remove(path.string() + suffix);
+  }
+
+  orm::Database db = orm::Database::inFile(path, options);
+  db.createTable<Row>();
+
+  const double batched = measureMs([&db] {
+    std::vector<Row> batch;
+    for (std::int64_t first = 1; first <= BatchedRows; first += BatchSize) {
+      batch.clear();
+      for (std::int64_t id = first; id < first + BatchSize; ++id) {
+        batch.push_back({.id = id, .value = id, .payload = "payload"});
+      }
+      db.persistMany(batch);
+    }
+  });
+
+  // Every insert is a separate transaction, dominated by syncs
+  const double single = measureMs([&db] {
+    for (std::int64_t id = BatchedRows + 1; id <= BatchedRows + SingleRows;
+         ++id) {
+      Row row{.id = id, .value = id, .payload = "payload"};
+      db.persist(row);
+    }
+  });
+
+  std::mt19937_64 random{1};
+  std::uniform_int_distribution<std::int64_t> keys{1, BatchedRows};
+  std::int64_t checksum = 0;
+  const double reads = measureMs([&] {
+    for (std::int64_t i = 0; i < Reads; ++i) {
+      checksum += db.find<Row>(keys(random))->value;
+    }
+  });
+
+  // Checksum keeps the reads from being optimized out
+  fmt::print("{:<12} {:>14.0f} {:>14.0f} {:>14.0f}   ({})\n", name,
+             static_cast<double>(BatchedRows) / batched * 1000,
+             static_cast<double>(SingleRows) / single * 1000,
+             static_cast<double>(Reads) / reads * 1000, checksum);
+}
+
+} // namespace
+
+int main() {
+  const std::pair<std::string_view, orm::ConnectionOptions> presets[] = {
+      {"default", {}},
+      {"bulkLoad", orm::ConnectionOptions::bulkLoad()},
+      {"readMostly", orm::ConnectionOptions::readMostly()},
+      {"durable", orm::ConnectionOptions::durable()},
+  };
+
+  fmt::print("{:<12} {:>14} {:>14} {:>14}\n", "preset", "batched rows/s",
+             "commits/s", "reads/s");
+  for (const auto &[name, options] : presets) {
+    run(name, options);
+  }
+}
@@ -1,4 +1,17 @@
 #pragma once
 
-#include <podrm/sqlite/cursor.hpp>   // IWYU pragma: export
-#include <podrm/sqlite/database.hpp> // IWYU pragma: export
+#include <podrm/sqlite/bulk_load.hpp>          // IWYU pragma: export
+#include <podrm/sqlite/change_capture.hpp>     // IWYU pragma: export
+#include <podrm/sqlite/change_event.hpp>       // IWYU pragma: export
+#include <podrm/sqlite/conflict_policy.hpp>    // IWYU pragma: export
+#include <podrm/sqlite/connection_options.hpp> // IWYU pragma: export
+#include <podrm/sqlite/cursor.hpp>             // IWYU pragma: export
+#include <podrm/sqlite/database.hpp>           // IWYU pragma: export
+#include <podrm/sqlite/limit_scope.hpp>        // IWYU pragma: export
+#include <podrm/sqlite/savepoint.hpp>          // IWYU pragma: export
+#include <podrm/sqlite/scan.hpp>               // IWYU pragma: export
+#include <podrm/sqlite/sharded_database.hpp>   // IWYU pragma: export
+#include <podrm/sqlite/slow_query_log.hpp>     // IWYU pragma: export
+#include <podrm/sqlite/snapshot_options.hpp>   // IWYU pragma: export
+#include <podrm/sqlite/subscription.hpp>       // IWYU pragma: export
+#include <podrm/sqlite/transaction.hpp>        // IWYU pragma: export
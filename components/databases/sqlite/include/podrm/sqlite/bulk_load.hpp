@@ -0,0 +1,57 @@
+#pragma once
+
+#include <podrm/metadata.hpp>
+#include <podrm/sqlite/detail/connection.hpp>
+
+#include <stdexcept>
+#include <utility>
+
+namespace podrm::sqlite {
+
+/// Bulk load of an entity table, operations of the database are a part of
+/// it until it is finished. Durability settings are relaxed, foreign key
+/// checks are deferred and secondary indexes of the table are dropped. The
+/// load is rolled back on destruction unless finished
+class BulkLoadGuard {
+public:
+  BulkLoadGuard(const BulkLoadGuard &) = delete;
+  BulkLoadGuard(BulkLoadGuard &&other) noexcept
+      : connection(std::exchange(other.connection, nullptr)),
+        description(other.description), state(std::move(other.state)) {}
+  BulkLoadGuard &operator=(const BulkLoadGuard &) = delete;
+  BulkLoadGuard &operator=(BulkLoadGuard &&) = delete;
+
+  ~BulkLoadGuard() {
+    if (this->connection != nullptr) {
+      this->connection->abortBulkLoad(this->state);
+    }
+  }
+
+  /// Rebuilds the indexes, validates foreign keys and commits
+  /// @throws std::runtime_error if foreign keys are violated, the load is
+  /// rolled back
+  void finish() {
+    if (this->connection == nullptr) {
+      throw std::logic_error{"Bulk load is already finished"};
+    }
+
+    std::exchange(this->connection, nullptr)
+        ->finishBulkLoad(*this->description, this->state);
+  }
+
+private:
+  detail::Connection *connection;
+
+  const EntityDescription *description;
+
+  detail::Connection::BulkLoadState state;
+
+  BulkLoadGuard(detail::Connection &connection,
+                const EntityDescription &description)
+      : connection(&connection), description(&description),
+        state(connection.beginBulkLoad(description)) {}
+
+  friend class Database;
+};
+
+} // namespace podrm::sqlite
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <podrm/sqlite/detail/connection.hpp>
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#ifdef PODRM_SQLITE_CHANGE_CAPTURE
+
+namespace podrm::sqlite {
+
+/// Records changes of entity tables with the SQLite session extension until
+/// destroyed, it must not outlive the database. Changes made while the
+/// capture is active are combined per row, e.g. an inserted and then
+/// deleted row is not recorded at all
+class ChangeCapture {
+public:
+  ChangeCapture(const ChangeCapture &) = delete;
+  ChangeCapture(ChangeCapture &&other) noexcept
+      : connection(other.connection),
+        session(std::exchange(other.session, nullptr)) {}
+  ChangeCapture &operator=(const ChangeCapture &) = delete;
+  ChangeCapture &operator=(ChangeCapture &&) = delete;
+
+  ~ChangeCapture() {
+    if (this->session != nullptr) {
+      this->connection->endCapture(*this->session);
+    }
+  }
+
+  /// @returns changes with old values of the rows, so that conflicts are
+  /// detected when they are applied
+  std::vector<std::byte> changeset() {
+    return this->connection->captured(*this->session, false);
+  }
+
+  /// @returns compact changes with only new values and primary keys of
+  /// deleted rows
+  std::vector<std::byte> patchset() {
+    return this->connection->captured(*this->session, true);
+  }
+
+private:
+  detail::Connection *connection;
+
+  sqlite3_session *session;
+
+  ChangeCapture(detail::Connection &connection, sqlite3_session &session)
+      : connection(&connection), session(&session) {}
+
+  friend class Database;
+};
+
+} // namespace podrm::sqlite
+
+#endif
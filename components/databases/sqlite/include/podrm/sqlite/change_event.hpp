@@ -0,0 +1,33 @@
+#pragma once
+
+#include <podrm/metadata.hpp>
+
+#include <cstdint>
+
+namespace podrm::sqlite {
+
+enum class ChangeOperation : std::uint8_t {
+  Insert,
+  Update,
+  Delete,
+};
+
+/// Committed change of an entity
+template <DatabaseEntity Entity> struct ChangeEvent {
+  ChangeOperation operation;
+
+  PrimaryKeyType<Entity> key;
+};
+
+namespace detail {
+
+/// Change of a table row reported by the update hook
+struct RowChange {
+  ChangeOperation operation;
+
+  std::int64_t rowid;
+};
+
+} // namespace detail
+
+} // namespace podrm::sqlite
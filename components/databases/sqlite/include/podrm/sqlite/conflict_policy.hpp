@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+
+namespace podrm::sqlite {
+
+/// Resolution of changes that conflict with the database they are applied
+/// to, e.g. an updated row that was changed or deleted there
+enum class ConflictPolicy : std::uint8_t {
+  Abort,   ///< Roll back all changes and throw
+  Omit,    ///< Skip the conflicting change
+  Replace, ///< Overwrite the row, other conflicts are skipped
+};
+
+} // namespace podrm::sqlite
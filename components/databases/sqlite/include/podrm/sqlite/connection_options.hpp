@@ -0,0 +1,119 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+namespace podrm::sqlite {
+
+enum class JournalMode : std::uint8_t {
+  Delete,
+  Truncate,
+  Persist,
+  Memory,
+  Wal,
+  Off,
+};
+
+enum class Synchronous : std::uint8_t {
+  Off,
+  Normal,
+  Full,
+  Extra,
+};
+
+enum class TempStore : std::uint8_t {
+  Default,
+  File,
+  Memory,
+};
+
+enum class LockingMode : std::uint8_t {
+  Normal,
+  Exclusive,
+};
+
+/// Settings applied when a connection is opened, unset values keep the
+/// SQLite defaults
+struct ConnectionOptions {
+  std::optional<JournalMode> journalMode;
+
+  std::optional<Synchronous> synchronous;
+
+  /// Maximum number of bytes of the database file mapped into memory
+  std::optional<std::int64_t> mmapSize;
+
+  /// Page cache size, in pages if positive or in KiB if negative
+  std::optional<std::int64_t> cacheSize;
+
+  /// Page size in bytes, only has an effect before the database is created
+  std::optional<std::int64_t> pageSize;
+
+  std::optional<TempStore> tempStore;
+
+  /// Time to retry operations on a locked database before failing
+  std::optional<std::chrono::milliseconds> busyTimeout;
+
+  std::optional<LockingMode> lockingMode;
+
+  /// Opens the connection in multi-thread mode, it must not be used by
+  /// several threads at once
+  bool noMutex = false;
+
+  /// Shares the page cache with other connections to the same database
+  bool sharedCache = false;
+
+  /// Opens the database read-only, it must exist
+  bool readOnly = false;
+
+  /// Opens the database read-only without locking or change detection. The
+  /// file must not be changed by any process while it is open
+  bool immutable = false;
+
+  /// Fastest writes for loading data that can be recreated if the process
+  /// crashes: no journal, no syncs, exclusive lock
+  static ConnectionOptions bulkLoad() {
+    ConnectionOptions options;
+    options.journalMode = JournalMode::Off;
+    options.synchronous = Synchronous::Off;
+    options.cacheSize = -256 * 1024;
+    options.tempStore = TempStore::Memory;
+    options.lockingMode = LockingMode::Exclusive;
+    return options;
+  }
+
+  /// Concurrent readers with occasional writers: WAL journal, memory-mapped
+  /// reads and a large page cache
+  static ConnectionOptions readMostly() {
+    ConnectionOptions options;
+    options.journalMode = JournalMode::Wal;
+    options.synchronous = Synchronous::Normal;
+    options.mmapSize = std::int64_t{256} * 1024 * 1024;
+    options.cacheSize = -64 * 1024;
+    options.tempStore = TempStore::Memory;
+    options.busyTimeout = std::chrono::seconds{5};
+    return options;
+  }
+
+  /// Committed transactions survive power loss: WAL journal synced on every
+  /// commit
+  static ConnectionOptions durable() {
+    ConnectionOptions options;
+    options.journalMode = JournalMode::Wal;
+    options.synchronous = Synchronous::Full;
+    options.busyTimeout = std::chrono::seconds{5};
+    return options;
+  }
+};
+
+/// Settings of a database opened with Database::openReadOnly
+struct ReadOnlyOptions {
+  /// The file is never changed while it is open, e.g. a shipped reference
+  /// database, so reads skip locking and change detection
+  bool immutable = true;
+
+  /// Maximum number of bytes mapped into memory, the file size if unset
+  std::optional<std::int64_t> mmapSize;
+};
+
+} // namespace podrm::sqlite
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <podrm/metadata.hpp>
 #include <podrm/sqlite/detail/cursor.hpp>
 
 #include <cassert>
@@ -10,6 +11,8 @@
 
 namespace podrm::sqlite {
 
+template <DatabaseEntity Entity> class Scan;
+
 template <typename T> class Cursor {
 public:
   class Iterator;
@@ -24,6 +27,8 @@ private:
   explicit Cursor(detail::Cursor impl) : impl(std::move(impl)) {}
 
   friend class Database;
+
+  template <DatabaseEntity Entity> friend class Scan;
 };
 
 template <typename T> class Cursor<T>::Iterator {
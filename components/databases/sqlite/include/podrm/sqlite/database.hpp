@@ -1,12 +1,39 @@
 #pragma once
 
+#include <podrm/aggregate.hpp>
+#include <podrm/cancellation.hpp>
+#include <podrm/instrumentation.hpp>
 #include <podrm/metadata.hpp>
+#include <podrm/parallel.hpp>
+#include <podrm/predicate.hpp>
+#include <podrm/span.hpp>
+#include <podrm/sqlite/bulk_load.hpp>
+#include <podrm/sqlite/change_capture.hpp>
+#include <podrm/sqlite/change_event.hpp>
+#include <podrm/sqlite/conflict_policy.hpp>
+#include <podrm/sqlite/connection_options.hpp>
 #include <podrm/sqlite/cursor.hpp>
 #include <podrm/sqlite/detail/connection.hpp>
+#include <podrm/sqlite/limit_scope.hpp>
+#include <podrm/sqlite/savepoint.hpp>
+#include <podrm/sqlite/scan.hpp>
+#include <podrm/sqlite/slow_query_log.hpp>
+#include <podrm/sqlite/snapshot_options.hpp>
+#include <podrm/sqlite/subscription.hpp>
+#include <podrm/sqlite/transaction.hpp>
 
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
+#include <functional>
 #include <optional>
+#include <ranges>
+#include <string_view>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
 namespace podrm::sqlite {
 
@@ -14,16 +41,94 @@ class Database {
 public:
   //---------------- Constructors ------------------//
 
-  static Database fromRaw(sqlite3 &connection) {
-    return Database{detail::Connection::fromRaw(connection)};
+  /// Open flags of the options are ignored, the connection is already open
+  static Database fromRaw(sqlite3 &connection,
+                          const ConnectionOptions &options = {}) {
+    return Database{detail::Connection::fromRaw(connection, options)};
   }
 
-  static Database inMemory(const char *name) {
-    return Database{detail::Connection::inMemory(name)};
+  static Database inMemory(const char *name,
+                           const ConnectionOptions &options = {}) {
+    return Database{detail::Connection::inMemory(name, options)};
   }
 
-  static Database inFile(const std::filesystem::path &path) {
-    return Database{detail::Connection::inFile(path)};
+  /// @param options connection settings, e.g. ConnectionOptions::durable()
+  static Database inFile(const std::filesystem::path &path,
+                         const ConnectionOptions &options = {}) {
+    return Database{detail::Connection::inFile(path, options)};
+  }
+
+  /// Opens a database file that is not written at runtime, e.g. a shipped
+  /// reference database, with the whole file memory-mapped. Immutable
+  /// files are read without file locks, so threads reading through
+  /// databases of their own do not contend
+  static Database openReadOnly(const std::filesystem::path &path,
+                               const ReadOnlyOptions &options = {}) {
+    return Database{detail::Connection::openReadOnly(path, options)};
+  }
+
+  /// Copies the database file into memory at once, e.g. to serve reads
+  /// without page cache misses. Changes stay in memory until written back
+  /// with snapshotTo
+  /// @param options settings of the in-memory connection
+  static Database loadIntoMemory(const std::filesystem::path &path,
+                                 const ConnectionOptions &options = {}) {
+    return Database{detail::Connection::loadIntoMemory(path, options)};
+  }
+
+  //---------------- Snapshots ------------------//
+
+  /// Replaces the contents of the file with this database using the online
+  /// backup API. The copy is written in throttled steps and restarts if
+  /// this database is changed by another connection in between. Readers of
+  /// the file see either the previous snapshot or the new one
+  /// @throws std::runtime_error if a database stays locked for
+  /// SnapshotOptions::busyTimeout
+  /// @throws OperationCancelled or OperationTimedOut once the limits are
+  /// exceeded
+  void snapshotTo(const std::filesystem::path &path,
+                  const SnapshotOptions &options = {}) {
+    this->connection.snapshotTo(path, options);
+  }
+
+  //---------------- Transactions ------------------//
+
+  /// Begins a transaction, operations of this database are a part of it
+  /// until it is committed or rolled back
+  [[nodiscard]] Transaction begin() { return Transaction{this->connection}; }
+
+  /// Starts a savepoint, e.g. to undo a part of a transaction
+  [[nodiscard]] Savepoint savepoint() { return Savepoint{this->connection}; }
+
+  //---------------- Limits ------------------//
+
+  /// Operations of this database fail with OperationCancelled or
+  /// OperationTimedOut once the limits are exceeded, including statements
+  /// that are already running, until the scope is destroyed
+  [[nodiscard]] LimitScope limit(OperationLimits limits) {
+    return LimitScope{this->connection, std::move(limits)};
+  }
+
+  /// Interrupts the running operation with OperationCancelled, can be called
+  /// from any thread
+  void interrupt() { this->connection.interrupt(); }
+
+  //---------------- Instrumentation ------------------//
+
+  /// Reports every statement with its timings and sizes to the observer,
+  /// e.g. a HistogramObserver. Statements are not timed without one
+  /// @param observer observer outliving the database, nullptr to stop
+  /// reporting
+  void setObserver(Observer *observer) {
+    this->connection.setObserver(observer);
+  }
+
+  /// Reports statements running longer than the threshold with their
+  /// expanded text, parameter types and query plans, flagging full table
+  /// scans, e.g. SlowQueryLog::toFile("slow.log")
+  /// @param log new log, nullopt to disable it
+  void setSlowQueryLog(std::optional<SlowQueryLog> log) {
+    this->connection.setSlowQueryLog(std::move(log));
   }
 
   //---------------- Operations ------------------//
@@ -32,15 +137,113 @@ public:
     return this->connection.createTable(DatabaseEntityDescription<T>.value());
   }
 
+  /// Creates an index on the top-level primitive field, e.g. for ordered
+  /// scans
+  template <auto MemberPtr>
+    requires DatabaseField<MemberPtr>
+  void createIndex() {
+    this->connection.createIndex(
+        DatabaseEntityDescription<MemberClass<MemberPtr>>.value(),
+        DatabaseFieldIndex<MemberPtr>.value());
+  }
+
   template <typename T> bool exists() {
     return this->connection.exists(DatabaseEntityDescription<T>.value());
   }
 
+  /// Inserts the entity, for IdMode::Auto the generated key is written back
   template <DatabaseEntity Entity> void persist(Entity &entity) {
     return this->connection.persist(DatabaseEntityDescription<Entity>.value(),
                                     &entity);
   }
 
+  /// Persists all entities of the range in a single transaction
+  template <std::ranges::forward_range Range>
+    requires DatabaseEntity<std::ranges::range_value_t<Range>> &&
+             std::is_same_v<std::ranges::range_reference_t<Range>,
+                            std::ranges::range_value_t<Range> &>
+  void persistMany(Range &&entities) {
+    using Entity = std::ranges::range_value_t<Range>;
+
+    std::vector<void *> pointers;
+    for (Entity &entity : entities) {
+      pointers.push_back(&entity);
+    }
+
+    this->connection.persistMany(DatabaseEntityDescription<Entity>.value(),
+                                 pointers);
+  }
+
+  /// Starts a bulk load of the entity table, e.g. to restore a backup
+  template <DatabaseEntity Entity> [[nodiscard]] BulkLoadGuard beginBulkLoad() {
+    return BulkLoadGuard{this->connection,
+                         DatabaseEntityDescription<Entity>.value()};
+  }
+
+#ifdef PODRM_SQLITE_CHANGE_CAPTURE
+  /// Starts recording changes of the entity tables, e.g. to replicate them
+  /// to another database with applyChanges
+  template <DatabaseEntity... Entities>
+    requires(sizeof...(Entities) > 0)
+  [[nodiscard]] ChangeCapture captureChanges() {
+    const std::array<std::string_view, sizeof...(Entities)> tables = {
+        DatabaseEntityDescription<Entities>->name...,
+    };
+    return ChangeCapture{this->connection,
+                         this->connection.beginCapture(tables)};
+  }
+
+  /// Applies a changeset or a patchset of ChangeCapture in a single
+  /// transaction
+  /// @throws std::runtime_error if a conflict aborts the changes, none of
+  /// them are applied then
+  void applyChanges(const span<const std::byte> changes,
+                    const ConflictPolicy policy = ConflictPolicy::Abort) {
+    this->connection.applyChanges(changes, policy);
+  }
+#endif
+
+  /// Calls the callback with the changes of the entity table made by every
+  /// committed transaction, e.g. to invalidate caches. It is called in the
+  /// committing thread once the committing operation is done, so it may use
+  /// the database, but must not throw. Changes of rolled back transactions
+  /// are not reported
+  /// @param callback called as callback(span<const ChangeEvent<Entity>>)
+  template <DatabaseEntity Entity, typename Callback>
+    requires std::integral<PrimaryKeyType<Entity>> &&
+             std::invocable<Callback &, span<const ChangeEvent<Entity>>>
+  [[nodiscard]] Subscription subscribe(Callback callback) {
+    // Integer primary keys are aliases of the rowid reported by the hooks
+    const std::uint64_t id = this->connection.subscribe(
+        DatabaseEntityDescription<Entity>->name,
+        [callback = std::move(callback)](
+            const span<const detail::RowChange> changes) mutable {
+          std::vector<ChangeEvent<Entity>> events;
+          events.reserve(changes.size());
+          for (const detail::RowChange &change : changes) {
+            events.push_back(ChangeEvent<Entity>{
+                .operation = change.operation,
+                .key = static_cast<PrimaryKeyType<Entity>>(change.rowid),
+            });
+          }
+          std::invoke(callback, span<const ChangeEvent<Entity>>{
+                                    events.data(), events.size()});
+        });
+    return Subscription{this->connection, id};
+  }
+
+  /// Persists all entities of the range in a bulk load
+  template <std::ranges::forward_range Range>
+    requires DatabaseEntity<std::ranges::range_value_t<Range>> &&
+             std::is_same_v<std::ranges::range_reference_t<Range>,
+                            std::ranges::range_value_t<Range> &>
+  void bulkLoad(Range &&entities) {
+    BulkLoadGuard guard =
+        this->beginBulkLoad<std::ranges::range_value_t<Range>>();
+    this->persistMany(entities);
+    guard.finish();
+  }
+
   template <DatabaseEntity Entity>
   std::optional<Entity> find(const PrimaryKeyType<Entity> &key) {
     Entity result;
@@ -57,16 +260,266 @@ public:
     this->connection.erase(DatabaseEntityDescription<Entity>.value(), key);
   }
 
+  /// Erases the entities matching the predicate
+  /// @returns number of erased entities
+  template <DatabaseEntity Entity>
+  std::uint64_t eraseWhere(const Predicate<Entity> &where) {
+    return this->connection.eraseWhere(
+        DatabaseEntityDescription<Entity>.value(), where.conditions);
+  }
+
+  /// Erases the entities with the given keys, missing keys are ignored
+  /// @returns number of erased entities
+  template <DatabaseEntity Entity, std::ranges::input_range Range>
+    requires std::convertible_to<std::ranges::range_reference_t<Range>,
+                                 const PrimaryKeyType<Entity> &>
+  std::uint64_t eraseMany(Range &&keys) {
+    std::vector<AsImage> images;
+    for (const PrimaryKeyType<Entity> &key : keys) {
+      images.emplace_back(key);
+    }
+
+    return this->connection.eraseMany(DatabaseEntityDescription<Entity>.value(),
+                                      images);
+  }
+
+  /// Applies the assignments to the entities matching the predicate, e.g.
+  /// db.updateWhere(Column<&T::a> > 1, Column<&T::b>.set(2))
+  /// @returns number of updated entities
+  template <DatabaseEntity Entity, std::same_as<SetExpression<Entity>>... Sets>
+    requires(sizeof...(Sets) > 0)
+  std::uint64_t updateWhere(const Predicate<Entity> &where,
+                            const Sets &...sets) {
+    const std::array<Assignment, sizeof...(Sets)> assignments = {
+        sets.assignment...,
+    };
+
+    return this->connection.updateWhere(
+        DatabaseEntityDescription<Entity>.value(), where.conditions,
+        assignments);
+  }
+
   template <DatabaseEntity Entity> void update(const Entity &entity) {
     this->connection.update(DatabaseEntityDescription<Entity>.value(), &entity);
   }
 
+  /// Inserts the entity or updates it if an entity with the same primary key
+  /// already exists
+  template <DatabaseEntity Entity> void upsert(const Entity &entity) {
+    this->connection.upsert(DatabaseEntityDescription<Entity>.value(), &entity);
+  }
+
+  /// Upserts all entities of the range in a single transaction
+  template <std::ranges::forward_range Range>
+    requires DatabaseEntity<std::ranges::range_value_t<Range>> &&
+             std::is_lvalue_reference_v<std::ranges::range_reference_t<Range>>
+  void upsertMany(Range &&entities) {
+    using Entity = std::ranges::range_value_t<Range>;
+
+    std::vector<const void *> pointers;
+    for (const Entity &entity : entities) {
+      pointers.push_back(&entity);
+    }
+
+    this->connection.upsertMany(DatabaseEntityDescription<Entity>.value(),
+                                pointers);
+  }
+
+  /// Updates only the selected fields of the entity
+  template <DatabaseEntity Entity, FieldSelector... Fields>
+    requires(sizeof...(Fields) > 0)
+  void update(const Entity &entity, const Fields... fields) {
+    this->connection.update(DatabaseEntityDescription<Entity>.value(), &entity,
+                            makeFieldMask(fields...));
+  }
+
+  /// Updates only the fields that differ from the snapshot
+  /// @param snapshot entity state as it was loaded from the database
+  template <DatabaseEntity Entity>
+  void update(const Entity &entity, const Entity &snapshot) {
+    this->connection.updateChanged(DatabaseEntityDescription<Entity>.value(),
+                                   &entity, &snapshot);
+  }
+
+  /// Atomically adds the delta to a numeric field without reading the entity
+  /// @returns new value of the field, or nullopt if the entity is not found
+  template <auto MemberPtr>
+    requires DatabaseField<MemberPtr>
+  std::optional<MemberType<MemberPtr>>
+  increment(const PrimaryKeyType<MemberClass<MemberPtr>> &key,
+            const MemberType<MemberPtr> &delta) {
+    MemberType<MemberPtr> result;
+    if (!this->connection.increment(
+            DatabaseEntityDescription<MemberClass<MemberPtr>>.value(),
+            DatabaseFieldIndex<MemberPtr>.value(), key, &delta, &result)) {
+      return std::nullopt;
+    }
+
+    return result;
+  }
+
+  /// Atomically replaces the field value if it is equal to the expected one
+  /// @returns true if the value was replaced
+  template <auto MemberPtr>
+    requires DatabaseField<MemberPtr>
+  bool compareAndSet(const PrimaryKeyType<MemberClass<MemberPtr>> &key,
+                     const MemberType<MemberPtr> &expected,
+                     const MemberType<MemberPtr> &desired) {
+    return this->connection.compareAndSet(
+        DatabaseEntityDescription<MemberClass<MemberPtr>>.value(),
+        DatabaseFieldIndex<MemberPtr>.value(), key, &expected, &desired);
+  }
+
   template <DatabaseEntity Entity> Cursor<Entity> iterate() {
     return Cursor<Entity>{
         this->connection.iterate(DatabaseEntityDescription<Entity>.value()),
     };
   }
 
+  /// Iterates over entities, reading only the columns of the projection
+  /// @tparam Projection struct with fields named as the entity columns
+  template <DatabaseEntity Entity, ProjectionOf<Entity> Projection>
+  Cursor<Projection> iterateAs() {
+    return Cursor<Projection>{
+        this->connection.iterate(DatabaseEntityDescription<Entity>.value(),
+                                 ProjectionDescription<Projection>.value()),
+    };
+  }
+
+  /// Calls the function for every entity of the table from several threads
+  /// at once. The table is split into rowid ranges scanned by read-only
+  /// connections, so changes not committed by this database are not seen
+  /// and exclusive locking mode blocks the scan. In-memory databases are
+  /// scanned in the calling thread
+  /// @param function called as function(Entity)
+  /// @param threads number of threads, hardware concurrency if 0
+  template <DatabaseEntity Entity, typename Function>
+    requires std::invocable<Function &, Entity>
+  void parallelForEach(Function function, const std::size_t threads = 0) {
+    this->connection.parallelScan(
+        DatabaseEntityDescription<Entity>.value(), threads,
+        [&function](std::size_t /*worker*/, detail::Cursor &cursor) {
+          for (; cursor.valid(); cursor.nextRow()) {
+            Entity entity;
+            static_cast<void>(cursor.extract(&entity));
+            std::invoke(function, std::move(entity));
+          }
+        });
+  }
+
+  /// Same as parallelForEach, but every thread accumulates into its own
+  /// copy of the initial value, the copies are merged at the end. The
+  /// initial value should thus be neutral, e.g. 0 for sums
+  /// @param accumulate called as accumulate(Result &, Entity)
+  /// @param merge called as merge(Result &, Result &&) to merge the result
+  /// of another thread
+  template <DatabaseEntity Entity, typename Result, typename Accumulate,
+            typename Merge>
+    requires std::invocable<Accumulate &, Result &, Entity> &&
+             std::invocable<Merge &, Result &, Result &&>
+  Result parallelReduce(const Result &init, Accumulate accumulate, Merge merge,
+                        const std::size_t threads = 0) {
+    std::vector<Result> results(workerCount(threads), init);
+    this->connection.parallelScan(
+        DatabaseEntityDescription<Entity>.value(), threads,
+        [&accumulate, &results](const std::size_t worker,
+                                detail::Cursor &cursor) {
+          for (; cursor.valid(); cursor.nextRow()) {
+            Entity entity;
+            static_cast<void>(cursor.extract(&entity));
+            std::invoke(accumulate, results[worker], std::move(entity));
+          }
+        });
+
+    Result result = std::move(results.front());
+    for (std::size_t i = 1; i < results.size(); ++i) {
+      std::invoke(merge, result, std::move(results[i]));
+    }
+    return result;
+  }
+
+  /// Counts the entities matching the predicate
+  template <DatabaseEntity Entity>
+  std::uint64_t count(const Predicate<Entity> &where = {}) {
+    // NOLINTNEXTLINE(bugprone-unchecked-optional-access): count is not NULL
+    return this->aggregate(Count<Entity>, where).value();
+  }
+
+  /// Sums the field over the entities matching the predicate
+  template <auto MemberPtr>
+    requires NumericField<MemberPtr>
+  MemberType<MemberPtr>
+  sum(const Predicate<MemberClass<MemberPtr>> &where = {}) {
+    return this->aggregate(Sum<MemberPtr>, where)
+        .value_or(MemberType<MemberPtr>{});
+  }
+
+  /// @returns minimum of the field, or nullopt if no entities match
+  template <auto MemberPtr>
+    requires PrimitiveField<MemberPtr>
+  std::optional<MemberType<MemberPtr>>
+  min(const Predicate<MemberClass<MemberPtr>> &where = {}) {
+    return this->aggregate(Min<MemberPtr>, where);
+  }
+
+  /// @returns maximum of the field, or nullopt if no entities match
+  template <auto MemberPtr>
+    requires PrimitiveField<MemberPtr>
+  std::optional<MemberType<MemberPtr>>
+  max(const Predicate<MemberClass<MemberPtr>> &where = {}) {
+    return this->aggregate(Max<MemberPtr>, where);
+  }
+
+  /// Computes the aggregate over the entities matching the predicate
+  /// @returns aggregate value, or nullopt if no entities match
+  template <DatabaseEntity Entity, typename Result>
+  std::optional<Result> aggregate(const Aggregate<Entity, Result> &aggregate,
+                                  const Predicate<Entity> &where = {}) {
+    Result result;
+    if (!this->connection.aggregate(DatabaseEntityDescription<Entity>.value(),
+                                    aggregate.description, where.conditions,
+                                    &result)) {
+      return std::nullopt;
+    }
+
+    return result;
+  }
+
+  /// Computes the aggregate for each distinct value of the key field
+  /// @returns (key, aggregate value) pairs ordered by the key
+  template <auto KeyPtr, typename Result>
+    requires PrimitiveField<KeyPtr>
+  std::vector<std::pair<MemberType<KeyPtr>, Result>>
+  groupBy(const Aggregate<MemberClass<KeyPtr>, Result> &aggregate,
+          const Predicate<MemberClass<KeyPtr>> &where = {}) {
+    using Entity = MemberClass<KeyPtr>;
+    using Group = std::pair<MemberType<KeyPtr>, Result>;
+
+    constexpr EntityDescription Description =
+        DatabaseEntityDescription<Entity>.value();
+    constexpr std::size_t Key = DatabaseFieldIndex<KeyPtr>.value();
+
+    const auto groupDescription = makeGroupDescription<MemberType<KeyPtr>,
+                                                       Result>(
+        Description.fields[Key], aggregate.description);
+
+    Cursor<Group> cursor{this->connection.groupBy(
+        Description, Key, aggregate.description, where.conditions,
+        groupDescription)};
+
+    std::vector<Group> groups;
+    for (Group group : cursor) {
+      groups.push_back(std::move(group));
+    }
+
+    return groups;
+  }
+
+  /// Scans entities in a stable order, by default ordered by the primary key
+  template <DatabaseEntity Entity> Scan<Entity> scan() {
+    return Scan<Entity>{this->connection};
+  }
+
 private:
   detail::Connection connection;
 
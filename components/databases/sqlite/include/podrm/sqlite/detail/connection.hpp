@@ -1,29 +1,183 @@
 #pragma once
 
+#include <podrm/aggregate.hpp>
+#include <podrm/cancellation.hpp>
+#include <podrm/instrumentation.hpp>
 #include <podrm/metadata.hpp>
+#include <podrm/predicate.hpp>
 #include <podrm/span.hpp>
+#include <podrm/sqlite/change_event.hpp>
+#include <podrm/sqlite/conflict_policy.hpp>
+#include <podrm/sqlite/connection_options.hpp>
 #include <podrm/sqlite/detail/cursor.hpp>
 #include <podrm/sqlite/detail/result.hpp>
+#include <podrm/sqlite/slow_query_log.hpp>
+#include <podrm/sqlite/snapshot_options.hpp>
 
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
 #include <cstdint>
 #include <filesystem>
+#include <functional>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <string>
 #include <string_view>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 struct sqlite3;
+struct sqlite3_session;
+struct sqlite3_stmt;
 
 namespace podrm::sqlite::detail {
 
+class SlowQueryTrace;
+
 class Connection {
 public:
   //---------------- Constructors ------------------//
 
-  static Connection fromRaw(sqlite3 &connection);
+  /// Open flags of the options are ignored, the connection is already open
+  static Connection fromRaw(sqlite3 &connection,
+                            const ConnectionOptions &options = {});
+
+  static Connection inMemory(const char *name,
+                             const ConnectionOptions &options = {});
+
+  static Connection inFile(const std::filesystem::path &path,
+                           const ConnectionOptions &options = {});
+
+  /// Opens the file read-only with the whole file memory-mapped
+  /// @param options immutable flag and memory map size, the file size if
+  /// unset
+  static Connection openReadOnly(const std::filesystem::path &path,
+                                 const ReadOnlyOptions &options);
+
+  /// Copies the database file into a new in-memory database
+  static Connection loadIntoMemory(const std::filesystem::path &path,
+                                   const ConnectionOptions &options = {});
+
+  //---------------- Snapshots ------------------//
+
+  /// Replaces the contents of the file with this database in steps, other
+  /// operations can run between them
+  void snapshotTo(const std::filesystem::path &path,
+                  const SnapshotOptions &options);
+
+  //---------------- Transactions ------------------//
+
+  void begin();
+
+  void commit();
+
+  void rollback();
+
+  /// Savepoint started by beginSavepoint
+  struct SavepointState {
+    std::string name;
+
+    /// Number of changes recorded when the savepoint started
+    std::size_t changes;
+  };
+
+  /// Starts a savepoint, nested in the running transaction if any
+  SavepointState beginSavepoint();
+
+  void releaseSavepoint(const SavepointState &state);
+
+  /// Undoes the changes made since the savepoint and releases it
+  void rollbackSavepoint(const SavepointState &state);
+
+  //---------------- Bulk loading ------------------//
+
+  /// Settings changed by beginBulkLoad, restored when the load ends
+  struct BulkLoadState {
+    std::int64_t synchronous;
+
+    /// Previous journal mode, empty if it was not changed
+    std::string journalMode;
+
+    /// Names and definitions of the dropped secondary indexes
+    std::vector<std::pair<std::string, std::string>> indexes;
+  };
+
+  /// Relaxes durability settings, begins a transaction with deferred foreign
+  /// key checks and drops secondary indexes of the entity table
+  BulkLoadState beginBulkLoad(const EntityDescription &description);
+
+  /// Recreates the indexes, checks foreign keys of the entity table in one
+  /// pass and commits
+  /// @throws std::runtime_error if foreign keys are violated, the load is
+  /// rolled back
+  void finishBulkLoad(const EntityDescription &description,
+                      const BulkLoadState &state);
+
+  /// Rolls back the load and restores the settings, errors are ignored
+  void abortBulkLoad(const BulkLoadState &state) noexcept;
 
-  static Connection inMemory(const char *name);
+#ifdef PODRM_SQLITE_CHANGE_CAPTURE
+  //---------------- Change capture ------------------//
 
-  static Connection inFile(const std::filesystem::path &path);
+  /// Starts recording changes of the tables with a new session
+  /// @returns session deleted with endCapture
+  sqlite3_session &beginCapture(span<const std::string_view> tables);
+
+  /// @param patchset whether to omit old values of the changed rows
+  /// @returns changes recorded by the session
+  std::vector<std::byte> captured(sqlite3_session &session, bool patchset);
+
+  /// Deletes the session under the connection mutex
+  void endCapture(sqlite3_session &session) noexcept;
+
+  /// Applies a changeset or a patchset in a savepoint
+  /// @throws std::runtime_error if a conflict aborts the changes
+  void applyChanges(span<const std::byte> changes, ConflictPolicy policy);
+#endif
+
+  //---------------- Change notifications ------------------//
+
+  using ChangeCallback = std::function<void(span<const RowChange> changes)>;
+
+  /// Calls the callback with the changes of the table made by every
+  /// committed transaction, once the statement that committed it returns
+  /// @returns id of the subscription
+  std::uint64_t subscribe(std::string_view table, ChangeCallback callback);
+
+  /// Waits for the calls of the callback running in other threads, so it is
+  /// not called once this returns. Calls of other callbacks are not waited
+  /// for
+  void unsubscribe(std::uint64_t id) noexcept;
+
+  //---------------- Limits ------------------//
+
+  /// Operations fail with OperationCancelled or OperationTimedOut once the
+  /// limits are exceeded, running statements are interrupted
+  /// @param limits new limits, nullopt to remove them
+  /// @returns previous limits
+  std::optional<OperationLimits>
+  setLimits(std::optional<OperationLimits> limits);
+
+  /// Interrupts the running statements, can be called from any thread
+  void interrupt();
+
+  //---------------- Instrumentation ------------------//
+
+  /// Reports every executed statement to the observer, which must outlive
+  /// the connection
+  /// @param observer new observer, nullptr to stop reporting
+  void setObserver(Observer *observer);
+
+  /// Reports statements running longer than the threshold of the log with
+  /// their query plans
+  /// @param log new log, nullopt to disable it
+  void setSlowQueryLog(std::optional<SlowQueryLog> log);
 
   //---------------- Operations ------------------//
 
@@ -31,8 +185,16 @@ public:
 
   bool exists(const EntityDescription &entity);
 
+  /// Creates an index on the top-level primitive field if it does not exist
+  void createIndex(const EntityDescription &entity, std::size_t field);
+
+  /// Inserts the entity, writing the generated key back for IdMode::Auto
   void persist(const EntityDescription &description, void *entity);
 
+  /// Persists all entities in a single transaction
+  void persistMany(const EntityDescription &description,
+                   span<void *const> entities);
+
   /// @param[out] result pointer to the result structure, filled if found
   bool find(const EntityDescription &description, const AsImage &key,
             void *result);
@@ -41,20 +203,251 @@ public:
 
   void update(EntityDescription description, const void *entity);
 
+  /// Erases the entities matching the conditions
+  /// @returns number of erased entities
+  std::uint64_t eraseWhere(const EntityDescription &description,
+                           span<const Condition> where);
+
+  /// Erases the entities with the given keys, missing keys are ignored
+  /// @returns number of erased entities
+  std::uint64_t eraseMany(const EntityDescription &description,
+                          span<const AsImage> keys);
+
+  /// Applies the assignments to the entities matching the conditions
+  /// @returns number of updated entities
+  std::uint64_t updateWhere(const EntityDescription &description,
+                            span<const Condition> where,
+                            span<const Assignment> assignments);
+
+  /// Inserts the entity or updates it if an entity with the same primary key
+  /// already exists
+  void upsert(const EntityDescription &description, const void *entity);
+
+  /// Upserts all entities in a single transaction
+  void upsertMany(const EntityDescription &description,
+                  span<const void *const> entities);
+
+  /// Updates only the top-level fields selected by the mask
+  void update(EntityDescription description, const void *entity,
+              FieldMask fields);
+
+  /// Updates only the top-level fields that differ from the snapshot, does
+  /// nothing if there are no changes
+  /// @param snapshot entity state as it was loaded from the database
+  void updateChanged(EntityDescription description, const void *entity,
+                     const void *snapshot);
+
+  /// Atomically adds the delta to a numeric field
+  /// @param[in] delta pointer to the value of the field type
+  /// @param[out] result pointer to the new field value, filled if found
+  bool increment(const EntityDescription &description, std::size_t field,
+                 const AsImage &key, const void *delta, void *result);
+
+  /// Atomically replaces the field value if it is equal to the expected one
+  /// @param[in] expected pointer to the value of the field type
+  /// @param[in] desired pointer to the value of the field type
+  /// @returns true if the value was replaced
+  bool compareAndSet(const EntityDescription &description, std::size_t field,
+                     const AsImage &key, const void *expected,
+                     const void *desired);
+
   Cursor iterate(EntityDescription description);
 
+  /// Iterates over the entity columns selected by the projection
+  Cursor iterate(EntityDescription description,
+                 span<const FieldDescription> projection);
+
+  /// Iterates over entities ordered by the field and then by the primary key
+  /// @param field index of the top-level primitive field to order by
+  /// @param after values of the ordering field and the primary key of the
+  /// last seen entity, only the key if ordered by the primary key, or empty
+  /// to start from the first entity
+  /// @param limit maximum number of entities, negative for no limit
+  Cursor scan(const EntityDescription &description, std::size_t field,
+              span<const AsImage> after, std::int64_t limit);
+
+  /// Computes the aggregate over the entities matching the conditions
+  /// @param[out] result pointer to the aggregate value, filled if there are
+  /// matching entities
+  bool aggregate(const EntityDescription &description,
+                 const AggregateDescription &aggregate,
+                 span<const Condition> where, void *result);
+
+  /// Scans the table in rowid ranges on read-only connections, one per
+  /// worker. Workers that run out of ranges steal them from the others.
+  /// Databases without a file are scanned by this connection in the calling
+  /// thread
+  /// @param workers number of workers, hardware concurrency if 0
+  /// @param visit called as visit(worker, cursor) for every range, from
+  /// several threads at once
+  void parallelScan(const EntityDescription &description, std::size_t workers,
+                    const std::function<void(std::size_t, Cursor &)> &visit);
+
+  /// Computes the aggregate for each distinct value of the key field
+  /// @param group description of the (key, aggregate value) row
+  Cursor groupBy(const EntityDescription &description, std::size_t key,
+                 const AggregateDescription &aggregate,
+                 span<const Condition> where,
+                 span<const FieldDescription> group);
+
 private:
   std::unique_ptr<sqlite3, int (*)(sqlite3 *)> connection;
 
   std::unique_ptr<std::mutex> mutex = std::make_unique<std::mutex>();
 
-  explicit Connection(sqlite3 &connection);
+  /// Number of savepoints started, used to name them
+  std::uint64_t savepoints = 0;
+
+  /// Limits checked by the progress handler, kept on the heap so that its
+  /// address survives moves
+  std::unique_ptr<OperationLimits> limits;
+
+  /// Receives statement events, statements are not timed without it
+  Observer *observer = nullptr;
+
+  /// Whether statements are reported to the observer or the slow query
+  /// log. Read by operation scopes without the mutex, kept on the heap so
+  /// that the connection stays movable
+  std::unique_ptr<std::atomic<bool>> reported =
+      std::make_unique<std::atomic<bool>>(false);
+
+  /// @returns whether operation scopes set the reported operation
+  [[nodiscard]] bool reporting() const {
+    return this->reported->load(std::memory_order_relaxed);
+  }
+
+  /// Whether the database was opened as immutable, inherited by the
+  /// connections of parallel scans
+  bool immutable = false;
+
+  /// Slow query log, shared with the results that report the statements
+  /// they step through
+  std::shared_ptr<SlowQueryTrace> slowQueries;
+
+  /// Change subscribers with the changes collected by the update hook
+  struct Subscriptions {
+    /// Guards the fields, hooks run without the connection mutex while
+    /// results are stepped
+    std::mutex mutex;
+
+    std::uint64_t nextId = 0;
+
+    /// Tables and callbacks by subscription id
+    std::map<std::uint64_t, std::pair<std::string, ChangeCallback>>
+        subscribers;
+
+    /// Changes of the running transaction with their tables
+    std::vector<std::pair<std::string, RowChange>> pending;
+
+    /// Changes of the transaction being committed, the commit hook runs
+    /// before the commit completes and the commit may still fail
+    std::vector<std::pair<std::string, RowChange>> committing;
+
+    /// Changes of committed transactions that are not delivered yet
+    std::vector<std::vector<std::pair<std::string, RowChange>>> committed;
+
+    /// Threads calling each subscriber by subscription id, unsubscribing
+    /// waits for the other threads calling the same subscriber
+    std::map<std::uint64_t, std::vector<std::thread::id>> deliverers;
+
+    /// Notified when a thread returns from a callback
+    std::condition_variable delivered;
+  };
+
+  /// Kept on the heap so that its address survives moves
+  std::unique_ptr<Subscriptions> subscriptions =
+      std::make_unique<Subscriptions>();
+
+  using CachedStatement =
+      std::unique_ptr<sqlite3_stmt, int (*)(sqlite3_stmt *)>;
+
+  /// Prepared statements reused between executions, keyed by their text
+  std::unordered_map<std::string, CachedStatement> statements;
+
+  /// Kinds of statements generated from entity descriptions
+  enum class Generated : std::uint8_t {
+    Insert,
+    PartialUpdate,
+    Upsert,
+  };
+
+  /// Generated statements, keyed by kind, entity and selected fields
+  std::map<std::tuple<Generated, std::string_view, FieldMask>, std::string>
+      generated;
+
+  Connection(sqlite3 &connection, const ConnectionOptions &options);
+
+  /// Opens the database, closing the handle on failure
+  static sqlite3 &open(const char *filename, int flags,
+                       const ConnectionOptions &options);
+
+  /// @throws OperationCancelled or OperationTimedOut if the limits are
+  /// already exceeded
+  void checkLimits() const;
+
+  /// Records changes of subscribed tables
+  static void updateHook(void *context, int operation, const char *database,
+                         const char *table, long long rowid);
+
+  /// Moves the recorded changes to the committing ones
+  static int commitHook(void *context);
+
+  static void rollbackHook(void *context);
+
+  /// @returns number of changes recorded in the running transaction, e.g.
+  /// to discard the changes of a rolled back savepoint
+  std::size_t pendingChanges();
+
+  /// Discards the changes recorded after the first ones
+  void discardChanges(std::size_t first);
+
+  /// Moves the changes of the commit attempted by a statement to the
+  /// committed ones if it succeeded, or back to the running transaction
+  void settleChanges(bool succeeded);
+
+  /// Calls the subscribers with the committed changes, must be called
+  /// without holding the connection mutex
+  void deliverChanges();
+
+  /// Restores settings changed by beginBulkLoad
+  void restoreSettings(const BulkLoadState &state);
 
   /// @returns number of affected entries
   std::uint64_t execute(std::string_view statement,
                         span<const AsImage> args = {});
 
+  /// Same as execute, but ignores the limits, e.g. to roll back after an
+  /// interrupted statement
+  std::uint64_t executeUnlimited(std::string_view statement,
+                                 span<const AsImage> args = {});
+
+  /// Same as execute, but keeps the statement prepared for reuse
+  /// @param[out] lastInsertRowId rowid of the last inserted row, if not null
+  /// @returns number of affected entries
+  std::uint64_t executeCached(const std::string &statement,
+                              span<const AsImage> args = {},
+                              std::int64_t *lastInsertRowId = nullptr);
+
+  /// Binds the arguments, remembering their types for the slow query log
+  void bind(sqlite3_stmt &statement, span<const AsImage> args);
+
+  /// @returns cached prepared statement, preparing it on the first use. The
+  /// mutex must be locked by the caller
+  sqlite3_stmt &prepareCached(const std::string &statement);
+
+  /// Runs the body inside a savepoint, rolling it back if the body throws
+  template <typename Body> void inSavepoint(const Body &body);
+
+  /// @returns statement of the given kind, generating it on the first use
+  std::string getGenerated(Generated kind, const EntityDescription &description,
+                           FieldMask fields = 0);
+
   Result query(std::string_view statement, span<const AsImage> args = {});
+
+  /// Same as query, but reuses the prepared statement unless it is still in
+  /// use by another result
+  Result queryCached(const std::string &statement,
+                     span<const AsImage> args = {});
 };
 
 } // namespace podrm::sqlite::detail
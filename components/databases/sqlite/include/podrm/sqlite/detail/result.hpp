@@ -1,14 +1,33 @@
 #pragma once
 
+#include <podrm/metadata.hpp>
 #include <podrm/sqlite/detail/row.hpp>
 
 #include <memory>
 #include <optional>
+#include <vector>
+
+namespace podrm::detail {
+
+struct Observation;
+
+} // namespace podrm::detail
 
 namespace podrm::sqlite::detail {
 
+class SlowQueryTrace;
+
 class Result {
 public:
+  Result(const Result &) = delete;
+  Result(Result &&other) noexcept;
+  Result &operator=(const Result &) = delete;
+  Result &operator=(Result &&other) noexcept;
+
+  /// Reports the statement to the observer and the slow query log if it
+  /// was not consumed
+  ~Result();
+
   [[nodiscard]] std::optional<Row> getRow() const {
     if (!this->statement.has_value()) {
       return std::nullopt;
@@ -25,13 +44,34 @@ public:
 private:
   using Statement = std::unique_ptr<sqlite3_stmt, int (*)(sqlite3_stmt *)>;
 
+  /// Bound arguments owning their strings and blobs, read by the statement
+  /// while it is stepped. Declared first to outlive the statement
+  std::vector<AsImage> arguments;
+
   std::optional<Statement> statement;
 
   int columnCount = 0;
 
+  /// Event reported once all rows are stepped through, null without an
+  /// observer
+  std::unique_ptr<podrm::detail::Observation> observation;
+
+  /// Slow query log of the connection, reported to once the statement is
+  /// done, null without a log
+  std::shared_ptr<SlowQueryTrace> slowQueries;
+
   friend class Connection;
 
-  explicit Result(Statement statement);
+  /// @param arguments arguments bound to the statement, see ownArguments
+  Result(Statement statement, std::vector<AsImage> arguments,
+         std::unique_ptr<podrm::detail::Observation> observation = nullptr,
+         std::shared_ptr<SlowQueryTrace> slowQueries = nullptr);
+
+  /// Reports the observation, if any, and drops it
+  void finishObservation();
+
+  /// Reports the slow statements traced so far, if there is a log
+  void reportSlowQueries();
 };
 
 } // namespace podrm::sqlite::detail
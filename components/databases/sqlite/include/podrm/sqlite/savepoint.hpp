@@ -0,0 +1,64 @@
+#pragma once
+
+#include <podrm/sqlite/detail/connection.hpp>
+
+#include <stdexcept>
+#include <utility>
+
+namespace podrm::sqlite {
+
+/// Savepoint nested in the running transaction, or a transaction of its own
+/// outside of one. Rolled back on destruction unless released
+class Savepoint {
+public:
+  Savepoint(const Savepoint &) = delete;
+  Savepoint(Savepoint &&other) noexcept
+      : connection(std::exchange(other.connection, nullptr)),
+        state(std::move(other.state)) {}
+  Savepoint &operator=(const Savepoint &) = delete;
+  Savepoint &operator=(Savepoint &&) = delete;
+
+  ~Savepoint() {
+    if (this->connection == nullptr) {
+      return;
+    }
+
+    try {
+      this->connection->rollbackSavepoint(this->state);
+    } catch (...) { // NOLINT(bugprone-empty-catch): destructor must not throw
+    }
+  }
+
+  /// Keeps the changes made since the savepoint as a part of the enclosing
+  /// transaction
+  void release() {
+    this->checkRunning();
+    this->connection->releaseSavepoint(this->state);
+    this->connection = nullptr;
+  }
+
+  /// Undoes the changes made since the savepoint
+  void rollback() {
+    this->checkRunning();
+    this->connection->rollbackSavepoint(this->state);
+    this->connection = nullptr;
+  }
+
+private:
+  detail::Connection *connection;
+
+  detail::Connection::SavepointState state;
+
+  explicit Savepoint(detail::Connection &connection)
+      : connection(&connection), state(connection.beginSavepoint()) {}
+
+  void checkRunning() const {
+    if (this->connection == nullptr) {
+      throw std::logic_error{"Savepoint is already finished"};
+    }
+  }
+
+  friend class Database;
+};
+
+} // namespace podrm::sqlite
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <podrm/metadata.hpp>
+#include <podrm/sqlite/cursor.hpp>
+#include <podrm/sqlite/detail/connection.hpp>
+
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace podrm::sqlite {
+
+/// Range over entities ordered by a field and then by the primary key,
+/// continuing after the last seen entity (keyset pagination)
+template <DatabaseEntity Entity> class Scan {
+public:
+  /// Orders entities by the field, ties are ordered by the primary key. The
+  /// field should be indexed to avoid sorting the whole table
+  template <auto MemberPtr>
+    requires DatabaseField<MemberPtr> &&
+             std::same_as<MemberClass<MemberPtr>, Entity>
+  Scan &orderBy() & {
+    static_assert(
+        std::holds_alternative<PrimitiveFieldDescription>(
+            Description.fields[DatabaseFieldIndex<MemberPtr>.value()].field),
+        "Only primitive fields can be used for ordering");
+
+    this->field = DatabaseFieldIndex<MemberPtr>.value();
+    return *this;
+  }
+
+  template <auto MemberPtr>
+    requires DatabaseField<MemberPtr> &&
+             std::same_as<MemberClass<MemberPtr>, Entity>
+  Scan orderBy() && {
+    this->orderBy<MemberPtr>();
+    return std::move(*this);
+  }
+
+  /// Continues after the entity with the given key, only for scans ordered by
+  /// the primary key
+  Scan &after(const PrimaryKeyType<Entity> &key) & {
+    this->lastKey = key;
+    this->last.reset();
+    return *this;
+  }
+
+  Scan after(const PrimaryKeyType<Entity> &key) && {
+    this->after(key);
+    return std::move(*this);
+  }
+
+  /// Continues after the given entity
+  Scan &after(const Entity &entity) & {
+    this->last = entity;
+    this->lastKey.reset();
+    return *this;
+  }
+
+  Scan after(const Entity &entity) && {
+    this->after(entity);
+    return std::move(*this);
+  }
+
+  /// Limits the number of entities returned by the scan
+  Scan &limit(const std::int64_t count) & {
+    this->count = count;
+    return *this;
+  }
+
+  Scan limit(const std::int64_t count) && {
+    this->limit(count);
+    return std::move(*this);
+  }
+
+  /// Executes the scan, the scan must outlive the iteration
+  typename Cursor<Entity>::Iterator begin() {
+    std::vector<AsImage> keyset;
+    if (this->last.has_value()) {
+      keyset.push_back(this->image(this->field));
+      if (this->field != Description.primaryKey) {
+        keyset.push_back(this->image(Description.primaryKey));
+      }
+    } else if (this->lastKey.has_value()) {
+      keyset.emplace_back(*this->lastKey);
+    }
+
+    this->cursor = Cursor<Entity>{
+        this->connection.get().scan(Description, this->field, keyset,
+                                    this->count),
+    };
+    return this->cursor->begin();
+  }
+
+  typename Cursor<Entity>::Sentinel end() { return {}; }
+
+private:
+  static constexpr EntityDescription Description =
+      DatabaseEntityDescription<Entity>.value();
+
+  std::reference_wrapper<detail::Connection> connection;
+
+  std::size_t field = Description.primaryKey;
+
+  std::optional<Entity> last;
+
+  std::optional<PrimaryKeyType<Entity>> lastKey;
+
+  std::int64_t count = -1;
+
+  std::optional<Cursor<Entity>> cursor;
+
+  explicit Scan(detail::Connection &connection) : connection(connection) {}
+
+  [[nodiscard]] AsImage image(const std::size_t index) const {
+    const FieldDescription &description = Description.fields[index];
+    return std::get<PrimitiveFieldDescription>(description.field)
+        .asImage(description.constMemberPtr(&*this->last));
+  }
+
+  friend class Database;
+};
+
+} // namespace podrm::sqlite
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <podrm/metadata.hpp>
+#include <podrm/sqlite/cursor.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+namespace podrm::sqlite {
+
+class ShardedDatabase;
+
+namespace detail {
+
+/// Reads the entities of several shard cursors, either one cursor after
+/// another or merged by an order all of them are sorted by
+template <DatabaseEntity Entity> class ShardMerge {
+public:
+  /// @returns true if the first entity goes before the second one
+  using Less = bool (*)(const Entity &, const Entity &);
+
+  class Iterator;
+  class Sentinel {};
+
+  /// @param less order of every cursor, nullptr to read the cursors one
+  /// after another
+  /// @param count maximum number of entities, unlimited if negative
+  ShardMerge(const Less less, const std::int64_t count)
+      : less(less), remaining(count) {}
+
+  /// Adds a cursor, which must outlive the iteration
+  void add(typename sqlite::Cursor<Entity>::Iterator iterator) {
+    if (iterator != typename sqlite::Cursor<Entity>::Sentinel{}) {
+      this->heads.push_back(Head{.entity = *iterator, .iterator = iterator});
+    }
+  }
+
+  Iterator begin() {
+    this->select();
+    return Iterator{*this};
+  }
+
+  Sentinel end() { return {}; }
+
+private:
+  /// Current entity of a cursor
+  struct Head {
+    Entity entity;
+
+    typename sqlite::Cursor<Entity>::Iterator iterator;
+  };
+
+  Less less;
+
+  std::int64_t remaining;
+
+  std::vector<Head> heads;
+
+  /// Index of the head read next
+  std::size_t current = 0;
+
+  [[nodiscard]] bool done() const {
+    return this->heads.empty() || this->remaining == 0;
+  }
+
+  void next() {
+    Head &head = this->heads[this->current];
+    ++head.iterator;
+    if (head.iterator == typename sqlite::Cursor<Entity>::Sentinel{}) {
+      this->heads.erase(this->heads.begin() +
+                        static_cast<std::ptrdiff_t>(this->current));
+    } else {
+      head.entity = *head.iterator;
+    }
+
+    if (this->remaining > 0) {
+      --this->remaining;
+    }
+    this->select();
+  }
+
+  /// Selects the smallest head, or the first one without an order
+  void select() {
+    if (this->less == nullptr || this->heads.empty()) {
+      this->current = 0;
+      return;
+    }
+
+    this->current = static_cast<std::size_t>(
+        std::ranges::min_element(this->heads, this->less, &Head::entity) -
+        this->heads.begin());
+  }
+};
+
+template <DatabaseEntity Entity> class ShardMerge<Entity>::Iterator {
+public:
+  using iterator_category = std::input_iterator_tag;
+  using value_type = Entity;
+  using difference_type = std::ptrdiff_t;
+  using pointer = const Entity *;
+  using reference = const Entity &;
+
+  const Entity &operator*() const {
+    const ShardMerge &merge = this->merge.get();
+    return merge.heads[merge.current].entity;
+  }
+
+  Iterator &operator++() {
+    this->merge.get().next();
+
+    return *this;
+  }
+
+  Iterator operator++(int) { return ++(*this); }
+
+  friend bool operator==(const Iterator &lhs, const Sentinel /*sentinel*/) {
+    return lhs.done();
+  }
+
+private:
+  std::reference_wrapper<ShardMerge> merge;
+
+  explicit Iterator(ShardMerge &merge) : merge(merge) {}
+
+  [[nodiscard]] bool done() const { return this->merge.get().done(); }
+
+  friend class ShardMerge<Entity>;
+};
+
+} // namespace detail
+
+/// Range over the entities of every shard, shard after shard
+template <DatabaseEntity Entity> class ShardedCursor {
+public:
+  /// Starts reading the shard cursors, the range can be iterated once
+  typename detail::ShardMerge<Entity>::Iterator begin() {
+    for (Cursor<Entity> &cursor : this->cursors) {
+      this->merge.add(cursor.begin());
+    }
+    return this->merge.begin();
+  }
+
+  typename detail::ShardMerge<Entity>::Sentinel end() { return {}; }
+
+private:
+  std::vector<Cursor<Entity>> cursors;
+
+  detail::ShardMerge<Entity> merge{nullptr, -1};
+
+  explicit ShardedCursor(std::vector<Cursor<Entity>> cursors)
+      : cursors(std::move(cursors)) {}
+
+  friend class ShardedDatabase;
+};
+
+} // namespace podrm::sqlite
@@ -0,0 +1,479 @@
+#pragma once
+
+#include <podrm/aggregate.hpp>
+#include <podrm/instrumentation.hpp>
+#include <podrm/metadata.hpp>
+#include <podrm/parallel.hpp>
+#include <podrm/predicate.hpp>
+#include <podrm/span.hpp>
+#include <podrm/sqlite/connection_options.hpp>
+#include <podrm/sqlite/database.hpp>
+#include <podrm/sqlite/sharded_cursor.hpp>
+#include <podrm/sqlite/sharded_scan.hpp>
+#include <podrm/sqlite/transaction.hpp>
+
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <optional>
+#include <ranges>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace podrm::sqlite {
+
+namespace detail {
+
+/// @returns shard of the primary key image, stable across builds and
+/// platforms
+std::size_t defaultShard(const AsImage &key, std::size_t shards);
+
+} // namespace detail
+
+/// Spreads entities over several databases, e.g. files, by their primary
+/// key. Operations on a key go to its shard, operations on whole tables go
+/// to every shard. Shards are independent databases, so operations spanning
+/// several of them are not atomic and entities need manual primary keys
+class ShardedDatabase {
+public:
+  //---------------- Constructors ------------------//
+
+  /// @throws std::invalid_argument if there are no shards
+  explicit ShardedDatabase(std::vector<Database> shards);
+
+  /// Opens a shard for every file, the order of the files selects shards
+  /// and must not change once entities are stored
+  /// @param options connection settings of every shard
+  static ShardedDatabase inFiles(span<const std::filesystem::path> paths,
+                                 const ConnectionOptions &options = {});
+
+  //---------------- Routing ------------------//
+
+  std::size_t shardCount() const { return this->shards.size(); }
+
+  Database &shard(const std::size_t index) { return this->shards.at(index); }
+
+  /// Routes the entity by the function instead of the primary key hash
+  /// @param function called as function(key), returns a shard index
+  template <DatabaseEntity Entity, typename Function>
+    requires std::is_invocable_r_v<std::size_t, Function &,
+                                   const PrimaryKeyType<Entity> &>
+  void setShardFunction(Function function) {
+    this->shardFunctions.insert_or_assign(
+        DatabaseEntityDescription<Entity>->name,
+        [function = std::move(function)](const void *key) mutable {
+          return static_cast<std::size_t>(std::invoke(
+              function, *static_cast<const PrimaryKeyType<Entity> *>(key)));
+        });
+  }
+
+  /// @returns index of the shard storing the entity with the key
+  /// @throws std::out_of_range if the shard function returns an invalid
+  /// index
+  template <DatabaseEntity Entity>
+  std::size_t shardOf(const PrimaryKeyType<Entity> &key) const {
+    static_assert(DatabaseEntityDescription<Entity>->idMode == IdMode::Manual,
+                  "Sharded entities need manual primary keys");
+    return this->shardOf(DatabaseEntityDescription<Entity>.value(), &key);
+  }
+
+  //---------------- Transactions ------------------//
+
+  /// Begins a transaction on the shard of the key, operations on keys of
+  /// the same shard are a part of it until it is committed or rolled back
+  template <DatabaseEntity Entity>
+  [[nodiscard]] Transaction begin(const PrimaryKeyType<Entity> &key) {
+    return this->shards[this->shardOf<Entity>(key)].begin();
+  }
+
+  //---------------- Settings ------------------//
+
+  /// Interrupts the running operations of every shard, can be called from
+  /// any thread
+  void interrupt() {
+    for (Database &shard : this->shards) {
+      shard.interrupt();
+    }
+  }
+
+  /// Reports statements of every shard to the observer
+  /// @param observer observer outliving the database, nullptr to stop
+  /// reporting
+  void setObserver(Observer *observer) {
+    for (Database &shard : this->shards) {
+      shard.setObserver(observer);
+    }
+  }
+
+  //---------------- Operations ------------------//
+
+  template <DatabaseEntity T> void createTable() {
+    for (Database &shard : this->shards) {
+      shard.createTable<T>();
+    }
+  }
+
+  template <DatabaseEntity T> bool exists() {
+    return std::ranges::any_of(
+        this->shards, [](Database &shard) { return shard.exists<T>(); });
+  }
+
+  template <DatabaseEntity Entity> void persist(Entity &entity) {
+    this->shardFor(entity).persist(entity);
+  }
+
+  /// Persists the entities of every shard in a transaction of that shard,
+  /// shards are written in parallel
+  template <std::ranges::forward_range Range>
+    requires DatabaseEntity<std::ranges::range_value_t<Range>> &&
+             std::is_same_v<std::ranges::range_reference_t<Range>,
+                            std::ranges::range_value_t<Range> &>
+  void persistMany(Range &&entities) {
+    this->forEachGroup(entities, [](Database &shard, auto group) {
+      shard.persistMany(group);
+    });
+  }
+
+  template <DatabaseEntity Entity>
+  std::optional<Entity> find(const PrimaryKeyType<Entity> &key) {
+    return this->shards[this->shardOf<Entity>(key)].template find<Entity>(key);
+  }
+
+  template <DatabaseEntity Entity>
+  void erase(const PrimaryKeyType<Entity> &key) {
+    this->shards[this->shardOf<Entity>(key)].template erase<Entity>(key);
+  }
+
+  /// Erases the entities matching the predicate in every shard
+  /// @returns number of erased entities
+  template <DatabaseEntity Entity>
+  std::uint64_t eraseWhere(const Predicate<Entity> &where) {
+    std::uint64_t erased = 0;
+    for (Database &shard : this->shards) {
+      erased += shard.eraseWhere<Entity>(where);
+    }
+    return erased;
+  }
+
+  /// Erases the entities with the given keys from their shards, missing keys
+  /// are ignored
+  /// @returns number of erased entities
+  template <DatabaseEntity Entity, std::ranges::input_range Range>
+    requires std::convertible_to<std::ranges::range_reference_t<Range>,
+                                 const PrimaryKeyType<Entity> &>
+  std::uint64_t eraseMany(Range &&keys) {
+    std::vector<std::vector<PrimaryKeyType<Entity>>> groups(
+        this->shards.size());
+    for (const PrimaryKeyType<Entity> &key : keys) {
+      groups[this->shardOf<Entity>(key)].push_back(key);
+    }
+
+    std::uint64_t erased = 0;
+    for (std::size_t shard = 0; shard < groups.size(); ++shard) {
+      if (!groups[shard].empty()) {
+        erased += this->shards[shard].eraseMany<Entity>(groups[shard]);
+      }
+    }
+    return erased;
+  }
+
+  /// Applies the assignments to the entities matching the predicate in
+  /// every shard
+  /// @returns number of updated entities
+  template <DatabaseEntity Entity, std::same_as<SetExpression<Entity>>... Sets>
+    requires(sizeof...(Sets) > 0)
+  std::uint64_t updateWhere(const Predicate<Entity> &where,
+                            const Sets &...sets) {
+    std::uint64_t updated = 0;
+    for (Database &shard : this->shards) {
+      updated += shard.updateWhere<Entity>(where, sets...);
+    }
+    return updated;
+  }
+
+  template <DatabaseEntity Entity> void update(const Entity &entity) {
+    this->shardFor(entity).update(entity);
+  }
+
+  /// Updates only the selected fields of the entity
+  template <DatabaseEntity Entity, FieldSelector... Fields>
+    requires(sizeof...(Fields) > 0)
+  void update(const Entity &entity, const Fields... fields) {
+    this->shardFor(entity).update(entity, fields...);
+  }
+
+  /// Updates only the fields that differ from the snapshot
+  template <DatabaseEntity Entity>
+  void update(const Entity &entity, const Entity &snapshot) {
+    this->shardFor(entity).update(entity, snapshot);
+  }
+
+  template <DatabaseEntity Entity> void upsert(const Entity &entity) {
+    this->shardFor(entity).upsert(entity);
+  }
+
+  /// Upserts the entities of every shard in a transaction of that shard,
+  /// shards are written in parallel
+  template <std::ranges::forward_range Range>
+    requires DatabaseEntity<std::ranges::range_value_t<Range>> &&
+             std::is_lvalue_reference_v<std::ranges::range_reference_t<Range>>
+  void upsertMany(Range &&entities) {
+    this->forEachGroup(entities, [](Database &shard, auto group) {
+      shard.upsertMany(group);
+    });
+  }
+
+  /// Atomically adds the delta to a numeric field without reading the entity
+  /// @returns new value of the field, or nullopt if the entity is not found
+  template <auto MemberPtr>
+    requires DatabaseField<MemberPtr>
+  std::optional<MemberType<MemberPtr>>
+  increment(const PrimaryKeyType<MemberClass<MemberPtr>> &key,
+            const MemberType<MemberPtr> &delta) {
+    return this->shards[this->shardOf<MemberClass<MemberPtr>>(key)]
+        .template increment<MemberPtr>(key, delta);
+  }
+
+  /// Atomically replaces the field value if it is equal to the expected one
+  /// @returns true if the value was replaced
+  template <auto MemberPtr>
+    requires DatabaseField<MemberPtr>
+  bool compareAndSet(const PrimaryKeyType<MemberClass<MemberPtr>> &key,
+                     const MemberType<MemberPtr> &expected,
+                     const MemberType<MemberPtr> &desired) {
+    return this->shards[this->shardOf<MemberClass<MemberPtr>>(key)]
+        .template compareAndSet<MemberPtr>(key, expected, desired);
+  }
+
+  /// Iterates over the entities of every shard, shard after shard
+  template <DatabaseEntity Entity> ShardedCursor<Entity> iterate() {
+    std::vector<Cursor<Entity>> cursors;
+    cursors.reserve(this->shards.size());
+    for (Database &shard : this->shards) {
+      cursors.push_back(shard.iterate<Entity>());
+    }
+    return ShardedCursor<Entity>{std::move(cursors)};
+  }
+
+  /// Calls the function for every entity of every shard, shards are scanned
+  /// by several threads at once in no particular order
+  /// @param function called as function(Entity)
+  /// @param threads number of threads, hardware concurrency if 0
+  template <DatabaseEntity Entity, typename Function>
+    requires std::invocable<Function &, Entity>
+  void parallelForEach(Function function, const std::size_t threads = 0) {
+    parallelFor(this->shards.size(), this->workers(threads),
+                [this, &function](std::size_t /*worker*/,
+                                  const std::size_t shard) {
+                  for (Entity entity : this->shards[shard].iterate<Entity>()) {
+                    std::invoke(function, std::move(entity));
+                  }
+                });
+  }
+
+  /// Same as parallelForEach, but every thread accumulates into its own
+  /// copy of the initial value, the copies are merged at the end. The
+  /// initial value should thus be neutral, e.g. 0 for sums
+  /// @param accumulate called as accumulate(Result &, Entity)
+  /// @param merge called as merge(Result &, Result &&)
+  template <DatabaseEntity Entity, typename Result, typename Accumulate,
+            typename Merge>
+    requires std::invocable<Accumulate &, Result &, Entity> &&
+             std::invocable<Merge &, Result &, Result &&>
+  Result parallelReduce(const Result &init, Accumulate accumulate, Merge merge,
+                        const std::size_t threads = 0) {
+    std::vector<Result> results(this->workers(threads), init);
+    parallelFor(this->shards.size(), results.size(),
+                [this, &accumulate, &results](const std::size_t worker,
+                                              const std::size_t shard) {
+                  for (Entity entity : this->shards[shard].iterate<Entity>()) {
+                    std::invoke(accumulate, results[worker],
+                                std::move(entity));
+                  }
+                });
+
+    Result result = std::move(results.front());
+    for (std::size_t i = 1; i < results.size(); ++i) {
+      std::invoke(merge, result, std::move(results[i]));
+    }
+    return result;
+  }
+
+  /// Counts the entities matching the predicate in every shard
+  template <DatabaseEntity Entity>
+  std::uint64_t count(const Predicate<Entity> &where = {}) {
+    std::uint64_t count = 0;
+    for (Database &shard : this->shards) {
+      count += shard.count<Entity>(where);
+    }
+    return count;
+  }
+
+  /// Sums the field over the entities matching the predicate in every shard
+  template <auto MemberPtr>
+    requires NumericField<MemberPtr>
+  MemberType<MemberPtr>
+  sum(const Predicate<MemberClass<MemberPtr>> &where = {}) {
+    return this->aggregate(Sum<MemberPtr>, where)
+        .value_or(MemberType<MemberPtr>{});
+  }
+
+  /// @returns minimum of the field in every shard, or nullopt if no entities
+  /// match
+  template <auto MemberPtr>
+    requires PrimitiveField<MemberPtr>
+  std::optional<MemberType<MemberPtr>>
+  min(const Predicate<MemberClass<MemberPtr>> &where = {}) {
+    return this->aggregate(Min<MemberPtr>, where);
+  }
+
+  /// @returns maximum of the field in every shard, or nullopt if no entities
+  /// match
+  template <auto MemberPtr>
+    requires PrimitiveField<MemberPtr>
+  std::optional<MemberType<MemberPtr>>
+  max(const Predicate<MemberClass<MemberPtr>> &where = {}) {
+    return this->aggregate(Max<MemberPtr>, where);
+  }
+
+  /// Computes the aggregate in every shard and combines the shard values
+  /// @returns aggregate value, or nullopt if no entities match
+  template <DatabaseEntity Entity, typename Result>
+  std::optional<Result> aggregate(const Aggregate<Entity, Result> &aggregate,
+                                  const Predicate<Entity> &where = {}) {
+    std::optional<Result> result;
+    for (Database &shard : this->shards) {
+      std::optional<Result> value = shard.aggregate(aggregate, where);
+      if (!value.has_value()) {
+        continue;
+      }
+
+      if (result.has_value()) {
+        combine(aggregate.description.function, *result, std::move(*value));
+      } else {
+        result = std::move(value);
+      }
+    }
+    return result;
+  }
+
+  /// Computes the aggregate for each distinct value of the key field in
+  /// every shard, groups of the same key are combined
+  /// @returns (key, aggregate value) pairs ordered by the key
+  template <auto KeyPtr, typename Result>
+    requires PrimitiveField<KeyPtr>
+  std::vector<std::pair<MemberType<KeyPtr>, Result>>
+  groupBy(const Aggregate<MemberClass<KeyPtr>, Result> &aggregate,
+          const Predicate<MemberClass<KeyPtr>> &where = {}) {
+    std::map<MemberType<KeyPtr>, Result> groups;
+    for (Database &shard : this->shards) {
+      for (auto &[key, value] : shard.groupBy<KeyPtr>(aggregate, where)) {
+        const auto [group, inserted] = groups.try_emplace(key, value);
+        if (!inserted) {
+          combine(aggregate.description.function, group->second,
+                  std::move(value));
+        }
+      }
+    }
+
+    return {groups.begin(), groups.end()};
+  }
+
+  /// Scans entities of every shard in a stable order, by default ordered by
+  /// the primary key
+  template <DatabaseEntity Entity> ShardedScan<Entity> scan() {
+    std::vector<Scan<Entity>> scans;
+    scans.reserve(this->shards.size());
+    for (Database &shard : this->shards) {
+      scans.push_back(shard.scan<Entity>());
+    }
+    return ShardedScan<Entity>{std::move(scans)};
+  }
+
+private:
+  using ShardFunction = std::function<std::size_t(const void *key)>;
+
+  std::vector<Database> shards;
+
+  /// Shard functions by entity name
+  std::unordered_map<std::string_view, ShardFunction> shardFunctions;
+
+  std::size_t shardOf(const EntityDescription &entity, const void *key) const;
+
+  template <DatabaseEntity Entity>
+  std::size_t shardOfEntity(const Entity &entity) const {
+    const EntityDescription &description =
+        DatabaseEntityDescription<Entity>.value();
+    return this->shardOf<Entity>(*static_cast<const PrimaryKeyType<Entity> *>(
+        description.fields[description.primaryKey].constMemberPtr(&entity)));
+  }
+
+  template <DatabaseEntity Entity> Database &shardFor(const Entity &entity) {
+    return this->shards[this->shardOfEntity(entity)];
+  }
+
+  /// Combines the aggregate value of a shard into the value of the others
+  template <typename Result>
+  static void combine(const AggregateFunction function, Result &result,
+                      Result &&other) {
+    switch (function) {
+    case AggregateFunction::Count:
+    case AggregateFunction::Sum:
+      if constexpr (requires { result += other; }) {
+        result += other;
+      }
+      break;
+    case AggregateFunction::Min:
+      if (other < result) {
+        result = std::move(other);
+      }
+      break;
+    case AggregateFunction::Max:
+      if (result < other) {
+        result = std::move(other);
+      }
+      break;
+    }
+  }
+
+  std::size_t workers(const std::size_t threads) const {
+    return std::min(workerCount(threads), this->shards.size());
+  }
+
+  /// Splits the entities by shard and writes every group in parallel
+  /// @param write called as write(Database &, group) where group is a range
+  /// of entity references
+  template <typename Range, typename Write>
+  void forEachGroup(Range &entities, Write write) {
+    using Reference = std::ranges::range_reference_t<Range>;
+    using Pointer = std::add_pointer_t<Reference>;
+
+    std::vector<std::vector<Pointer>> groups(this->shards.size());
+    for (Reference entity : entities) {
+      groups[this->shardOfEntity(entity)].push_back(&entity);
+    }
+
+    parallelFor(groups.size(), this->workers(0),
+                [this, &groups, &write](std::size_t /*worker*/,
+                                        const std::size_t shard) {
+                  if (groups[shard].empty()) {
+                    return;
+                  }
+                  write(this->shards[shard],
+                        groups[shard] |
+                            std::views::transform(
+                                [](const Pointer entity) -> Reference {
+                                  return *entity;
+                                }));
+                });
+  }
+};
+
+} // namespace podrm::sqlite
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <podrm/metadata.hpp>
+#include <podrm/sqlite/scan.hpp>
+#include <podrm/sqlite/sharded_cursor.hpp>
+
+#include <concepts>
+#include <cstdint>
+#include <optional>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace podrm::sqlite {
+
+/// Range over the entities of every shard ordered by a field and then by the
+/// primary key, continuing after the last seen entity (keyset pagination).
+/// Every shard is scanned in the same order and the scans are merged
+template <DatabaseEntity Entity> class ShardedScan {
+public:
+  /// Orders entities by the field, ties are ordered by the primary key. The
+  /// field should be indexed to avoid sorting the whole tables
+  template <auto MemberPtr>
+    requires DatabaseField<MemberPtr> &&
+             std::same_as<MemberClass<MemberPtr>, Entity>
+  ShardedScan &orderBy() & {
+    for (Scan<Entity> &scan : this->scans) {
+      scan.template orderBy<MemberPtr>();
+    }
+    this->less = &ShardedScan::byField<MemberPtr>;
+    return *this;
+  }
+
+  template <auto MemberPtr>
+    requires DatabaseField<MemberPtr> &&
+             std::same_as<MemberClass<MemberPtr>, Entity>
+  ShardedScan orderBy() && {
+    this->orderBy<MemberPtr>();
+    return std::move(*this);
+  }
+
+  /// Continues after the entity with the given key, only for scans ordered by
+  /// the primary key
+  ShardedScan &after(const PrimaryKeyType<Entity> &key) & {
+    for (Scan<Entity> &scan : this->scans) {
+      scan.after(key);
+    }
+    return *this;
+  }
+
+  ShardedScan after(const PrimaryKeyType<Entity> &key) && {
+    this->after(key);
+    return std::move(*this);
+  }
+
+  /// Continues after the given entity
+  ShardedScan &after(const Entity &entity) & {
+    for (Scan<Entity> &scan : this->scans) {
+      scan.after(entity);
+    }
+    return *this;
+  }
+
+  ShardedScan after(const Entity &entity) && {
+    this->after(entity);
+    return std::move(*this);
+  }
+
+  /// Limits the number of entities returned by the scan, every shard returns
+  /// at most as many
+  ShardedScan &limit(const std::int64_t count) & {
+    for (Scan<Entity> &scan : this->scans) {
+      scan.limit(count);
+    }
+    this->count = count;
+    return *this;
+  }
+
+  ShardedScan limit(const std::int64_t count) && {
+    this->limit(count);
+    return std::move(*this);
+  }
+
+  /// Executes the scans, the scan must outlive the iteration
+  typename detail::ShardMerge<Entity>::Iterator begin() {
+    this->merge.emplace(this->less, this->count);
+    for (Scan<Entity> &scan : this->scans) {
+      this->merge->add(scan.begin());
+    }
+    return this->merge->begin();
+  }
+
+  typename detail::ShardMerge<Entity>::Sentinel end() { return {}; }
+
+private:
+  static constexpr EntityDescription Description =
+      DatabaseEntityDescription<Entity>.value();
+
+  std::vector<Scan<Entity>> scans;
+
+  typename detail::ShardMerge<Entity>::Less less = &ShardedScan::byKey;
+
+  std::int64_t count = -1;
+
+  std::optional<detail::ShardMerge<Entity>> merge;
+
+  explicit ShardedScan(std::vector<Scan<Entity>> scans)
+      : scans(std::move(scans)) {}
+
+  static const PrimaryKeyType<Entity> &key(const Entity &entity) {
+    return *static_cast<const PrimaryKeyType<Entity> *>(
+        Description.fields[Description.primaryKey].constMemberPtr(&entity));
+  }
+
+  static bool byKey(const Entity &lhs, const Entity &rhs) {
+    return key(lhs) < key(rhs);
+  }
+
+  template <auto MemberPtr>
+  static bool byField(const Entity &lhs, const Entity &rhs) {
+    return std::forward_as_tuple(lhs.*MemberPtr, key(lhs)) <
+           std::forward_as_tuple(rhs.*MemberPtr, key(rhs));
+  }
+
+  friend class ShardedDatabase;
+};
+
+} // namespace podrm::sqlite
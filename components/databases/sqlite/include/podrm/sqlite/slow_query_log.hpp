@@ -0,0 +1,57 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace podrm::sqlite {
+
+/// Statement that ran longer than the slow query log threshold
+struct SlowQuery {
+  /// Entity and operation that ran the statement, empty if the statement
+  /// finished outside of an operation, e.g. while iterating a cursor
+  std::string_view entity;
+  std::string_view operation;
+
+  /// Statement text with the bound parameters substituted
+  std::string statement;
+
+  /// SQLite storage classes of the bound parameters
+  std::vector<std::string_view> parameterTypes;
+
+  /// Running time measured by SQLite, with millisecond resolution on most
+  /// platforms
+  std::chrono::nanoseconds elapsed;
+
+  /// Lines of EXPLAIN QUERY PLAN, indented by two spaces per level
+  std::vector<std::string> plan;
+
+  /// Whether the plan scans a table without using an index
+  bool fullScan;
+};
+
+/// Reports statements running longer than the threshold, together with
+/// their query plans
+struct SlowQueryLog {
+  std::chrono::nanoseconds threshold = std::chrono::milliseconds{100};
+
+  /// Called once the statement is done, from a thread that uses the
+  /// database, must not use the database
+  std::function<void(const SlowQuery &)> callback;
+
+  /// Appends slow queries to the file, which may be shared by several
+  /// databases
+  /// @throws std::runtime_error if the file cannot be opened
+  static SlowQueryLog toFile(const std::filesystem::path &path,
+                             std::chrono::nanoseconds threshold =
+                                 std::chrono::milliseconds{100});
+};
+
+/// Writes the slow query as several lines of text
+std::ostream &operator<<(std::ostream &stream, const SlowQuery &query);
+
+} // namespace podrm::sqlite
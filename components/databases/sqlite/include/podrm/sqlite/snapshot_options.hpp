@@ -0,0 +1,22 @@
+#pragma once
+
+#include <chrono>
+
+namespace podrm::sqlite {
+
+/// Throttling of a snapshot written with the online backup API. The source
+/// database is only locked while a step copies its pages, so other
+/// operations run between the steps
+struct SnapshotOptions {
+  /// Pages copied per step, negative to copy everything in one step
+  int pagesPerStep = 256;
+
+  /// Time to sleep between the steps
+  std::chrono::milliseconds pause{0};
+
+  /// Time to retry while either database is locked, e.g. by a reader of the
+  /// file, before the snapshot fails
+  std::chrono::milliseconds busyTimeout{5000};
+};
+
+} // namespace podrm::sqlite
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <podrm/sqlite/detail/connection.hpp>
+
+#include <cstdint>
+#include <utility>
+
+namespace podrm::sqlite {
+
+/// Delivers change events to its callback until destroyed, it must not
+/// outlive the database. Destruction waits for the calls of its callback
+/// running in other threads
+class Subscription {
+public:
+  Subscription(const Subscription &) = delete;
+  Subscription(Subscription &&other) noexcept
+      : connection(std::exchange(other.connection, nullptr)), id(other.id) {}
+  Subscription &operator=(const Subscription &) = delete;
+  Subscription &operator=(Subscription &&) = delete;
+
+  ~Subscription() {
+    if (this->connection != nullptr) {
+      this->connection->unsubscribe(this->id);
+    }
+  }
+
+private:
+  detail::Connection *connection;
+
+  std::uint64_t id;
+
+  Subscription(detail::Connection &connection, const std::uint64_t id)
+      : connection(&connection), id(id) {}
+
+  friend class Database;
+};
+
+} // namespace podrm::sqlite
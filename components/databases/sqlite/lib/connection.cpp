@@ -1,15 +1,36 @@
+#include "error.hpp"
+#include "slow_query_trace.hpp"
+
+#include <podrm/aggregate.hpp>
+#include <podrm/cancellation.hpp>
+#include <podrm/instrumentation.hpp>
 #include <podrm/metadata.hpp>
 #include <podrm/multilambda.hpp>
+#include <podrm/observation.hpp>
+#include <podrm/parallel.hpp>
+#include <podrm/predicate.hpp>
 #include <podrm/span.hpp>
+#include <podrm/sqlite/conflict_policy.hpp>
+#include <podrm/sqlite/connection_options.hpp>
 #include <podrm/sqlite/detail/connection.hpp>
 #include <podrm/sqlite/detail/cursor.hpp>
 #include <podrm/sqlite/detail/result.hpp>
 #include <podrm/sqlite/detail/row.hpp>
+#include <podrm/sqlite/slow_query_log.hpp>
+#include <podrm/sqlite/snapshot_options.hpp>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <cassert>
+#include <cctype>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <filesystem>
+#include <functional>
+#include <iterator>
 #include <limits>
 #include <memory>
 #include <mutex>
@@ -17,6 +38,8 @@
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <thread>
+#include <type_traits>
 #include <utility>
 #include <variant>
 #include <vector>
@@ -29,6 +52,15 @@ namespace podrm::sqlite::detail {
 
 namespace {
 
+/// Maximum number of keys bound to a single statement, key lists are padded
+/// to powers of two up to it so that few statements are cached
+constexpr std::size_t MaxBoundKeys = 512;
+
+using podrm::detail::notify;
+using podrm::detail::observe;
+using podrm::detail::OperationScope;
+using podrm::detail::Stopwatch;
+
 using Statement =
     std::unique_ptr<sqlite3_stmt, decltype([](sqlite3_stmt *statement) {
                       sqlite3_finalize(statement);
@@ -47,30 +79,30 @@ Statement createStatement(sqlite3 &connection,
   return Statement{stmt};
 }
 
-void bindArg(const Statement &statement, const int pos, const AsImage &value) {
-  const auto bindInt = [&statement, pos](const std::int64_t value) {
-    sqlite3_bind_int64(statement.get(), pos + 1, value);
+void bindArg(sqlite3_stmt *const statement, const int pos,
+             const AsImage &value) {
+  const auto bindInt = [statement, pos](const std::int64_t value) {
+    sqlite3_bind_int64(statement, pos + 1, value);
   };
-  const auto bindUInt = [&statement, pos](const std::uint64_t value) {
+  const auto bindUInt = [statement, pos](const std::uint64_t value) {
     if (value > std::numeric_limits<std::int64_t>::max()) {
       throw std::invalid_argument{"Unsigned integer too big"};
     }
-    sqlite3_bind_int64(statement.get(), pos + 1,
-                       static_cast<std::int64_t>(value));
+    sqlite3_bind_int64(statement, pos + 1, static_cast<std::int64_t>(value));
   };
-  const auto bindBlob = [&statement, pos](const span<const std::byte> blob) {
-    sqlite3_bind_blob64(statement.get(), pos, blob.data(), blob.size(),
+  const auto bindBlob = [statement, pos](const span<const std::byte> blob) {
+    sqlite3_bind_blob64(statement, pos, blob.data(), blob.size(),
                         SQLITE_STATIC);
   };
-  const auto bindDouble = [&statement, pos](const double value) {
-    sqlite3_bind_double(statement.get(), pos + 1, value);
+  const auto bindDouble = [statement, pos](const double value) {
+    sqlite3_bind_double(statement, pos + 1, value);
   };
-  const auto bindText = [&statement, pos](const std::string_view text) {
-    sqlite3_bind_text64(statement.get(), pos + 1, text.data(), text.size(),
+  const auto bindText = [statement, pos](const std::string_view text) {
+    sqlite3_bind_text64(statement, pos + 1, text.data(), text.size(),
                         SQLITE_STATIC, SQLITE_UTF8);
   };
-  const auto bindBool = [&statement, pos](const bool value) {
-    sqlite3_bind_int(statement.get(), pos + 1, value ? 1 : 0);
+  const auto bindBool = [statement, pos](const bool value) {
+    sqlite3_bind_int(statement, pos + 1, value ? 1 : 0);
   };
 
   std::visit(podrm::detail::MultiLambda{bindBlob, bindDouble, bindText, bindInt,
@@ -78,6 +110,75 @@ void bindArg(const Statement &statement, const int pos, const AsImage &value) {
              value);
 }
 
+/// @returns copies of the arguments owning their strings and blobs, which
+/// are bound without copying and must outlive the statement steps
+std::vector<AsImage> ownArguments(const span<const AsImage> args) {
+  std::vector<AsImage> owned;
+  owned.reserve(args.size());
+  for (const AsImage &arg : args) {
+    owned.push_back(std::visit(
+        podrm::detail::MultiLambda{
+            [](const span<const std::byte> blob) -> AsImage {
+              return std::vector<std::byte>{blob.begin(), blob.end()};
+            },
+            [](const std::string_view text) -> AsImage {
+              return std::string{text};
+            },
+            [](const auto &value) -> AsImage { return value; },
+        },
+        arg));
+  }
+  return owned;
+}
+
+/// @returns SQLite storage class of the bound value
+std::string_view storageClass(const AsImage &value) {
+  return std::visit(
+      [](const auto &value) -> std::string_view {
+        using Image = std::decay_t<decltype(value)>;
+        if constexpr (std::is_same_v<Image, span<const std::byte>> ||
+                      std::is_same_v<Image, std::vector<std::byte>>) {
+          return "BLOB";
+        } else if constexpr (std::is_same_v<Image, std::string_view> ||
+                             std::is_same_v<Image, std::string>) {
+          return "TEXT";
+        } else if constexpr (std::is_same_v<Image, double>) {
+          return "REAL";
+        } else {
+          return "INTEGER";
+        }
+      },
+      value);
+}
+
+/// Reports the queued slow statements once it goes out of scope, after the
+/// error of a failed statement is read
+class SlowQueryReport {
+public:
+  explicit SlowQueryReport(SlowQueryTrace *const trace) : trace(trace) {}
+
+  SlowQueryReport(const SlowQueryReport &) = delete;
+  SlowQueryReport(SlowQueryReport &&) = delete;
+  SlowQueryReport &operator=(const SlowQueryReport &) = delete;
+  SlowQueryReport &operator=(SlowQueryReport &&) = delete;
+
+  ~SlowQueryReport() {
+    if (this->trace != nullptr) {
+      this->trace->report();
+    }
+  }
+
+private:
+  SlowQueryTrace *trace;
+};
+
+/// @returns number of rows changed by the statement, the connection keeps
+/// the count of the last data modifying statement
+std::uint64_t changedRows(sqlite3_stmt &statement,
+                          const std::uint64_t changes) {
+  return sqlite3_stmt_readonly(&statement) != 0 ? 0 : changes;
+}
+
 std::string_view toString(const ImageType type) {
   switch (type) {
   case ImageType::Bool:
@@ -231,192 +332,1886 @@ std::vector<AsImage> intoArgs(const FieldDescription description,
       description.field);
 }
 
-} // namespace
+bool sameImage(const AsImage &lhs, const AsImage &rhs) {
+  if (lhs.index() != rhs.index()) {
+    return false;
+  }
 
-Connection::Connection(sqlite3 &connection)
-    : connection(&connection, &sqlite3_close_v2) {
-  this->execute("PRAGMA foreign_keys = ON");
+  return std::visit(
+      [&rhs](const auto &value) {
+        using Image = std::decay_t<decltype(value)>;
+        const Image &other = std::get<Image>(rhs);
+        if constexpr (std::is_same_v<Image, span<const std::byte>>) {
+          return std::equal(value.begin(), value.end(), other.begin(),
+                            other.end());
+        } else {
+          return value == other;
+        }
+      },
+      lhs);
 }
 
-Connection Connection::fromRaw(sqlite3 &connection) {
-  return Connection{connection};
+bool sameField(const FieldDescription &description, const void *lhs,
+               const void *rhs) {
+  const std::vector<AsImage> lhsImages = intoArgs(description, lhs);
+  const std::vector<AsImage> rhsImages = intoArgs(description, rhs);
+
+  return std::equal(lhsImages.begin(), lhsImages.end(), rhsImages.begin(),
+                    rhsImages.end(), sameImage);
 }
 
-Connection Connection::inMemory(const char *const name) {
-  sqlite3 *connection = nullptr;
-  const int result = sqlite3_open_v2(
-      name, &connection,
-      SQLITE_OPEN_MEMORY | SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr);
-  if (result != SQLITE_OK) {
-    throw std::runtime_error{sqlite3_errstr(result)};
+void checkMaskable(const EntityDescription &description) {
+  if (description.fields.size() > MaxMaskedFields) {
+    throw std::invalid_argument{
+        fmt::format("Entity {} has too many fields for a partial update",
+                    description.name),
+    };
   }
-
-  return Connection{*connection};
 }
 
-Connection Connection::inFile(const std::filesystem::path &path) {
-  sqlite3 *connection = nullptr;
-  const int result =
-      sqlite3_open_v2(path.string().c_str(), &connection,
-                      SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr);
-  if (result != SQLITE_OK) {
-    throw std::runtime_error{sqlite3_errstr(result)};
+std::string createPartialUpdate(const EntityDescription &description,
+                                const FieldMask fields) {
+  fmt::memory_buffer buf;
+  fmt::appender appender{buf};
+
+  fmt::format_to(appender, "UPDATE '{}' SET ", description.name);
+
+  bool first = true;
+  for (std::size_t i = 0; i < description.fields.size(); ++i) {
+    if ((fields & (FieldMask{1} << i)) != 0) {
+      createUpdateParamPlaceholders(description.fields[i], appender, {}, first);
+    }
   }
 
-  return Connection{*connection};
+  fmt::format_to(appender, " WHERE {} = ?",
+                 description.fields[description.primaryKey].name);
+
+  return fmt::to_string(buf);
 }
 
-std::uint64_t Connection::execute(const std::string_view statement,
-                                  const span<const AsImage> args) {
-  const std::unique_lock lock{*this->mutex};
+const PrimitiveFieldDescription &
+getPrimitiveField(const EntityDescription &description,
+                  const std::size_t field) {
+  const auto *primitive =
+      std::get_if<PrimitiveFieldDescription>(&description.fields[field].field);
+  if (primitive == nullptr) {
+    throw std::invalid_argument{
+        fmt::format("Field {}.{} is not primitive", description.name,
+                    description.fields[field].name),
+    };
+  }
 
-  const Statement stmt = createStatement(*this->connection, statement);
+  return *primitive;
+}
 
-  for (int i = 0; i < args.size(); ++i) {
-    bindArg(stmt, i, args[i]);
+void checkAutoId(const EntityDescription &description) {
+  const PrimitiveFieldDescription &primaryKey =
+      getPrimitiveField(description, description.primaryKey);
+  if (primaryKey.imageType != ImageType::Int &&
+      primaryKey.imageType != ImageType::Uint) {
+    throw std::invalid_argument{
+        fmt::format("Entity {} has automatic ids, but its primary key is not "
+                    "an integer",
+                    description.name),
+    };
   }
+}
 
-  const int executeResult = sqlite3_step(stmt.get());
-  if (executeResult != SQLITE_DONE) {
-    throw std::runtime_error{sqlite3_errmsg(this->connection.get())};
+void setGeneratedKey(const EntityDescription &description, void *entity,
+                     const std::int64_t key) {
+  const FieldDescription &field = description.fields[description.primaryKey];
+  const PrimitiveFieldDescription &primaryKey =
+      getPrimitiveField(description, description.primaryKey);
+
+  if (primaryKey.imageType == ImageType::Uint) {
+    primaryKey.fromImage(static_cast<std::uint64_t>(key),
+                         field.memberPtr(entity));
+  } else {
+    primaryKey.fromImage(key, field.memberPtr(entity));
   }
+}
 
-  return sqlite3_changes64(this->connection.get());
+/// @returns description of the field as a standalone value
+FieldDescription asValue(const FieldDescription &field) {
+  return FieldDescription{
+      .name = field.name,
+      .memberPtr = [](void *value) { return value; },
+      .constMemberPtr = [](const void *value) { return value; },
+      .field = field.field,
+  };
 }
 
-Result Connection::query(const std::string_view statement,
-                         const span<const AsImage> args) {
-  const std::unique_lock lock{*this->mutex};
+std::string_view toString(const Comparison comparison) {
+  switch (comparison) {
+  case Comparison::Equal:
+    return "=";
+  case Comparison::NotEqual:
+    return "<>";
+  case Comparison::Less:
+    return "<";
+  case Comparison::LessOrEqual:
+    return "<=";
+  case Comparison::Greater:
+    return ">";
+  case Comparison::GreaterOrEqual:
+    return ">=";
+  }
 
-  Statement stmt = createStatement(*this->connection, statement);
+  assert(false);
+  return "";
+}
 
-  for (int i = 0; i < args.size(); ++i) {
-    bindArg(stmt, i, args[i]);
+/// Appends the WHERE clause and collects the compared values into args
+void formatWhere(const EntityDescription &description,
+                 const span<const Condition> where, fmt::appender appender,
+                 std::vector<AsImage> &args) {
+  bool first = true;
+  for (const Condition &condition : where) {
+    getPrimitiveField(description, condition.field);
+
+    fmt::format_to(appender, R"({}"{}" {} ?)", first ? " WHERE " : " AND ",
+                   description.fields[condition.field].name,
+                   toString(condition.comparison));
+    args.push_back(condition.value);
+    first = false;
+  }
+}
+
+std::string formatAggregate(const EntityDescription &description,
+                            const AggregateDescription &aggregate) {
+  if (aggregate.function == AggregateFunction::Count) {
+    return "COUNT(*)";
+  }
+
+  getPrimitiveField(description, aggregate.field);
+
+  const std::string_view name = description.fields[aggregate.field].name;
+  switch (aggregate.function) {
+  case AggregateFunction::Count:
+    break;
+  case AggregateFunction::Sum:
+    return fmt::format(R"(SUM("{}"))", name);
+  case AggregateFunction::Min:
+    return fmt::format(R"(MIN("{}"))", name);
+  case AggregateFunction::Max:
+    return fmt::format(R"(MAX("{}"))", name);
   }
 
-  return Result{{stmt.release(), &sqlite3_finalize}};
+  assert(false);
+  return "";
 }
 
-void Connection::createTable(const EntityDescription &entity) {
-  this->execute(fmt::format("DROP TABLE IF EXISTS '{}'", entity.name));
+void collectColumns(const FieldDescription &description,
+                    std::vector<std::string_view> prefixes,
+                    std::vector<std::string> &columns) {
+  prefixes.push_back(description.name);
 
-  fmt::memory_buffer buf;
-  fmt::appender appender{buf};
-  fmt::format_to(appender, "CREATE TABLE '{}' (", entity.name);
+  const auto collectPrimitive =
+      [&prefixes, &columns](const PrimitiveFieldDescription &) {
+        columns.emplace_back(fmt::to_string(fmt::join(prefixes, "_")));
+      };
 
-  bool first = true;
-  for (std::size_t i = 0; i < entity.fields.size(); ++i) {
-    createFields(entity.fields[i], entity.primaryKey == i, appender, {}, first);
+  const auto collectComposite =
+      [&prefixes, &columns](const CompositeFieldDescription &descr) {
+        for (const FieldDescription &field : descr.fields) {
+          collectColumns(field, prefixes, columns);
+        }
+      };
+
+  std::visit(podrm::detail::MultiLambda{collectPrimitive, collectComposite},
+             description.field);
+}
+
+std::string createInsert(const EntityDescription &description) {
+  std::vector<std::string> columns;
+  for (std::size_t i = 0; i < description.fields.size(); ++i) {
+    if (description.idMode != IdMode::Auto || i != description.primaryKey) {
+      collectColumns(description.fields[i], {}, columns);
+    }
   }
 
-  for (const FieldDescription &field : entity.fields) {
-    createConstraints(field, appender, {});
+  if (columns.empty()) {
+    return fmt::format("INSERT INTO '{}' DEFAULT VALUES", description.name);
   }
 
+  fmt::memory_buffer buf;
+  fmt::appender appender{buf};
+
+  fmt::format_to(appender, R"(INSERT INTO '{}' ("{}") VALUES ()",
+                 description.name, fmt::join(columns, R"(",")"));
+  for (std::size_t i = 0; i < columns.size(); ++i) {
+    fmt::format_to(appender, "{}?", i == 0 ? "" : ",");
+  }
   fmt::format_to(appender, ")");
-  this->execute(fmt::to_string(buf));
-}
 
-bool Connection::exists(const EntityDescription &entity) {
-  const Result result = this->query(
-      fmt::format("SELECT EXISTS(SELECT 1 FROM '{}')", entity.name));
-  // NOLINTNEXTLINE(bugprone-unchecked-optional-access): fixed query
-  return result.getRow().value().get(0).boolean();
+  return fmt::to_string(buf);
 }
 
-void Connection::persist(const EntityDescription &description, void *entity) {
+std::string createUpsert(const EntityDescription &description) {
   fmt::memory_buffer buf;
   fmt::appender appender{buf};
 
   fmt::format_to(appender, "INSERT INTO '{}' VALUES (", description.name);
 
   bool first = true;
-  std::vector<AsImage> values;
+  for (const FieldDescription &field : description.fields) {
+    createPersistParamPlaceholders(field, appender, first);
+  }
+
+  fmt::format_to(appender, R"() ON CONFLICT("{}") DO )",
+                 description.fields[description.primaryKey].name);
+
+  std::vector<std::string> columns;
   for (std::size_t i = 0; i < description.fields.size(); ++i) {
-    if (description.idMode == IdMode::Auto && i == description.primaryKey) {
-      // TODO: support auto ids
+    if (i != description.primaryKey) {
+      collectColumns(description.fields[i], {}, columns);
     }
-    createPersistParamPlaceholders(description.fields[i], appender, first);
+  }
 
-    for (AsImage &value :
-         intoArgs(description.fields[i],
-                  description.fields[i].constMemberPtr(entity))) {
-      values.emplace_back(std::move(value));
-    }
+  if (columns.empty()) {
+    fmt::format_to(appender, "NOTHING");
+    return fmt::to_string(buf);
+  }
+
+  fmt::format_to(appender, "UPDATE SET ");
+  first = true;
+  for (const std::string &column : columns) {
+    fmt::format_to(appender, R"({}"{}"=excluded."{}")", first ? "" : ",",
+                   column, column);
+    first = false;
   }
-  fmt::format_to(appender, ")");
 
-  this->execute(fmt::to_string(buf), values);
+  return fmt::to_string(buf);
 }
 
-bool Connection::find(const EntityDescription &description, const AsImage &key,
-                      void *result) {
-  const std::string queryStr =
-      fmt::format("SELECT * FROM '{}' WHERE {} = ?", description.name,
-                  description.fields[description.primaryKey].name);
+std::string_view toString(const JournalMode mode) {
+  switch (mode) {
+  case JournalMode::Delete:
+    return "DELETE";
+  case JournalMode::Truncate:
+    return "TRUNCATE";
+  case JournalMode::Persist:
+    return "PERSIST";
+  case JournalMode::Memory:
+    return "MEMORY";
+  case JournalMode::Wal:
+    return "WAL";
+  case JournalMode::Off:
+    return "OFF";
+  }
+  throw std::invalid_argument{"Unsupported journal mode"};
+}
 
-  const Cursor cursor = Cursor{
-      this->query(queryStr, podrm::span<const AsImage, 1>{&key, 1}),
-      description.fields,
-  };
+std::string_view toString(const Synchronous synchronous) {
+  switch (synchronous) {
+  case Synchronous::Off:
+    return "OFF";
+  case Synchronous::Normal:
+    return "NORMAL";
+  case Synchronous::Full:
+    return "FULL";
+  case Synchronous::Extra:
+    return "EXTRA";
+  }
+  throw std::invalid_argument{"Unsupported synchronous mode"};
+}
 
-  return cursor.extract(result);
+std::string_view toString(const TempStore store) {
+  switch (store) {
+  case TempStore::Default:
+    return "DEFAULT";
+  case TempStore::File:
+    return "FILE";
+  case TempStore::Memory:
+    return "MEMORY";
+  }
+  throw std::invalid_argument{"Unsupported temp store"};
 }
 
-void Connection::erase(const EntityDescription description,
-                       const AsImage &key) {
-  const std::string queryStr =
-      fmt::format("DELETE FROM '{}' WHERE {} = ?", description.name,
-                  description.fields[description.primaryKey].name);
+std::string_view toString(const LockingMode mode) {
+  switch (mode) {
+  case LockingMode::Normal:
+    return "NORMAL";
+  case LockingMode::Exclusive:
+    return "EXCLUSIVE";
+  }
+  throw std::invalid_argument{"Unsupported locking mode"};
+}
 
-  const std::uint64_t changes =
-      this->execute(queryStr, podrm::span<const AsImage, 1>{&key, 1});
-  if (changes == 0) {
-    throw std::runtime_error("Entity with the given key is not found");
+/// Runs the pragma, ignoring the rows some pragmas return
+void runPragma(sqlite3 &connection, const std::string &statement) {
+  char *error = nullptr;
+  if (sqlite3_exec(&connection, statement.c_str(), nullptr, nullptr, &error) !=
+      SQLITE_OK) {
+    const std::runtime_error exception{error};
+    sqlite3_free(error);
+    throw exception;
   }
 }
 
-void Connection::update(const EntityDescription description,
-                        const void *entity) {
-  fmt::memory_buffer buf;
-  fmt::appender appender{buf};
+/// @returns first column of the first row returned by the pragma
+std::string queryPragma(sqlite3 &connection, const std::string &statement) {
+  const Statement stmt = createStatement(connection, statement);
+  const int result = sqlite3_step(stmt.get());
+  if (result != SQLITE_ROW) {
+    throwError(connection, result);
+  }
 
-  fmt::format_to(appender, "UPDATE '{}' SET ", description.name);
+  const auto *const text =
+      reinterpret_cast<const char *>(sqlite3_column_text(stmt.get(), 0));
+  return text == nullptr ? std::string{} : std::string{text};
+}
 
-  bool first = true;
-  std::vector<AsImage> values;
-  for (const FieldDescription field : description.fields) {
-    createUpdateParamPlaceholders(field, appender, {}, first);
-    for (AsImage &value : intoArgs(field, field.constMemberPtr(entity))) {
-      values.emplace_back(std::move(value));
+/// @returns URI opening the file as immutable, reserved characters of the
+/// path are percent-encoded
+std::string immutableUri(const std::string_view filename) {
+  std::string uri = "file:";
+  for (const char c : filename) {
+    if (c == '%' || c == '?' || c == '#') {
+      fmt::format_to(std::back_inserter(uri), "%{:02X}",
+                     static_cast<unsigned char>(c));
+    } else {
+      uri.push_back(c);
     }
   }
+  uri += "?immutable=1";
+  return uri;
+}
 
-  fmt::format_to(appender, " WHERE {} = ?",
-                 description.fields[description.primaryKey].name);
+#ifdef PODRM_SQLITE_CHANGE_CAPTURE
+/// Conflict handler of sqlite3changeset_apply
+/// @param context pointer to the ConflictPolicy
+int resolveConflict(void *const context, const int conflict,
+                    sqlite3_changeset_iter * /*iterator*/) {
+  switch (*static_cast<const ConflictPolicy *>(context)) {
+  case ConflictPolicy::Abort:
+    return SQLITE_CHANGESET_ABORT;
+  case ConflictPolicy::Omit:
+    return SQLITE_CHANGESET_OMIT;
+  case ConflictPolicy::Replace:
+    // Only rows that exist with other values can be replaced
+    return conflict == SQLITE_CHANGESET_DATA ||
+                   conflict == SQLITE_CHANGESET_CONFLICT
+               ? SQLITE_CHANGESET_REPLACE
+               : SQLITE_CHANGESET_OMIT;
+  }
+  return SQLITE_CHANGESET_ABORT;
+}
+#endif
+
+using Handle = std::unique_ptr<sqlite3, decltype(&sqlite3_close_v2)>;
+
+/// Copies the main database with the online backup API. Steps failing
+/// while either database is locked are retried with a back-off until
+/// SnapshotOptions::busyTimeout passes without progress
+/// @param sourceMutex mutex held while the source is accessed, if any
+/// @param limits limits checked between the steps, if any
+void copyDatabase(sqlite3 &source, sqlite3 &destination,
+                  const SnapshotOptions &options, std::mutex *const sourceMutex,
+                  const OperationLimits *const limits) {
+  // Shortest sleep before a locked database is tried again
+  constexpr std::chrono::milliseconds BusyBackoff{10};
+
+  const auto locked = [sourceMutex](const auto &access) {
+    if (sourceMutex == nullptr) {
+      return access();
+    }
+    const std::lock_guard lock{*sourceMutex};
+    return access();
+  };
 
-  std::vector<AsImage> key = intoArgs(
-      description.fields[description.primaryKey],
-      description.fields[description.primaryKey].constMemberPtr(entity));
-  if (key.size() != 1) {
-    throw std::invalid_argument{
-        fmt::format("Entity has composite primary key")};
+  sqlite3_backup *const backup = locked([&source, &destination] {
+    return sqlite3_backup_init(&destination, "main", &source, "main");
+  });
+  if (backup == nullptr) {
+    throwError(destination, sqlite3_errcode(&destination));
   }
-  values.emplace_back(std::move(key[0]));
+  const auto finish = [&locked, backup] {
+    return locked([backup] { return sqlite3_backup_finish(backup); });
+  };
 
-  const std::uint64_t changes = this->execute(fmt::to_string(buf), values);
-  if (changes == 0) {
-    throw std::runtime_error("Entity with the given key is not found");
+  int result = SQLITE_OK;
+  try {
+    std::chrono::milliseconds busy{0};
+    while (true) {
+      if (limits != nullptr) {
+        limits->check();
+      }
+
+      result = locked([backup, &options] {
+        return sqlite3_backup_step(backup, options.pagesPerStep);
+      });
+      if (result == SQLITE_BUSY || result == SQLITE_LOCKED) {
+        if (busy >= options.busyTimeout) {
+          break;
+        }
+        const std::chrono::milliseconds wait =
+            std::max(options.pause, BusyBackoff);
+        std::this_thread::sleep_for(wait);
+        busy += wait;
+        continue;
+      }
+      if (result != SQLITE_OK) {
+        break;
+      }
+
+      busy = {};
+      if (options.pause.count() > 0) {
+        std::this_thread::sleep_for(options.pause);
+      }
+    }
+  } catch (...) {
+    finish();
+    throw;
+  }
+
+  // Locked databases are not errors of the backup
+  const int finishResult = finish();
+  if (result == SQLITE_BUSY || result == SQLITE_LOCKED) {
+    throw std::runtime_error{sqlite3_errstr(result)};
+  }
+  if (result != SQLITE_DONE) {
+    throwError(destination, finishResult);
   }
 }
 
-Cursor Connection::iterate(const EntityDescription description) {
-  const std::string queryStr =
-      fmt::format("SELECT * FROM '{}'", description.name);
+} // namespace
 
-  return Cursor{
-      this->query(queryStr),
-      description.fields,
+Connection::Connection(sqlite3 &connection, const ConnectionOptions &options)
+    : connection(&connection, &sqlite3_close_v2) {
+  // Page size must be set before the journal mode creates the database
+  if (options.pageSize.has_value()) {
+    runPragma(connection,
+              fmt::format("PRAGMA page_size = {}", *options.pageSize));
+  }
+  if (options.journalMode.has_value()) {
+    const std::string_view requested = toString(*options.journalMode);
+    const std::string mode = queryPragma(
+        connection, fmt::format("PRAGMA journal_mode = {}", requested));
+    const auto sameMode = [](const char actual, const char expected) {
+      return std::toupper(static_cast<unsigned char>(actual)) == expected;
+    };
+    // Unsupported modes are ignored, e.g. WAL for in-memory databases
+    if (!std::ranges::equal(mode, requested, sameMode)) {
+      throw std::runtime_error{
+          fmt::format("Journal mode {} is not supported by the database, it "
+                      "uses {}",
+                      requested, mode),
+      };
+    }
+  }
+  if (options.lockingMode.has_value()) {
+    runPragma(connection, fmt::format("PRAGMA locking_mode = {}",
+                                      toString(*options.lockingMode)));
+  }
+  if (options.synchronous.has_value()) {
+    runPragma(connection, fmt::format("PRAGMA synchronous = {}",
+                                      toString(*options.synchronous)));
+  }
+  if (options.cacheSize.has_value()) {
+    runPragma(connection,
+              fmt::format("PRAGMA cache_size = {}", *options.cacheSize));
+  }
+  if (options.mmapSize.has_value()) {
+    runPragma(connection,
+              fmt::format("PRAGMA mmap_size = {}", *options.mmapSize));
+  }
+  if (options.tempStore.has_value()) {
+    runPragma(connection, fmt::format("PRAGMA temp_store = {}",
+                                      toString(*options.tempStore)));
+  }
+  if (options.busyTimeout.has_value()) {
+    sqlite3_busy_timeout(&connection,
+                         static_cast<int>(options.busyTimeout->count()));
+  }
+
+  // Foreign keys are only checked by writes
+  this->immutable = options.immutable;
+  if (!options.readOnly && !options.immutable) {
+    this->executeUnlimited("PRAGMA foreign_keys = ON");
+  }
+}
+
+sqlite3 &Connection::open(const char *const filename, int flags,
+                          const ConnectionOptions &options) {
+  flags |= options.readOnly || options.immutable
+               ? SQLITE_OPEN_READONLY
+               : SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
+  if (options.noMutex) {
+    flags |= SQLITE_OPEN_NOMUTEX;
+  }
+  if (options.sharedCache) {
+    flags |= SQLITE_OPEN_SHAREDCACHE;
+  }
+
+  // Immutability can only be requested by a URI parameter
+  const std::string uri = options.immutable ? immutableUri(filename) : "";
+  if (options.immutable) {
+    flags |= SQLITE_OPEN_URI;
+  }
+
+  sqlite3 *connection = nullptr;
+  const int result = sqlite3_open_v2(
+      options.immutable ? uri.c_str() : filename, &connection, flags, nullptr);
+  if (result != SQLITE_OK) {
+    sqlite3_close_v2(connection);
+    throw std::runtime_error{sqlite3_errstr(result)};
+  }
+
+  return *connection;
+}
+
+Connection Connection::fromRaw(sqlite3 &connection,
+                               const ConnectionOptions &options) {
+  return Connection{connection, options};
+}
+
+Connection Connection::inMemory(const char *const name,
+                                const ConnectionOptions &options) {
+  return Connection{open(name, SQLITE_OPEN_MEMORY, options), options};
+}
+
+Connection Connection::inFile(const std::filesystem::path &path,
+                              const ConnectionOptions &options) {
+  return Connection{open(path.string().c_str(), 0, options), options};
+}
+
+Connection Connection::openReadOnly(const std::filesystem::path &path,
+                                    const ReadOnlyOptions &options) {
+  const ConnectionOptions connectionOptions{
+      .mmapSize = options.mmapSize.value_or(
+          static_cast<std::int64_t>(std::filesystem::file_size(path))),
+      .readOnly = true,
+      .immutable = options.immutable,
+  };
+  return inFile(path, connectionOptions);
+}
+
+Connection Connection::loadIntoMemory(const std::filesystem::path &path,
+                                      const ConnectionOptions &options) {
+  ConnectionOptions fileOptions;
+  fileOptions.readOnly = true;
+  const Handle file{&open(path.string().c_str(), 0, fileOptions),
+                    &sqlite3_close_v2};
+
+  // Options are applied after the copy, which sets the page size
+  Handle memory{&open(path.string().c_str(), SQLITE_OPEN_MEMORY, options),
+                &sqlite3_close_v2};
+  copyDatabase(*file, *memory, SnapshotOptions{.pagesPerStep = -1}, nullptr,
+               nullptr);
+  return Connection{*memory.release(), options};
+}
+
+void Connection::snapshotTo(const std::filesystem::path &path,
+                            const SnapshotOptions &options) {
+  const Handle file{&open(path.string().c_str(), 0, {}), &sqlite3_close_v2};
+  // Other operations of this connection run between the steps
+  copyDatabase(*this->connection, *file, options, this->mutex.get(),
+               this->limits.get());
+}
+
+std::uint64_t Connection::execute(const std::string_view statement,
+                                  const span<const AsImage> args) {
+  this->checkLimits();
+  return this->executeUnlimited(statement, args);
+}
+
+std::uint64_t Connection::executeUnlimited(const std::string_view statement,
+                                           const span<const AsImage> args) {
+  std::unique_lock lock{*this->mutex};
+
+  Stopwatch stopwatch{this->observer != nullptr};
+  const Statement stmt = createStatement(*this->connection, statement);
+  const std::chrono::nanoseconds prepareTime = stopwatch.lap();
+
+  this->bind(*stmt.get(), args);
+
+  const std::size_t recorded = this->pendingChanges();
+  const SlowQueryReport report{this->slowQueries.get()};
+  const int executeResult = sqlite3_step(stmt.get());
+  this->settleChanges(executeResult == SQLITE_DONE);
+  if (executeResult != SQLITE_DONE) {
+    // Changes of the failed statement are undone
+    this->discardChanges(recorded);
+    throwError(*this->connection, executeResult);
+  }
+
+  const std::uint64_t changes = sqlite3_changes64(this->connection.get());
+  if (this->observer != nullptr) {
+    notify(*this->observer, statement, prepareTime, stopwatch.lap(),
+           changedRows(*stmt, changes), args, false);
+  }
+
+  lock.unlock();
+  this->deliverChanges();
+
+  return changes;
+}
+
+template <typename Body> void Connection::inSavepoint(const Body &body) {
+  const SavepointState savepoint = this->beginSavepoint();
+
+  try {
+    body();
+  } catch (...) {
+    this->rollbackSavepoint(savepoint);
+    throw;
+  }
+
+  this->releaseSavepoint(savepoint);
+}
+
+void Connection::bind(sqlite3_stmt &statement,
+                      const span<const AsImage> args) {
+  for (int i = 0; i < args.size(); ++i) {
+    bindArg(&statement, i, args[i]);
+  }
+
+  if (this->slowQueries != nullptr) {
+    std::vector<std::string_view> types;
+    types.reserve(args.size());
+    for (const AsImage &arg : args) {
+      types.push_back(storageClass(arg));
+    }
+
+    this->slowQueries->setParameterTypes(statement, std::move(types));
+  }
+}
+
+sqlite3_stmt &Connection::prepareCached(const std::string &statement) {
+  auto cached = this->statements.find(statement);
+  if (cached == this->statements.end()) {
+    sqlite3_stmt *stmt = nullptr;
+    const int result = sqlite3_prepare_v3(
+        this->connection.get(), statement.data(),
+        static_cast<int>(statement.size()), SQLITE_PREPARE_PERSISTENT, &stmt,
+        nullptr);
+    if (result != SQLITE_OK) {
+      throw std::runtime_error{sqlite3_errmsg(this->connection.get())};
+    }
+
+    cached = this->statements
+                 .emplace(statement, CachedStatement{stmt, &sqlite3_finalize})
+                 .first;
+  }
+
+  return *cached->second;
+}
+
+std::uint64_t Connection::executeCached(const std::string &statement,
+                                        const span<const AsImage> args,
+                                        std::int64_t *const lastInsertRowId) {
+  std::unique_lock lock{*this->mutex};
+  this->checkLimits();
+
+  Stopwatch stopwatch{this->observer != nullptr};
+  const bool cacheHit =
+      stopwatch.running() && this->statements.contains(statement);
+
+  // Statement stays prepared, but bound values must not outlive this call
+  const auto reset = [](sqlite3_stmt *stmt) {
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+  };
+  std::unique_ptr<sqlite3_stmt, decltype(reset)> stmt{
+      &this->prepareCached(statement), reset};
+  const std::chrono::nanoseconds prepareTime = stopwatch.lap();
+
+  this->bind(*stmt.get(), args);
+
+  const std::size_t recorded = this->pendingChanges();
+  const SlowQueryReport report{this->slowQueries.get()};
+  const int executeResult = sqlite3_step(stmt.get());
+  this->settleChanges(executeResult == SQLITE_DONE);
+  if (executeResult != SQLITE_DONE) {
+    this->discardChanges(recorded);
+    throwError(*this->connection, executeResult);
+  }
+
+  if (lastInsertRowId != nullptr) {
+    *lastInsertRowId = sqlite3_last_insert_rowid(this->connection.get());
+  }
+
+  const std::uint64_t changes = sqlite3_changes64(this->connection.get());
+  if (this->observer != nullptr) {
+    notify(*this->observer, statement, prepareTime, stopwatch.lap(),
+           changedRows(*stmt, changes), args, cacheHit);
+  }
+
+  // Other threads may reuse the statement while the changes are delivered
+  stmt.reset();
+  lock.unlock();
+  this->deliverChanges();
+
+  return changes;
+}
+
+std::string Connection::getGenerated(const Generated kind,
+                                     const EntityDescription &description,
+                                     const FieldMask fields) {
+  const std::unique_lock lock{*this->mutex};
+
+  auto cached = this->generated.find({kind, description.name, fields});
+  if (cached != this->generated.end()) {
+    return cached->second;
+  }
+
+  std::string statement;
+  switch (kind) {
+  case Generated::Insert:
+    statement = createInsert(description);
+    break;
+  case Generated::PartialUpdate:
+    statement = createPartialUpdate(description, fields);
+    break;
+  case Generated::Upsert:
+    statement = createUpsert(description);
+    break;
+  }
+
+  this->generated.emplace(std::tuple{kind, description.name, fields},
+                          statement);
+
+  return statement;
+}
+
+Result Connection::query(const std::string_view statement,
+                         const span<const AsImage> args) {
+  const std::unique_lock lock{*this->mutex};
+  this->checkLimits();
+
+  Stopwatch stopwatch{this->observer != nullptr};
+  Statement stmt = createStatement(*this->connection, statement);
+  const std::chrono::nanoseconds prepareTime = stopwatch.lap();
+
+  // Result is stepped after the caller's arguments may be gone
+  std::vector<AsImage> arguments = ownArguments(args);
+  this->bind(*stmt.get(), arguments);
+
+  return Result{
+      {stmt.release(), &sqlite3_finalize},
+      std::move(arguments),
+      observe(this->observer, statement, prepareTime, args, false),
+      this->slowQueries,
+  };
+}
+
+Result Connection::queryCached(const std::string &statement,
+                               const span<const AsImage> args) {
+  const std::unique_lock lock{*this->mutex};
+  this->checkLimits();
+
+  Stopwatch stopwatch{this->observer != nullptr};
+  bool cacheHit = stopwatch.running() && this->statements.contains(statement);
+
+  // Statement stays prepared, but bound values must not outlive the result
+  sqlite3_stmt *stmt = &this->prepareCached(statement);
+  int (*release)(sqlite3_stmt *) = [](sqlite3_stmt *stmt) {
+    sqlite3_reset(stmt);
+    return sqlite3_clear_bindings(stmt);
+  };
+
+  // Cached statement is still stepped through by another result
+  if (sqlite3_stmt_busy(stmt) != 0) {
+    stmt = createStatement(*this->connection, statement).release();
+    release = &sqlite3_finalize;
+    cacheHit = false;
+  }
+
+  Result::Statement result{stmt, release};
+  const std::chrono::nanoseconds prepareTime = stopwatch.lap();
+
+  std::vector<AsImage> arguments = ownArguments(args);
+  this->bind(*result.get(), arguments);
+
+  return Result{
+      std::move(result),
+      std::move(arguments),
+      observe(this->observer, statement, prepareTime, args, cacheHit),
+      this->slowQueries,
+  };
+}
+
+void Connection::begin() { this->executeUnlimited("BEGIN"); }
+
+void Connection::commit() { this->executeUnlimited("COMMIT"); }
+
+void Connection::rollback() { this->executeUnlimited("ROLLBACK"); }
+
+Connection::SavepointState Connection::beginSavepoint() {
+  // Unique names do not release savepoints of the same name started by the
+  // user
+  std::string name;
+  {
+    const std::lock_guard lock{*this->mutex};
+    name = fmt::format("podrm_{}", this->savepoints++);
+  }
+
+  this->executeUnlimited(fmt::format(R"(SAVEPOINT "{}")", name));
+  return SavepointState{.name = std::move(name),
+                        .changes = this->pendingChanges()};
+}
+
+void Connection::releaseSavepoint(const SavepointState &state) {
+  this->executeUnlimited(fmt::format(R"(RELEASE "{}")", state.name));
+}
+
+void Connection::rollbackSavepoint(const SavepointState &state) {
+  this->executeUnlimited(fmt::format(R"(ROLLBACK TO "{}")", state.name));
+  // Rolling back to a savepoint does not call the rollback hook, and
+  // releasing it may commit
+  this->discardChanges(state.changes);
+  this->releaseSavepoint(state);
+}
+
+Connection::BulkLoadState
+Connection::beginBulkLoad(const EntityDescription &description) {
+  const OperationScope scope{description.name, "beginBulkLoad",
+                             this->reporting()};
+  BulkLoadState state{};
+  {
+    const Result synchronous = this->query("PRAGMA synchronous");
+    // NOLINTNEXTLINE(bugprone-unchecked-optional-access): fixed query
+    state.synchronous = synchronous.getRow().value().get(0).bigint();
+  }
+  {
+    const Result journal = this->query("PRAGMA journal_mode");
+    // NOLINTNEXTLINE(bugprone-unchecked-optional-access): fixed query
+    const std::string_view mode = journal.getRow().value().get(0).text();
+    // WAL is cheap to write already and cannot be left while other
+    // connections use the database
+    if (mode == "delete" || mode == "truncate" || mode == "persist") {
+      state.journalMode = mode;
+    }
+  }
+
+  runPragma(*this->connection, "PRAGMA synchronous = OFF");
+  if (!state.journalMode.empty()) {
+    runPragma(*this->connection, "PRAGMA journal_mode = MEMORY");
+  }
+
+  try {
+    this->begin();
+  } catch (...) {
+    this->restoreSettings(state);
+    throw;
+  }
+
+  try {
+    // Reset automatically when the transaction ends
+    this->executeUnlimited("PRAGMA defer_foreign_keys = ON");
+
+    {
+      // Automatic indexes of constraints have no definition and are kept
+      const std::array<AsImage, 1> table = {description.name};
+      Result indexes = this->query(
+          "SELECT name, sql FROM sqlite_master "
+          "WHERE type = 'index' AND tbl_name = ? AND sql IS NOT NULL",
+          table);
+      while (const std::optional<Row> row = indexes.getRow()) {
+        state.indexes.emplace_back(row->get(0).text(), row->get(1).text());
+        indexes.nextRow();
+      }
+    }
+
+    for (const auto &[name, definition] : state.indexes) {
+      this->executeUnlimited(fmt::format(R"(DROP INDEX "{}")", name));
+    }
+  } catch (...) {
+    this->abortBulkLoad(state);
+    throw;
+  }
+
+  return state;
+}
+
+void Connection::finishBulkLoad(const EntityDescription &description,
+                                const BulkLoadState &state) {
+  const OperationScope scope{description.name, "finishBulkLoad",
+                             this->reporting()};
+  try {
+    for (const auto &[name, definition] : state.indexes) {
+      this->executeUnlimited(definition);
+    }
+
+    bool violated = false;
+    {
+      const Result violations = this->query(
+          fmt::format("PRAGMA foreign_key_check('{}')", description.name));
+      violated = violations.valid();
+    }
+    if (violated) {
+      throw std::runtime_error{
+          fmt::format("Bulk load of {} violates foreign keys",
+                      description.name),
+      };
+    }
+
+    this->commit();
+  } catch (...) {
+    this->abortBulkLoad(state);
+    throw;
+  }
+
+  this->restoreSettings(state);
+}
+
+void Connection::abortBulkLoad(const BulkLoadState &state) noexcept {
+  try {
+    this->rollback();
+  } catch (...) { // NOLINT(bugprone-empty-catch): transaction may be gone
+  }
+
+  try {
+    this->restoreSettings(state);
+  } catch (...) { // NOLINT(bugprone-empty-catch): best effort
+  }
+}
+
+void Connection::restoreSettings(const BulkLoadState &state) {
+  runPragma(*this->connection,
+            fmt::format("PRAGMA synchronous = {}", state.synchronous));
+  if (!state.journalMode.empty()) {
+    runPragma(*this->connection,
+              fmt::format("PRAGMA journal_mode = {}", state.journalMode));
+  }
+}
+
+#ifdef PODRM_SQLITE_CHANGE_CAPTURE
+sqlite3_session &
+Connection::beginCapture(const span<const std::string_view> tables) {
+  const std::unique_lock lock{*this->mutex};
+
+  sqlite3_session *session = nullptr;
+  const int result =
+      sqlite3session_create(this->connection.get(), "main", &session);
+  if (result != SQLITE_OK) {
+    throwError(*this->connection, result);
+  }
+
+  for (const std::string_view table : tables) {
+    const int attachResult =
+        sqlite3session_attach(session, std::string{table}.c_str());
+    if (attachResult != SQLITE_OK) {
+      sqlite3session_delete(session);
+      throwError(*this->connection, attachResult);
+    }
+  }
+
+  return *session;
+}
+
+std::vector<std::byte> Connection::captured(sqlite3_session &session,
+                                            const bool patchset) {
+  const std::unique_lock lock{*this->mutex};
+
+  int size = 0;
+  void *data = nullptr;
+  const int result =
+      patchset ? sqlite3session_patchset(&session, &size, &data)
+               : sqlite3session_changeset(&session, &size, &data);
+  const std::unique_ptr<void, decltype(&sqlite3_free)> owner{data,
+                                                             &sqlite3_free};
+  if (result != SQLITE_OK) {
+    throwError(*this->connection, result);
+  }
+
+  const auto *const bytes = static_cast<const std::byte *>(data);
+  return {bytes, bytes + size};
+}
+
+void Connection::endCapture(sqlite3_session &session) noexcept {
+  const std::unique_lock lock{*this->mutex};
+  sqlite3session_delete(&session);
+}
+
+void Connection::applyChanges(const span<const std::byte> changes,
+                              ConflictPolicy policy) {
+  this->checkLimits();
+
+  // Own savepoint discards the recorded changes of an aborted apply
+  this->inSavepoint([this, changes, &policy] {
+    const std::unique_lock lock{*this->mutex};
+
+    const int result = sqlite3changeset_apply(
+        this->connection.get(), static_cast<int>(changes.size()),
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast): not modified
+        const_cast<std::byte *>(changes.data()), nullptr, &resolveConflict,
+        &policy);
+    if (result == SQLITE_ABORT) {
+      throw std::runtime_error{"Changes conflict with the database"};
+    }
+    if (result != SQLITE_OK) {
+      throwError(*this->connection, result);
+    }
+  });
+}
+#endif
+
+std::uint64_t Connection::subscribe(const std::string_view table,
+                                    ChangeCallback callback) {
+  const std::unique_lock lock{*this->mutex};
+  Subscriptions &subscriptions = *this->subscriptions;
+  const std::lock_guard subscriptionsLock{subscriptions.mutex};
+
+  if (subscriptions.subscribers.empty()) {
+    sqlite3_update_hook(this->connection.get(), &Connection::updateHook,
+                        &subscriptions);
+    sqlite3_commit_hook(this->connection.get(), &Connection::commitHook,
+                        &subscriptions);
+    sqlite3_rollback_hook(this->connection.get(), &Connection::rollbackHook,
+                          &subscriptions);
+  }
+
+  const std::uint64_t id = subscriptions.nextId++;
+  subscriptions.subscribers.emplace(
+      id, std::pair{std::string{table}, std::move(callback)});
+  return id;
+}
+
+void Connection::unsubscribe(const std::uint64_t id) noexcept {
+  Subscriptions &subscriptions = *this->subscriptions;
+  {
+    // Waits without the connection mutex, callbacks may use the database
+    std::unique_lock subscriptionsLock{subscriptions.mutex};
+    subscriptions.subscribers.erase(id);
+    const std::thread::id self = std::this_thread::get_id();
+    const auto othersDone = [&subscriptions, id, self] {
+      const auto deliverers = subscriptions.deliverers.find(id);
+      return deliverers == subscriptions.deliverers.end() ||
+             std::ranges::all_of(deliverers->second,
+                                 [self](const std::thread::id deliverer) {
+                                   return deliverer == self;
+                                 });
+    };
+    subscriptions.delivered.wait(subscriptionsLock, othersDone);
+  }
+
+  const std::unique_lock lock{*this->mutex};
+  const std::lock_guard subscriptionsLock{subscriptions.mutex};
+  if (subscriptions.subscribers.empty()) {
+    sqlite3_update_hook(this->connection.get(), nullptr, nullptr);
+    sqlite3_commit_hook(this->connection.get(), nullptr, nullptr);
+    sqlite3_rollback_hook(this->connection.get(), nullptr, nullptr);
+    subscriptions.pending.clear();
+    subscriptions.committing.clear();
+    subscriptions.committed.clear();
+  }
+}
+
+void Connection::updateHook(void *const context, const int operation,
+                            const char *const database,
+                            const char *const table, const long long rowid) {
+  auto &subscriptions = *static_cast<Subscriptions *>(context);
+  if (std::string_view{database} != "main") {
+    return;
+  }
+
+  const std::lock_guard lock{subscriptions.mutex};
+  const bool subscribed = std::ranges::any_of(
+      subscriptions.subscribers,
+      [table](const auto &subscriber) {
+        return subscriber.second.first == table;
+      });
+  if (!subscribed) {
+    return;
+  }
+
+  ChangeOperation changeOperation = ChangeOperation::Update;
+  if (operation == SQLITE_INSERT) {
+    changeOperation = ChangeOperation::Insert;
+  } else if (operation == SQLITE_DELETE) {
+    changeOperation = ChangeOperation::Delete;
+  }
+
+  subscriptions.pending.emplace_back(
+      table, RowChange{.operation = changeOperation, .rowid = rowid});
+}
+
+int Connection::commitHook(void *const context) {
+  auto &subscriptions = *static_cast<Subscriptions *>(context);
+  const std::lock_guard lock{subscriptions.mutex};
+
+  // Delivered once the committing statement is done, a failed commit keeps
+  // the transaction running or rolls it back
+  std::ranges::move(subscriptions.pending,
+                    std::back_inserter(subscriptions.committing));
+  subscriptions.pending.clear();
+
+  // Zero lets the commit proceed
+  return 0;
+}
+
+void Connection::rollbackHook(void *const context) {
+  auto &subscriptions = *static_cast<Subscriptions *>(context);
+  const std::lock_guard lock{subscriptions.mutex};
+  subscriptions.pending.clear();
+  subscriptions.committing.clear();
+}
+
+std::size_t Connection::pendingChanges() {
+  const std::lock_guard lock{this->subscriptions->mutex};
+  return this->subscriptions->pending.size();
+}
+
+void Connection::discardChanges(const std::size_t first) {
+  const std::lock_guard lock{this->subscriptions->mutex};
+  std::vector<std::pair<std::string, RowChange>> &pending =
+      this->subscriptions->pending;
+  if (pending.size() > first) {
+    pending.erase(pending.begin() + static_cast<std::ptrdiff_t>(first),
+                  pending.end());
+  }
+}
+
+void Connection::settleChanges(const bool succeeded) {
+  const std::lock_guard lock{this->subscriptions->mutex};
+  Subscriptions &subscriptions = *this->subscriptions;
+  if (subscriptions.committing.empty()) {
+    return;
+  }
+
+  if (succeeded) {
+    subscriptions.committed.push_back(std::move(subscriptions.committing));
+  } else {
+    subscriptions.pending.insert(
+        subscriptions.pending.begin(),
+        std::make_move_iterator(subscriptions.committing.begin()),
+        std::make_move_iterator(subscriptions.committing.end()));
+  }
+  subscriptions.committing.clear();
+}
+
+void Connection::deliverChanges() {
+  Subscriptions &subscriptions = *this->subscriptions;
+  std::vector<std::vector<std::pair<std::string, RowChange>>> committed;
+  std::vector<std::pair<std::uint64_t, std::pair<std::string, ChangeCallback>>>
+      subscribers;
+  {
+    const std::lock_guard lock{subscriptions.mutex};
+    if (subscriptions.committed.empty()) {
+      return;
+    }
+    committed = std::move(subscriptions.committed);
+    subscriptions.committed.clear();
+    subscribers.assign(subscriptions.subscribers.begin(),
+                       subscriptions.subscribers.end());
+  }
+
+  // Callbacks run unlocked, so that they may use the database
+  const std::thread::id self = std::this_thread::get_id();
+  std::vector<RowChange> changes;
+  for (const auto &transaction : committed) {
+    for (const auto &[id, subscriber] : subscribers) {
+      const auto &[table, callback] = subscriber;
+      changes.clear();
+      for (const auto &[changedTable, change] : transaction) {
+        if (changedTable == table) {
+          changes.push_back(change);
+        }
+      }
+      if (changes.empty()) {
+        continue;
+      }
+
+      // Earlier callbacks may end the subscription, other threads ending it
+      // wait for this call
+      {
+        const std::lock_guard lock{subscriptions.mutex};
+        if (!subscriptions.subscribers.contains(id)) {
+          continue;
+        }
+        subscriptions.deliverers[id].push_back(self);
+      }
+
+      const auto finish = [&subscriptions, id, self] {
+        {
+          const std::lock_guard lock{subscriptions.mutex};
+          std::vector<std::thread::id> &threads =
+              subscriptions.deliverers[id];
+          threads.erase(std::ranges::find(threads, self));
+          if (threads.empty()) {
+            subscriptions.deliverers.erase(id);
+          }
+        }
+        subscriptions.delivered.notify_all();
+      };
+
+      try {
+        callback(changes);
+      } catch (...) {
+        finish();
+        throw;
+      }
+      finish();
+    }
+  }
+}
+
+std::optional<OperationLimits>
+Connection::setLimits(std::optional<OperationLimits> limits) {
+  // Number of virtual machine instructions between limit checks
+  constexpr int ProgressPeriod = 1000;
+
+  const std::unique_lock lock{*this->mutex};
+
+  std::optional<OperationLimits> previous;
+  if (this->limits != nullptr) {
+    previous = std::move(*this->limits);
+  }
+
+  if (!limits.has_value()) {
+    sqlite3_progress_handler(this->connection.get(), 0, nullptr, nullptr);
+    this->limits.reset();
+    return previous;
+  }
+
+  this->limits = std::make_unique<OperationLimits>(std::move(*limits));
+  sqlite3_progress_handler(
+      this->connection.get(), ProgressPeriod,
+      [](void *data) {
+        const auto &limits = *static_cast<const OperationLimits *>(data);
+        if (limits.token.cancelled()) {
+          setInterruption(Interruption::Cancelled);
+          return 1;
+        }
+        if (limits.exceeded()) {
+          setInterruption(Interruption::TimedOut);
+          return 1;
+        }
+        return 0;
+      },
+      this->limits.get());
+
+  return previous;
+}
+
+void Connection::interrupt() { sqlite3_interrupt(this->connection.get()); }
+
+void Connection::setObserver(Observer *const observer) {
+  const std::unique_lock lock{*this->mutex};
+  this->observer = observer;
+  this->reported->store(observer != nullptr || this->slowQueries != nullptr,
+                        std::memory_order_relaxed);
+}
+
+void Connection::setSlowQueryLog(std::optional<SlowQueryLog> log) {
+  const std::unique_lock lock{*this->mutex};
+
+  if (!log.has_value()) {
+    sqlite3_trace_v2(this->connection.get(), 0, nullptr, nullptr);
+    this->slowQueries.reset();
+    this->reported->store(this->observer != nullptr,
+                          std::memory_order_relaxed);
+    return;
+  }
+
+  if (!log->callback) {
+    throw std::invalid_argument{"Slow query log requires a callback"};
+  }
+
+  auto trace =
+      std::make_shared<SlowQueryTrace>(*this->connection, std::move(*log));
+  sqlite3_trace_v2(this->connection.get(), SQLITE_TRACE_PROFILE,
+                   &SlowQueryTrace::profile, trace.get());
+  this->slowQueries = std::move(trace);
+  this->reported->store(true, std::memory_order_relaxed);
+}
+
+void Connection::checkLimits() const {
+  if (this->limits != nullptr) {
+    this->limits->check();
+  }
+}
+
+void Connection::createTable(const EntityDescription &entity) {
+  const OperationScope scope{entity.name, "createTable", this->reporting()};
+  this->execute(fmt::format("DROP TABLE IF EXISTS '{}'", entity.name));
+
+  fmt::memory_buffer buf;
+  fmt::appender appender{buf};
+  fmt::format_to(appender, "CREATE TABLE '{}' (", entity.name);
+
+  bool first = true;
+  for (std::size_t i = 0; i < entity.fields.size(); ++i) {
+    createFields(entity.fields[i], entity.primaryKey == i, appender, {}, first);
+  }
+
+  for (const FieldDescription &field : entity.fields) {
+    createConstraints(field, appender, {});
+  }
+
+  fmt::format_to(appender, ")");
+  this->execute(fmt::to_string(buf));
+}
+
+void Connection::createIndex(const EntityDescription &entity,
+                             const std::size_t field) {
+  const OperationScope scope{entity.name, "createIndex", this->reporting()};
+  getPrimitiveField(entity, field);
+
+  const std::string_view name = entity.fields[field].name;
+  this->execute(
+      fmt::format(R"(CREATE INDEX IF NOT EXISTS "{}_{}" ON '{}' ("{}"))",
+                  entity.name, name, entity.name, name));
+}
+
+bool Connection::exists(const EntityDescription &entity) {
+  const OperationScope scope{entity.name, "exists", this->reporting()};
+  const Result result = this->query(
+      fmt::format("SELECT EXISTS(SELECT 1 FROM '{}')", entity.name));
+  // NOLINTNEXTLINE(bugprone-unchecked-optional-access): fixed query
+  return result.getRow().value().get(0).boolean();
+}
+
+void Connection::persist(const EntityDescription &description, void *entity) {
+  const OperationScope scope{description.name, "persist", this->reporting()};
+  const bool autoId = description.idMode == IdMode::Auto;
+  if (autoId) {
+    checkAutoId(description);
+  }
+
+  const std::string statement =
+      this->getGenerated(Generated::Insert, description);
+
+  std::vector<AsImage> values;
+  for (std::size_t i = 0; i < description.fields.size(); ++i) {
+    if (autoId && i == description.primaryKey) {
+      continue;
+    }
+
+    for (AsImage &value :
+         intoArgs(description.fields[i],
+                  description.fields[i].constMemberPtr(entity))) {
+      values.emplace_back(std::move(value));
+    }
+  }
+
+  std::int64_t rowId = 0;
+  this->executeCached(statement, values, &rowId);
+
+  if (autoId) {
+    setGeneratedKey(description, entity, rowId);
+  }
+}
+
+void Connection::persistMany(const EntityDescription &description,
+                             const span<void *const> entities) {
+  const OperationScope scope{description.name, "persistMany",
+                             this->reporting()};
+  this->inSavepoint([this, &description, entities] {
+    for (void *entity : entities) {
+      this->persist(description, entity);
+    }
+  });
+}
+
+bool Connection::find(const EntityDescription &description, const AsImage &key,
+                      void *result) {
+  const OperationScope scope{description.name, "find", this->reporting()};
+  const std::string queryStr =
+      fmt::format("SELECT * FROM '{}' WHERE {} = ?", description.name,
+                  description.fields[description.primaryKey].name);
+
+  const Cursor cursor = Cursor{
+      this->query(queryStr, podrm::span<const AsImage, 1>{&key, 1}),
+      description.fields,
+  };
+
+  return cursor.extract(result);
+}
+
+void Connection::erase(const EntityDescription description,
+                       const AsImage &key) {
+  const OperationScope scope{description.name, "erase", this->reporting()};
+  const std::string queryStr =
+      fmt::format("DELETE FROM '{}' WHERE {} = ?", description.name,
+                  description.fields[description.primaryKey].name);
+
+  const std::uint64_t changes =
+      this->execute(queryStr, podrm::span<const AsImage, 1>{&key, 1});
+  if (changes == 0) {
+    throw std::runtime_error("Entity with the given key is not found");
+  }
+}
+
+std::uint64_t Connection::eraseWhere(const EntityDescription &description,
+                                     const span<const Condition> where) {
+  const OperationScope scope{description.name, "eraseWhere", this->reporting()};
+  fmt::memory_buffer buf;
+  fmt::appender appender{buf};
+  std::vector<AsImage> args;
+
+  fmt::format_to(appender, "DELETE FROM '{}'", description.name);
+  formatWhere(description, where, appender, args);
+
+  return this->executeCached(fmt::to_string(buf), args);
+}
+
+std::uint64_t Connection::eraseMany(const EntityDescription &description,
+                                    const span<const AsImage> keys) {
+  const OperationScope scope{description.name, "eraseMany", this->reporting()};
+  const std::string_view key = description.fields[description.primaryKey].name;
+
+  std::uint64_t erased = 0;
+  this->inSavepoint([this, &description, keys, key, &erased] {
+    std::vector<AsImage> chunk;
+    for (std::size_t offset = 0; offset < keys.size();
+         offset += MaxBoundKeys) {
+      const std::size_t count = std::min(MaxBoundKeys, keys.size() - offset);
+
+      // Repeating the last key does not change the erased rows
+      chunk.assign(keys.begin() + static_cast<std::ptrdiff_t>(offset),
+                   keys.begin() + static_cast<std::ptrdiff_t>(offset + count));
+      const AsImage last = chunk.back();
+      chunk.resize(std::bit_ceil(count), last);
+
+      fmt::memory_buffer buf;
+      fmt::appender appender{buf};
+      fmt::format_to(appender, R"(DELETE FROM '{}' WHERE "{}" IN ()",
+                     description.name, key);
+      for (std::size_t i = 0; i < chunk.size(); ++i) {
+        fmt::format_to(appender, "{}?", i == 0 ? "" : ",");
+      }
+      fmt::format_to(appender, ")");
+
+      erased += this->executeCached(fmt::to_string(buf), chunk);
+    }
+  });
+
+  return erased;
+}
+
+std::uint64_t
+Connection::updateWhere(const EntityDescription &description,
+                        const span<const Condition> where,
+                        const span<const Assignment> assignments) {
+  const OperationScope scope{description.name, "updateWhere",
+                             this->reporting()};
+  if (assignments.empty()) {
+    throw std::invalid_argument{
+        fmt::format("No fields of {} to update", description.name),
+    };
+  }
+
+  fmt::memory_buffer buf;
+  fmt::appender appender{buf};
+  std::vector<AsImage> args;
+
+  fmt::format_to(appender, "UPDATE '{}' SET ", description.name);
+  bool first = true;
+  for (const Assignment &assignment : assignments) {
+    getPrimitiveField(description, assignment.field);
+
+    const std::string_view name = description.fields[assignment.field].name;
+    switch (assignment.operation) {
+    case AssignmentOperation::Set:
+      fmt::format_to(appender, R"({}"{}" = ?)", first ? "" : ",", name);
+      break;
+    case AssignmentOperation::Add:
+      fmt::format_to(appender, R"({}"{}" = "{}" + ?)", first ? "" : ",", name,
+                     name);
+      break;
+    }
+    args.push_back(assignment.value);
+    first = false;
+  }
+  formatWhere(description, where, appender, args);
+
+  return this->executeCached(fmt::to_string(buf), args);
+}
+
+void Connection::update(const EntityDescription description,
+                        const void *entity) {
+  const OperationScope scope{description.name, "update", this->reporting()};
+  fmt::memory_buffer buf;
+  fmt::appender appender{buf};
+
+  fmt::format_to(appender, "UPDATE '{}' SET ", description.name);
+
+  bool first = true;
+  std::vector<AsImage> values;
+  for (const FieldDescription field : description.fields) {
+    createUpdateParamPlaceholders(field, appender, {}, first);
+    for (AsImage &value : intoArgs(field, field.constMemberPtr(entity))) {
+      values.emplace_back(std::move(value));
+    }
+  }
+
+  fmt::format_to(appender, " WHERE {} = ?",
+                 description.fields[description.primaryKey].name);
+
+  std::vector<AsImage> key = intoArgs(
+      description.fields[description.primaryKey],
+      description.fields[description.primaryKey].constMemberPtr(entity));
+  if (key.size() != 1) {
+    throw std::invalid_argument{
+        fmt::format("Entity has composite primary key")};
+  }
+  values.emplace_back(std::move(key[0]));
+
+  const std::uint64_t changes = this->execute(fmt::to_string(buf), values);
+  if (changes == 0) {
+    throw std::runtime_error("Entity with the given key is not found");
+  }
+}
+
+void Connection::upsert(const EntityDescription &description,
+                        const void *entity) {
+  const OperationScope scope{description.name, "upsert", this->reporting()};
+  const std::string statement =
+      this->getGenerated(Generated::Upsert, description);
+
+  std::vector<AsImage> values;
+  for (const FieldDescription &field : description.fields) {
+    for (AsImage &value : intoArgs(field, field.constMemberPtr(entity))) {
+      values.emplace_back(std::move(value));
+    }
+  }
+
+  this->executeCached(statement, values);
+}
+
+void Connection::upsertMany(const EntityDescription &description,
+                            const span<const void *const> entities) {
+  const OperationScope scope{description.name, "upsertMany", this->reporting()};
+  this->inSavepoint([this, &description, entities] {
+    for (const void *entity : entities) {
+      this->upsert(description, entity);
+    }
+  });
+}
+
+void Connection::update(const EntityDescription description,
+                        const void *entity, const FieldMask fields) {
+  const OperationScope scope{description.name, "update", this->reporting()};
+  checkMaskable(description);
+
+  if (fields == 0) {
+    throw std::invalid_argument{"No fields selected for update"};
+  }
+
+  const std::string statement =
+      this->getGenerated(Generated::PartialUpdate, description, fields);
+
+  std::vector<AsImage> values;
+  for (std::size_t i = 0; i < description.fields.size(); ++i) {
+    if ((fields & (FieldMask{1} << i)) == 0) {
+      continue;
+    }
+
+    const FieldDescription &field = description.fields[i];
+    for (AsImage &value : intoArgs(field, field.constMemberPtr(entity))) {
+      values.emplace_back(std::move(value));
+    }
+  }
+
+  std::vector<AsImage> key = intoArgs(
+      description.fields[description.primaryKey],
+      description.fields[description.primaryKey].constMemberPtr(entity));
+  if (key.size() != 1) {
+    throw std::invalid_argument{
+        fmt::format("Entity has composite primary key")};
+  }
+  values.emplace_back(std::move(key[0]));
+
+  const std::uint64_t changes = this->executeCached(statement, values);
+  if (changes == 0) {
+    throw std::runtime_error("Entity with the given key is not found");
+  }
+}
+
+void Connection::updateChanged(const EntityDescription description,
+                               const void *entity, const void *snapshot) {
+  const OperationScope scope{description.name, "updateChanged",
+                             this->reporting()};
+  checkMaskable(description);
+
+  FieldMask changed = 0;
+  for (std::size_t i = 0; i < description.fields.size(); ++i) {
+    const FieldDescription &field = description.fields[i];
+    if (!sameField(field, field.constMemberPtr(entity),
+                   field.constMemberPtr(snapshot))) {
+      changed |= FieldMask{1} << i;
+    }
+  }
+
+  if (changed == 0) {
+    return;
+  }
+
+  this->update(description, entity, changed);
+}
+
+bool Connection::increment(const EntityDescription &description,
+                           const std::size_t field, const AsImage &key,
+                           const void *delta, void *result) {
+  const OperationScope scope{description.name, "increment", this->reporting()};
+  const PrimitiveFieldDescription &primitive =
+      getPrimitiveField(description, field);
+  if (primitive.imageType != ImageType::Int &&
+      primitive.imageType != ImageType::Uint &&
+      primitive.imageType != ImageType::Float) {
+    throw std::invalid_argument{
+        fmt::format("Field {}.{} is not numeric", description.name,
+                    description.fields[field].name),
+    };
+  }
+
+  const std::string_view name = description.fields[field].name;
+  const std::string queryStr = fmt::format(
+      R"(UPDATE '{}' SET "{}" = "{}" + ? WHERE {} = ? RETURNING "{}")",
+      description.name, name, name,
+      description.fields[description.primaryKey].name, name);
+
+  const std::array<AsImage, 2> args = {primitive.asImage(delta), key};
+
+  const FieldDescription value = asValue(description.fields[field]);
+  bool found = false;
+  {
+    const Cursor cursor{
+        this->query(queryStr, args),
+        podrm::span<const FieldDescription, 1>{&value, 1},
+    };
+    found = cursor.extract(result);
+  }
+
+  // Autocommit transaction of the update ends with its statement
+  this->settleChanges(true);
+  this->deliverChanges();
+
+  return found;
+}
+
+bool Connection::compareAndSet(const EntityDescription &description,
+                               const std::size_t field, const AsImage &key,
+                               const void *expected, const void *desired) {
+  const OperationScope scope{description.name, "compareAndSet",
+                             this->reporting()};
+  const PrimitiveFieldDescription &primitive =
+      getPrimitiveField(description, field);
+
+  const std::string_view name = description.fields[field].name;
+  const std::string statement =
+      fmt::format(R"(UPDATE '{}' SET "{}" = ? WHERE {} = ? AND "{}" = ?)",
+                  description.name, name,
+                  description.fields[description.primaryKey].name, name);
+
+  const std::array<AsImage, 3> args = {
+      primitive.asImage(desired),
+      key,
+      primitive.asImage(expected),
+  };
+
+  return this->executeCached(statement, args) != 0;
+}
+
+Cursor Connection::iterate(const EntityDescription description) {
+  const OperationScope scope{description.name, "iterate", this->reporting()};
+  const std::string queryStr =
+      fmt::format("SELECT * FROM '{}'", description.name);
+
+  return Cursor{
+      this->query(queryStr),
+      description.fields,
+  };
+}
+
+Cursor Connection::iterate(const EntityDescription description,
+                           const span<const FieldDescription> projection) {
+  const OperationScope scope{description.name, "iterate", this->reporting()};
+  std::vector<std::string_view> columns;
+  for (const FieldDescription &field : projection) {
+    columns.push_back(field.name);
+  }
+
+  const std::string queryStr =
+      fmt::format(R"(SELECT "{}" FROM '{}')", fmt::join(columns, R"(",")"),
+                  description.name);
+
+  return Cursor{
+      this->query(queryStr),
+      projection,
+  };
+}
+
+Cursor Connection::scan(const EntityDescription &description,
+                        const std::size_t field,
+                        const span<const AsImage> after,
+                        const std::int64_t limit) {
+  const OperationScope scope{description.name, "scan", this->reporting()};
+  getPrimitiveField(description, field);
+
+  const std::string_view key = description.fields[description.primaryKey].name;
+  const std::string_view order = description.fields[field].name;
+  const bool byKey = field == description.primaryKey;
+
+  if (!after.empty() && after.size() != (byKey ? 1 : 2)) {
+    throw std::invalid_argument{
+        fmt::format("Scan of {} ordered by {} must continue after both the "
+                    "field value and the primary key",
+                    description.name, order),
+    };
+  }
+
+  fmt::memory_buffer buf;
+  fmt::appender appender{buf};
+
+  fmt::format_to(appender, "SELECT * FROM '{}'", description.name);
+  if (!after.empty()) {
+    if (byKey) {
+      fmt::format_to(appender, R"( WHERE "{}" > ?)", key);
+    } else {
+      fmt::format_to(appender, R"( WHERE ("{}","{}") > (?,?))", order, key);
+    }
+  }
+  if (byKey) {
+    fmt::format_to(appender, R"( ORDER BY "{}" LIMIT ?)", key);
+  } else {
+    fmt::format_to(appender, R"( ORDER BY "{}","{}" LIMIT ?)", order, key);
+  }
+
+  std::vector<AsImage> args{after.begin(), after.end()};
+  args.emplace_back(limit);
+
+  return Cursor{
+      this->queryCached(fmt::to_string(buf), args),
+      description.fields,
+  };
+}
+
+bool Connection::aggregate(const EntityDescription &description,
+                           const AggregateDescription &aggregate,
+                           const span<const Condition> where, void *result) {
+  const OperationScope scope{description.name, "aggregate", this->reporting()};
+  fmt::memory_buffer buf;
+  fmt::appender appender{buf};
+  std::vector<AsImage> args;
+
+  fmt::format_to(appender, "SELECT {} FROM '{}'",
+                 formatAggregate(description, aggregate), description.name);
+  formatWhere(description, where, appender, args);
+  if (aggregate.function != AggregateFunction::Count) {
+    // Aggregates of an empty set are NULL, return no row instead
+    fmt::format_to(appender, " HAVING COUNT(*) > 0");
+  }
+
+  const FieldDescription value{
+      .name = "aggregate",
+      .memberPtr = [](void *value) { return value; },
+      .constMemberPtr = [](const void *value) { return value; },
+      .field = aggregate.result,
+  };
+  const Cursor cursor{
+      this->queryCached(fmt::to_string(buf), args),
+      podrm::span<const FieldDescription, 1>{&value, 1},
+  };
+
+  return cursor.extract(result);
+}
+
+void Connection::parallelScan(
+    const EntityDescription &description, const std::size_t workers,
+    const std::function<void(std::size_t, Cursor &)> &visit) {
+  const OperationScope scope{description.name, "parallelScan",
+                             this->reporting()};
+
+  // Several ranges per worker, so that rows spread unevenly over rowids can
+  // be balanced by stealing
+  constexpr std::uint64_t RangesPerWorker = 16;
+
+  const std::size_t count = workerCount(workers);
+  const char *const filename =
+      sqlite3_db_filename(this->connection.get(), "main");
+  // Memory databases cannot be opened by other connections
+  if (count == 1 || filename == nullptr || *filename == '\0') {
+    Cursor cursor = this->iterate(description);
+    visit(0, cursor);
+    return;
+  }
+
+  std::int64_t first = 0;
+  std::uint64_t width = 0;
+  {
+    const Result bounds = this->query(
+        fmt::format("SELECT min(rowid), max(rowid) FROM '{}' "
+                    "HAVING count(*) > 0",
+                    description.name));
+    const std::optional<Row> row = bounds.getRow();
+    if (!row.has_value()) {
+      return;
+    }
+    first = row->get(0).bigint();
+    width = static_cast<std::uint64_t>(row->get(1).bigint()) -
+            static_cast<std::uint64_t>(first);
+  }
+
+  const auto ranges = static_cast<std::size_t>(
+      std::min(count * RangesPerWorker, std::max<std::uint64_t>(width, 1)));
+  // Splits the rowid span evenly without overflowing on huge spans
+  const auto offset = [width, ranges](const std::uint64_t range) {
+    return width / ranges * range + width % ranges * range / ranges;
+  };
+
+  // Opened here, so that connection errors are thrown in the calling thread
+  const ConnectionOptions readerOptions{
+      .busyTimeout = std::chrono::seconds{5},
+      .noMutex = true,
+      .readOnly = true,
+      .immutable = this->immutable,
+  };
+  std::vector<Connection> readers;
+  readers.reserve(std::min(count, ranges));
+  for (std::size_t i = 0; i < std::min(count, ranges); ++i) {
+    readers.push_back(inFile(filename, readerOptions));
+    readers.back().setObserver(this->observer);
+    if (this->limits != nullptr) {
+      readers.back().setLimits(*this->limits);
+    }
+  }
+
+  const std::string statement =
+      fmt::format("SELECT * FROM '{}' WHERE rowid BETWEEN ? AND ?",
+                  description.name);
+  const auto scanRange = [&](const std::size_t worker,
+                              const std::size_t range) {
+    const OperationScope workerScope{description.name, "parallelScan",
+                                     this->reporting()};
+    const std::uint64_t last =
+        range + 1 == ranges ? width : offset(range + 1) - 1;
+    const std::array<AsImage, 2> bounds = {
+        static_cast<std::int64_t>(static_cast<std::uint64_t>(first) +
+                                  offset(range)),
+        static_cast<std::int64_t>(static_cast<std::uint64_t>(first) + last),
+    };
+    Cursor cursor{readers[worker].queryCached(statement, bounds),
+                  description.fields};
+    visit(worker, cursor);
+  };
+  parallelFor(ranges, readers.size(), scanRange);
+}
+
+Cursor Connection::groupBy(const EntityDescription &description,
+                           const std::size_t key,
+                           const AggregateDescription &aggregate,
+                           const span<const Condition> where,
+                           const span<const FieldDescription> group) {
+  const OperationScope scope{description.name, "groupBy", this->reporting()};
+  getPrimitiveField(description, key);
+
+  fmt::memory_buffer buf;
+  fmt::appender appender{buf};
+  std::vector<AsImage> args;
+
+  const std::string_view name = description.fields[key].name;
+  fmt::format_to(appender, R"(SELECT "{}", {} FROM '{}')", name,
+                 formatAggregate(description, aggregate), description.name);
+  formatWhere(description, where, appender, args);
+  fmt::format_to(appender, R"( GROUP BY "{}" ORDER BY "{}")", name, name);
+
+  return Cursor{
+      this->queryCached(fmt::to_string(buf), args),
+      group,
   };
 }
 
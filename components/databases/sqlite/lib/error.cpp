@@ -0,0 +1,36 @@
+#include "error.hpp"
+
+#include <podrm/cancellation.hpp>
+
+#include <stdexcept>
+#include <utility>
+
+#include <sqlite3.h>
+
+namespace podrm::sqlite::detail {
+
+namespace {
+
+// Progress handler runs in the thread that steps the statement
+thread_local Interruption lastInterruption = Interruption::None;
+
+} // namespace
+
+void setInterruption(const Interruption interruption) {
+  lastInterruption = interruption;
+}
+
+void throwError(sqlite3 &connection, const int code) {
+  if (code != SQLITE_INTERRUPT) {
+    throw std::runtime_error{sqlite3_errmsg(&connection)};
+  }
+
+  // sqlite3_interrupt calls from other threads leave no reason
+  if (std::exchange(lastInterruption, Interruption::None) ==
+      Interruption::TimedOut) {
+    throw OperationTimedOut{};
+  }
+  throw OperationCancelled{};
+}
+
+} // namespace podrm::sqlite::detail
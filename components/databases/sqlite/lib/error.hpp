@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+
+#include <sqlite3.h>
+
+namespace podrm::sqlite::detail {
+
+/// Reason of a statement interrupted by the progress handler
+enum class Interruption : std::uint8_t {
+  None,
+  Cancelled,
+  TimedOut,
+};
+
+/// Remembers why the progress handler interrupts the statement running in
+/// this thread
+void setInterruption(Interruption interruption);
+
+/// @throws OperationCancelled or OperationTimedOut if the statement was
+/// interrupted, std::runtime_error with the connection error otherwise
+[[noreturn]] void throwError(sqlite3 &connection, int code);
+
+} // namespace podrm::sqlite::detail
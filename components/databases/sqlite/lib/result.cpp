@@ -1,38 +1,119 @@
+#include "error.hpp"
+#include "slow_query_trace.hpp"
+
+#include <podrm/observation.hpp>
 #include <podrm/sqlite/detail/result.hpp>
 
 #include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <memory>
 #include <optional>
-#include <stdexcept>
 #include <utility>
+#include <vector>
 
 #include <sqlite3.h>
 
 namespace podrm::sqlite::detail {
 
-Result::Result(Result::Statement statement) : statement(std::move(statement)) {
+namespace {
+
+/// @returns number of bytes of the column value, without converting it
+std::uint64_t columnSize(sqlite3_stmt *const statement, const int column) {
+  switch (sqlite3_column_type(statement, column)) {
+  case SQLITE_INTEGER:
+  case SQLITE_FLOAT:
+    return sizeof(std::int64_t);
+  case SQLITE_NULL:
+    return 0;
+  default:
+    return static_cast<std::uint64_t>(sqlite3_column_bytes(statement, column));
+  }
+}
+
+} // namespace
+
+Result::Result(Result::Statement statement, std::vector<AsImage> arguments,
+               std::unique_ptr<podrm::detail::Observation> observation,
+               std::shared_ptr<SlowQueryTrace> slowQueries)
+    : arguments(std::move(arguments)), statement(std::move(statement)),
+      observation(std::move(observation)),
+      slowQueries(std::move(slowQueries)) {
   this->nextRow();
 }
 
+Result::Result(Result &&other) noexcept = default;
+
+Result &Result::operator=(Result &&other) noexcept {
+  if (this != &other) {
+    this->finishObservation();
+    this->statement = std::move(other.statement);
+    this->reportSlowQueries();
+    this->arguments = std::move(other.arguments);
+    this->columnCount = other.columnCount;
+    this->observation = std::move(other.observation);
+    this->slowQueries = std::move(other.slowQueries);
+  }
+  return *this;
+}
+
+Result::~Result() {
+  this->finishObservation();
+  // Statement is traced once it is reset
+  this->statement.reset();
+  this->reportSlowQueries();
+}
+
 bool Result::nextRow() {
   assert(this->statement.has_value());
 
   const int result = sqlite3_step(this->statement->get());
+  if (this->observation != nullptr) {
+    this->observation->event.executeTime += this->observation->stopwatch.lap();
+  }
+
   if (result == SQLITE_DONE) {
     this->statement.reset();
+    this->finishObservation();
+    this->reportSlowQueries();
     return false;
   }
 
   if (result != SQLITE_ROW) {
-    throw std::runtime_error{
-        sqlite3_errmsg(sqlite3_db_handle(this->statement->get())),
-    };
+    throwError(*sqlite3_db_handle(this->statement->get()), result);
   }
 
   this->columnCount = sqlite3_data_count(this->statement->get());
 
+  if (this->observation != nullptr) {
+    StatementEvent &event = this->observation->event;
+    ++event.rows;
+    for (int column = 0; column < this->columnCount; ++column) {
+      event.bytesDecoded += columnSize(this->statement->get(), column);
+    }
+    // Time spent by the caller between steps is not execution time
+    this->observation->stopwatch.lap();
+  }
+
   return true;
 }
 
 bool Result::valid() const { return this->statement.has_value(); }
 
+void Result::finishObservation() {
+  if (this->observation == nullptr) {
+    return;
+  }
+
+  const std::unique_ptr<podrm::detail::Observation> observation =
+      std::move(this->observation);
+  observation->emit();
+}
+
+void Result::reportSlowQueries() {
+  if (this->slowQueries != nullptr) {
+    this->slowQueries->report();
+  }
+}
+
 } // namespace podrm::sqlite::detail
@@ -0,0 +1,117 @@
+#include <podrm/metadata.hpp>
+#include <podrm/multilambda.hpp>
+#include <podrm/span.hpp>
+#include <podrm/sqlite/connection_options.hpp>
+#include <podrm/sqlite/database.hpp>
+#include <podrm/sqlite/sharded_database.hpp>
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <fmt/core.h>
+
+namespace podrm::sqlite {
+
+namespace detail {
+
+namespace {
+
+constexpr std::uint64_t FnvOffset = 14695981039346656037ULL;
+constexpr std::uint64_t FnvPrime = 1099511628211ULL;
+
+std::uint64_t fnv1a(const span<const std::byte> bytes) {
+  std::uint64_t hash = FnvOffset;
+  for (const std::byte byte : bytes) {
+    hash ^= static_cast<std::uint64_t>(byte);
+    hash *= FnvPrime;
+  }
+  return hash;
+}
+
+std::uint64_t fnv1a(const std::string_view str) {
+  return fnv1a(span<const std::byte>{
+      reinterpret_cast<const std::byte *>(str.data()), str.size()});
+}
+
+/// Hashes the bytes of the value in little-endian order, so that the
+/// shards of numeric keys do not depend on the platform
+std::uint64_t fnv1a(const std::uint64_t value) {
+  std::uint64_t hash = FnvOffset;
+  for (std::size_t i = 0; i < sizeof(value); ++i) {
+    hash ^= (value >> (i * 8)) & 0xFF;
+    hash *= FnvPrime;
+  }
+  return hash;
+}
+
+} // namespace
+
+std::size_t defaultShard(const AsImage &key, const std::size_t shards) {
+  const podrm::detail::MultiLambda hash{
+      [](const span<const std::byte> bytes) { return fnv1a(bytes); },
+      [](const std::vector<std::byte> &bytes) {
+        return fnv1a(span<const std::byte>{bytes.data(), bytes.size()});
+      },
+      [](const std::string_view str) { return fnv1a(str); },
+      [](const std::string &str) { return fnv1a(std::string_view{str}); },
+      [](const double value) {
+        return fnv1a(std::bit_cast<std::uint64_t>(value));
+      },
+      [](const std::uint64_t value) { return fnv1a(value); },
+      [](const std::int64_t value) {
+        return fnv1a(static_cast<std::uint64_t>(value));
+      },
+      [](const bool value) { return fnv1a(std::uint64_t{value}); },
+  };
+
+  return static_cast<std::size_t>(std::visit(hash, key) % shards);
+}
+
+} // namespace detail
+
+ShardedDatabase::ShardedDatabase(std::vector<Database> shards)
+    : shards(std::move(shards)) {
+  if (this->shards.empty()) {
+    throw std::invalid_argument{"Sharded database needs at least one shard"};
+  }
+}
+
+ShardedDatabase
+ShardedDatabase::inFiles(const span<const std::filesystem::path> paths,
+                         const ConnectionOptions &options) {
+  std::vector<Database> shards;
+  shards.reserve(paths.size());
+  for (const std::filesystem::path &path : paths) {
+    shards.push_back(Database::inFile(path, options));
+  }
+  return ShardedDatabase{std::move(shards)};
+}
+
+std::size_t ShardedDatabase::shardOf(const EntityDescription &entity,
+                                     const void *key) const {
+  const auto function = this->shardFunctions.find(entity.name);
+  if (function == this->shardFunctions.end()) {
+    return detail::defaultShard(
+        getPrimitiveDescription(entity, entity.primaryKey).asImage(key),
+        this->shards.size());
+  }
+
+  const std::size_t shard = function->second(key);
+  if (shard >= this->shards.size()) {
+    throw std::out_of_range{
+        fmt::format("Shard function of {} returned shard {} of {}",
+                    entity.name, shard, this->shards.size()),
+    };
+  }
+  return shard;
+}
+
+} // namespace podrm::sqlite
@@ -0,0 +1,62 @@
+#include <podrm/sqlite/slow_query_log.hpp>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+#include <fmt/core.h>
+#include <fmt/format.h>
+
+namespace podrm::sqlite {
+
+SlowQueryLog SlowQueryLog::toFile(const std::filesystem::path &path,
+                                  const std::chrono::nanoseconds threshold) {
+  struct File {
+    std::mutex mutex;
+    std::ofstream stream;
+  };
+
+  auto file = std::make_shared<File>();
+  file->stream.open(path, std::ios::app);
+  if (!file->stream.is_open()) {
+    throw std::runtime_error{
+        fmt::format("Failed to open slow query log {}", path.string()),
+    };
+  }
+
+  return SlowQueryLog{
+      .threshold = threshold,
+      .callback =
+          [file = std::move(file)](const SlowQuery &query) {
+            const std::lock_guard lock{file->mutex};
+            file->stream << query << std::flush;
+          },
+  };
+}
+
+std::ostream &operator<<(std::ostream &stream, const SlowQuery &query) {
+  const std::chrono::duration<double, std::milli> elapsed = query.elapsed;
+  stream << fmt::format("slow query {:.3f} ms", elapsed.count());
+  if (!query.operation.empty()) {
+    stream << fmt::format(" in {} of {}", query.operation, query.entity);
+  }
+  stream << (query.fullScan ? ", full scan\n" : "\n");
+
+  stream << "  statement: " << query.statement << '\n';
+  if (!query.parameterTypes.empty()) {
+    stream << fmt::format("  parameters: {}\n",
+                          fmt::join(query.parameterTypes, ", "));
+  }
+  for (const std::string &line : query.plan) {
+    stream << "  plan: " << line << '\n';
+  }
+
+  return stream;
+}
+
+} // namespace podrm::sqlite
@@ -0,0 +1,139 @@
+#include "slow_query_trace.hpp"
+
+#include <podrm/instrumentation.hpp>
+#include <podrm/sqlite/slow_query_log.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fmt/core.h>
+#include <sqlite3.h>
+
+namespace podrm::sqlite::detail {
+
+namespace {
+
+/// Set while the current thread explains a plan, so that the explanation
+/// itself is not traced
+thread_local bool explaining = false;
+
+/// @returns whether the EXPLAIN QUERY PLAN step reads a whole table, scans
+/// through an index do not count
+bool isFullScan(const std::string_view detail) {
+  return detail.starts_with("SCAN ") &&
+         detail.find(" USING ") == std::string_view::npos &&
+         !detail.starts_with("SCAN CONSTANT ROW");
+}
+
+/// Fills the plan of the statement, leaves it empty if the statement cannot
+/// be explained
+void explainPlan(sqlite3 &connection, const std::string_view statement,
+                 SlowQuery &query) {
+  const std::string explain = fmt::format("EXPLAIN QUERY PLAN {}", statement);
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v2(&connection, explain.c_str(),
+                         static_cast<int>(explain.size()), &stmt,
+                         nullptr) != SQLITE_OK) {
+    return;
+  }
+  const std::unique_ptr<sqlite3_stmt, int (*)(sqlite3_stmt *)> guard{
+      stmt, &sqlite3_finalize};
+
+  // Columns are id, parent id, unused and the step description
+  std::unordered_map<int, std::size_t> depths;
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    const auto parent = depths.find(sqlite3_column_int(stmt, 1));
+    const std::size_t depth = parent == depths.end() ? 0 : parent->second + 1;
+    depths[sqlite3_column_int(stmt, 0)] = depth;
+
+    const std::string_view detail{
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        reinterpret_cast<const char *>(sqlite3_column_text(stmt, 3)),
+        static_cast<std::size_t>(sqlite3_column_bytes(stmt, 3)),
+    };
+    query.fullScan = query.fullScan || isFullScan(detail);
+    query.plan.push_back(std::string(depth * 2, ' ') + std::string{detail});
+  }
+}
+
+} // namespace
+
+int SlowQueryTrace::profile(const unsigned type, void *const context,
+                            void *const statement, void *const elapsed) {
+  auto &trace = *static_cast<SlowQueryTrace *>(context);
+  auto *const stmt = static_cast<sqlite3_stmt *>(statement);
+  if (type != SQLITE_TRACE_PROFILE || explaining) {
+    return 0;
+  }
+
+  // Exceptions must not be thrown through SQLite
+  try {
+    SlowQuery query{
+        .entity = podrm::detail::currentOperation.entity,
+        .operation = podrm::detail::currentOperation.operation,
+        .statement = {},
+        .parameterTypes = {},
+        .elapsed = std::chrono::nanoseconds{
+            *static_cast<const sqlite3_int64 *>(elapsed)},
+        .plan = {},
+        .fullScan = false,
+    };
+
+    const std::lock_guard lock{trace.mutex};
+    const auto types = trace.parameterTypes.find(stmt);
+    if (types != trace.parameterTypes.end()) {
+      query.parameterTypes = std::move(types->second);
+      trace.parameterTypes.erase(types);
+    }
+
+    if (query.elapsed < trace.log.threshold) {
+      return 0;
+    }
+
+    char *const expanded = sqlite3_expanded_sql(stmt);
+    query.statement = expanded != nullptr ? expanded : sqlite3_sql(stmt);
+    sqlite3_free(expanded);
+
+    trace.pending.emplace_back(sqlite3_sql(stmt), std::move(query));
+  } catch (...) {
+    // The statement is done, a failed report must not fail it
+  }
+
+  return 0;
+}
+
+void SlowQueryTrace::setParameterTypes(sqlite3_stmt &statement,
+                                       std::vector<std::string_view> types) {
+  const std::lock_guard lock{this->mutex};
+  this->parameterTypes[&statement] = std::move(types);
+}
+
+void SlowQueryTrace::report() {
+  std::vector<std::pair<std::string, SlowQuery>> queries;
+  {
+    const std::lock_guard lock{this->mutex};
+    queries.swap(this->pending);
+  }
+
+  for (auto &[statement, query] : queries) {
+    // The statement is done, a failed report must not fail its caller
+    try {
+      explaining = true;
+      explainPlan(this->connection, statement, query);
+      explaining = false;
+
+      this->log.callback(query);
+    } catch (...) {
+      explaining = false;
+    }
+  }
+}
+
+} // namespace podrm::sqlite::detail
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <podrm/sqlite/slow_query_log.hpp>
+
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <sqlite3.h>
+
+namespace podrm::sqlite::detail {
+
+/// Slow query log of a connection. The trace callback only queues slow
+/// statements, they are explained and reported once done, since the
+/// connection must not be used from within the callback
+class SlowQueryTrace {
+public:
+  SlowQueryTrace(sqlite3 &connection, SlowQueryLog log)
+      : connection(connection), log(std::move(log)) {}
+
+  /// SQLITE_TRACE_PROFILE callback, the context is the trace
+  static int profile(unsigned type, void *context, void *statement,
+                     void *elapsed);
+
+  /// Remembers storage classes of the arguments bound to the statement
+  void setParameterTypes(sqlite3_stmt &statement,
+                         std::vector<std::string_view> types);
+
+  /// Explains the queued statements and passes them to the log. Runs the
+  /// explanations on the connection, so it must not be called from SQLite
+  /// callbacks
+  void report();
+
+private:
+  sqlite3 &connection;
+
+  SlowQueryLog log;
+
+  /// Guards the fields below, results are stepped without the connection
+  /// mutex
+  std::mutex mutex;
+
+  std::unordered_map<sqlite3_stmt *, std::vector<std::string_view>>
+      parameterTypes;
+
+  /// Slow statements waiting for their plans, with the text to explain
+  std::vector<std::pair<std::string, SlowQuery>> pending;
+};
+
+} // namespace podrm::sqlite::detail
@@ -1,18 +1,39 @@
 #include "field.hpp"
 
+#include <podrm/aggregate.hpp>
+#include <podrm/cancellation.hpp>
+#include <podrm/hdr_histogram.hpp>
+#include <podrm/instrumentation.hpp>
 #include <podrm/metadata.hpp>
+#include <podrm/predicate.hpp>
+#include <podrm/prefetch.hpp>
 #include <podrm/reflection.hpp>
 #include <podrm/span.hpp>
 #include <podrm/sqlite.hpp>
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cstdint>
+#include <filesystem>
+#include <fstream>
 #include <functional>
+#include <iterator>
+#include <mutex>
 #include <optional>
+#include <ranges>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include <catch2/catch_test_macros.hpp>
+#include <sqlite3.h>
 
 namespace orm = podrm::sqlite;
 
@@ -60,6 +81,42 @@ constexpr auto podrm::EntityRegistration<Person> =
 
 static_assert(podrm::DatabaseEntity<Person>);
 
+namespace {
+
+struct PersonName {
+  std::int64_t id;
+
+  std::string name;
+};
+
+struct PersonAge {
+  std::int64_t id;
+
+  std::int64_t age;
+};
+
+} // namespace
+
+static_assert(podrm::ProjectionOf<PersonName, Person>);
+static_assert(not podrm::ProjectionOf<PersonAge, Person>);
+
+namespace {
+
+struct Counter {
+  std::int64_t id;
+
+  std::int64_t hits;
+};
+
+} // namespace
+
+template <>
+constexpr auto podrm::EntityRegistration<Counter> =
+    podrm::EntityRegistrationData<Counter>{
+        .id = test::Field<Counter, &Counter::id>,
+        .idMode = IdMode::Manual,
+    };
+
 TEST_CASE("SQLite works", "[sqlite]") {
   orm::Database db = orm::Database::inMemory("test");
 
@@ -94,6 +151,43 @@ TEST_CASE("SQLite works", "[sqlite]") {
 
   REQUIRE_NOTHROW(db.persist(person));
 
+  SECTION("persist writes back generated ids") {
+    CHECK(address.id != 0);
+    CHECK(person.id != 0);
+
+    Person newPerson{
+        .id = person.id,
+        .name = "John",
+        .address{.key = address.id},
+    };
+    REQUIRE_NOTHROW(db.persist(newPerson));
+    CHECK(newPerson.id != person.id);
+  }
+
+  SECTION("persistMany writes back generated ids") {
+    std::array people = {
+        Person{
+            .id = 0,
+            .name = "John",
+            .address{.key = address.id},
+        },
+        Person{
+            .id = 0,
+            .name = "Jane",
+            .address{.key = address.id},
+        },
+    };
+    REQUIRE_NOTHROW(db.persistMany(people));
+    CHECK(people[0].id != person.id);
+    CHECK(people[1].id != people[0].id);
+
+    for (const Person &expected : people) {
+      const std::optional<Person> personFound = db.find<Person>(expected.id);
+      REQUIRE(personFound.has_value());
+      CHECK(*personFound == expected);
+    }
+  }
+
   SECTION("find on non-existent id returns nullopt") {
     const std::optional<Person> person = db.find<Person>(42);
     CHECK_FALSE(person.has_value());
@@ -139,6 +233,103 @@ TEST_CASE("SQLite works", "[sqlite]") {
     CHECK(personFound->name == "Anne");
   }
 
+  SECTION("update of selected fields does not write other fields") {
+    person.name = "Anne";
+    person.address.key = 42;
+    REQUIRE_NOTHROW(
+        db.update(person, podrm::test::Field<Person, &Person::name>));
+
+    const std::optional<Person> personFound = db.find<Person>(person.id);
+    REQUIRE(personFound.has_value());
+    CHECK(personFound->name == "Anne");
+    CHECK(personFound->address.key == address.id);
+  }
+
+  SECTION("update against a snapshot writes only changed fields") {
+    Address newAddress{
+        .id = 1,
+        .postalCode = "def",
+    };
+    REQUIRE_NOTHROW(db.persist(newAddress));
+
+    const std::optional<Person> snapshot = db.find<Person>(person.id);
+    REQUIRE(snapshot.has_value());
+
+    Person renamed = *snapshot;
+    renamed.name = "Bob";
+    REQUIRE_NOTHROW(db.update(renamed));
+
+    Person moved = *snapshot;
+    moved.address.key = newAddress.id;
+    REQUIRE_NOTHROW(db.update(moved, *snapshot));
+
+    const std::optional<Person> personFound = db.find<Person>(person.id);
+    REQUIRE(personFound.has_value());
+    CHECK(personFound->name == "Bob");
+    CHECK(personFound->address.key == newAddress.id);
+  }
+
+  SECTION("update against an unchanged snapshot does nothing") {
+    REQUIRE_NOTHROW(db.erase<Person>(person.id));
+    CHECK_NOTHROW(db.update(person, person));
+  }
+
+  SECTION("upsert updates an existing entity") {
+    person.name = "Anne";
+    REQUIRE_NOTHROW(db.upsert(person));
+
+    const std::optional<Person> personFound = db.find<Person>(person.id);
+    REQUIRE(personFound.has_value());
+    CHECK(personFound->name == "Anne");
+  }
+
+  SECTION("upsertMany inserts new and updates existing entities") {
+    person.name = "Anne";
+    const std::array people = {
+        person,
+        Person{
+            .id = person.id + 1,
+            .name = "John",
+            .address{.key = address.id},
+        },
+    };
+    REQUIRE_NOTHROW(db.upsertMany(people));
+
+    for (const Person &expected : people) {
+      const std::optional<Person> personFound = db.find<Person>(expected.id);
+      REQUIRE(personFound.has_value());
+      CHECK(*personFound == expected);
+    }
+  }
+
+  SECTION("upsertMany is rolled back on failure") {
+    const std::array people = {
+        Person{
+            .id = person.id + 1,
+            .name = "John",
+            .address{.key = address.id},
+        },
+        Person{
+            .id = person.id + 2,
+            .name = "Jane",
+            .address{.key = 42},
+        },
+    };
+    CHECK_THROWS(db.upsertMany(people));
+    CHECK_FALSE(db.find<Person>(person.id + 1).has_value());
+  }
+
+  SECTION("iterateAs reads only the projected columns") {
+    int i = 0;
+    for (const PersonName &result : db.iterateAs<Person, PersonName>()) {
+      CHECK(result.id == person.id);
+      CHECK(result.name == person.name);
+      ++i;
+    }
+
+    CHECK(i == 1);
+  }
+
   SECTION("iterate iterates over existing entities") {
     Person newPerson{
         .id = 1,
@@ -162,3 +353,1409 @@ TEST_CASE("SQLite works", "[sqlite]") {
     CHECK(i == 2);
   }
 }
+
+TEST_CASE("SQLite atomic field operations", "[sqlite]") {
+  orm::Database db = orm::Database::inMemory("test");
+
+  REQUIRE_NOTHROW(db.createTable<Counter>());
+
+  Counter counter{
+      .id = 1,
+      .hits = 0,
+  };
+  REQUIRE_NOTHROW(db.persist(counter));
+
+  SECTION("increment returns the new value") {
+    CHECK(db.increment<&Counter::hits>(counter.id, 2) == 2);
+    CHECK(db.increment<&Counter::hits>(counter.id, -1) == 1);
+
+    const std::optional<Counter> counterFound = db.find<Counter>(counter.id);
+    REQUIRE(counterFound.has_value());
+    CHECK(counterFound->hits == 1);
+  }
+
+  SECTION("increment on non-existent id returns nullopt") {
+    CHECK_FALSE(db.increment<&Counter::hits>(42, 1).has_value());
+  }
+
+  SECTION("compareAndSet replaces only the expected value") {
+    CHECK(db.compareAndSet<&Counter::hits>(counter.id, 0, 5));
+    CHECK_FALSE(db.compareAndSet<&Counter::hits>(counter.id, 0, 7));
+
+    const std::optional<Counter> counterFound = db.find<Counter>(counter.id);
+    REQUIRE(counterFound.has_value());
+    CHECK(counterFound->hits == 5);
+  }
+
+  SECTION("compareAndSet on non-existent id does nothing") {
+    CHECK_FALSE(db.compareAndSet<&Counter::hits>(42, 0, 5));
+  }
+}
+
+TEST_CASE("SQLite keyset pagination", "[sqlite]") {
+  orm::Database db = orm::Database::inMemory("test");
+
+  REQUIRE_NOTHROW(db.createTable<Counter>());
+  REQUIRE_NOTHROW(db.createIndex<&Counter::hits>());
+
+  std::vector<Counter> counters = {
+      {.id = 3, .hits = 20}, {.id = 1, .hits = 30}, {.id = 4, .hits = 10},
+      {.id = 5, .hits = 40}, {.id = 2, .hits = 10},
+  };
+  REQUIRE_NOTHROW(db.persistMany(counters));
+
+  const auto collectIds = [](auto &&scan) {
+    std::vector<std::int64_t> ids;
+    for (const Counter &counter : scan) {
+      ids.push_back(counter.id);
+    }
+    return ids;
+  };
+
+  SECTION("scan is ordered by the primary key") {
+    CHECK(collectIds(db.scan<Counter>()) ==
+          std::vector<std::int64_t>{1, 2, 3, 4, 5});
+  }
+
+  SECTION("scan continues after the last key") {
+    CHECK(collectIds(db.scan<Counter>().limit(2)) ==
+          std::vector<std::int64_t>{1, 2});
+    CHECK(collectIds(db.scan<Counter>().after(2).limit(2)) ==
+          std::vector<std::int64_t>{3, 4});
+    CHECK(collectIds(db.scan<Counter>().after(4).limit(2)) ==
+          std::vector<std::int64_t>{5});
+  }
+
+  SECTION("scan ordered by a field continues after the last entity") {
+    orm::Scan<Counter> scan = db.scan<Counter>().orderBy<&Counter::hits>();
+    CHECK(collectIds(scan) == std::vector<std::int64_t>{2, 4, 3, 1, 5});
+
+    CHECK(collectIds(scan.after(Counter{.id = 2, .hits = 10}).limit(2)) ==
+          std::vector<std::int64_t>{4, 3});
+  }
+
+  SECTION("scan ordered by a field requires the last entity") {
+    CHECK_THROWS(
+        collectIds(db.scan<Counter>().orderBy<&Counter::hits>().after(2)));
+  }
+}
+
+TEST_CASE("SQLite cursors keep their arguments", "[sqlite]") {
+  orm::Database db = orm::Database::inMemory("test");
+
+  REQUIRE_NOTHROW(db.createTable<Address>());
+  REQUIRE_NOTHROW(db.createTable<Person>());
+
+  Address address{.id = 0, .postalCode = "abc"};
+  REQUIRE_NOTHROW(db.persist(address));
+
+  // Names are too long for the small string buffer, so that freed
+  // arguments are not read back by chance
+  constexpr int People = 2000;
+  const auto nameOf = [](const int i) {
+    std::string number = std::to_string(i);
+    return "person with a name longer than the small string buffer " +
+           std::string(4 - number.size(), '0') + number;
+  };
+
+  std::vector<Person> people;
+  for (int i = 0; i < People; ++i) {
+    people.push_back({.id = 0, .name = nameOf(i), .address{address.id}});
+  }
+  REQUIRE_NOTHROW(db.persistMany(people));
+  // Ordered by the index, rows are produced as the result is stepped
+  REQUIRE_NOTHROW(db.createIndex<&Person::name>());
+
+  SECTION("scan continues after a string key") {
+    std::vector<std::string> names;
+    for (const Person &person :
+         db.scan<Person>().orderBy<&Person::name>().after(people[999])) {
+      names.push_back(person.name);
+    }
+
+    REQUIRE(names.size() == People - 1000);
+    CHECK(names.front() == nameOf(1000));
+    CHECK(names.back() == nameOf(People - 1));
+  }
+
+  SECTION("groupBy filters by a string") {
+    const auto groups = db.groupBy<&Person::name>(
+        podrm::Count<Person>, podrm::Column<&Person::name> != nameOf(0));
+
+    REQUIRE(groups.size() == People - 1);
+    CHECK(groups.front() == std::pair{nameOf(1), std::uint64_t{1}});
+    CHECK(groups.back() == std::pair{nameOf(People - 1), std::uint64_t{1}});
+  }
+}
+
+TEST_CASE("SQLite aggregates", "[sqlite]") {
+  orm::Database db = orm::Database::inMemory("test");
+
+  REQUIRE_NOTHROW(db.createTable<Address>());
+  REQUIRE_NOTHROW(db.createTable<Person>());
+
+  Address address{.id = 0, .postalCode = "abc"};
+  REQUIRE_NOTHROW(db.persist(address));
+
+  std::vector<Person> people = {
+      {.id = 0, .name = "Alex", .address{.key = address.id}},
+      {.id = 0, .name = "Bob", .address{.key = address.id}},
+      {.id = 0, .name = "Alex", .address{.key = address.id}},
+  };
+  REQUIRE_NOTHROW(db.persistMany(people));
+
+  SECTION("count counts matching entities") {
+    CHECK(db.count<Person>() == 3);
+    CHECK(db.count<Person>(podrm::Column<&Person::name> == "Alex") == 2);
+    CHECK(db.count<Person>(podrm::Column<&Person::name> == "Alex" &&
+                           podrm::Column<&Person::id> > people[0].id) == 1);
+    CHECK(db.count<Person>(podrm::Column<&Person::name> == "John") == 0);
+  }
+
+  SECTION("sum, min and max are computed over matching entities") {
+    const std::int64_t first = people[0].id;
+    const std::int64_t last = people[2].id;
+
+    CHECK(db.sum<&Person::id>() == first + people[1].id + last);
+    CHECK(db.sum<&Person::id>(podrm::Column<&Person::name> == "John") == 0);
+    CHECK(db.min<&Person::id>() == first);
+    CHECK(db.max<&Person::id>(podrm::Column<&Person::name> == "Alex") == last);
+    CHECK(db.max<&Person::name>() == "Bob");
+    CHECK_FALSE(db.min<&Person::id>(podrm::Column<&Person::name> == "John")
+                    .has_value());
+  }
+
+  SECTION("groupBy aggregates each group") {
+    using Groups = std::vector<std::pair<std::string, std::uint64_t>>;
+    CHECK(db.groupBy<&Person::name>(podrm::Count<Person>) ==
+          Groups{{"Alex", 2}, {"Bob", 1}});
+
+    CHECK(db.groupBy<&Person::name>(podrm::Max<&Person::id>) ==
+          std::vector<std::pair<std::string, std::int64_t>>{
+              {"Alex", people[2].id},
+              {"Bob", people[1].id},
+          });
+
+    CHECK(db.groupBy<&Person::name>(podrm::Count<Person>,
+                                    podrm::Column<&Person::name> != "Bob") ==
+          Groups{{"Alex", 2}});
+  }
+}
+
+TEST_CASE("SQLite bulk operations", "[sqlite]") {
+  orm::Database db = orm::Database::inMemory("test");
+
+  REQUIRE_NOTHROW(db.createTable<Counter>());
+
+  std::vector<Counter> counters = {
+      {.id = 1, .hits = 10},
+      {.id = 2, .hits = 20},
+      {.id = 3, .hits = 30},
+  };
+  REQUIRE_NOTHROW(db.persistMany(counters));
+
+  SECTION("eraseWhere erases only matching entities") {
+    CHECK(db.eraseWhere(podrm::Column<&Counter::hits> >= 20) == 2);
+    CHECK(db.eraseWhere(podrm::Column<&Counter::hits> >= 20) == 0);
+    CHECK(db.count<Counter>() == 1);
+  }
+
+  SECTION("eraseMany ignores missing keys") {
+    CHECK(db.eraseMany<Counter>(std::vector<std::int64_t>{1, 3, 42}) == 2);
+    CHECK(db.find<Counter>(2).has_value());
+    CHECK(db.count<Counter>() == 1);
+  }
+
+  SECTION("eraseMany erases more keys than a statement binds") {
+    std::vector<Counter> more;
+    for (std::int64_t id = 4; id <= 700; ++id) {
+      more.push_back({.id = id, .hits = 0});
+    }
+    REQUIRE_NOTHROW(db.persistMany(more));
+
+    std::vector<std::int64_t> keys;
+    for (std::int64_t id = 2; id <= 600; ++id) {
+      keys.push_back(id);
+    }
+    CHECK(db.eraseMany<Counter>(keys) == 599);
+    CHECK(db.count<Counter>() == 101);
+    CHECK(db.find<Counter>(1).has_value());
+    CHECK(db.find<Counter>(601).has_value());
+  }
+
+  SECTION("updateWhere applies assignments to matching entities") {
+    CHECK(db.updateWhere(podrm::Column<&Counter::id> != 2,
+                         podrm::Column<&Counter::hits>.add(5)) == 2);
+    CHECK(db.updateWhere<Counter>({}, podrm::Column<&Counter::hits>.add(1)) ==
+          3);
+    CHECK(db.find<Counter>(1)->hits == 16);
+    CHECK(db.find<Counter>(2)->hits == 21);
+
+    CHECK(db.updateWhere(podrm::Column<&Counter::hits> > 30,
+                         podrm::Column<&Counter::hits>.set(0)) == 1);
+    CHECK(db.find<Counter>(3)->hits == 0);
+  }
+
+  SECTION("bulk operations are rolled back with the transaction") {
+    {
+      orm::Transaction transaction = db.begin();
+      CHECK(db.eraseWhere<Counter>({}) == 3);
+      CHECK(db.count<Counter>() == 0);
+    }
+    CHECK(db.count<Counter>() == 3);
+
+    orm::Transaction transaction = db.begin();
+    CHECK(db.updateWhere<Counter>({}, podrm::Column<&Counter::hits>.set(1)) ==
+          3);
+    CHECK(db.eraseMany<Counter>(std::vector<std::int64_t>{1}) == 1);
+    transaction.commit();
+
+    CHECK(db.sum<&Counter::hits>() == 2);
+  }
+
+  SECTION("savepoints undo a part of the transaction") {
+    orm::Transaction transaction = db.begin();
+    CHECK(db.eraseMany<Counter>(std::vector<std::int64_t>{1}) == 1);
+    {
+      orm::Savepoint savepoint = db.savepoint();
+      CHECK(db.eraseWhere<Counter>({}) == 2);
+    }
+    orm::Savepoint savepoint = db.savepoint();
+    CHECK(db.eraseMany<Counter>(std::vector<std::int64_t>{2}) == 1);
+    savepoint.release();
+    transaction.commit();
+
+    CHECK(db.count<Counter>() == 1);
+    CHECK(db.find<Counter>(3).has_value());
+  }
+}
+
+TEST_CASE("SQLite operation limits", "[sqlite]") {
+  orm::Database db = orm::Database::inMemory("test");
+
+  REQUIRE_NOTHROW(db.createTable<Counter>());
+
+  std::vector<Counter> counters;
+  for (std::int64_t i = 1; i <= 5000; ++i) {
+    counters.push_back({.id = i, .hits = i});
+  }
+  REQUIRE_NOTHROW(db.persistMany(counters));
+
+  SECTION("expired deadline fails operations until the scope ends") {
+    {
+      const orm::LimitScope scope = db.limit(
+          podrm::OperationLimits::timeout(std::chrono::seconds{-1}));
+      CHECK_THROWS_AS(db.count<Counter>(), podrm::OperationTimedOut);
+      CHECK_THROWS_AS(db.find<Counter>(1), podrm::OperationTimedOut);
+    }
+    CHECK(db.count<Counter>() == 5000);
+  }
+
+  SECTION("cancellation interrupts a running statement") {
+    podrm::CancellationSource source;
+    const orm::LimitScope scope = db.limit({.token = source.token()});
+
+    std::int64_t seen = 0;
+    const auto iterateAll = [&db, &source, &seen] {
+      for (const Counter &counter : db.iterate<Counter>()) {
+        static_cast<void>(counter);
+        if (++seen == 10) {
+          source.cancel();
+        }
+      }
+    };
+    CHECK_THROWS_AS(iterateAll(), podrm::OperationCancelled);
+    CHECK(seen < 5000);
+  }
+}
+
+TEST_CASE("SQLite connection options", "[sqlite]") {
+  const std::filesystem::path path =
+      std::filesystem::temp_directory_path() / "podrm-connection-options.db";
+  std::filesystem::remove(path);
+
+  SECTION("presets are applied") {
+    sqlite3 *raw = nullptr;
+    REQUIRE(sqlite3_open(path.string().c_str(), &raw) == SQLITE_OK);
+    orm::Database db =
+        orm::Database::fromRaw(*raw, orm::ConnectionOptions::readMostly());
+
+    std::string journalMode;
+    sqlite3_exec(
+        raw, "PRAGMA journal_mode",
+        [](void *data, int /*columns*/, char **values, char ** /*names*/) {
+          *static_cast<std::string *>(data) = values[0];
+          return 0;
+        },
+        &journalMode, nullptr);
+    CHECK(journalMode == "wal");
+
+    REQUIRE_NOTHROW(db.createTable<Counter>());
+    Counter counter{.id = 1, .hits = 2};
+    REQUIRE_NOTHROW(db.persist(counter));
+    CHECK(db.find<Counter>(1)->hits == 2);
+  }
+
+  SECTION("unsupported journal modes are rejected") {
+    CHECK_THROWS_AS(
+        orm::Database::inMemory("test", {.journalMode = orm::JournalMode::Wal}),
+        std::runtime_error);
+    CHECK_NOTHROW(orm::Database::inMemory(
+        "test", {.journalMode = orm::JournalMode::Memory}));
+  }
+
+  SECTION("read-only connection rejects writes") {
+    CHECK_THROWS_AS(orm::Database::inFile(path, {.readOnly = true}),
+                    std::runtime_error);
+
+    orm::Database::inFile(path, orm::ConnectionOptions::durable())
+        .createTable<Counter>();
+
+    orm::Database db = orm::Database::inFile(path, {.readOnly = true});
+    CHECK(db.count<Counter>() == 0);
+    Counter counter{.id = 1, .hits = 2};
+    CHECK_THROWS_AS(db.persist(counter), std::runtime_error);
+  }
+}
+
+TEST_CASE("SQLite savepoints", "[sqlite]") {
+  sqlite3 *raw = nullptr;
+  REQUIRE(sqlite3_open(":memory:", &raw) == SQLITE_OK);
+  orm::Database db = orm::Database::fromRaw(*raw);
+
+  REQUIRE_NOTHROW(db.createTable<Counter>());
+  Counter counter{.id = 1, .hits = 0};
+  REQUIRE_NOTHROW(db.persist(counter));
+
+  SECTION("savepoints of the user do not clash with own ones") {
+    orm::Savepoint savepoint = db.savepoint();
+    CHECK(db.eraseMany<Counter>(std::vector<std::int64_t>{1}) == 1);
+    REQUIRE(sqlite3_exec(raw, "SAVEPOINT podrm", nullptr, nullptr,
+                         nullptr) == SQLITE_OK);
+
+    savepoint.rollback();
+    CHECK(db.find<Counter>(1).has_value());
+  }
+}
+
+TEST_CASE("SQLite bulk load", "[sqlite]") {
+  sqlite3 *raw = nullptr;
+  REQUIRE(sqlite3_open(":memory:", &raw) == SQLITE_OK);
+  orm::Database db = orm::Database::fromRaw(*raw);
+
+  REQUIRE_NOTHROW(db.createTable<Address>());
+  REQUIRE_NOTHROW(db.createTable<Person>());
+  REQUIRE_NOTHROW(db.createIndex<&Person::name>());
+
+  const auto countIndexes = [raw] {
+    int count = 0;
+    sqlite3_exec(
+        raw,
+        "SELECT 1 FROM sqlite_master WHERE type = 'index' AND "
+        "tbl_name = 'Person' AND sql IS NOT NULL",
+        [](void *data, int /*columns*/, char ** /*values*/,
+           char ** /*names*/) {
+          ++*static_cast<int *>(data);
+          return 0;
+        },
+        &count, nullptr);
+    return count;
+  };
+
+  SECTION("foreign keys are checked once the load is finished") {
+    orm::BulkLoadGuard guard = db.beginBulkLoad<Person>();
+    CHECK(countIndexes() == 0);
+
+    Person person{.id = 0, .name = "Alex", .address{.key = 1}};
+    REQUIRE_NOTHROW(db.persist(person));
+    Address address{.id = 0, .postalCode = "abc"};
+    REQUIRE_NOTHROW(db.persist(address));
+    REQUIRE(address.id == 1);
+
+    REQUIRE_NOTHROW(guard.finish());
+    CHECK(countIndexes() == 1);
+    CHECK(db.count<Person>() == 1);
+  }
+
+  SECTION("violations roll the load back") {
+    std::vector<Person> people = {
+        {.id = 0, .name = "Alex", .address{.key = 42}},
+        {.id = 0, .name = "John", .address{.key = 42}},
+    };
+    CHECK_THROWS_AS(db.bulkLoad(people), std::runtime_error);
+    CHECK(countIndexes() == 1);
+    CHECK(db.count<Person>() == 0);
+  }
+
+  SECTION("unfinished load is rolled back") {
+    {
+      orm::BulkLoadGuard guard = db.beginBulkLoad<Address>();
+      Address address{.id = 0, .postalCode = "abc"};
+      REQUIRE_NOTHROW(db.persist(address));
+    }
+    CHECK(countIndexes() == 1);
+    CHECK(db.count<Address>() == 0);
+  }
+}
+
+namespace {
+
+/// Keeps the events of the statements run by the database
+class RecordingObserver final : public podrm::Observer {
+public:
+  struct Event {
+    std::string entity;
+    std::string operation;
+    std::uint64_t rows;
+    std::uint64_t bytesBound;
+    std::uint64_t bytesDecoded;
+    bool cacheHit;
+  };
+
+  std::vector<Event> events;
+
+  void onStatement(const podrm::StatementEvent &event) override {
+    this->events.push_back(Event{
+        .entity = std::string{event.entity},
+        .operation = std::string{event.operation},
+        .rows = event.rows,
+        .bytesBound = event.bytesBound,
+        .bytesDecoded = event.bytesDecoded,
+        .cacheHit = event.cacheHit,
+    });
+  }
+};
+
+} // namespace
+
+TEST_CASE("SQLite instrumentation", "[sqlite]") {
+  orm::Database db = orm::Database::inMemory("instrumentation");
+  REQUIRE_NOTHROW(db.createTable<Address>());
+
+  RecordingObserver observer;
+  db.setObserver(&observer);
+
+  Address first{.id = 0, .postalCode = "abc"};
+  Address second{.id = 0, .postalCode = "defg"};
+  REQUIRE_NOTHROW(db.persist(first));
+  REQUIRE_NOTHROW(db.persist(second));
+  REQUIRE(observer.events.size() == 2);
+  CHECK(observer.events[0].entity == "Address");
+  CHECK(observer.events[0].operation == "persist");
+  CHECK(observer.events[0].rows == 1);
+  CHECK(observer.events[0].bytesBound == 3);
+  CHECK_FALSE(observer.events[0].cacheHit);
+  CHECK(observer.events[1].bytesBound == 4);
+  CHECK(observer.events[1].cacheHit);
+
+  observer.events.clear();
+  REQUIRE(db.find<Address>(first.id) == first);
+  REQUIRE(observer.events.size() == 1);
+  CHECK(observer.events[0].operation == "find");
+  CHECK(observer.events[0].rows == 1);
+  CHECK(observer.events[0].bytesBound == sizeof(std::int64_t));
+  CHECK(observer.events[0].bytesDecoded == sizeof(std::int64_t) + 3);
+
+  observer.events.clear();
+  {
+    std::vector<Address> addresses;
+    for (Address address : db.iterate<Address>()) {
+      addresses.push_back(std::move(address));
+    }
+    CHECK(addresses.size() == 2);
+  }
+  REQUIRE(observer.events.size() == 1);
+  CHECK(observer.events[0].operation == "iterate");
+  CHECK(observer.events[0].rows == 2);
+
+  SECTION("statements are not reported without an observer") {
+    observer.events.clear();
+    db.setObserver(nullptr);
+    REQUIRE_NOTHROW(db.erase<Address>(first.id));
+    CHECK(observer.events.empty());
+  }
+
+  SECTION("histograms collect percentiles") {
+    podrm::HistogramObserver histograms;
+    db.setObserver(&histograms);
+    for (int i = 0; i < 10; ++i) {
+      REQUIRE(db.find<Address>(second.id).has_value());
+    }
+    db.setObserver(nullptr);
+
+    CHECK(histograms.latency.count() == 10);
+    CHECK(histograms.rows.percentile(50) == 1);
+    CHECK(histograms.latency.percentile(50) <= histograms.latency.max());
+
+    std::ostringstream dump;
+    histograms.dump(dump);
+    CHECK(dump.str().find("latency_ns: count=10") != std::string::npos);
+  }
+}
+
+TEST_CASE("HDR histogram", "[sqlite]") {
+  podrm::HdrHistogram histogram;
+  CHECK(histogram.percentile(50) == 0);
+
+  for (std::uint64_t value = 1; value <= 1000; ++value) {
+    histogram.record(value);
+  }
+  histogram.record(std::uint64_t{1} << 40U);
+
+  CHECK(histogram.count() == 1001);
+  CHECK(histogram.max() == std::uint64_t{1} << 40U);
+  CHECK(histogram.percentile(100) == std::uint64_t{1} << 40U);
+
+  // Buckets above 128 are 1/64 of their power of two wide
+  const std::uint64_t median = histogram.percentile(50);
+  CHECK(median >= 500);
+  CHECK(median <= 508);
+  CHECK(histogram.percentile(10) == 101);
+
+  histogram.reset();
+  CHECK(histogram.count() == 0);
+  CHECK(histogram.max() == 0);
+}
+
+TEST_CASE("SQLite slow query log", "[sqlite]") {
+  orm::Database db = orm::Database::inMemory("slow");
+  REQUIRE_NOTHROW(db.createTable<Address>());
+  REQUIRE_NOTHROW(db.createTable<Counter>());
+
+  std::vector<orm::SlowQuery> queries;
+  db.setSlowQueryLog(orm::SlowQueryLog{
+      .threshold = std::chrono::nanoseconds{0},
+      .callback =
+          [&queries](const orm::SlowQuery &query) { queries.push_back(query); },
+  });
+
+  Address address{.id = 0, .postalCode = "abc"};
+  REQUIRE_NOTHROW(db.persist(address));
+  REQUIRE(queries.size() == 1);
+  CHECK(queries[0].entity == "Address");
+  CHECK(queries[0].operation == "persist");
+  CHECK(queries[0].statement.find("'abc'") != std::string::npos);
+  CHECK(queries[0].parameterTypes == std::vector<std::string_view>{"TEXT"});
+
+  queries.clear();
+  REQUIRE(db.find<Address>(address.id).has_value());
+  REQUIRE(queries.size() == 1);
+  CHECK(queries[0].parameterTypes ==
+        std::vector<std::string_view>{"INTEGER"});
+  CHECK_FALSE(queries[0].plan.empty());
+  CHECK_FALSE(queries[0].fullScan);
+
+  queries.clear();
+  for (const Address &entity : db.iterate<Address>()) {
+    CHECK(entity == address);
+  }
+  REQUIRE(queries.size() == 1);
+  CHECK(queries[0].fullScan);
+
+  std::ostringstream text;
+  text << queries[0];
+  CHECK(text.str().find("full scan") != std::string::npos);
+
+  SECTION("errors of slow statements are kept") {
+    Counter counter{.id = 1, .hits = 0};
+    REQUIRE_NOTHROW(db.persist(counter));
+    try {
+      db.persist(counter);
+      FAIL("Duplicate key is persisted");
+    } catch (const std::runtime_error &error) {
+      CHECK(std::string_view{error.what()}.find("UNIQUE") !=
+            std::string_view::npos);
+    }
+  }
+
+  SECTION("log can be written to a file") {
+    const std::filesystem::path path =
+        std::filesystem::temp_directory_path() / "podrm-slow-query.log";
+    std::filesystem::remove(path);
+
+    db.setSlowQueryLog(
+        orm::SlowQueryLog::toFile(path, std::chrono::nanoseconds{0}));
+    REQUIRE(db.find<Address>(address.id).has_value());
+    db.setSlowQueryLog(std::nullopt);
+
+    std::ifstream file{path};
+    const std::string contents{std::istreambuf_iterator<char>{file}, {}};
+    CHECK(contents.find("slow query") != std::string::npos);
+    CHECK(contents.find("plan: SEARCH") != std::string::npos);
+    std::filesystem::remove(path);
+  }
+
+  SECTION("disabled log reports nothing") {
+    db.setSlowQueryLog(std::nullopt);
+    queries.clear();
+    REQUIRE(db.find<Address>(address.id).has_value());
+    CHECK(queries.empty());
+  }
+
+  SECTION("statements of several threads are explained") {
+    constexpr int Threads = 4;
+    constexpr int Finds = 50;
+
+    std::mutex mutex;
+    std::vector<orm::SlowQuery> reported;
+    db.setSlowQueryLog(orm::SlowQueryLog{
+        .threshold = std::chrono::nanoseconds{0},
+        .callback =
+            [&mutex, &reported](const orm::SlowQuery &query) {
+              const std::lock_guard lock{mutex};
+              reported.push_back(query);
+            },
+    });
+
+    std::atomic<int> found{0};
+    std::vector<std::thread> threads;
+    threads.reserve(Threads);
+    for (int i = 0; i < Threads; ++i) {
+      threads.emplace_back([&db, &address, &found] {
+        for (int j = 0; j < Finds; ++j) {
+          found += db.find<Address>(address.id).has_value() ? 1 : 0;
+        }
+      });
+    }
+    for (std::thread &thread : threads) {
+      thread.join();
+    }
+
+    CHECK(found == Threads * Finds);
+    REQUIRE(reported.size() == Threads * Finds);
+    for (const orm::SlowQuery &query : reported) {
+      CHECK(query.operation == "find");
+      CHECK_FALSE(query.plan.empty());
+    }
+  }
+}
+
+TEST_CASE("SQLite parallel scan", "[sqlite]") {
+  const std::filesystem::path path =
+      std::filesystem::temp_directory_path() / "podrm-parallel-scan.db";
+  std::filesystem::remove(path);
+
+  constexpr std::int64_t Count = 1000;
+  std::int64_t expectedSum = 0;
+
+  {
+    orm::Database db = orm::Database::inFile(path);
+    REQUIRE_NOTHROW(db.createTable<Counter>());
+
+    // Sparse keys leave some rowid ranges empty
+    std::vector<Counter> counters;
+    for (std::int64_t i = 0; i < Count; ++i) {
+      counters.push_back(Counter{.id = i * i, .hits = i});
+      expectedSum += i;
+    }
+    REQUIRE_NOTHROW(db.persistMany(counters));
+  }
+
+  orm::Database db = orm::Database::inFile(path);
+
+  SECTION("every entity is visited once") {
+    std::mutex mutex;
+    std::vector<std::int64_t> hits;
+    db.parallelForEach<Counter>(
+        [&mutex, &hits](const Counter &counter) {
+          const std::lock_guard lock{mutex};
+          hits.push_back(counter.hits);
+        },
+        4);
+
+    std::ranges::sort(hits);
+    REQUIRE(hits.size() == Count);
+    for (std::int64_t i = 0; i < Count; ++i) {
+      CHECK(hits[static_cast<std::size_t>(i)] == i);
+    }
+  }
+
+  SECTION("results of threads are merged") {
+    const std::int64_t sum = db.parallelReduce<Counter>(
+        std::int64_t{0},
+        [](std::int64_t &sum, const Counter &counter) { sum += counter.hits; },
+        [](std::int64_t &sum, const std::int64_t other) { sum += other; }, 4);
+    CHECK(sum == expectedSum);
+  }
+
+  SECTION("exceptions are rethrown") {
+    CHECK_THROWS_AS(db.parallelForEach<Counter>(
+                        [](const Counter &counter) {
+                          if (counter.hits == Count / 2) {
+                            throw std::runtime_error{"stop"};
+                          }
+                        },
+                        4),
+                    std::runtime_error);
+  }
+
+  SECTION("memory databases are scanned by the connection") {
+    orm::Database memory = orm::Database::inMemory("parallel");
+    REQUIRE_NOTHROW(memory.createTable<Counter>());
+    Counter counter{.id = 1, .hits = 1};
+    REQUIRE_NOTHROW(memory.persist(counter));
+
+    std::atomic<int> visited{0};
+    memory.parallelForEach<Counter>(
+        [&visited](const Counter & /*counter*/) { ++visited; }, 4);
+    CHECK(visited == 1);
+  }
+
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("SQLite prefetch", "[sqlite]") {
+  orm::Database db = orm::Database::inMemory("test");
+
+  REQUIRE_NOTHROW(db.createTable<Counter>());
+
+  constexpr std::int64_t Count = 5000;
+  std::vector<Counter> counters;
+  for (std::int64_t i = 1; i <= Count; ++i) {
+    counters.push_back({.id = i, .hits = i});
+  }
+  REQUIRE_NOTHROW(db.persistMany(counters));
+
+  SECTION("entities are read in order") {
+    std::int64_t expected = 1;
+    for (const Counter &counter : podrm::prefetch(db.iterate<Counter>(), 8)) {
+      CHECK(counter.hits == expected);
+      ++expected;
+    }
+    CHECK(expected == Count + 1);
+  }
+
+  SECTION("reading stops when the consumer does") {
+    std::int64_t seen = 0;
+    for (const Counter &counter : podrm::prefetch(db.iterate<Counter>(), 4)) {
+      static_cast<void>(counter);
+      if (++seen == 10) {
+        break;
+      }
+    }
+    CHECK(seen == 10);
+    CHECK(db.count<Counter>() == Count);
+  }
+
+  SECTION("errors are rethrown to the consumer") {
+    podrm::CancellationSource source;
+    const orm::LimitScope scope = db.limit({.token = source.token()});
+
+    std::int64_t seen = 0;
+    const auto iterateAll = [&db, &source, &seen] {
+      for (const Counter &counter :
+           podrm::prefetch(db.iterate<Counter>(), 1)) {
+        CHECK(counter.hits == seen + 1);
+        if (++seen == 10) {
+          source.cancel();
+        }
+      }
+    };
+    CHECK_THROWS_AS(iterateAll(), podrm::OperationCancelled);
+    CHECK(seen < Count);
+  }
+
+  SECTION("capacity must be positive") {
+    CHECK_THROWS_AS(podrm::prefetch(db.iterate<Counter>(), 0),
+                    std::invalid_argument);
+  }
+
+  SECTION("values are read in the operation of the caller") {
+    const podrm::detail::OperationScope scope{"Counter", "export", true};
+    const auto operations =
+        std::views::iota(0, 3) | std::views::transform([](int /*value*/) {
+          return podrm::detail::currentOperation.operation;
+        });
+
+    std::vector<std::string_view> seen;
+    for (const std::string_view operation : podrm::prefetch(operations, 1)) {
+      seen.push_back(operation);
+    }
+    CHECK(seen == std::vector<std::string_view>(3, "export"));
+  }
+}
+
+TEST_CASE("SQLite sharded database", "[sqlite]") {
+  const std::filesystem::path directory =
+      std::filesystem::temp_directory_path();
+  const std::array<std::filesystem::path, 3> paths{
+      directory / "podrm-shard-0.db",
+      directory / "podrm-shard-1.db",
+      directory / "podrm-shard-2.db",
+  };
+  for (const std::filesystem::path &path : paths) {
+    std::filesystem::remove(path);
+  }
+
+  {
+    orm::ShardedDatabase db = orm::ShardedDatabase::inFiles(paths);
+    REQUIRE(db.shardCount() == paths.size());
+    REQUIRE_NOTHROW(db.createTable<Counter>());
+
+    constexpr std::int64_t Count = 300;
+    std::vector<Counter> counters;
+    for (std::int64_t i = 0; i < Count; ++i) {
+      counters.push_back({.id = i, .hits = i});
+    }
+    REQUIRE_NOTHROW(db.persistMany(counters));
+
+    SECTION("entities are spread over the shards") {
+      CHECK(db.count<Counter>() == Count);
+      for (std::size_t shard = 0; shard < db.shardCount(); ++shard) {
+        CHECK(db.shard(shard).count<Counter>() > 0);
+      }
+
+      for (std::int64_t i = 0; i < Count; ++i) {
+        CHECK(db.shard(db.shardOf<Counter>(i)).find<Counter>(i).has_value());
+      }
+    }
+
+    SECTION("operations on a key go to its shard") {
+      Counter counter{.id = Count, .hits = 1};
+      REQUIRE_NOTHROW(db.persist(counter));
+      CHECK(db.find<Counter>(Count)->hits == 1);
+
+      counter.hits = 2;
+      REQUIRE_NOTHROW(db.update(counter));
+      CHECK(db.increment<&Counter::hits>(Count, 3) == 5);
+      CHECK(db.compareAndSet<&Counter::hits>(Count, 5, 6));
+      CHECK(db.find<Counter>(Count)->hits == 6);
+
+      REQUIRE_NOTHROW(db.erase<Counter>(Count));
+      CHECK_FALSE(db.find<Counter>(Count).has_value());
+      CHECK(db.count<Counter>() == Count);
+    }
+
+    SECTION("table operations fan out") {
+      CHECK(db.updateWhere(podrm::Column<&Counter::hits> < 10,
+                           podrm::Column<&Counter::hits>.set(0)) == 10);
+      CHECK(db.eraseWhere(podrm::Column<&Counter::hits> == 0) == 10);
+
+      const std::int64_t sum = db.parallelReduce<Counter>(
+          std::int64_t{0},
+          [](std::int64_t &sum, const Counter &counter) {
+            sum += counter.hits;
+          },
+          [](std::int64_t &sum, const std::int64_t other) { sum += other; },
+          2);
+      CHECK(sum == (Count - 1) * Count / 2 - 45);
+
+      std::atomic<std::int64_t> visited{0};
+      db.parallelForEach<Counter>(
+          [&visited](const Counter & /*counter*/) { ++visited; });
+      CHECK(visited == Count - 10);
+    }
+
+    SECTION("reads fan out") {
+      const auto collectIds = [](auto &&range) {
+        std::vector<std::int64_t> ids;
+        for (const Counter &counter : range) {
+          ids.push_back(counter.id);
+        }
+        return ids;
+      };
+
+      std::vector<std::int64_t> ids = collectIds(db.iterate<Counter>());
+      std::ranges::sort(ids);
+      CHECK(ids == collectIds(counters));
+
+      CHECK(collectIds(db.scan<Counter>()) == collectIds(counters));
+      CHECK(collectIds(db.scan<Counter>().after(99).limit(3)) ==
+            std::vector<std::int64_t>{100, 101, 102});
+      CHECK(collectIds(db.scan<Counter>()
+                           .orderBy<&Counter::hits>()
+                           .after(Counter{.id = 149, .hits = 149})
+                           .limit(2)) == std::vector<std::int64_t>{150, 151});
+
+      CHECK(db.sum<&Counter::hits>() == (Count - 1) * Count / 2);
+      CHECK(db.min<&Counter::hits>() == 0);
+      CHECK(db.max<&Counter::hits>() == Count - 1);
+      CHECK_FALSE(
+          db.max<&Counter::hits>(podrm::Column<&Counter::hits> < 0)
+              .has_value());
+
+      REQUIRE(db.updateWhere(podrm::Column<&Counter::hits> < 10,
+                             podrm::Column<&Counter::hits>.set(0)) == 10);
+      CHECK(db.groupBy<&Counter::hits>(podrm::Count<Counter>,
+                                       podrm::Column<&Counter::hits> < 12) ==
+            std::vector<std::pair<std::int64_t, std::uint64_t>>{
+                {0, 10}, {10, 1}, {11, 1}});
+
+      CHECK(db.eraseMany<Counter>(
+                std::vector<std::int64_t>{0, 1, 2, 3, 4, Count}) == 5);
+      CHECK(db.count<Counter>() == Count - 5);
+    }
+
+    SECTION("transactions are per shard") {
+      {
+        const orm::Transaction transaction = db.begin<Counter>(0);
+        REQUIRE_NOTHROW(db.erase<Counter>(0));
+      }
+      CHECK(db.find<Counter>(0).has_value());
+    }
+
+    SECTION("shard function overrides the hash") {
+      db.setShardFunction<Counter>(
+          [](const std::int64_t key) { return key < 0 ? 0 : 5; });
+      CHECK(db.shardOf<Counter>(-1) == 0);
+      CHECK_THROWS_AS(db.shardOf<Counter>(1), std::out_of_range);
+    }
+  }
+
+  CHECK_THROWS_AS(orm::ShardedDatabase{std::vector<orm::Database>{}},
+                  std::invalid_argument);
+
+  for (const std::filesystem::path &path : paths) {
+    std::filesystem::remove(path);
+  }
+}
+
+TEST_CASE("SQLite in-memory snapshots", "[sqlite]") {
+  const std::filesystem::path path =
+      std::filesystem::temp_directory_path() / "podrm-snapshot.db";
+  std::filesystem::remove(path);
+
+  constexpr std::int64_t Count = 2000;
+  {
+    orm::Database db = orm::Database::inFile(path);
+    REQUIRE_NOTHROW(db.createTable<Counter>());
+    std::vector<Counter> counters;
+    for (std::int64_t i = 1; i <= Count; ++i) {
+      counters.push_back({.id = i, .hits = i});
+    }
+    REQUIRE_NOTHROW(db.persistMany(counters));
+  }
+
+  orm::Database memory = orm::Database::loadIntoMemory(path);
+  CHECK(memory.count<Counter>() == Count);
+  CHECK(memory.find<Counter>(Count)->hits == Count);
+
+  REQUIRE_NOTHROW(memory.erase<Counter>(1));
+  Counter counter{.id = Count + 1, .hits = 0};
+  REQUIRE_NOTHROW(memory.persist(counter));
+
+  // Changes reach the file only with a snapshot
+  CHECK(orm::Database::inFile(path).find<Counter>(1).has_value());
+
+  REQUIRE_NOTHROW(memory.snapshotTo(path, {.pagesPerStep = 1}));
+  {
+    orm::Database db = orm::Database::inFile(path);
+    CHECK(db.count<Counter>() == Count);
+    CHECK_FALSE(db.find<Counter>(1).has_value());
+    CHECK(db.find<Counter>(Count + 1).has_value());
+  }
+
+  SECTION("snapshots wait for readers of the file") {
+    sqlite3 *reader = nullptr;
+    REQUIRE(sqlite3_open(path.string().c_str(), &reader) == SQLITE_OK);
+    REQUIRE(sqlite3_exec(reader, "BEGIN; SELECT count(*) FROM 'Counter'",
+                         nullptr, nullptr, nullptr) == SQLITE_OK);
+
+    CHECK_THROWS_AS(
+        memory.snapshotTo(path,
+                          {.busyTimeout = std::chrono::milliseconds{50}}),
+        std::runtime_error);
+
+    std::thread release{[reader] {
+      std::this_thread::sleep_for(std::chrono::milliseconds{50});
+      sqlite3_exec(reader, "COMMIT", nullptr, nullptr, nullptr);
+    }};
+    CHECK_NOTHROW(memory.snapshotTo(path));
+    release.join();
+    sqlite3_close(reader);
+  }
+
+  SECTION("snapshots are cancelled by the limits") {
+    const orm::LimitScope scope =
+        memory.limit(podrm::OperationLimits::timeout(std::chrono::seconds{-1}));
+    CHECK_THROWS_AS(memory.snapshotTo(path), podrm::OperationTimedOut);
+  }
+
+  std::filesystem::remove(path);
+  CHECK_THROWS_AS(orm::Database::loadIntoMemory(path), std::runtime_error);
+}
+
+TEST_CASE("SQLite read-only databases", "[sqlite]") {
+  const std::filesystem::path path =
+      std::filesystem::temp_directory_path() / "podrm-read-only?#%.db";
+  std::filesystem::remove(path);
+
+  constexpr std::int64_t Count = 1000;
+  {
+    orm::Database db = orm::Database::inFile(path);
+    REQUIRE_NOTHROW(db.createTable<Counter>());
+    std::vector<Counter> counters;
+    for (std::int64_t i = 1; i <= Count; ++i) {
+      counters.push_back({.id = i, .hits = i});
+    }
+    REQUIRE_NOTHROW(db.persistMany(counters));
+  }
+
+  SECTION("immutable files are read by several threads") {
+    orm::Database db = orm::Database::openReadOnly(path);
+    CHECK(db.find<Counter>(Count)->hits == Count);
+    CHECK_THROWS_AS(db.erase<Counter>(1), std::runtime_error);
+
+    std::atomic<std::int64_t> sum{0};
+    db.parallelForEach<Counter>(
+        [&sum](const Counter &counter) { sum += counter.hits; }, 4);
+    CHECK(sum == Count * (Count + 1) / 2);
+  }
+
+  SECTION("mutable files are read with locking") {
+    orm::Database db =
+        orm::Database::openReadOnly(path, {.immutable = false, .mmapSize = 0});
+    CHECK(db.count<Counter>() == Count);
+    CHECK_THROWS_AS(db.erase<Counter>(1), std::runtime_error);
+  }
+
+  std::filesystem::remove(path);
+}
+
+#ifdef PODRM_SQLITE_CHANGE_CAPTURE
+TEST_CASE("SQLite change capture", "[sqlite]") {
+  const std::filesystem::path directory =
+      std::filesystem::temp_directory_path();
+  const std::filesystem::path sourcePath = directory / "podrm-changes-src.db";
+  const std::filesystem::path targetPath = directory / "podrm-changes-dst.db";
+  std::filesystem::remove(sourcePath);
+  std::filesystem::remove(targetPath);
+
+  orm::Database source = orm::Database::inFile(sourcePath);
+  orm::Database target = orm::Database::inFile(targetPath);
+  for (orm::Database *db : {&source, &target}) {
+    REQUIRE_NOTHROW(db->createTable<Counter>());
+    std::vector<Counter> counters;
+    for (std::int64_t i = 1; i <= 100; ++i) {
+      counters.push_back({.id = i, .hits = i});
+    }
+    REQUIRE_NOTHROW(db->persistMany(counters));
+  }
+
+  std::vector<std::byte> changeset;
+  std::vector<std::byte> patchset;
+  {
+    orm::ChangeCapture capture = source.captureChanges<Counter>();
+    Counter counter{.id = 101, .hits = 101};
+    REQUIRE_NOTHROW(source.persist(counter));
+    REQUIRE_NOTHROW(source.update(Counter{.id = 1, .hits = 10}));
+    REQUIRE_NOTHROW(source.erase<Counter>(2));
+
+    changeset = capture.changeset();
+    patchset = capture.patchset();
+  }
+  CHECK_FALSE(changeset.empty());
+  CHECK(patchset.size() < changeset.size());
+
+  const auto checkApplied = [&target] {
+    CHECK(target.count<Counter>() == 100);
+    CHECK(target.find<Counter>(1)->hits == 10);
+    CHECK_FALSE(target.find<Counter>(2).has_value());
+    CHECK(target.find<Counter>(101)->hits == 101);
+  };
+
+  SECTION("changesets are applied") {
+    REQUIRE_NOTHROW(target.applyChanges(changeset));
+    checkApplied();
+  }
+
+  SECTION("patchsets are applied") {
+    REQUIRE_NOTHROW(target.applyChanges(patchset));
+    checkApplied();
+  }
+
+  SECTION("conflicts are resolved by the policy") {
+    REQUIRE_NOTHROW(target.update(Counter{.id = 1, .hits = 5}));
+
+    CHECK_THROWS_AS(target.applyChanges(changeset), std::runtime_error);
+    CHECK(target.find<Counter>(2).has_value());
+
+    REQUIRE_NOTHROW(target.applyChanges(changeset, orm::ConflictPolicy::Omit));
+    CHECK(target.find<Counter>(1)->hits == 5);
+    CHECK_FALSE(target.find<Counter>(2).has_value());
+  }
+
+  SECTION("conflicting rows are replaced") {
+    REQUIRE_NOTHROW(target.update(Counter{.id = 1, .hits = 5}));
+    REQUIRE_NOTHROW(
+        target.applyChanges(changeset, orm::ConflictPolicy::Replace));
+    checkApplied();
+  }
+
+  std::filesystem::remove(sourcePath);
+  std::filesystem::remove(targetPath);
+}
+#endif
+
+TEST_CASE("SQLite change notifications", "[sqlite]") {
+  orm::Database db = orm::Database::inMemory("test");
+  REQUIRE_NOTHROW(db.createTable<Counter>());
+
+  using Event = std::pair<orm::ChangeOperation, std::int64_t>;
+  using Events = podrm::span<const orm::ChangeEvent<Counter>>;
+  std::vector<std::vector<Event>> batches;
+  std::optional<orm::Subscription> subscription =
+      db.subscribe<Counter>([&batches](const Events events) {
+        std::vector<Event> &batch = batches.emplace_back();
+        for (const orm::ChangeEvent<Counter> &event : events) {
+          batch.emplace_back(event.operation, event.key);
+        }
+      });
+
+  SECTION("autocommitted changes are reported one by one") {
+    Counter counter{.id = 1, .hits = 0};
+    REQUIRE_NOTHROW(db.persist(counter));
+    REQUIRE_NOTHROW(db.update(Counter{.id = 1, .hits = 5}));
+    CHECK(db.increment<&Counter::hits>(1, 1) == 6);
+    REQUIRE_NOTHROW(db.erase<Counter>(1));
+
+    CHECK(batches == std::vector<std::vector<Event>>{
+                         {{orm::ChangeOperation::Insert, 1}},
+                         {{orm::ChangeOperation::Update, 1}},
+                         {{orm::ChangeOperation::Update, 1}},
+                         {{orm::ChangeOperation::Delete, 1}},
+                     });
+  }
+
+  SECTION("transactions are reported once committed") {
+    orm::Transaction transaction = db.begin();
+    Counter first{.id = 1, .hits = 0};
+    Counter second{.id = 2, .hits = 0};
+    REQUIRE_NOTHROW(db.persist(first));
+    REQUIRE_NOTHROW(db.persist(second));
+    REQUIRE_NOTHROW(db.erase<Counter>(1));
+    CHECK(batches.empty());
+
+    transaction.commit();
+    CHECK(batches == std::vector<std::vector<Event>>{{
+                         {orm::ChangeOperation::Insert, 1},
+                         {orm::ChangeOperation::Insert, 2},
+                         {orm::ChangeOperation::Delete, 1},
+                     }});
+  }
+
+  SECTION("rolled back changes are not reported") {
+    {
+      orm::Transaction transaction = db.begin();
+      Counter counter{.id = 1, .hits = 0};
+      REQUIRE_NOTHROW(db.persist(counter));
+      transaction.rollback();
+    }
+
+    std::vector<Counter> counters = {
+        {.id = 2, .hits = 0},
+        {.id = 2, .hits = 0},
+    };
+    CHECK_THROWS(db.persistMany(counters));
+    CHECK(batches.empty());
+  }
+
+  SECTION("destroyed subscriptions are not called") {
+    subscription.reset();
+    Counter counter{.id = 1, .hits = 0};
+    REQUIRE_NOTHROW(db.persist(counter));
+    CHECK(batches.empty());
+  }
+
+  SECTION("subscriptions destroyed during a delivery are not called") {
+    std::optional<orm::Subscription> later;
+    const orm::Subscription ending =
+        db.subscribe<Counter>([&later](const Events /*events*/) {
+          later.reset();
+        });
+    int calls = 0;
+    later.emplace(
+        db.subscribe<Counter>([&calls](const Events /*events*/) { ++calls; }));
+
+    Counter counter{.id = 1, .hits = 0};
+    REQUIRE_NOTHROW(db.persist(counter));
+    CHECK_FALSE(later.has_value());
+    CHECK(calls == 0);
+    CHECK(batches.size() == 1);
+  }
+
+  SECTION("destroying subscriptions waits for other threads") {
+    std::atomic<bool> started = false;
+    std::atomic<bool> finished = false;
+    std::optional<orm::Subscription> slow{
+        db.subscribe<Counter>([&started, &finished](const Events /*events*/) {
+          started = true;
+          std::this_thread::sleep_for(std::chrono::milliseconds{50});
+          finished = true;
+        }),
+    };
+
+    std::thread committing{[&db] {
+      Counter counter{.id = 1, .hits = 0};
+      db.persist(counter);
+    }};
+    while (!started) {
+      std::this_thread::yield();
+    }
+    slow.reset();
+    CHECK(finished);
+    committing.join();
+  }
+
+  SECTION("callbacks in two threads end their own subscriptions") {
+    std::atomic<bool> firstCalled = false;
+    std::atomic<bool> secondCalled = false;
+    std::optional<orm::Subscription> first;
+    std::optional<orm::Subscription> second;
+    first.emplace(db.subscribe<Counter>(
+        [&first, &firstCalled, &secondCalled](const Events events) {
+          if (events.front().key != 1) {
+            return;
+          }
+          firstCalled = true;
+          while (!secondCalled) {
+            std::this_thread::yield();
+          }
+          first.reset();
+        }));
+    second.emplace(
+        db.subscribe<Counter>([&second, &secondCalled](const Events events) {
+          if (events.front().key != 2) {
+            return;
+          }
+          secondCalled = true;
+          second.reset();
+        }));
+
+    std::thread committing{[&db] {
+      Counter counter{.id = 1, .hits = 0};
+      db.persist(counter);
+    }};
+    while (!firstCalled) {
+      std::this_thread::yield();
+    }
+    Counter counter{.id = 2, .hits = 0};
+    REQUIRE_NOTHROW(db.persist(counter));
+    committing.join();
+    CHECK_FALSE(first.has_value());
+    CHECK_FALSE(second.has_value());
+  }
+}
+
+namespace {
+
+/// Default VFS with syncs of journals failing on demand, e.g. to fail
+/// commits after the commit hook
+class FaultyVfs {
+public:
+  FaultyVfs() {
+    this->vfs = *original();
+    this->vfs.zName = "podrm-faulty";
+    this->vfs.xOpen = &FaultyVfs::open;
+    sqlite3_vfs_register(&this->vfs, 1);
+  }
+
+  FaultyVfs(const FaultyVfs &) = delete;
+  FaultyVfs(FaultyVfs &&) = delete;
+  FaultyVfs &operator=(const FaultyVfs &) = delete;
+  FaultyVfs &operator=(FaultyVfs &&) = delete;
+
+  ~FaultyVfs() {
+    sqlite3_vfs_unregister(&this->vfs);
+    sqlite3_vfs_register(original(), 1);
+  }
+
+  static inline std::atomic<bool> failSyncs = false;
+
+private:
+  sqlite3_vfs vfs{};
+
+  static inline sqlite3_io_methods methods{};
+  static inline int (*originalSync)(sqlite3_file *, int) = nullptr;
+
+  static sqlite3_vfs *original() {
+    static sqlite3_vfs *const vfs = sqlite3_vfs_find(nullptr);
+    return vfs;
+  }
+
+  static int open(sqlite3_vfs * /*vfs*/, const char *name, sqlite3_file *file,
+                  const int flags, int *outFlags) {
+    const int result =
+        original()->xOpen(original(), name, file, flags, outFlags);
+    if (result != SQLITE_OK || file->pMethods == nullptr ||
+        (flags & SQLITE_OPEN_MAIN_JOURNAL) == 0) {
+      return result;
+    }
+
+    // Journals of the default VFS share their methods, which do not refer
+    // back to them
+    if (originalSync == nullptr) {
+      methods = *file->pMethods;
+      originalSync = methods.xSync;
+      methods.xSync = &FaultyVfs::sync;
+    }
+    file->pMethods = &methods;
+    return result;
+  }
+
+  static int sync(sqlite3_file *file, const int flags) {
+    if (failSyncs) {
+      return SQLITE_IOERR_FSYNC;
+    }
+    return originalSync(file, flags);
+  }
+};
+
+} // namespace
+
+TEST_CASE("SQLite change notifications of failed commits", "[sqlite]") {
+  const std::filesystem::path path =
+      std::filesystem::temp_directory_path() / "podrm-failed-commit.db";
+  std::filesystem::remove(path);
+
+  const FaultyVfs vfs;
+  orm::Database db = orm::Database::inFile(path);
+  REQUIRE_NOTHROW(db.createTable<Counter>());
+
+  std::vector<std::vector<std::int64_t>> batches;
+  const orm::Subscription subscription = db.subscribe<Counter>(
+      [&batches](const podrm::span<const orm::ChangeEvent<Counter>> events) {
+        std::vector<std::int64_t> &batch = batches.emplace_back();
+        for (const orm::ChangeEvent<Counter> &event : events) {
+          batch.push_back(event.key);
+        }
+      });
+
+  Counter first{.id = 1, .hits = 0};
+  Counter second{.id = 2, .hits = 0};
+
+  SECTION("commits failing after the commit hook are not reported") {
+    {
+      orm::Transaction transaction = db.begin();
+      REQUIRE_NOTHROW(db.persist(first));
+      FaultyVfs::failSyncs = true;
+      CHECK_THROWS(transaction.commit());
+      FaultyVfs::failSyncs = false;
+    }
+    CHECK_FALSE(db.find<Counter>(1).has_value());
+
+    REQUIRE_NOTHROW(db.persist(second));
+    CHECK(batches == std::vector<std::vector<std::int64_t>>{{2}});
+  }
+
+  SECTION("commits of locked files are reported once retried") {
+    // Readers of the file keep the commit from taking its exclusive lock
+    sqlite3 *reader = nullptr;
+    REQUIRE(sqlite3_open(path.string().c_str(), &reader) == SQLITE_OK);
+    REQUIRE(sqlite3_exec(reader, "BEGIN; SELECT count(*) FROM 'Counter'",
+                         nullptr, nullptr, nullptr) == SQLITE_OK);
+
+    orm::Transaction transaction = db.begin();
+    REQUIRE_NOTHROW(db.persist(first));
+    CHECK_THROWS(transaction.commit());
+    CHECK(batches.empty());
+
+    REQUIRE(sqlite3_exec(reader, "COMMIT", nullptr, nullptr, nullptr) ==
+            SQLITE_OK);
+    sqlite3_close(reader);
+    REQUIRE_NOTHROW(transaction.commit());
+    CHECK(batches == std::vector<std::vector<std::int64_t>>{{1}});
+  }
+
+  std::filesystem::remove(path);
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <podrm/metadata.hpp>
+#include <podrm/predicate.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <variant>
+
+namespace podrm {
+
+enum class AggregateFunction : std::uint8_t {
+  Count,
+  Sum,
+  Min,
+  Max,
+};
+
+/// Aggregate function over a top-level primitive entity field
+struct AggregateDescription {
+  AggregateFunction function;
+
+  /// Index of the field in EntityDescription::fields
+  std::size_t field;
+
+  /// Description of the aggregate value
+  PrimitiveFieldDescription result;
+};
+
+/// Aggregate of the entity producing a value of the Result type
+template <typename Entity, typename Result> struct Aggregate {
+  AggregateDescription description;
+};
+
+/// Description of the row count
+constexpr PrimitiveFieldDescription CountDescription{
+    .imageType = ImageType::Uint,
+    .asImage = [](const void *value) -> AsImage {
+      return *static_cast<const std::uint64_t *>(value);
+    },
+    .fromImage =
+        [](const FromImage image, void *value) {
+          *static_cast<std::uint64_t *>(value) = std::get<std::uint64_t>(image);
+        },
+    .foreignKeyContraint = std::nullopt,
+};
+
+/// @returns description of the top-level primitive field
+constexpr const PrimitiveFieldDescription &
+getPrimitiveDescription(const EntityDescription &entity,
+                        const std::size_t field) {
+  return std::get<PrimitiveFieldDescription>(entity.fields[field].field);
+}
+
+/// @returns true if the field is a top-level numeric field of the entity
+constexpr bool isNumericField(const EntityDescription &entity,
+                              const std::size_t field) {
+  if (!isPrimitiveField(entity, field)) {
+    return false;
+  }
+
+  const ImageType type = getPrimitiveDescription(entity, field).imageType;
+  return type == ImageType::Int || type == ImageType::Uint ||
+         type == ImageType::Float;
+}
+
+template <auto MemberPtr>
+concept NumericField =
+    DatabaseField<MemberPtr> &&
+    isNumericField(DatabaseEntityDescription<MemberClass<MemberPtr>>.value(),
+                   DatabaseFieldIndex<MemberPtr>.value());
+
+/// Number of entities
+template <DatabaseEntity Entity>
+constexpr Aggregate<Entity, std::uint64_t> Count{
+    .description{
+        .function = AggregateFunction::Count,
+        .field = DatabaseEntityDescription<Entity>.value().primaryKey,
+        .result = CountDescription,
+    },
+};
+
+namespace detail {
+
+template <auto MemberPtr>
+constexpr Aggregate<MemberClass<MemberPtr>, MemberType<MemberPtr>>
+makeFieldAggregate(const AggregateFunction function) {
+  return {
+      .description{
+          .function = function,
+          .field = DatabaseFieldIndex<MemberPtr>.value(),
+          .result = getPrimitiveDescription(
+              DatabaseEntityDescription<MemberClass<MemberPtr>>.value(),
+              DatabaseFieldIndex<MemberPtr>.value()),
+      },
+  };
+}
+
+} // namespace detail
+
+/// Sum of the field values, zero if there are no entities
+template <auto MemberPtr>
+  requires NumericField<MemberPtr>
+constexpr Aggregate<MemberClass<MemberPtr>, MemberType<MemberPtr>> Sum =
+    detail::makeFieldAggregate<MemberPtr>(AggregateFunction::Sum);
+
+/// Minimum of the field values
+template <auto MemberPtr>
+  requires PrimitiveField<MemberPtr>
+constexpr Aggregate<MemberClass<MemberPtr>, MemberType<MemberPtr>> Min =
+    detail::makeFieldAggregate<MemberPtr>(AggregateFunction::Min);
+
+/// Maximum of the field values
+template <auto MemberPtr>
+  requires PrimitiveField<MemberPtr>
+constexpr Aggregate<MemberClass<MemberPtr>, MemberType<MemberPtr>> Max =
+    detail::makeFieldAggregate<MemberPtr>(AggregateFunction::Max);
+
+/// @returns description of a (group key, aggregate value) pair
+template <typename Key, typename Result>
+std::array<FieldDescription, 2>
+makeGroupDescription(const FieldDescription &key,
+                     const AggregateDescription &aggregate) {
+  using Group = std::pair<Key, Result>;
+
+  return {
+      FieldDescription{
+          .name = key.name,
+          .memberPtr = [](void *group) -> void * {
+            return &static_cast<Group *>(group)->first;
+          },
+          .constMemberPtr = [](const void *group) -> const void * {
+            return &static_cast<const Group *>(group)->first;
+          },
+          .field = key.field,
+      },
+      FieldDescription{
+          .name = "aggregate",
+          .memberPtr = [](void *group) -> void * {
+            return &static_cast<Group *>(group)->second;
+          },
+          .constMemberPtr = [](const void *group) -> const void * {
+            return &static_cast<const Group *>(group)->second;
+          },
+          .field = aggregate.result,
+      },
+  };
+}
+
+} // namespace podrm
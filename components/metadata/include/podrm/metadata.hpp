@@ -7,6 +7,7 @@
 #include <optional>
 #include <string>
 #include <string_view>
+#include <type_traits>
 #include <variant>
 #include <vector>
 
@@ -74,6 +75,24 @@ struct EntityDescription {
   std::size_t primaryKey;
 };
 
+/// Set of top-level entity fields, bit N selects EntityDescription::fields[N]
+using FieldMask = std::uint64_t;
+
+/// Maximum number of top-level fields that can be selected by a FieldMask
+constexpr std::size_t MaxMaskedFields = 64;
+
+/// Type that selects a top-level entity field by its index, e.g.
+/// podrm::FieldDescriptor
+template <typename Selector>
+concept FieldSelector = requires(const Selector &selector) {
+  requires std::is_convertible_v<decltype(selector.get()), std::size_t>;
+};
+
+template <FieldSelector... Selectors>
+constexpr FieldMask makeFieldMask(const Selectors... selectors) {
+  return (FieldMask{0} | ... | (FieldMask{1} << selectors.get()));
+}
+
 template <typename Entity>
 constexpr std::optional<EntityDescription> DatabaseEntityDescription =
     std::nullopt;
@@ -91,4 +110,79 @@ concept DatabaseEntity =
     std::is_convertible_v<decltype(PrimaryKeyName<Entity>), std::string_view> &&
     requires { typename PrimaryKeyType<Entity>; };
 
+/// Description of a projection type, its fields are matched with flattened
+/// entity columns by name
+template <typename Projection>
+constexpr std::optional<span<const FieldDescription>> ProjectionDescription =
+    std::nullopt;
+
+/// @returns true if the column is a primitive field of the given image type
+constexpr bool hasColumn(const span<const FieldDescription> fields,
+                         const std::string_view column, const ImageType type) {
+  for (const FieldDescription &field : fields) {
+    if (const auto *primitive =
+            std::get_if<PrimitiveFieldDescription>(&field.field)) {
+      if (field.name == column && primitive->imageType == type) {
+        return true;
+      }
+      continue;
+    }
+
+    const std::size_t prefixLength = field.name.size();
+    if (column.size() > prefixLength && column.starts_with(field.name) &&
+        column[prefixLength] == '_' &&
+        hasColumn(std::get<CompositeFieldDescription>(field.field).fields,
+                  column.substr(prefixLength + 1), type)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/// @returns true if every projection field has a matching entity column
+constexpr bool isProjectionOf(const span<const FieldDescription> projection,
+                              const EntityDescription &entity) {
+  for (const FieldDescription &field : projection) {
+    const auto *primitive =
+        std::get_if<PrimitiveFieldDescription>(&field.field);
+    if (primitive == nullptr ||
+        !hasColumn(entity.fields, field.name, primitive->imageType)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+template <typename Projection, typename Entity>
+concept ProjectionOf =
+    DatabaseEntity<Entity> && ProjectionDescription<Projection>.has_value() &&
+    isProjectionOf(ProjectionDescription<Projection>.value(),
+                   DatabaseEntityDescription<Entity>.value());
+
+template <auto MemberPtr> struct MemberPtrTraits {};
+
+template <typename Class, typename Member, Member Class::*MemberPtr>
+struct MemberPtrTraits<MemberPtr> {
+  using ClassType = Class;
+  using MemberType = Member;
+};
+
+/// Class of the member pointer
+template <auto MemberPtr>
+using MemberClass = typename MemberPtrTraits<MemberPtr>::ClassType;
+
+/// Type of the member referenced by the member pointer
+template <auto MemberPtr>
+using MemberType = typename MemberPtrTraits<MemberPtr>::MemberType;
+
+/// Index of the top-level entity field referenced by the member pointer
+template <auto MemberPtr>
+constexpr std::optional<std::size_t> DatabaseFieldIndex = std::nullopt;
+
+template <auto MemberPtr>
+concept DatabaseField = DatabaseEntity<MemberClass<MemberPtr>> &&
+                        DatabaseFieldIndex<MemberPtr>.has_value();
+
 } // namespace podrm
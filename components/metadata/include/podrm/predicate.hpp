@@ -0,0 +1,175 @@
+#pragma once
+
+#include <podrm/metadata.hpp>
+#include <podrm/span.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace podrm {
+
+enum class Comparison : std::uint8_t {
+  Equal,
+  NotEqual,
+  Less,
+  LessOrEqual,
+  Greater,
+  GreaterOrEqual,
+};
+
+/// Comparison of a top-level primitive entity field with a value
+struct Condition {
+  /// Index of the field in EntityDescription::fields
+  std::size_t field;
+
+  Comparison comparison;
+
+  /// Owning image of the value
+  AsImage value;
+};
+
+/// @returns image that does not reference the original value
+inline AsImage ownImage(AsImage image) {
+  if (const auto *text = std::get_if<std::string_view>(&image)) {
+    return std::string{*text};
+  }
+
+  if (const auto *bytes = std::get_if<span<const std::byte>>(&image)) {
+    return std::vector<std::byte>(bytes->begin(), bytes->end());
+  }
+
+  return image;
+}
+
+/// Conjunction of conditions on entity fields, empty predicate matches every
+/// entity
+template <typename Entity> struct Predicate {
+  std::vector<Condition> conditions;
+
+  friend Predicate operator&&(Predicate lhs, const Predicate &rhs) {
+    lhs.conditions.insert(lhs.conditions.end(), rhs.conditions.begin(),
+                          rhs.conditions.end());
+    return lhs;
+  }
+};
+
+enum class AssignmentOperation : std::uint8_t {
+  Set, ///< Replace the field value
+  Add, ///< Add to the numeric field value
+};
+
+/// Assignment to a top-level primitive entity field
+struct Assignment {
+  /// Index of the field in EntityDescription::fields
+  std::size_t field;
+
+  AssignmentOperation operation;
+
+  /// Owning image of the value
+  AsImage value;
+};
+
+/// Assignment to a field of the entity, used for bulk updates
+template <typename Entity> struct SetExpression {
+  Assignment assignment;
+};
+
+/// @returns true if the field is a top-level primitive field of the entity
+constexpr bool isPrimitiveField(const EntityDescription &entity,
+                                const std::size_t field) {
+  return std::holds_alternative<PrimitiveFieldDescription>(
+      entity.fields[field].field);
+}
+
+/// Top-level primitive field of a database entity
+template <auto MemberPtr>
+concept PrimitiveField =
+    DatabaseField<MemberPtr> &&
+    isPrimitiveField(DatabaseEntityDescription<MemberClass<MemberPtr>>.value(),
+                     DatabaseFieldIndex<MemberPtr>.value());
+
+/// Reference to a top-level primitive field, used to build predicates
+template <auto MemberPtr>
+  requires PrimitiveField<MemberPtr>
+class ColumnRef {
+public:
+  using Entity = MemberClass<MemberPtr>;
+  using Value = MemberType<MemberPtr>;
+
+  static constexpr std::size_t Index = DatabaseFieldIndex<MemberPtr>.value();
+
+  /// @returns assignment of the value to the field
+  [[nodiscard]] SetExpression<Entity> set(const Value &value) const {
+    return {.assignment = assign(AssignmentOperation::Set, value)};
+  }
+
+  /// @returns assignment of the field incremented by the delta
+  [[nodiscard]] SetExpression<Entity> add(const Value &delta) const
+    requires std::is_arithmetic_v<Value>
+  {
+    return {.assignment = assign(AssignmentOperation::Add, delta)};
+  }
+
+  friend Predicate<Entity> operator==(ColumnRef column, const Value &value) {
+    return column.compare(Comparison::Equal, value);
+  }
+
+  friend Predicate<Entity> operator!=(ColumnRef column, const Value &value) {
+    return column.compare(Comparison::NotEqual, value);
+  }
+
+  friend Predicate<Entity> operator<(ColumnRef column, const Value &value) {
+    return column.compare(Comparison::Less, value);
+  }
+
+  friend Predicate<Entity> operator<=(ColumnRef column, const Value &value) {
+    return column.compare(Comparison::LessOrEqual, value);
+  }
+
+  friend Predicate<Entity> operator>(ColumnRef column, const Value &value) {
+    return column.compare(Comparison::Greater, value);
+  }
+
+  friend Predicate<Entity> operator>=(ColumnRef column, const Value &value) {
+    return column.compare(Comparison::GreaterOrEqual, value);
+  }
+
+private:
+  static AsImage image(const Value &value) {
+    const auto &description = std::get<PrimitiveFieldDescription>(
+        DatabaseEntityDescription<Entity>.value().fields[Index].field);
+
+    return ownImage(description.asImage(&value));
+  }
+
+  [[nodiscard]] Predicate<Entity> compare(const Comparison comparison,
+                                          const Value &value) const {
+    return Predicate<Entity>{
+        .conditions = {Condition{
+            .field = Index,
+            .comparison = comparison,
+            .value = image(value),
+        }},
+    };
+  }
+
+  [[nodiscard]] static Assignment assign(const AssignmentOperation operation,
+                                         const Value &value) {
+    return Assignment{
+        .field = Index,
+        .operation = operation,
+        .value = image(value),
+    };
+  }
+};
+
+/// Field reference for predicates, e.g. podrm::Column<&Person::age> > 18
+template <auto MemberPtr> constexpr ColumnRef<MemberPtr> Column{};
+
+} // namespace podrm
@@ -168,8 +168,24 @@ getFieldDescriptions() {
                                  std::make_index_sequence<std::size(names)>());
 }
 
+template <detail::Reflectable T, std::size_t... Idx>
+constexpr bool hasPrimitiveFields(std::index_sequence<Idx...> /*indices*/) {
+  return (RegisteredPrimitive<boost::pfr::tuple_element_t<Idx, T>> && ...);
+}
+
 } // namespace detail
 
+/// Plain struct of registered primitives, usable as a projection of entities
+template <typename T>
+concept RegisteredProjection =
+    detail::Reflectable<T> &&
+    detail::hasPrimitiveFields<T>(
+        std::make_index_sequence<boost::pfr::tuple_size_v<T>>());
+
+template <RegisteredProjection T>
+constexpr std::optional<span<const FieldDescription>>
+    ProjectionDescription<T> = detail::FieldDescriptions<T>;
+
 template <RegisteredEntity T>
 constexpr std::optional<EntityDescription> DatabaseEntityDescription<T> =
     EntityDescription{
@@ -179,4 +195,10 @@ constexpr std::optional<EntityDescription> DatabaseEntityDescription<T> =
         .primaryKey = EntityRegistration<T>.id.get(),
     };
 
+template <auto MemberPtr>
+  requires(std::is_member_pointer_v<decltype(MemberPtr)> &&
+           RegisteredEntity<MemberClass<MemberPtr>>)
+constexpr std::optional<std::size_t> DatabaseFieldIndex<MemberPtr> =
+    FieldOf<MemberClass<MemberPtr>, MemberPtr>.get();
+
 } // namespace podrm
@@ -20,6 +20,16 @@ struct Entity {
   Composite composite;
 };
 
+struct Projection {
+  std::int64_t id;
+
+  std::int64_t composite_b; // NOLINT(readability-identifier-naming)
+};
+
+struct WrongProjection {
+  std::int64_t composite;
+};
+
 } // namespace
 
 template <>
@@ -89,4 +99,9 @@ constexpr podrm::EntityDescription ExpectedEntityDescription = {
 
 static_assert(EntityDescription == ExpectedEntityDescription);
 
+static_assert(podrm::RegisteredProjection<Projection>);
+static_assert(not podrm::RegisteredProjection<Entity>);
+static_assert(podrm::ProjectionOf<Projection, Entity>);
+static_assert(not podrm::ProjectionOf<WrongProjection, Entity>);
+
 } // namespace
@@ -60,4 +60,7 @@ constexpr podrm::EntityDescription ExpectedDescription = {
 
 static_assert(PersonDescription == ExpectedDescription);
 
+static_assert(podrm::DatabaseFieldIndex<&Person::id> == 0);
+static_assert(podrm::DatabaseFieldIndex<&Person::name> == 1);
+
 } // namespace
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+namespace podrm {
+
+/// Thrown when an operation is stopped by its cancellation token
+class OperationCancelled : public std::runtime_error {
+public:
+  OperationCancelled() : std::runtime_error{"Operation is cancelled"} {}
+};
+
+/// Thrown when an operation does not complete before its deadline
+class OperationTimedOut : public std::runtime_error {
+public:
+  OperationTimedOut() : std::runtime_error{"Operation deadline is exceeded"} {}
+};
+
+/// Observes cancellation requested by a CancellationSource, default
+/// constructed token is never cancelled
+class CancellationToken {
+public:
+  CancellationToken() = default;
+
+  [[nodiscard]] bool cancelled() const noexcept {
+    return this->state != nullptr &&
+           this->state->load(std::memory_order_relaxed);
+  }
+
+private:
+  std::shared_ptr<const std::atomic<bool>> state;
+
+  explicit CancellationToken(std::shared_ptr<const std::atomic<bool>> state)
+      : state(std::move(state)) {}
+
+  friend class CancellationSource;
+};
+
+class CancellationSource {
+public:
+  CancellationSource() : state(std::make_shared<std::atomic<bool>>(false)) {}
+
+  /// Requests cancellation of all operations with tokens of this source
+  void cancel() noexcept {
+    this->state->store(true, std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] CancellationToken token() const {
+    return CancellationToken{this->state};
+  }
+
+private:
+  std::shared_ptr<std::atomic<bool>> state;
+};
+
+/// Cancellation token and deadline of an operation
+struct OperationLimits {
+  using Clock = std::chrono::steady_clock;
+
+  CancellationToken token;
+
+  std::optional<Clock::time_point> deadline;
+
+  static OperationLimits timeout(const Clock::duration duration) {
+    return OperationLimits{
+        .token = CancellationToken{},
+        .deadline = Clock::now() + duration,
+    };
+  }
+
+  /// @returns true if the operation should be stopped
+  [[nodiscard]] bool exceeded() const {
+    return this->token.cancelled() ||
+           (this->deadline.has_value() && Clock::now() >= *this->deadline);
+  }
+
+  /// @throws OperationCancelled if the token is cancelled
+  /// @throws OperationTimedOut if the deadline has passed
+  void check() const {
+    if (this->token.cancelled()) {
+      throw OperationCancelled{};
+    }
+    if (this->deadline.has_value() && Clock::now() >= *this->deadline) {
+      throw OperationTimedOut{};
+    }
+  }
+};
+
+} // namespace podrm
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <podrm/instrumentation.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+
+namespace podrm {
+
+/// Log-linear histogram of non-negative values with a relative error below
+/// 1/64. Recording is lock-free and may run concurrently with reads, which
+/// then see a consistent enough snapshot for reporting
+class HdrHistogram {
+public:
+  void record(const std::uint64_t value) {
+    this->buckets[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+    this->total.fetch_add(1, std::memory_order_relaxed);
+    this->sum.fetch_add(value, std::memory_order_relaxed);
+
+    std::uint64_t current = this->maximum.load(std::memory_order_relaxed);
+    while (current < value &&
+           !this->maximum.compare_exchange_weak(current, value,
+                                                std::memory_order_relaxed)) {
+    }
+  }
+
+  [[nodiscard]] std::uint64_t count() const {
+    return this->total.load(std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] std::uint64_t max() const {
+    return this->maximum.load(std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] double mean() const {
+    const std::uint64_t count = this->count();
+    return count == 0 ? 0.0
+                      : static_cast<double>(
+                            this->sum.load(std::memory_order_relaxed)) /
+                            static_cast<double>(count);
+  }
+
+  /// @param percentile value in [0, 100]
+  /// @returns upper bound of the bucket containing the percentile, 0 if
+  /// nothing is recorded
+  [[nodiscard]] std::uint64_t percentile(const double percentile) const {
+    const std::uint64_t count = this->count();
+    if (count == 0) {
+      return 0;
+    }
+
+    const auto rank = std::max<std::uint64_t>(
+        1, static_cast<std::uint64_t>(
+               std::ceil(percentile / 100.0 * static_cast<double>(count))));
+    std::uint64_t seen = 0;
+    for (std::size_t bucket = 0; bucket < BucketCount; ++bucket) {
+      seen += this->buckets[bucket].load(std::memory_order_relaxed);
+      if (seen >= rank) {
+        return std::min(upperBound(bucket), this->max());
+      }
+    }
+    return this->max();
+  }
+
+  void reset() {
+    for (std::atomic<std::uint64_t> &bucket : this->buckets) {
+      bucket.store(0, std::memory_order_relaxed);
+    }
+    this->total.store(0, std::memory_order_relaxed);
+    this->sum.store(0, std::memory_order_relaxed);
+    this->maximum.store(0, std::memory_order_relaxed);
+  }
+
+private:
+  /// Values below 2^SubBucketBits get a bucket each, every further power of
+  /// two is split into 2^(SubBucketBits - 1) buckets
+  static constexpr unsigned SubBucketBits = 7;
+  static constexpr std::uint64_t SubBucketCount = std::uint64_t{1}
+                                                  << SubBucketBits;
+  static constexpr std::uint64_t HalfCount = SubBucketCount / 2;
+  static constexpr std::size_t BucketCount =
+      SubBucketCount + (64 - SubBucketBits) * HalfCount;
+
+  std::array<std::atomic<std::uint64_t>, BucketCount> buckets{};
+
+  std::atomic<std::uint64_t> total{0};
+
+  std::atomic<std::uint64_t> sum{0};
+
+  std::atomic<std::uint64_t> maximum{0};
+
+  static std::size_t bucketOf(const std::uint64_t value) {
+    if (value < SubBucketCount) {
+      return static_cast<std::size_t>(value);
+    }
+
+    const auto magnitude = static_cast<unsigned>(std::bit_width(value) - 1);
+    const unsigned shift = magnitude - (SubBucketBits - 1);
+    return static_cast<std::size_t>(
+        SubBucketCount + (magnitude - SubBucketBits) * HalfCount +
+        ((value >> shift) - HalfCount));
+  }
+
+  static std::uint64_t upperBound(const std::size_t bucket) {
+    if (bucket < SubBucketCount) {
+      return bucket;
+    }
+
+    const std::uint64_t group = (bucket - SubBucketCount) / HalfCount;
+    const std::uint64_t offset = (bucket - SubBucketCount) % HalfCount;
+    const auto shift = static_cast<unsigned>(group + 1);
+    return ((HalfCount + offset + 1) << shift) - 1;
+  }
+};
+
+/// Observer collecting statement latencies and sizes into histograms, may be
+/// shared by connections running in different threads
+class HistogramObserver final : public Observer {
+public:
+  /// Prepare plus execute time in nanoseconds
+  HdrHistogram latency;
+
+  /// Prepare time in nanoseconds of statements that were not cached
+  HdrHistogram prepare;
+
+  HdrHistogram rows;
+
+  HdrHistogram bytesBound;
+
+  HdrHistogram bytesDecoded;
+
+  void onStatement(const StatementEvent &event) override {
+    this->latency.record(
+        static_cast<std::uint64_t>((event.prepareTime + event.executeTime)
+                                       .count()));
+    if (!event.cacheHit) {
+      this->prepare.record(
+          static_cast<std::uint64_t>(event.prepareTime.count()));
+    }
+    this->rows.record(event.rows);
+    this->bytesBound.record(event.bytesBound);
+    this->bytesDecoded.record(event.bytesDecoded);
+  }
+
+  /// Writes count, mean and p50, p90, p99, p99.9 and max of every histogram
+  void dump(std::ostream &stream) const {
+    dump(stream, "latency_ns", this->latency);
+    dump(stream, "prepare_ns", this->prepare);
+    dump(stream, "rows", this->rows);
+    dump(stream, "bytes_bound", this->bytesBound);
+    dump(stream, "bytes_decoded", this->bytesDecoded);
+  }
+
+private:
+  static void dump(std::ostream &stream, const std::string_view name,
+                   const HdrHistogram &histogram) {
+    stream << name << ": count=" << histogram.count()
+           << " mean=" << histogram.mean()
+           << " p50=" << histogram.percentile(50)
+           << " p90=" << histogram.percentile(90)
+           << " p99=" << histogram.percentile(99)
+           << " p99.9=" << histogram.percentile(99.9)
+           << " max=" << histogram.max() << '\n';
+  }
+};
+
+} // namespace podrm
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <podrm/metadata.hpp>
+#include <podrm/span.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+namespace podrm {
+
+/// Statement executed by a backend, reported once its result is consumed
+struct StatementEvent {
+  /// Table of the operation, empty for statements not bound to an entity
+  std::string_view entity;
+
+  /// Database operation that runs the statement, e.g. "persist"
+  std::string_view operation;
+
+  std::string_view statement;
+
+  std::chrono::nanoseconds prepareTime;
+
+  /// Time spent executing the statement and stepping through its rows
+  std::chrono::nanoseconds executeTime;
+
+  /// Number of returned rows for queries, affected rows otherwise
+  std::uint64_t rows;
+
+  std::uint64_t bytesBound;
+
+  std::uint64_t bytesDecoded;
+
+  /// Whether a cached prepared statement was reused
+  bool cacheHit;
+};
+
+/// Receives events of every statement of a database. Called from the thread
+/// that runs the statement, must not throw or use the database
+class Observer {
+public:
+  Observer() = default;
+  Observer(const Observer &) = delete;
+  Observer(Observer &&) = delete;
+  Observer &operator=(const Observer &) = delete;
+  Observer &operator=(Observer &&) = delete;
+  virtual ~Observer() = default;
+
+  virtual void onStatement(const StatementEvent &event) = 0;
+};
+
+/// @returns number of bytes of the bound value
+inline std::uint64_t imageSize(const AsImage &image) {
+  return std::visit(
+      [](const auto &value) -> std::uint64_t {
+        using Image = std::decay_t<decltype(value)>;
+        if constexpr (std::is_same_v<Image, span<const std::byte>> ||
+                      std::is_same_v<Image, std::vector<std::byte>> ||
+                      std::is_same_v<Image, std::string_view> ||
+                      std::is_same_v<Image, std::string>) {
+          return value.size();
+        } else {
+          return sizeof(value);
+        }
+      },
+      image);
+}
+
+namespace detail {
+
+/// Entity and operation of the statements run by the current thread
+struct OperationContext {
+  std::string_view entity;
+  std::string_view operation;
+};
+
+inline thread_local OperationContext currentOperation;
+
+/// Sets the entity and operation reported for statements run during its
+/// lifetime, nested scopes restore the outer operation
+class OperationScope {
+public:
+  /// @param enabled whether the statements are reported, disabled scopes
+  /// leave the current operation untouched
+  OperationScope(const std::string_view entity,
+                 const std::string_view operation, const bool enabled)
+      : enabled(enabled) {
+    if (enabled) {
+      this->previous = currentOperation;
+      currentOperation = {.entity = entity, .operation = operation};
+    }
+  }
+
+  OperationScope(const OperationScope &) = delete;
+  OperationScope(OperationScope &&) = delete;
+  OperationScope &operator=(const OperationScope &) = delete;
+  OperationScope &operator=(OperationScope &&) = delete;
+
+  ~OperationScope() {
+    if (this->enabled) {
+      currentOperation = this->previous;
+    }
+  }
+
+private:
+  bool enabled;
+
+  OperationContext previous;
+};
+
+/// Measures time between laps, disabled stopwatches do not read the clock
+class Stopwatch {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit Stopwatch(const bool enabled)
+      : enabled(enabled),
+        start(enabled ? Clock::now() : Clock::time_point{}) {}
+
+  /// @returns time since the previous lap or the start, zero if disabled
+  std::chrono::nanoseconds lap() {
+    if (!this->enabled) {
+      return {};
+    }
+
+    const Clock::time_point now = Clock::now();
+    const std::chrono::nanoseconds elapsed = now - this->start;
+    this->start = now;
+    return elapsed;
+  }
+
+  [[nodiscard]] bool running() const { return this->enabled; }
+
+private:
+  bool enabled;
+
+  Clock::time_point start;
+};
+
+/// @returns total number of bytes of the bound values
+inline std::uint64_t boundSize(const span<const AsImage> args) {
+  std::uint64_t size = 0;
+  for (const AsImage &arg : args) {
+    size += imageSize(arg);
+  }
+  return size;
+}
+
+} // namespace detail
+
+} // namespace podrm
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <podrm/instrumentation.hpp>
+#include <podrm/metadata.hpp>
+#include <podrm/span.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace podrm::detail {
+
+/// Event of a query, completed while its result is stepped through
+struct Observation {
+  Observer &observer;
+
+  /// Owns the statement text referenced by the event
+  std::string statement;
+
+  StatementEvent event;
+
+  Stopwatch stopwatch{true};
+
+  /// Reports the event to the observer
+  void emit() {
+    this->event.statement = this->statement;
+    this->observer.onStatement(this->event);
+  }
+};
+
+/// Reports a statement without a result set in the current operation
+inline void notify(Observer &observer, const std::string_view statement,
+                   const std::chrono::nanoseconds prepareTime,
+                   const std::chrono::nanoseconds executeTime,
+                   const std::uint64_t rows, const span<const AsImage> args,
+                   const bool cacheHit) {
+  observer.onStatement(StatementEvent{
+      .entity = currentOperation.entity,
+      .operation = currentOperation.operation,
+      .statement = statement,
+      .prepareTime = prepareTime,
+      .executeTime = executeTime,
+      .rows = rows,
+      .bytesBound = boundSize(args),
+      .bytesDecoded = 0,
+      .cacheHit = cacheHit,
+  });
+}
+
+/// @returns observation of a query in the current operation, completed by
+/// its result, nullptr without an observer
+inline std::unique_ptr<Observation>
+observe(Observer *const observer, const std::string_view statement,
+        const std::chrono::nanoseconds prepareTime,
+        const span<const AsImage> args, const bool cacheHit) {
+  if (observer == nullptr) {
+    return nullptr;
+  }
+
+  return std::make_unique<Observation>(Observation{
+      .observer = *observer,
+      .statement = std::string{statement},
+      .event =
+          StatementEvent{
+              .entity = currentOperation.entity,
+              .operation = currentOperation.operation,
+              .statement = {},
+              .prepareTime = prepareTime,
+              .executeTime = {},
+              .rows = 0,
+              .bytesBound = boundSize(args),
+              .bytesDecoded = 0,
+              .cacheHit = cacheHit,
+          },
+  });
+}
+
+} // namespace podrm::detail
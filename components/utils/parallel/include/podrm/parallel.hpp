@@ -0,0 +1,120 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace podrm {
+
+/// @param requested number of workers, 0 for one per hardware thread
+/// @returns number of workers to use, at least one
+inline std::size_t workerCount(const std::size_t requested) {
+  if (requested != 0) {
+    return requested;
+  }
+  return std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+}
+
+/// Runs the tasks on the workers, the calling thread being the first one.
+/// Every worker starts with a contiguous block of tasks and, once it runs
+/// out, steals tasks from the ends of the other blocks
+/// @param body called as body(worker, task) for every task in [0, tasks)
+/// @throws the first exception thrown by the body, remaining tasks are
+/// skipped
+template <typename Body>
+void parallelFor(const std::size_t tasks, const std::size_t workers,
+                 const Body &body) {
+  const std::size_t count = std::min(workerCount(workers), tasks);
+  if (count == 0) {
+    return;
+  }
+
+  struct Queue {
+    std::mutex mutex;
+    std::deque<std::size_t> tasks;
+  };
+
+  std::vector<Queue> queues(count);
+  for (std::size_t worker = 0; worker < count; ++worker) {
+    for (std::size_t task = worker * tasks / count;
+         task < (worker + 1) * tasks / count; ++task) {
+      queues[worker].tasks.push_back(task);
+    }
+  }
+
+  // Own tasks are taken from the front and stolen ones from the back, so
+  // that owners and thieves rarely contend for the same task
+  using Task = std::optional<std::size_t>;
+  const auto next = [&queues, count](const std::size_t worker) -> Task {
+    for (std::size_t offset = 0; offset < count; ++offset) {
+      Queue &queue = queues[(worker + offset) % count];
+      const std::lock_guard lock{queue.mutex};
+      if (queue.tasks.empty()) {
+        continue;
+      }
+      std::size_t task = 0;
+      if (offset == 0) {
+        task = queue.tasks.front();
+        queue.tasks.pop_front();
+      } else {
+        task = queue.tasks.back();
+        queue.tasks.pop_back();
+      }
+      return task;
+    }
+    return std::nullopt;
+  };
+
+  std::atomic<bool> failed{false};
+  std::mutex errorMutex;
+  std::exception_ptr error;
+
+  const auto work = [&](const std::size_t worker) {
+    try {
+      while (!failed.load(std::memory_order_relaxed)) {
+        const Task task = next(worker);
+        if (!task.has_value()) {
+          return;
+        }
+        body(worker, *task);
+      }
+    } catch (...) {
+      const std::lock_guard lock{errorMutex};
+      if (error == nullptr) {
+        error = std::current_exception();
+      }
+      failed.store(true, std::memory_order_relaxed);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(count - 1);
+  try {
+    for (std::size_t worker = 1; worker < count; ++worker) {
+      threads.emplace_back(work, worker);
+    }
+  } catch (...) {
+    failed.store(true, std::memory_order_relaxed);
+    for (std::thread &thread : threads) {
+      thread.join();
+    }
+    throw;
+  }
+
+  work(0);
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  if (error != nullptr) {
+    std::rethrow_exception(error);
+  }
+}
+
+} // namespace podrm
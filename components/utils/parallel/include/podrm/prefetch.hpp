@@ -0,0 +1,200 @@
+#pragma once
+
+#include <podrm/instrumentation.hpp>
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace podrm {
+
+/// Input range reading another range ahead in a background thread, which
+/// stops once the bounded buffer is full until values are consumed.
+/// Exceptions of the source are rethrown by the iterator after the values
+/// read before them
+template <typename T> class Prefetched {
+public:
+  class Iterator;
+  class Sentinel {};
+
+  /// Starts reading the range in a background thread, which then owns it.
+  /// Statements run by the thread are reported in the current operation
+  /// @param capacity maximum number of values read ahead
+  template <typename Range>
+  Prefetched(Range range, const std::size_t capacity)
+      : state(std::make_unique<State>()) {
+    if (capacity == 0) {
+      throw std::invalid_argument{"Prefetch capacity must be positive"};
+    }
+    this->state->buffer.resize(capacity);
+
+    this->producer =
+        std::thread{[state = this->state.get(), range = std::move(range),
+                     context = detail::currentOperation]() mutable {
+          const detail::OperationScope scope{context.entity, context.operation,
+                                             !context.operation.empty()};
+          produce(*state, range);
+        }};
+  }
+
+  Prefetched(const Prefetched &) = delete;
+  Prefetched(Prefetched &&) noexcept = default;
+  Prefetched &operator=(const Prefetched &) = delete;
+  Prefetched &operator=(Prefetched &&) = delete;
+
+  /// Stops reading ahead and waits for the background thread
+  ~Prefetched() {
+    if (this->state == nullptr) {
+      return;
+    }
+
+    {
+      const std::lock_guard lock{this->state->mutex};
+      this->state->stopping = true;
+    }
+    this->state->notFull.notify_one();
+    this->producer.join();
+  }
+
+  /// Waits for the first value
+  Iterator begin() {
+    this->advance();
+    return Iterator{*this};
+  }
+
+  Sentinel end() { return Sentinel{}; }
+
+private:
+  struct State {
+    std::mutex mutex;
+
+    std::condition_variable notFull;
+
+    std::condition_variable notEmpty;
+
+    /// Ring buffer of values read ahead
+    std::vector<std::optional<T>> buffer;
+
+    std::size_t head = 0;
+
+    std::size_t size = 0;
+
+    /// Set once the source is exhausted or failed
+    bool done = false;
+
+    bool stopping = false;
+
+    std::exception_ptr error;
+  };
+
+  /// Kept on the heap so that its address survives moves
+  std::unique_ptr<State> state;
+
+  std::thread producer;
+
+  /// Value the iterator points to, empty at the end
+  std::optional<T> current;
+
+  template <typename Range> static void produce(State &state, Range &range) {
+    try {
+      for (auto &&value : range) {
+        std::unique_lock lock{state.mutex};
+        state.notFull.wait(lock, [&state] {
+          return state.size < state.buffer.size() || state.stopping;
+        });
+        if (state.stopping) {
+          return;
+        }
+
+        state.buffer[(state.head + state.size) % state.buffer.size()].emplace(
+            std::forward<decltype(value)>(value));
+        ++state.size;
+        lock.unlock();
+        state.notEmpty.notify_one();
+      }
+    } catch (...) {
+      const std::lock_guard lock{state.mutex};
+      state.error = std::current_exception();
+    }
+
+    {
+      const std::lock_guard lock{state.mutex};
+      state.done = true;
+    }
+    state.notEmpty.notify_one();
+  }
+
+  /// Moves the next value into current, waiting for it if needed
+  /// @throws exception of the source once all values before it are consumed
+  void advance() {
+    std::unique_lock lock{this->state->mutex};
+    this->state->notEmpty.wait(lock, [this] {
+      return this->state->size > 0 || this->state->done;
+    });
+
+    if (this->state->size == 0) {
+      this->current.reset();
+      if (this->state->error != nullptr) {
+        std::rethrow_exception(std::exchange(this->state->error, nullptr));
+      }
+      return;
+    }
+
+    std::optional<T> &slot = this->state->buffer[this->state->head];
+    this->current = std::move(slot);
+    slot.reset();
+    this->state->head = (this->state->head + 1) % this->state->buffer.size();
+    --this->state->size;
+    lock.unlock();
+    this->state->notFull.notify_one();
+  }
+};
+
+template <typename T> class Prefetched<T>::Iterator {
+public:
+  using value_type = T;
+  using difference_type = std::ptrdiff_t;
+
+  T &operator*() const { return *this->prefetched->current; }
+
+  T *operator->() const { return &*this->prefetched->current; }
+
+  Iterator &operator++() {
+    this->prefetched->advance();
+    return *this;
+  }
+
+  void operator++(int) { ++*this; }
+
+  bool operator==(const Sentinel /*sentinel*/) const {
+    return !this->prefetched->current.has_value();
+  }
+
+private:
+  Prefetched *prefetched;
+
+  explicit Iterator(Prefetched &prefetched) : prefetched(&prefetched) {}
+
+  friend class Prefetched<T>;
+};
+
+/// Reads the range, e.g. a database cursor, in a background thread while
+/// the caller processes the values. The database must allow its cursors to
+/// be stepped by another thread, which rules out SQLite connections opened
+/// with ConnectionOptions::noMutex
+/// @param capacity maximum number of values read ahead
+template <typename Range>
+Prefetched<std::remove_cvref_t<decltype(*std::declval<Range &>().begin())>>
+prefetch(Range range, const std::size_t capacity) {
+  return {std::move(range), capacity};
+}
+
+} // namespace podrm
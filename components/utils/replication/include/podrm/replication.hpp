@@ -0,0 +1,129 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace podrm {
+
+/// Routing settings of a database with read replicas
+struct ReplicationOptions {
+  using Clock = std::chrono::steady_clock;
+
+  /// Reads go to the primary for this long after a write of the same
+  /// session, so that the session sees its own writes despite replication
+  /// lag. Zero disables stickiness
+  Clock::duration stickiness = std::chrono::seconds{0};
+
+  /// Failed replicas are skipped for this long before they are tried again
+  Clock::duration retryAfter = std::chrono::seconds{5};
+};
+
+namespace detail {
+
+/// Sends writes to the primary and spreads reads over healthy replicas,
+/// falling back to the primary once every replica fails
+/// @tparam Db database type with an alive() health check
+template <typename Db> class ReplicaRouter {
+public:
+  using Clock = ReplicationOptions::Clock;
+
+  ReplicaRouter(Db primary, std::vector<Db> replicas,
+                const ReplicationOptions &options)
+      : primaryDb(std::move(primary)), replicaDbs(std::move(replicas)),
+        unhealthyUntil(this->replicaDbs.size()), options(options) {}
+
+  Db &primary() { return this->primaryDb; }
+
+  std::vector<Db> &replicas() { return this->replicaDbs; }
+
+  /// @returns primary database for a write, starting the stickiness window
+  Db &write() {
+    this->lastWrite = Clock::now();
+    return this->primaryDb;
+  }
+
+  /// Runs the read on the next replica not marked unhealthy. Replicas are
+  /// only checked once a read fails: replicas failing the health check then
+  /// are marked unhealthy and the read is retried on the next one. Errors of
+  /// a healthy replica, e.g. cancellation, are rethrown as is
+  /// @param read called as read(Db &)
+  template <typename Read> decltype(auto) read(Read &&read) {
+    const Clock::time_point now = Clock::now();
+    if (this->lastWrite.has_value() &&
+        now - *this->lastWrite < this->options.stickiness) {
+      return std::invoke(read, this->primaryDb);
+    }
+
+    for (std::size_t attempt = 0; attempt < this->replicaDbs.size();
+         ++attempt) {
+      const std::size_t index = this->next;
+      this->next = (this->next + 1) % this->replicaDbs.size();
+
+      if (now < this->unhealthyUntil[index]) {
+        continue;
+      }
+
+      Db &replica = this->replicaDbs[index];
+      try {
+        return std::invoke(read, replica);
+      } catch (const std::exception &) {
+        if (alive(replica)) {
+          throw;
+        }
+      }
+      this->unhealthyUntil[index] = now + this->options.retryAfter;
+    }
+
+    return std::invoke(read, this->primaryDb);
+  }
+
+  /// Checks every replica now, returning the failed ones to rotation once
+  /// they recover
+  /// @returns number of healthy replicas
+  std::size_t checkHealth() {
+    const Clock::time_point now = Clock::now();
+    std::size_t healthy = 0;
+    for (std::size_t i = 0; i < this->replicaDbs.size(); ++i) {
+      if (alive(this->replicaDbs[i])) {
+        this->unhealthyUntil[i] = {};
+        ++healthy;
+      } else {
+        this->unhealthyUntil[i] = now + this->options.retryAfter;
+      }
+    }
+    return healthy;
+  }
+
+private:
+  Db primaryDb;
+
+  std::vector<Db> replicaDbs;
+
+  /// Replicas are skipped until these time points after a failure
+  std::vector<Clock::time_point> unhealthyUntil;
+
+  ReplicationOptions options;
+
+  /// Replica to try first on the next read
+  std::size_t next = 0;
+
+  std::optional<Clock::time_point> lastWrite;
+
+  /// @returns false if the health check fails or throws
+  static bool alive(Db &db) {
+    try {
+      return db.alive();
+    } catch (const std::exception &) {
+      return false;
+    }
+  }
+};
+
+} // namespace detail
+
+} // namespace podrm
@@ -0,0 +1,132 @@
+#include <podrm/replication.hpp>
+
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+namespace {
+
+/// Database whose health is switched by the test
+struct FakeDb {
+  std::string name;
+
+  std::shared_ptr<bool> up = std::make_shared<bool>(true);
+
+  /// Number of health checks
+  std::shared_ptr<int> checks = std::make_shared<int>(0);
+
+  [[nodiscard]] bool alive() const {
+    ++*this->checks;
+    return *this->up;
+  }
+};
+
+using Router = podrm::detail::ReplicaRouter<FakeDb>;
+
+/// @throws std::runtime_error if the database is down
+std::string readName(FakeDb &db) {
+  if (!*db.up) {
+    throw std::runtime_error{"Connection lost"};
+  }
+  return db.name;
+}
+
+} // namespace
+
+TEST_CASE("ReplicaRouter spreads reads over healthy replicas",
+          "[replication]") {
+  using namespace std::chrono_literals;
+
+  const FakeDb primary{.name = "primary"};
+  const FakeDb first{.name = "first"};
+  const FakeDb second{.name = "second"};
+  Router router{primary, {first, second}, {.retryAfter = 200ms}};
+
+  SECTION("replicas are used in turn") {
+    CHECK(router.read(readName) == "first");
+    CHECK(router.read(readName) == "second");
+    CHECK(router.read(readName) == "first");
+  }
+
+  SECTION("reads do not check healthy replicas") {
+    CHECK(router.read(readName) == "first");
+    CHECK(router.read(readName) == "second");
+    CHECK(*first.checks == 0);
+    CHECK(*second.checks == 0);
+  }
+
+  SECTION("dead replicas are skipped") {
+    *first.up = false;
+    CHECK(router.read(readName) == "second");
+    CHECK(router.read(readName) == "second");
+    CHECK(router.read(readName) == "second");
+    CHECK(*first.checks == 1);
+  }
+
+  SECTION("replicas are tried again after retryAfter") {
+    *first.up = false;
+    CHECK(router.read(readName) == "second");
+
+    *first.up = true;
+    CHECK(router.read(readName) == "second");
+    CHECK(router.read(readName) == "second");
+
+    std::this_thread::sleep_for(250ms);
+    CHECK(router.read(readName) == "first");
+    CHECK(router.read(readName) == "second");
+  }
+
+  SECTION("health checks return replicas at once") {
+    *first.up = false;
+    CHECK(router.checkHealth() == 1);
+    CHECK(router.read(readName) == "second");
+    CHECK(router.read(readName) == "second");
+
+    *first.up = true;
+    CHECK(router.checkHealth() == 2);
+    CHECK(router.read(readName) == "first");
+  }
+
+  SECTION("reads fall back to the primary without healthy replicas") {
+    *first.up = false;
+    *second.up = false;
+    CHECK(router.read(readName) == "primary");
+    CHECK(router.read(readName) == "primary");
+  }
+
+  SECTION("reads failing on a dead replica are retried") {
+    const auto failOnFirst = [&first](FakeDb &db) {
+      if (db.name == "first") {
+        *first.up = false;
+        throw std::runtime_error{"Connection lost"};
+      }
+      return db.name;
+    };
+
+    CHECK(router.read(failOnFirst) == "second");
+    CHECK(router.read(readName) == "second");
+  }
+
+  SECTION("errors of healthy replicas are rethrown") {
+    const auto cancelled = [](FakeDb & /*db*/) -> std::string {
+      throw std::runtime_error{"Cancelled"};
+    };
+
+    CHECK_THROWS_AS(router.read(cancelled), std::runtime_error);
+    CHECK(router.read(readName) == "second");
+  }
+
+  SECTION("writes make reads sticky to the primary") {
+    Router sticky{primary, {first, second}, {.stickiness = 1h}};
+    CHECK(sticky.read(readName) == "first");
+
+    CHECK(sticky.write().name == "primary");
+    CHECK(sticky.read(readName) == "primary");
+  }
+}